@@ -19,6 +19,8 @@ namespace Engine
 
 		float fovy;
 		glm::mat4 projMatrix;
+		// Vertical resolution of the viewport (pixels)
+		float viewportHeight;
 
 		glm::vec3 translation;
 		glm::vec3 rotation;
@@ -38,6 +40,9 @@ namespace Engine
 		void onWindowResize(int width, int height);
 
 		float getFOV();
+		float getViewportHeight() const;
+		float getNearPlane() const;
+		float getFarPlane() const;
 
 		glm::mat4 & getProjectionMatrix();
 		glm::mat4 & getViewMatrix();
@@ -8,42 +8,66 @@
 #include <vector>
 
 #include "Camera.h"
-#include "instances/TextureInstance.h"
-#include "DeferredRenderObject.h"
+#include "IRenderable.h"
 #include "ShadowCaster.h"
+#include "ShadowCascadeCache.h"
+#include "ShadowCascadeFit.h"
 
 namespace Engine
 {
 	// Handles all shadow casters and give access to the shadow map textures to
-	// any shaders which need them
-	class CascadeShadowMaps
+	// any shaders which need them. The number of levels, their splits and their
+	// resolution are taken from the settings every frame (see ShadowCascadeFit). The levels
+	// are only rendered again where the cache needs it (see ShadowCascadeCache).
+	// The levels are the layers of a single depth texture array. Every area to render on
+	// a frame is a region with its own viewport, and the casters are drawn once for all
+	// of them: the shadow map programs emit each primitive on the regions it overlaps
+	class CascadeShadowMaps : public IRenderable
 	{
-	private:
-		// Cascade level information
-		typedef struct ShadowMap
-		{
-			// Projection matrix (holds the projection volume)
-			glm::mat4 proj;
-			// Light depth projection matrix
-			glm::mat4 depth;
-			// FBO
-			DeferredRenderObject * rtt;
-			// Pointer to the shadow map texture
-			TextureInstance * shadowMap;
-		} ShadowMap;
+	public:
+		static const unsigned int MAX_LEVELS = ShadowCascadeFit::MAX_LEVELS;
+		// Each level is rendered entirely, or on two strips when it scrolls (see ShadowCascadeCache).
+		// Must match MAX_SHADOW_REGIONS on the shadow map shaders
+		static const unsigned int MAX_REGIONS = MAX_LEVELS * 2;
 	private:
 		static CascadeShadowMaps * INSTANCE;
 	private:
-		// Cascade shadow maps (2 by default)
-		ShadowMap shadowMaps[2];
-		// varying variable used during runtime
-		int currentLevel;
-		
+		unsigned int numLevels;
+		// Shadow map texels per side
+		unsigned int resolution;
+		// Depth texture array holding a layer per level, and layers allocated on it
+		unsigned int depthTexture;
+		unsigned int depthLayers;
+		// FBO drawing on every layer at once, and FBOs of each layer alone (clears and scrolls)
+		unsigned int layeredFbo;
+		unsigned int layerFbos[MAX_LEVELS];
+		// Target of the level scrolls, copied back to the level layer
+		unsigned int spareTexture;
+		unsigned int spareFbo;
+		// Projection matrix of each level (holds the projection volume and the light view)
+		glm::mat4 levelProjections[MAX_LEVELS];
+		// Light depth matrix (bias applied) of each level, kept together to upload them at once
+		glm::mat4 depthMatrices[MAX_LEVELS];
+		// Splits and fit of the levels to the camera view
+		ShadowCascadeFit cascadeFit;
+		// Levels and areas of them rendered on each frame
+		ShadowCascadeCache shadowCache;
+
+		// Regions rendered on the last frame: projection cropped to the region area, layer (level)
+		// and area, in texels. The viewport of each region is its index
+		glm::mat4 regionProjections[MAX_REGIONS];
+		int regionLayers[MAX_REGIONS];
+		ShadowCascadeCache::Region regionAreas[MAX_REGIONS];
+		unsigned int numRegions;
+		// Draw calls issued to render every region on the last frame
+		unsigned int shadowDrawCalls;
+
 		// Shadow bias
 		glm::mat4 biasMatrix;
 
-		// Previous frame buffer before starting to render shadows to custom rtt
+		// Previous frame buffer and viewport before starting to render shadows to custom rtt
 		int previousFrameBuffer;
+		int previousViewport[4];
 
 		// List of renderable objects which cast shadows
 		std::vector<ShadowCaster *> shadowCasters;
@@ -51,32 +75,64 @@ namespace Engine
 		static CascadeShadowMaps & getInstance();
 	private:
 		CascadeShadowMaps();
-		void initializeShadowMap(int level, float minX, float maxX, float minY, float maxY, float minZ, float maxZ);
+		// (Re)creates the depth texture array and the spare map for the current levels and resolution
+		void allocateShadowMaps();
+		// Matches the levels and their resolution to the settings
+		void configure(Camera * eye);
+		// Moves the content of a level shadow map by whole texels: the texel (x, y) moves to (x - shiftX, y - shiftY)
+		void scrollShadowMap(unsigned int level, int shiftX, int shiftY);
+		// Clears an area (texels) of a level, and adds it to the regions to render
+		void addRegion(unsigned int level, const ShadowCascadeCache::Region & region);
 	public:
 		// Init all static data not changed throught the execution
 		void init();
-		// Computes the depth matrices given the camera position at the beginning of each frame (only once per frame)
-		// We want the shadow maps to be projected around the camera
+		// Fits the levels to the camera view at the beginning of each frame (only once per frame),
+		// and renders the shadow casters on them
 		void initializeFrame(Camera * eye);
-		// Prepares the system to render to the shadow map
-		void beginShadowRender(int level);
+		// Prepares the system to render the regions on the shadow maps
+		void beginShadowRender();
 		// Restores engine previous state
 		void endShadowRender();
 		// Register a element which can cast shadows
 		void registerShadowCaster(ShadowCaster * caster);
 
-		// Calls the shadow render code of each registered shadowcaster
+		// Calls the shadow render code of each registered shadowcaster once, with the projection
+		// of every region to render
 		void renderShadows(Camera * cam);
 
-		const glm::mat4 & getShadowProjectionMat();
+		const glm::mat4 & getShadowProjectionMat(unsigned int level);
 		const glm::mat4 & getBiasMat();
 
 		unsigned int getCascadeLevels();
 
-		const glm::mat4 & getDepthMatrix0();
-		const glm::mat4 & getDepthMatrix1();
+		// Regions rendered by renderShadows(), and level of each of them
+		unsigned int getShadowRegions();
+		unsigned int getRegionLevel(unsigned int region);
+		// Sets the layer of each region rendered and the number of regions on the shadow map program uniforms
+		void setRegionUniforms(unsigned int layersUniform, unsigned int regionsUniform);
+
+		const glm::mat4 & getDepthMatrix(unsigned int level);
+		// Depth matrices of every level
+		const glm::mat4 * getDepthMatrices();
+		// Depth matrices of every level applied to a model matrix. Returns the number of levels
+		unsigned int getDepthMatrices(const glm::mat4 & model, glm::mat4 * result);
+
+		// Binds the depth texture array to the texture unit 0, and sets it on the sampler uniform.
+		// The units 1 to MAX_LEVELS - 1 are left free
+		void bindDepthTextures(unsigned int samplerUniform);
+
+		// Splits, bounding spheres and texel density of the levels
+		const ShadowCascadeFit & getCascadeFit() const;
+		// Update of each level on the last frame, and how often they were reused
+		const ShadowCascadeCache & getCascadeCache() const;
+		unsigned int getShadowDrawCalls() const;
+		// Bytes used by the shadow maps in use
+		size_t getMemoryUsage() const;
 
-		const TextureInstance * getDepthTexture0();
-		const TextureInstance * getDepthTexture1();
+		void notifyRenderModeUpdate(RenderMode mode);
+		// Renders every level entirely on the next frame, as the light direction might have changed
+		void notifyLightUpdate();
+		// Renders again the levels holding the bounds, as the casters within them changed
+		void notifyCasterUpdate(const glm::vec3 & boundsMin, const glm::vec3 & boundsMax);
 	};
 }
\ No newline at end of file
@@ -17,6 +17,8 @@ namespace Engine
 	{
 		GLenum bufferType;
 		TextureInstance * texture;
+		// Texture owned by someone else, which neither resizes nor releases it
+		bool shared;
 	} typedef BufferInfo;
 
 	// FBO Wrapper class. Eases the access, use, and manipulation of FBOs
@@ -60,6 +62,14 @@ namespace Engine
 		TextureInstance * addDepthBuffer32(unsigned int w, unsigned int h);
 		TextureInstance * getBufferByName(std::string name);
 
+		// Attach textures created elsewhere (such as the ones a render graph shares between passes).
+		// Their owner resizes them before the FBOs are resized
+		void attachColorBuffer(unsigned int index, TextureInstance * texture, std::string name = "");
+		void attachDepthBuffer(TextureInstance * texture);
+
+		// Creates a texture suitable as color or depth attachment
+		static TextureInstance * createRenderTexture(GLenum gpuTextureFormat, GLenum inputTextureFormat, GLenum pixelFormat, unsigned int w, unsigned int h, std::string name = "", int filterMethod = GL_NEAREST);
+
 		void initialize();
 		void setResizeMod(float widthMod = 1.0f, float heightMod = 1.0f);
 		void resizeFBO(unsigned int w, unsigned int h);
@@ -0,0 +1,44 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+namespace Engine
+{
+	// Geometry submitted to the GPU by the renderers which support levels of detail, so
+	// their savings can be inspected at runtime. Renderers record their draws during the
+	// frame, and the totals are published once it ends
+	class FrameStatistics
+	{
+	private:
+		static unsigned int currentDrawCalls;
+		static unsigned long long currentTriangles;
+		static unsigned long long currentFullDetailTriangles;
+
+		// Draw commands issued since the start
+		static unsigned long long totalDrawCalls;
+	public:
+		// Totals of the last complete frame
+		static unsigned int drawCalls;
+		static unsigned long long triangles;
+		// Triangles which would have been submitted drawing everything at full detail
+		static unsigned long long fullDetailTriangles;
+
+		static void recordDraw(unsigned long long triangles, unsigned long long fullDetailTriangles);
+		// Publishes the totals of the frame and starts a new one
+		static void endFrame();
+
+		// Counts a draw command of a renderer without levels of detail (recordDraw() counts its draws)
+		static void countDrawCall();
+		// Replaces the GL uniform entry points by ones which count the calls before forwarding them.
+		// Must be called once GLEW is initialized. Only done on request (Settings::countUniformCalls),
+		// otherwise the uniform call counts stay at 0
+		static void installUniformCounter();
+		// Restores the driver entry points
+		static void removeUniformCounter();
+		// GL calls issued since the start. The calls of a pass are the difference before and after it
+		static unsigned long long getDrawCallCount();
+		static unsigned long long getUniformCallCount();
+	};
+}
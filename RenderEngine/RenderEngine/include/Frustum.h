@@ -0,0 +1,73 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace Engine
+{
+	// List of axis aligned bounding boxes, stored as structure of arrays so
+	// they can be tested against a frustum 4 at a time
+	class BoundingBoxList
+	{
+	private:
+		std::vector<float> minX, minY, minZ;
+		std::vector<float> maxX, maxY, maxZ;
+	public:
+		void clear();
+		void reserve(size_t count);
+		void add(const glm::vec3 & boundsMin, const glm::vec3 & boundsMax);
+
+		size_t size() const;
+
+		glm::vec3 getMin(size_t index) const;
+		glm::vec3 getMax(size_t index) const;
+
+		friend class Frustum;
+	};
+
+	// View volume defined by 6 planes, extracted from a view projection matrix
+	// (Gribb & Hartmann). Plane normals point towards the inside of the volume
+	class Frustum
+	{
+	public:
+		enum FrustumPlane
+		{
+			PLANE_LEFT,
+			PLANE_RIGHT,
+			PLANE_BOTTOM,
+			PLANE_TOP,
+			PLANE_NEAR,
+			PLANE_FAR,
+			PLANE_COUNT
+		};
+	private:
+		// (normal, distance), normalized
+		glm::vec4 planes[PLANE_COUNT];
+	public:
+		Frustum();
+		Frustum(const glm::mat4 & viewProjection);
+
+		void update(const glm::mat4 & viewProjection);
+
+		const glm::vec4 & getPlane(FrustumPlane plane) const;
+
+		// Removes the given plane, so the volume extends infinitely past it (such as a shadow map
+		// volume extruded towards the light, as everything between the light and it casts shadows)
+		void extrude(FrustumPlane plane);
+
+		// Conservative test: returns false only if the box is fully outside one of the planes
+		bool intersects(const glm::vec3 & boundsMin, const glm::vec3 & boundsMax) const;
+
+		// Same test as intersects() for every box of the list, 4 at a time. visible must hold
+		// boxes.size() values, which are set to 1 for the intersecting boxes and to 0 for the
+		// rest. Returns the number of intersecting boxes
+		size_t intersects(const BoundingBoxList & boxes, unsigned char * visible) const;
+	};
+}
@@ -19,5 +19,11 @@ namespace Engine
 	{
 	public:
 		virtual void notifyRenderModeUpdate(RenderMode mode) = 0;
+
+		// The light color or direction changed
+		virtual void notifyLightUpdate()
+		{
+
+		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace Engine
+{
+	/**
+	 * Vertex buffer holding per instance data (a vec4 per instance) for instanced draws. Its
+	 * contents are replaced on every upload, orphaning the previous storage so draws still
+	 * reading it do not stall the upload
+	 */
+	class InstanceBuffer
+	{
+	private:
+		// Buffer id, created on the first upload
+		unsigned int vbo;
+		// Instances the buffer storage can hold
+		size_t capacity;
+		// Instances of the last upload
+		size_t numInstances;
+	public:
+		InstanceBuffer();
+
+		void upload(const std::vector<glm::vec4> & instances);
+		// Feeds the instances, from firstInstance on, to the attribute location of the bound
+		// vertex array, advancing once per instance
+		void bind(unsigned int location, size_t firstInstance = 0);
+		// Stops feeding the attribute, so other programs drawing the same vertex array do not read it
+		void unbind(unsigned int location);
+
+		size_t getNumInstances() const;
+
+		void destroy();
+	};
+}
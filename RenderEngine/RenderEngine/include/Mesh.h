@@ -7,8 +7,16 @@
 
 #include <assimp\scene.h>
 
+#include "VertexFormat.h"
+
 namespace Engine
 {
+	// Tag to build a Mesh which takes ownership of the given arrays (allocated with new[]) instead of copying them
+	struct AdoptBuffersTag
+	{
+	};
+	static const AdoptBuffersTag ADOPT_BUFFERS = AdoptBuffersTag();
+
 	// Represents a triangle mesh
 	// Is also in charge of syncing and releasing CPU and GPU resources
 	// related to the mesh
@@ -26,6 +34,11 @@ namespace Engine
 		float *emission;
 		float *uvs;
 		float *tangents;
+
+		// GPU storage layout of the vertex attributes
+		VertexFormat format;
+		// GL type of the indices on the GPU (16 bit when all vertices can be addressed with them)
+		unsigned int indexType;
 	public:
 		unsigned int vao;
 		unsigned int vboFaces;
@@ -35,12 +48,18 @@ namespace Engine
 		unsigned int vboEmission;
 		unsigned int vboUVs;
 		unsigned int vboTangents;
+		// Single buffer holding all the attributes when the vertex format is interleaved
+		unsigned int vboInterleaved;
 
 	public:
 		Mesh();
-		Mesh(aiMesh * mesh);
-		Mesh(const unsigned int numF, const unsigned int numV, const unsigned int *f, const float *v, const float *c, const float *n, const float *uv, const float *t, const float *e = 0);
+		Mesh(aiMesh * mesh, bool uploadToGPU = true);
+		// If uploadToGPU is false, syncGPU() must be called later on the thread owning the GL context
+		Mesh(const unsigned int numF, const unsigned int numV, const unsigned int *f, const float *v, const float *c, const float *n, const float *uv, const float *t, const float *e = 0, bool uploadToGPU = true);
+		Mesh(AdoptBuffersTag, const unsigned int numF, const unsigned int numV, unsigned int *f, float *v, float *c, float *n, float *uv, float *t, float *e = 0, bool uploadToGPU = true);
 		Mesh(const Mesh &other);
+		// Takes the CPU buffers and GPU objects of other, which is left empty
+		Mesh(Mesh &&other);
 		~Mesh();
 
 		void loadFromMesh(aiMesh * mesh);
@@ -57,10 +76,36 @@ namespace Engine
 		const float * getTangetns() const;
 		const float * getEmissive() const;
 
+		// Axis aligned bounds of the CPU vertices (zero if there are none)
+		void computeBounds(float boundsMin[3], float boundsMax[3]) const;
+
 		void computeNormals();
 		void computeTangents();
 
-		void syncGPU();
+		// Reorders faces and vertices for the GPU vertex cache and vertex fetch, and optionally to reduce
+		// overdraw (see MeshOptimizer). Only the order of the data changes, and the faces keep their order if the
+		// result would have a worse vertex cache ratio. Must be called before syncGPU()
+		void optimize(bool reduceOverdraw = false);
+
+		// Builds a simplified copy of the mesh with at most targetFaces faces, unless the error bound (relative to
+		// the mesh size, see MeshSimplifier) is reached first. The copy only holds the vertices it uses, keeps the
+		// vertex format and is not uploaded to the GPU. Returns null if the mesh is not made of triangles
+		Mesh * simplify(unsigned int targetFaces, float targetError, float * resultError = 0) const;
+
+		// Sets how the attributes will be stored on the GPU. Must be called before syncGPU()
+		void setVertexFormat(const VertexFormat & newFormat);
+		const VertexFormat & getVertexFormat() const;
+
+		// GL type of the uploaded indices (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT), to be used on the draw calls
+		unsigned int getIndexType() const;
+
+		// Uploads the mesh to the GPU. packedVertices may hold the interleaved vertex buffer, already packed
+		// with the mesh vertex format (see VertexFormat::packInterleaved), to skip packing it again
+		void syncGPU(const unsigned char * packedVertices = 0);
+
+		// Points the given shader attribute location to the mesh data of the attribute, according to
+		// the vertex format. Does nothing if the mesh does not hold the attribute. The mesh must be in use
+		void bindAttribute(VertexAttribute attribute, unsigned int location) const;
 
 		void releaseGPU();
 		void releaseCPU();
@@ -69,5 +114,9 @@ namespace Engine
 	private:
 		void extractTopology(aiMesh * mesh);
 		void extractGeometry(aiMesh * mesh);
+		// Fills data with the CPU arrays of each attribute (null if not present)
+		void getAttributeData(const float * data[VERTEX_ATTRIB_COUNT]) const;
+		// Buffer holding the given attribute when the vertex format is not interleaved
+		unsigned int getAttributeBuffer(VertexAttribute attribute) const;
 	};
 }
\ No newline at end of file
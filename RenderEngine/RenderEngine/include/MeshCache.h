@@ -0,0 +1,83 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#include "Mesh.h"
+
+#include <string>
+#include <vector>
+
+namespace Engine
+{
+	/**
+	 * Binary mesh container used to skip importing, processing or generating meshes on
+	 * later runs. A file holds the indices and vertex streams of a single mesh exactly
+	 * as they are on the CPU, its bounds, its vertex format and a hash of whatever the
+	 * mesh was built from. Files are read through a memory mapping and validated against
+	 * the format version and the expected hash, so stale files are simply rebuilt
+	 */
+	namespace MeshCache
+	{
+		// Must be increased whenever the layout or the processing applied to the cached
+		// meshes (import flags, optimization, generated geometry...) changes
+		const unsigned int VERSION = 3;
+
+		const unsigned long long HASH_SEED = 14695981039346656037ULL;
+
+		// FNV-1a hash of the given bytes. Pass the previous result as seed to hash several values
+		unsigned long long hash(const void * data, size_t size, unsigned long long seed = HASH_SEED);
+		// Hash of the indices and CPU vertex streams of the mesh (for meshes other meshes are built from)
+		unsigned long long hashMesh(const Mesh & mesh, unsigned long long seed = HASH_SEED);
+
+		// File layout: the header, followed by the indices (numFaces * 3 unsigned ints), the present
+		// attributes, in VertexAttribute order, as floats and, for interleaved vertex formats, the packed
+		// GPU vertex buffer (numVertices * vertexSize bytes). Native endianness
+		typedef struct Header
+		{
+			unsigned int magic;
+			unsigned int version;
+			unsigned long long paramHash;
+			unsigned int numFaces;
+			unsigned int numVertices;
+			// Bit (1 << VertexAttribute) set for every attribute stored
+			unsigned int attributeMask;
+			// GPU vertex format of the mesh
+			unsigned int interleaved;
+			unsigned char attributeTypes[VERTEX_ATTRIB_COUNT];
+			unsigned char padding[8 - VERTEX_ATTRIB_COUNT];
+			// Size of a packed vertex (0 if the format is not interleaved)
+			unsigned int vertexSize;
+			unsigned int reserved;
+			float boundsMin[3];
+			float boundsMax[3];
+			// Bytes following the header, to detect truncated files
+			unsigned long long dataSize;
+		} Header;
+
+		// Contents of a cache file, ready to be uploaded
+		typedef struct Entry
+		{
+			// CPU mesh, not uploaded yet
+			Mesh * mesh;
+			// Packed GPU vertex buffer to pass to Mesh::syncGPU (empty if the format is not interleaved)
+			std::vector<unsigned char> packedVertices;
+			float boundsMin[3];
+			float boundsMax[3];
+		} Entry;
+
+		// Writes the mesh CPU data to fileName. Only triangle meshes can be stored. Safe to call
+		// concurrently for different files
+		bool writeMesh(const std::string & fileName, const Mesh & mesh, unsigned long long paramHash);
+
+		// Reads fileName if it is a valid cache file built from paramHash. No per vertex processing is
+		// done, the streams are copied out of a memory mapping. Does not issue GL calls
+		bool readMesh(const std::string & fileName, unsigned long long paramHash, Entry & entry);
+
+		// Same as readMesh, but the mesh is uploaded straight from the mapping. Returns null if the file
+		// is not valid
+		Mesh * loadMesh(const std::string & fileName, unsigned long long paramHash);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace Engine
+{
+	/**
+	 * Triangle and vertex reordering passes to make better use of the GPU post-transform
+	 * vertex cache, the vertex fetch and early depth rejection. They work on indexed
+	 * triangle lists (3 indices per face) and are applied through Mesh::optimize()
+	 */
+	namespace MeshOptimizer
+	{
+		// Post-transform cache size the passes optimize for (and the default of the statistics)
+		const unsigned int DEFAULT_CACHE_SIZE = 16;
+
+		typedef struct VertexCacheStatistics
+		{
+			// Vertices transformed (cache misses)
+			unsigned int verticesTransformed;
+			// Average cache miss ratio: transformed vertices per triangle (best 0.5, worst 3)
+			float acmr;
+			// Average transform to vertex ratio: transformed vertices per referenced vertex (best 1)
+			float atvr;
+		} VertexCacheStatistics;
+
+		// Compressed vertex to corner adjacency. The corners using vertex v are corners[start[v]] to
+		// corners[start[v + 1] - 1], as positions in the index buffer (face = corner / 3) in increasing order
+		typedef struct VertexAdjacency
+		{
+			std::vector<unsigned int> start;
+			std::vector<unsigned int> corners;
+		} VertexAdjacency;
+
+		// Builds the adjacency of the triangles of the index buffer
+		void buildVertexAdjacency(VertexAdjacency & adjacency, const unsigned int * indices, size_t numIndices, size_t numVertices);
+
+		// Simulates a FIFO post-transform cache of the given size over the index buffer
+		VertexCacheStatistics analyzeVertexCache(const unsigned int * indices, size_t numIndices, size_t numVertices, unsigned int cacheSize = DEFAULT_CACHE_SIZE);
+
+		// Reorders the triangles for vertex cache locality (Tipsify, Sander et al. 2007).
+		// Triangles keep their winding
+		void optimizeVertexCache(unsigned int * indices, size_t numIndices, size_t numVertices, unsigned int cacheSize = DEFAULT_CACHE_SIZE);
+
+		// Reorders clusters of the (already cache optimized) triangles so the ones facing outwards are drawn
+		// first, which reduces overdraw from any view direction. Clusters are only split where the cache
+		// efficiency does not drop more than threshold times (1.05 = 5% worse ACMR at most)
+		void optimizeOverdraw(unsigned int * indices, size_t numIndices, const float * positions, size_t numVertices, float threshold = 1.05f, unsigned int cacheSize = DEFAULT_CACHE_SIZE);
+
+		// Computes the vertex order which makes the vertex fetch sequential: vertices are sorted by first
+		// use in the index buffer, unused ones go last. remap[oldIndex] = newIndex
+		void computeVertexFetchRemap(unsigned int * remap, const unsigned int * indices, size_t numIndices, size_t numVertices);
+	}
+}
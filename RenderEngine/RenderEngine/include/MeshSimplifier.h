@@ -0,0 +1,38 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#include <cstddef>
+
+namespace Engine
+{
+	/**
+	 * Triangle mesh simplification by quadric error edge collapse (Garland & Heckbert 1997).
+	 * Edges are collapsed onto one of their vertices, so the vertex data is not modified:
+	 * only a new index buffer is produced, and every vertex keeps its attributes
+	 */
+	namespace MeshSimplifier
+	{
+		// Settings of a level of detail: the mesh is simplified down to triangleRatio of its triangles,
+		// unless the error would exceed maxError (relative to the mesh size, as measured by simplify) first
+		typedef struct LodSettings
+		{
+			float triangleRatio;
+			float maxError;
+		} LodSettings;
+
+		// Simplifies the triangle list until it has targetIndexCount indices or the cost of the next collapse
+		// exceeds targetError, relative to the largest side of the mesh bounding box. destination must hold
+		// numIndices values. Returns the number of indices written. If resultError is given, receives the
+		// largest collapse cost, relative to the same size.
+		// The cost of a collapse is the root of the area weighted mean squared distance from the new vertex to
+		// the planes accumulated in its quadric. It bounds the accumulated quadric error only: it is not the
+		// Hausdorff distance to the original surface, which may be larger (distances are measured to the
+		// infinite planes of the faces, and averaged by area)
+		size_t simplify(unsigned int * destination, const unsigned int * indices, size_t numIndices, const float * positions, size_t numVertices,
+			size_t targetIndexCount, float targetError, float * resultError = 0);
+	}
+}
@@ -51,6 +51,13 @@ namespace Engine
 
 		// At which depth should we start to add leafs (must be < than maxDepth)
 		unsigned int depthStartingLeaf;
+
+		// Split seed mode. When > 0, every branch draws its random numbers from its own
+		// stream (derived from the seed and the branch position in the tree) and the
+		// subtrees starting at this depth are generated in parallel. The result is the
+		// same regardless of the number of threads, but differs from the default mode,
+		// where the whole tree consumes a single random sequence (0)
+		unsigned int parallelSplitDepth = 0;
 	} TreeGenerationData;
 
 	// Base class for all procedural vegation generators
@@ -66,5 +73,8 @@ namespace Engine
 
 		// Will return the tree mesh after computing it
 		virtual Mesh * generate() = 0;
+		// Same as generate(), but the mesh is not uploaded to the GPU. Does not
+		// issue GL calls, so it can be run on any thread
+		virtual Mesh * generateCPU() = 0;
 	};
 }
\ No newline at end of file
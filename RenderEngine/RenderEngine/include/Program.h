@@ -69,6 +69,8 @@ namespace Engine
 		// Clean up
 		virtual void destroy();
 	protected:
+		// Defines added to the shaders loaded by initialize()
+		virtual std::string getConfigString();
 		// Loads a shader source code and applies UBER Shader technique
 		unsigned int loadShader(std::string fileName, GLenum type, std::string configString = "", bool outputToFile = false, std::string outputFileName = "");
 	};
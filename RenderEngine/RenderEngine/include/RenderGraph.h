@@ -0,0 +1,89 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+namespace Engine
+{
+	/**
+	 * Declarative description of the full screen passes of a frame and the render targets they
+	 * read and write. Once compiled, each target lives from the first pass writing it to the last
+	 * pass reading it, and targets with the same description whose lifetimes do not overlap share
+	 * a texture. The inputs of a pass are alive while it runs, so they never share a texture with
+	 * its outputs. Passes only get a depth buffer if they write a depth target.
+	 *
+	 * The graph only runs on the CPU, it does not issue GL calls. The renderer allocates the
+	 * textures it assigns (see DeferredRenderer)
+	 */
+	class RenderGraph
+	{
+	public:
+		// Format and sampling of a render target, as given to DeferredRenderObject::addColorBuffer()
+		typedef struct TargetDesc
+		{
+			GLenum gpuTextureFormat;
+			GLenum inputTextureFormat;
+			GLenum pixelFormat;
+			int filterMethod;
+		} TargetDesc;
+
+		typedef struct Target
+		{
+			std::string name;
+			TargetDesc desc;
+			// First and last pass using it, and texture assigned (-1 if no pass uses it)
+			int firstPass;
+			int lastPass;
+			int texture;
+		} Target;
+
+		typedef struct Pass
+		{
+			std::string name;
+			std::vector<unsigned int> reads;
+			std::vector<unsigned int> writes;
+		} Pass;
+	private:
+		std::vector<Target> targets;
+		std::vector<Pass> passes;
+		// Description of each texture assigned
+		std::vector<TargetDesc> textures;
+	public:
+		RenderGraph();
+
+		// Declares a render target. Returns the target index
+		unsigned int addTarget(const std::string & name, const TargetDesc & desc);
+		// Adds a pass after the ones added before. Returns the pass index
+		unsigned int addPass(const std::string & name, const std::vector<unsigned int> & reads, const std::vector<unsigned int> & writes);
+
+		// Computes the lifetime of the targets and assigns them textures. Without aliasing, each
+		// target used gets its own texture. Returns false, with no texture assigned, if a pass
+		// reads a target before any pass writes it
+		bool compile(bool alias = true);
+
+		const std::vector<Target> & getTargets() const;
+		const std::vector<Pass> & getPasses() const;
+		unsigned int getNumTextures() const;
+		const TargetDesc & getTextureDesc(unsigned int texture) const;
+		// Texture assigned to the target by compile()
+		int getTexture(unsigned int target) const;
+
+		// Bytes used by the textures at the given screen size, or by one texture per target used
+		size_t getMemoryUsage(unsigned int width, unsigned int height, bool aliased = true) const;
+
+		// Writes the passes, and the lifetime and texture of every target
+		void dump(std::ostream & os) const;
+
+		static bool isDepthFormat(GLenum gpuTextureFormat);
+		static unsigned int getBytesPerTexel(GLenum gpuTextureFormat);
+	private:
+		static bool isCompatible(const TargetDesc & a, const TargetDesc & b);
+	};
+}
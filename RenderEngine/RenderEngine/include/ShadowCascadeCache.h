@@ -0,0 +1,113 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Frustum.h"
+#include "ShadowCascadeFit.h"
+
+namespace Engine
+{
+	/**
+	 * Decides which texels of each shadow map level are rendered on each frame. A level keeps
+	 * its shadow map while its slice stays inside it, as the fit covers a few texels and some
+	 * depth more than needed (ShadowCascadeFit::Parameters::marginTexels and depthSlack). Once
+	 * the slice moves past them, the map is scrolled by whole texels to the new fit, and only
+	 * the texels it did not cover before are rendered. The whole level is rendered again when
+	 * its fit changes (settings or light direction), when the depth range runs out, when casters
+	 * within its volume change (see invalidateBounds()), and after a number of frames, so
+	 * animated casters show up.
+	 *
+	 * Like the fit, the cache only runs on the CPU, it does not issue GL calls
+	 */
+	class ShadowCascadeCache
+	{
+	public:
+		enum Update
+		{
+			// The shadow map is used as it is
+			UPDATE_NONE,
+			// The shadow map content moves by whole texels, and the texels exposed are rendered
+			UPDATE_SCROLL,
+			// The whole shadow map is rendered
+			UPDATE_FULL
+		};
+
+		typedef struct Parameters
+		{
+			// Levels below it are rendered entirely every frame
+			unsigned int firstLevel;
+			// Frames after which a level is rendered entirely even if it was reused (0 never)
+			unsigned int interval;
+		} Parameters;
+
+		// Shadow map area, in texels
+		typedef struct Region
+		{
+			int x;
+			int y;
+			int width;
+			int height;
+		} Region;
+
+		typedef struct Level
+		{
+			// Fit the shadow map holds. Its view and projection are the ones to render and sample it with
+			ShadowCascadeFit::Cascade cascade;
+			bool valid;
+			// Update of the last frame. Scrolls move the texel (x, y) to (x - shiftX, y - shiftY)
+			Update update;
+			int shiftX;
+			int shiftY;
+			// Areas to render on the last frame
+			std::vector<Region> regions;
+			// Frames since the level was rendered entirely
+			unsigned int age;
+			// Frames processed, and how many of them reused, scrolled or rendered entirely the level
+			unsigned long long frames;
+			unsigned long long reused;
+			unsigned long long scrolled;
+			unsigned long long rendered;
+		} Level;
+		// Changed caster bounds kept until the next update. Past this many, every level is invalidated
+		static const size_t MAX_CHANGED_BOUNDS = 1024;
+	private:
+		Parameters params;
+		std::vector<Level> levels;
+		// World bounds of the casters which changed since the last update
+		BoundingBoxList changedBounds;
+		std::vector<unsigned char> changedVisibility;
+	public:
+		ShadowCascadeCache();
+
+		void configure(const Parameters & parameters);
+		// Every level is rendered entirely on the next update (such as when the light direction changes)
+		void invalidate();
+		// Casters within the bounds appeared, moved or disappeared (such as terrain tiles entering the render
+		// radius, or vegetation placed on a tile). Levels whose volume, extruded towards the light, holds
+		// them are rendered entirely on the next update
+		void invalidateBounds(const glm::vec3 & boundsMin, const glm::vec3 & boundsMax);
+		// Decides the update of each level from the fit of this frame
+		void update(const ShadowCascadeFit & fit);
+		void resetStatistics();
+
+		const Parameters & getParameters() const;
+		const std::vector<Level> & getLevels() const;
+
+		// Light view depth range [nearDepth, farDepth] of an orthographic projection
+		static void getDepthRange(const glm::mat4 & projection, float & nearDepth, float & farDepth);
+		// Crop of a level projection to the region of its shadow map: maps the region onto the whole clip
+		// space, and a viewport on the region places it back on its texels
+		static glm::mat4 getRegionCrop(const Region & region, unsigned int resolution);
+	private:
+		// Wether any of the changed bounds casts shadows on the level volume
+		bool containsChangedBounds(const ShadowCascadeFit::Cascade & cascade);
+	};
+}
@@ -0,0 +1,101 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace Engine
+{
+	/**
+	 * Fits the levels of the cascade shadow maps to the view frustum. The shadowed distance is
+	 * split in slices, one per level, and each level covers the bounding sphere of its slice.
+	 * The sphere does not change with the camera orientation, so the projected size of the
+	 * shadow map texels stays the same while the camera turns, and its center is snapped to
+	 * the texel grid so the texels do not shift over the scene while it moves. Both together
+	 * remove the shadow edge shimmering.
+	 *
+	 * The fit only runs on the CPU, it does not issue GL calls
+	 */
+	class ShadowCascadeFit
+	{
+	public:
+		static const unsigned int MAX_LEVELS = 4;
+
+		enum SplitScheme
+		{
+			// Constant ratio between the slice ends, best fits the perspective aliasing
+			SPLIT_LOGARITHMIC = 0,
+			// Constant slice length
+			SPLIT_LINEAR = 1,
+			// Blend of both, weighted by the lambda parameter (Zhang et al. 2006)
+			SPLIT_PRACTICAL = 2
+		};
+
+		typedef struct Parameters
+		{
+			unsigned int levels;
+			SplitScheme scheme;
+			// Weight of the logarithmic splits on the practical scheme (0 - 1)
+			float lambda;
+			// View distances where the shadows start (camera near plane) and end
+			float nearDistance;
+			float shadowDistance;
+			// Shadow map texels per side
+			unsigned int resolution;
+			// Distance towards the light, beyond the slice, covered by the light depth range, so
+			// casters between the light and the slice are rendered too
+			float casterDistance;
+			// Texels covered around the slice sphere (at least 1, the snapped center may be a texel away),
+			// and depth covered beyond the needed range on both ends (times the sphere radius). Lets a
+			// level be reused while its slice moves (see ShadowCascadeCache)
+			unsigned int marginTexels;
+			float depthSlack;
+		} Parameters;
+
+		typedef struct Cascade
+		{
+			// View distances covered by the level
+			float nearDistance;
+			float farDistance;
+			// Bounding sphere of the slice (world space), its center snapped to the texel grid
+			glm::vec3 center;
+			float radius;
+			// Light view and orthographic projection of the level
+			glm::mat4 view;
+			glm::mat4 projection;
+			// Shadow map texels per world unit
+			float texelDensity;
+		} Cascade;
+	private:
+		Parameters params;
+		// Slice ends, from the near distance to the shadow distance (levels + 1 distances)
+		std::vector<float> splits;
+		std::vector<Cascade> cascades;
+	public:
+		ShadowCascadeFit();
+
+		// Computes the split distances
+		void configure(const Parameters & parameters);
+		// Fits each level to the view of the camera given its inverse view matrix and its projection
+		// matrix, for a directional light. lightDirection points towards the light
+		void fit(const glm::mat4 & invViewMatrix, const glm::mat4 & projectionMatrix, const glm::vec3 & lightDirection);
+
+		const Parameters & getParameters() const;
+		const std::vector<float> & getSplits() const;
+		const std::vector<Cascade> & getCascades() const;
+
+		// Slice ends of levels slices between nearDistance and farDistance
+		static void computeSplits(SplitScheme scheme, float lambda, unsigned int levels, float nearDistance, float farDistance, std::vector<float> & result);
+		// Smallest sphere around the slice between nearDistance and farDistance of a symmetric frustum,
+		// given the tangents of its half angles. The center lies on the view axis, centerDistance away
+		static void computeSliceSphere(float tanHalfX, float tanHalfY, float nearDistance, float farDistance, float & centerDistance, float & radius);
+		// Light view rotation (no translation) looking along -lightDirection
+		static glm::mat4 getLightRotation(const glm::vec3 & lightDirection);
+	};
+}
@@ -14,6 +14,8 @@ namespace Engine
 	class ShadowCaster
 	{
 	public:
-		virtual void renderShadow(Camera * camera, const glm::mat4 & projectionMatrix) = 0;
+		// Draws the caster once for every shadow map region, given the projection of each of them
+		// (see CascadeShadowMaps::renderShadows())
+		virtual void renderShadow(Camera * camera, const glm::mat4 * projectionMatrices, unsigned int regions) = 0;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <ostream>
+
+namespace Engine
+{
+	namespace Concurrent
+	{
+		// Where a stage is allowed to run
+		enum TaskAffinity
+		{
+			// Must run on the thread that executes the graph (the one owning the GL context)
+			AFFINITY_MAIN_THREAD,
+			// Can run on any thread pool worker
+			AFFINITY_ANY_THREAD
+		};
+
+		/**
+		 * Declarative graph of the stages executed every frame. Each stage declares the
+		 * resources it reads and writes, and the dependencies are derived from the
+		 * declaration order (read after write, write after read and write after write).
+		 * Independent worker stages run concurrently on the thread pool while the main
+		 * thread stages (GL calls) run on the thread calling execute()
+		 */
+		class TaskGraph
+		{
+		private:
+			struct Stage
+			{
+				std::string name;
+				TaskAffinity affinity;
+				std::function<void()> job;
+				std::vector<unsigned int> reads;
+				std::vector<unsigned int> writes;
+
+				// Stages which must finish before this one starts
+				std::vector<unsigned int> dependencies;
+				// Stages which depend on this one
+				std::vector<unsigned int> successors;
+
+				std::atomic<unsigned int> pendingDependencies;
+
+				// Last execution timings, in microseconds since the frame start
+				long long startTime;
+				long long endTime;
+				// -1 for the main thread, worker index otherwise
+				int thread;
+			};
+		private:
+			std::vector<std::unique_ptr<Stage>> stages;
+			std::map<std::string, unsigned int> resourceIds;
+			std::vector<std::string> resourceNames;
+
+			// Main thread stages ready to run
+			std::mutex readyLock;
+			std::condition_variable readyMonitor;
+			std::vector<unsigned int> mainThreadReady;
+			std::atomic<unsigned int> completedStages;
+
+			std::chrono::high_resolution_clock::time_point frameStart;
+			long long frameTime;
+		public:
+			TaskGraph();
+			~TaskGraph();
+
+			// Adds a stage at the end of the graph. Returns the stage index
+			unsigned int addStage(const std::string & name,
+				const std::vector<std::string> & reads,
+				const std::vector<std::string> & writes,
+				TaskAffinity affinity,
+				std::function<void()> job);
+
+			// Runs all the stages once, returns when all of them finished
+			void execute();
+
+			unsigned int getNumStages() const { return (unsigned int)stages.size(); }
+			// Stages the given one waits for, derived from the declared reads and writes
+			const std::vector<unsigned int> & getDependencies(unsigned int stageIndex) const { return stages[stageIndex]->dependencies; }
+			// Duration of the last execute() call in microseconds
+			long long getLastFrameTime() const { return frameTime; }
+
+			// Writes the graph with the last frame timings. Stages in the critical
+			// path (the longest dependency chain by duration) are marked with '*'
+			void dump(std::ostream & os) const;
+		private:
+			unsigned int getResourceId(const std::string & name);
+			void dispatch(unsigned int stageIndex);
+			void runStage(unsigned int stageIndex);
+			std::vector<unsigned int> computeCriticalPath() const;
+		};
+	}
+}
@@ -4,9 +4,13 @@
 */
 #pragma once
 
+#include <unordered_map>
 #include <vector>
 
 #include "Camera.h"
+#include "Frustum.h"
+#include "TerrainQuadTree.h"
+#include "TerrainHeightField.h"
 #include "TerrainComponent.h"
 #include "IRenderable.h"
 #include "ShadowCaster.h"
@@ -23,6 +27,32 @@ namespace Engine
 
 		std::vector<TerrainComponent*> renderableComponents;
 		std::vector<TerrainComponent*> shadowableComponents;
+		// Tiles [xStart, xEnd) x [yStart, yEnd) within the render radius of each shadowable component on the last frame
+		std::vector<glm::ivec4> shadowTileWindows;
+
+		// Bounds of the tiles within the render radius of the component being rendered, and the groups
+		// of culling volumes (bit per group) each of them is inside of
+		BoundingBoxList tileBounds;
+		std::vector<unsigned char> tileVisibility;
+		std::vector<unsigned char> volumeVisibility;
+		// Tiles (i, j) of the component being rendered which pass the culling
+		std::vector<glm::ivec2> visibleTiles;
+
+		// World height range (min, max) of the terrain on the tiles, computed on demand from the
+		// height field and kept until the terrain settings change. A few of them per frame
+		TerrainHeightField heightField;
+		std::unordered_map<long long, glm::vec2> tileHeightRanges;
+		unsigned int heightRangeBudget;
+
+		// Quadtree terrain mode layout and nodes selected for the component being rendered
+		TerrainQuadTree quadTree;
+		std::vector<TerrainQuadTree::Node> quadTreeNodes;
+
+		// Light space volumes of the shadow map regions being rendered, in world units and in tiles,
+		// and shadow map level of each of them
+		std::vector<Frustum> shadowVolumes;
+		std::vector<Frustum> shadowTileVolumes;
+		std::vector<unsigned int> shadowVolumeLevels;
 	public:
 		Terrain();
 		Terrain(float tileWidth, unsigned int renderRadius);
@@ -31,17 +61,41 @@ namespace Engine
 		void registerComponent(TerrainComponent * comp);
 
 		void render(Camera * camera);
-		void renderShadow(Camera * camera, const glm::mat4 & projectionMatrix);
+		void renderShadow(Camera * camera, const glm::mat4 * projectionMatrices, unsigned int regions);
 
 		void notifyRenderModeUpdate(RenderMode mode);
 
 		float getTileScale();
 		unsigned int getRenderRadius();
+
+		const std::vector<TerrainComponent*> & getComponents() const;
 	private:
 		void initialize();
 		void createTileMesh();
+		// Registers a flat unit grid of resolution x resolution quads as "terrain_grid_<resolution>"
+		void createGridMesh(unsigned int resolution);
+
+		// Drops the tile height ranges if the terrain settings changed
+		void updateHeightField();
+		// False if the range is not known yet and the frame budget to compute them is spent
+		bool getTileHeightRange(int i, int j, glm::vec2 & range);
 
+		// Tiles [xStart, xEnd) x [yStart, yEnd) (x, y, z, w) within the render radius of the component
+		glm::ivec4 getTileWindow(TerrainComponent * component, Camera * cam);
+		// Notifies the shadow maps of the tiles which entered or left the render radius of a shadowable component
+		void updateShadowTileWindow(unsigned int index, Camera * cam);
+
+		// Fills visibleTiles with the tiles of the component within its render radius that intersect any of
+		// the volumes given and are not hidden by other components. Each volume belongs to a group, and the
+		// statistics of each group count the tiles intersecting any of its volumes
+		void selectTiles(TerrainComponent * component, Camera * cam, const Frustum * volumes, const unsigned int * volumeGroups, unsigned int numVolumes,
+			TileCullingStatistics * groupStatistics, unsigned int numGroups);
 		void renderTiledComponent(TerrainComponent * component, Camera * cam);
-		void renderTiledComponentShadow(TerrainComponent * component, Camera * cam, const glm::mat4 & proj);
+		void renderTiledComponentShadow(TerrainComponent * component, Camera * cam, const glm::mat4 * projections, unsigned int regions);
+
+		// Selects the quadtree nodes within the component render radius. Returns the number of nodes culled
+		size_t selectQuadTreeNodes(TerrainComponent * component, Camera * cam, const Frustum * frustums, unsigned int numFrustums);
+		void renderQuadTreeComponent(TerrainComponent * component, Camera * cam);
+		void renderQuadTreeComponentShadow(TerrainComponent * component, Camera * cam, const glm::mat4 * projections, unsigned int regions);
 	};
 }
@@ -6,18 +6,47 @@
 
 #include <glm/glm.hpp>
 
+#include <vector>
+
 #include "WorldConfig.h"
 #include "Camera.h"
 #include "Program.h"
+#include "ShadowCascadeFit.h"
+#include "TerrainQuadTree.h"
 
 namespace Engine
 {
+	// Tiles (or quadtree nodes) processed by a terrain component on its last render
+	typedef struct TileCullingStatistics
+	{
+		unsigned int tested;
+		unsigned int culled;
+		// Tiles inside the view frustum skipped by isTileHidden()
+		unsigned int hidden;
+		unsigned int drawn;
+	} TileCullingStatistics;
+
+	// GL calls issued by a terrain component on its last render and on its last shadow map render
+	typedef struct ComponentCallStatistics
+	{
+		unsigned int drawCalls;
+		unsigned int uniformCalls;
+		unsigned int shadowDrawCalls;
+		unsigned int shadowUniformCalls;
+	} ComponentCallStatistics;
+
 	// Parent class of all terrain components that give a common acess interface
 	class TerrainComponent
 	{
 	protected:
 		float scale;
 		bool isShadowable;
+	public:
+		TileCullingStatistics cullingStatistics;
+		// Same for each shadow cascade on the last shadow map render, culled against the light space volumes of
+		// the regions rendered on the cascade (none if it was reused)
+		TileCullingStatistics shadowCullingStatistics[ShadowCascadeFit::MAX_LEVELS];
+		ComponentCallStatistics callStatistics;
 	public:
 		TerrainComponent()
 		{
@@ -28,6 +57,12 @@ namespace Engine
 		{
 			this->scale = scale;
 			this->isShadowable = shadowable;
+			this->cullingStatistics = { 0, 0, 0, 0 };
+			for (unsigned int i = 0; i < ShadowCascadeFit::MAX_LEVELS; i++)
+			{
+				this->shadowCullingStatistics[i] = { 0, 0, 0, 0 };
+			}
+			this->callStatistics = { 0, 0, 0, 0 };
 			initialize();
 		}
 
@@ -42,6 +77,26 @@ namespace Engine
 		}
 
 		virtual unsigned int getRenderRadius() = 0;
+
+		virtual const char * getName()
+		{
+			return "Terrain component";
+		}
+
+		// Conservative world space bounds of everything the component draws on the tile (i, j).
+		// By default, the whole height range the terrain can reach
+		virtual void getTileBounds(int i, int j, glm::vec3 & boundsMin, glm::vec3 & boundsMax)
+		{
+			boundsMin = glm::vec3(float(i) * scale, 0.0f, float(j) * scale);
+			boundsMax = glm::vec3(float(i + 1) * scale, getMaxTerrainHeight(), float(j + 1) * scale);
+		}
+		
+		// Wether the tile (i, j) can be skipped because other components cover it, given the world
+		// height range of the terrain on it. Only called for tiles drawn as a grid
+		virtual bool isTileHidden(int i, int j, float minHeight, float maxHeight, Engine::Camera * camera)
+		{
+			return false;
+		}
 		
 		virtual Program * getActiveShader()
 		{
@@ -53,6 +108,12 @@ namespace Engine
 			return NULL;
 		}
 
+		// Called once per pass before drawing the tiles around the camera
+		virtual void updateComponent(Engine::Camera * camera)
+		{
+
+		}
+
 		virtual void preRenderComponent()
 		{
 
@@ -68,7 +129,8 @@ namespace Engine
 
 		}
 
-		virtual void renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam)
+		// The shadow render methods draw on every shadow map region at once, given their projections
+		virtual void renderShadow(const glm::mat4 * projections, unsigned int regions, int i, int j, Engine::Camera * cam)
 		{
 
 		}
@@ -77,5 +139,72 @@ namespace Engine
 		{
 
 		}
+
+		// Upper bound of the world space terrain height. The tessellation noise sums octaves of value
+		// noise in [0, 1] with halving amplitudes, and its cube is scaled by 1.5 (see terrain.teseval)
+		float getMaxTerrainHeight()
+		{
+			const unsigned int octaves = Engine::Settings::terrainOctaves < 24 ? Engine::Settings::terrainOctaves : 24;
+			const float maxNoise = Engine::Settings::terrainAmplitude * (2.0f - 2.0f / float(1u << octaves));
+			return maxNoise * maxNoise * maxNoise * 1.5f * scale;
+		}
+
+		// Wether the component draws the nodes of the quadtree terrain (Settings::terrainQuadTree)
+		// instead of a grid of tiles. The node area is given in terrain tiles
+		virtual bool supportsQuadTree()
+		{
+			return false;
+		}
+
+		virtual void renderQuadTreeNode(const TerrainQuadTree::Node & node, Engine::Camera * camera)
+		{
+
+		}
+
+		virtual void renderQuadTreeNodeShadow(const glm::mat4 * projections, unsigned int regions, const TerrainQuadTree::Node & node, Engine::Camera * cam)
+		{
+
+		}
+
+		// Wether the component draws every visible tile at once with instanced draws (Settings::terrainInstancing)
+		// instead of a draw per tile. Used for the tiles not drawn as a quadtree
+		virtual bool supportsInstancing()
+		{
+			return false;
+		}
+
+		// Draws the tiles (i, j) given
+		virtual void renderInstances(const std::vector<glm::ivec2> & tiles, Engine::Camera * camera)
+		{
+
+		}
+
+		virtual void renderShadowInstances(const glm::mat4 * projections, unsigned int regions, const std::vector<glm::ivec2> & tiles, Engine::Camera * cam)
+		{
+
+		}
+	protected:
+		// Shadow map region projections applied to a model matrix
+		void getShadowRegionMatrices(const glm::mat4 * projections, unsigned int regions, const glm::mat4 & model, glm::mat4 * result)
+		{
+			for (unsigned int i = 0; i < regions; i++)
+			{
+				result[i] = projections[i] * model;
+			}
+		}
+
+		// Bounds of vegetation of the given shape bounds (model space) spawned anywhere within the tile (i, j).
+		// Vegetation is only placed where the terrain height lies between the water level and the maximum
+		// vegetation height, and is bent by the wind up to windStrength * 0.01 units per unit of height (see tree.vert)
+		void getVegetationTileBounds(int i, int j, const glm::vec3 & shapeMin, const glm::vec3 & shapeMax, glm::vec3 & boundsMin, glm::vec3 & boundsMax)
+		{
+			const float minGround = Engine::Settings::waterHeight * 1.5f * scale;
+			const float maxGround = (Engine::Settings::waterHeight + Engine::Settings::vegetationMaxHeight) * 1.5f * scale;
+			const float maxBending = 0.01f * abs(Engine::Settings::windStrength) * glm::max(abs(shapeMin.y), abs(shapeMax.y))
+				* glm::length(glm::vec2(Engine::Settings::windDirection.x, Engine::Settings::windDirection.z));
+
+			boundsMin = glm::vec3(float(i) * scale + shapeMin.x - maxBending, minGround + shapeMin.y, float(j) * scale + shapeMin.z - maxBending);
+			boundsMax = glm::vec3(float(i + 1) * scale + shapeMax.x + maxBending, maxGround + shapeMax.y, float(j + 1) * scale + shapeMax.z + maxBending);
+		}
 	};
 }
\ No newline at end of file
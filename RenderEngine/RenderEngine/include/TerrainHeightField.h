@@ -0,0 +1,68 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <cstddef>
+
+namespace Engine
+{
+	/**
+	 * CPU evaluation of the terrain height, using the same value noise FBM as the terrain
+	 * shaders (noiseHeight in terrain.teseval, terrain_quadtree.vert and terrain.frag).
+	 * Lattice values come from an integer hash, so they are bit exact on both sides, and the
+	 * interpolation follows the shader operation order (GPUs may still fuse multiply-adds,
+	 * which changes the last bits of the result)
+	 */
+	class TerrainHeightField
+	{
+	public:
+		// Number of samples evaluated together by the batched entry points (two SIMD vectors)
+		static const unsigned int BATCH_SIZE = 8;
+
+		typedef struct Parameters
+		{
+			float amplitude;
+			float frecuency;
+			float scale;
+			unsigned int octaves;
+			// World width of a terrain tile. Noise coordinates are tile coordinates
+			float tileWidth;
+		} Parameters;
+	private:
+		Parameters params;
+	public:
+		// Uses the current terrain Settings
+		TerrainHeightField();
+		TerrainHeightField(const Parameters & parameters);
+
+		static Parameters getSettingsParameters();
+
+		// Reloads the parameters from Settings
+		void update();
+		void setParameters(const Parameters & parameters);
+		const Parameters & getParameters() const;
+
+		// Shader noiseHeight() at the given noise coordinates. This is the value compared against
+		// Settings::waterHeight and Settings::vegetationMaxHeight to place vegetation
+		float getNoiseHeight(float u, float v) const;
+		void getNoiseHeights(const float * u, const float * v, float * heights, size_t count) const;
+
+		// World height of the terrain surface at the world position (x, z)
+		float getHeight(float x, float z) const;
+		void getHeights(const float * x, const float * z, float * heights, size_t count) const;
+		// World heights of a grid of columns x rows points starting at (x, z), stored by rows
+		void getHeightGrid(float x, float z, float spacing, unsigned int columns, unsigned int rows, float * heights) const;
+
+		// Conservative range of getNoiseHeight() over the rectangle [u0, u1] x [v0, v1] (u0 <= u1, v0 <= v1).
+		// Each octave interpolates its lattice values bilinearly, so its extremes lie on the rectangle
+		// corners and the lattice lines crossing it: the octave ranges are exact and only their sum is not
+		void getNoiseRange(float u0, float v0, float u1, float v1, float & minHeight, float & maxHeight) const;
+		// World height range of the terrain surface on the tile (i, j)
+		void getTileRange(int i, int j, float & minHeight, float & maxHeight) const;
+	private:
+		// Evaluates BATCH_SIZE noise heights
+		void computeNoiseHeights(const float * u, const float * v, float * heights) const;
+	};
+}
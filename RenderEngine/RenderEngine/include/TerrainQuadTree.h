@@ -0,0 +1,91 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Frustum.h"
+
+namespace Engine
+{
+	/**
+	 * Continuous distance-dependent level of detail terrain layout (CDLOD, Strugar 2009).
+	 * The terrain is covered by a quadtree whose nodes double their size on every level.
+	 * Each level is drawn up to a distance from the camera (its range) at which the
+	 * spacing of its grid projects to the allowed screen-space error. Close to the end of
+	 * its range, the vertices of a node morph into the grid of the next level, so nodes of
+	 * different levels always meet on matching vertices and no cracks appear.
+	 *
+	 * Everything is measured in terrain tiles (world units / tile width). Selection only
+	 * runs on the CPU, it does not issue GL calls
+	 */
+	class TerrainQuadTree
+	{
+	public:
+		// Grid resolution of the terrain nodes. Partially covered nodes use half of it
+		static const unsigned int GRID_RESOLUTION = 64;
+
+		typedef struct Parameters
+		{
+			// Side of the smallest (level 0) nodes
+			float leafSize;
+			// Quads per side of the grid drawn for each node
+			unsigned int gridResolution;
+			// Allowed screen-space error, in pixels, of the grid spacing
+			float pixelError;
+			// Vertical resolution of the viewport and projection scale (1 / tan(fovy / 2))
+			float viewportHeight;
+			float projectionScale;
+			// Distance up to which the terrain is drawn
+			float viewDistance;
+			// Terrain height range
+			float minHeight;
+			float maxHeight;
+			// Fraction of each level range used to morph into the next level
+			float morphRatio;
+			unsigned int maxLevels;
+		} Parameters;
+
+		typedef struct Node
+		{
+			// Minimum corner and side of the area to draw
+			float x, z;
+			float size;
+			unsigned int level;
+			// Quads per side of the grid to draw. Nodes whose children are partly out of their range
+			// draw those children areas at their own detail: a quarter of the area with half the grid
+			unsigned int gridResolution;
+			// Distances from the camera at which the vertices start and finish morphing into the next level
+			float morphStart;
+			float morphEnd;
+		} Node;
+	private:
+		Parameters params;
+		// Range of each level
+		std::vector<float> ranges;
+	public:
+		TerrainQuadTree();
+
+		// Computes the level ranges
+		void configure(const Parameters & parameters);
+
+		const Parameters & getParameters() const;
+		const std::vector<float> & getRanges() const;
+		unsigned int getNumLevels() const;
+
+		// Adds to selection the nodes to draw from cameraPosition. If frustums are given, nodes outside of all
+		// of them are skipped. Returns the number of nodes skipped
+		size_t select(const glm::vec3 & cameraPosition, const Frustum * frustums, unsigned int numFrustums, std::vector<Node> & selection) const;
+	private:
+		// Returns false if the node is out of the range of its level (its parent must cover it)
+		bool selectNode(float x, float z, unsigned int level, const glm::vec3 & cameraPosition, const Frustum * frustums, unsigned int numFrustums, std::vector<Node> & selection, size_t & culled) const;
+		bool intersectsRange(float x, float z, float size, float range, const glm::vec3 & cameraPosition) const;
+		void addNode(float x, float z, float size, unsigned int level, unsigned int gridResolution, std::vector<Node> & selection) const;
+	};
+}
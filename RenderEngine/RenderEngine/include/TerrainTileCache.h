@@ -0,0 +1,164 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "TerrainHeightField.h"
+
+namespace Engine
+{
+	/**
+	 * Cache of terrain tile height and normal maps, keyed by the tile grid coordinates (i, j).
+	 * Tiles around the camera, and ahead of it along its movement, are generated on the thread
+	 * pool from a TerrainHeightField. The cache holds a fixed number of slots, given by its memory
+	 * budget, and evicts the least recently used tiles when it runs out of them.
+	 *
+	 * The cache does not issue GL calls: the owner uploads the tiles returned by getNewTiles()
+	 * after each update(), before using them. Every method must be called from the same thread
+	 */
+	class TerrainTileCache
+	{
+	public:
+		typedef struct Parameters
+		{
+			// Texels per tile side. Texels lie on the tile edges, so neighbour tiles share their borders
+			unsigned int resolution;
+			// Memory for the tile maps (CPU copy, the owner keeps the same amount on the GPU)
+			size_t memoryBudget;
+			// Tiles are prefetched around the camera position predicted this many seconds ahead,
+			// but no further than maxPrefetchDistance tiles
+			float prefetchTime;
+			float maxPrefetchDistance;
+			// Tiles being generated at once. Keeps the queue short so it follows the camera
+			unsigned int maxPendingTiles;
+		} Parameters;
+
+		typedef struct Statistics
+		{
+			unsigned int slots;
+			unsigned int residentTiles;
+			unsigned int pendingTiles;
+			size_t memoryUsed;
+			size_t memoryBudget;
+			// Since the last update
+			unsigned int hits;
+			unsigned int misses;
+			// Since the cache creation
+			unsigned long long generatedTiles;
+			unsigned long long evictedTiles;
+			unsigned long long prefetchedTiles;
+			// Tiles that could not be requested because every slot was in use this frame
+			unsigned long long budgetStalls;
+		} Statistics;
+	private:
+		enum TileState
+		{
+			TILE_PENDING,
+			TILE_RESIDENT
+		};
+
+		typedef struct Tile
+		{
+			int i, j;
+			unsigned int slot;
+			TileState state;
+			unsigned long long lastUse;
+			// Position on the LRU list (resident tiles only)
+			std::list<long long>::iterator lruPosition;
+		} Tile;
+
+		typedef struct Request
+		{
+			int i, j;
+			float distance;
+			bool prefetch;
+		} Request;
+
+		typedef struct CompletedTile
+		{
+			unsigned int slot;
+			unsigned int generation;
+		} CompletedTile;
+
+		Parameters params;
+		unsigned int numSlots;
+		size_t texelsPerTile;
+
+		// Slot storage: heights (noise units, see TerrainHeightField::getNoiseHeight) and
+		// normals (xyz as signed normalized bytes, w unused)
+		std::vector<float> heights;
+		std::vector<signed char> normals;
+
+		std::unordered_map<long long, Tile> tiles;
+		// Slot owners, and resident tiles from least to most recently used
+		std::vector<long long> slotTiles;
+		std::vector<unsigned int> freeSlots;
+		std::list<long long> lru;
+
+		// Height field used by the tiles being generated. Replaced (and every tile dropped) when
+		// the terrain settings change. Tasks keep their own reference
+		std::shared_ptr<const TerrainHeightField> heightField;
+		unsigned int generation;
+
+		std::mutex completedLock;
+		std::vector<CompletedTile> completed;
+		std::atomic<unsigned int> pendingTasks;
+
+		std::vector<Request> requests;
+		std::vector<unsigned int> newTiles;
+		unsigned long long frame;
+
+		Statistics stats;
+	public:
+		TerrainTileCache(const Parameters & parameters, const TerrainHeightField::Parameters & heightParameters);
+		// Waits for the tiles being generated
+		~TerrainTileCache();
+
+		// Collects the generated tiles and requests the missing ones around cameraTile (tile units)
+		// within radius tiles, plus the ones around its predicted position given velocity (tiles per
+		// second). Calls made again on the same frame only collect tiles.
+		void update(unsigned long long frameNumber, const glm::vec2 & cameraTile, const glm::vec2 & velocity, unsigned int radius);
+		// Drops every tile if the height field changed
+		void setHeightParameters(const TerrainHeightField::Parameters & heightParameters);
+		// Blocks until every tile being generated is done, and collects them
+		void flush();
+
+		// Slot of the tile (i, j), or -1 if it is not available yet. Marks the tile as used
+		int acquire(int i, int j);
+
+		// Slots which received a tile on the last update
+		const std::vector<unsigned int> & getNewTiles() const;
+		const float * getSlotHeights(unsigned int slot) const;
+		const signed char * getSlotNormals(unsigned int slot) const;
+
+		const Parameters & getParameters() const;
+		unsigned int getNumSlots() const;
+		const Statistics & getStatistics() const;
+
+		// Bytes used by a tile maps
+		static size_t getTileBytes(unsigned int resolution);
+	private:
+		static long long getKey(int i, int j);
+
+		void collectCompleted();
+		void addRequests(const glm::vec2 & center, unsigned int radius, const glm::vec2 & distanceOrigin, bool prefetch);
+		bool requestTile(const Request & request);
+		void evict(long long key);
+		void clear();
+
+		// Worker side: fills the slot maps of the tile (i, j)
+		void generateTile(const TerrainHeightField & field, unsigned int slot, int i, int j);
+	};
+}
@@ -5,33 +5,310 @@
 #pragma once
 
 #include <thread>
+#include <chrono>
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
-#include <list>
-#include <queue>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <type_traits>
+#include <utility>
+#include <new>
+#include <cstddef>
 
 namespace Engine
 {
 	namespace Concurrent
 	{
-		class Runnable
+		// Type erased callable with inline storage. Moving a task into a worker queue
+		// never touches the heap, the callable must fit within STORAGE_SIZE bytes
+		class Task
 		{
 		public:
-			virtual void run() = 0;
+			static const size_t STORAGE_SIZE = 48;
+		private:
+			enum Operation
+			{
+				OP_MOVE,
+				OP_DESTROY
+			};
+
+			typedef void(*InvokeFunc)(void * storage);
+			typedef void(*ManageFunc)(Operation op, void * dst, void * src);
+
+			typename std::aligned_storage<STORAGE_SIZE, alignof(std::max_align_t)>::type storage;
+			InvokeFunc invokeFunc;
+			ManageFunc manageFunc;
+		public:
+			Task()
+				:invokeFunc(nullptr), manageFunc(nullptr)
+			{
+			}
+
+			template<class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+			Task(F && func)
+			{
+				typedef typename std::decay<F>::type Callable;
+				static_assert(sizeof(Callable) <= STORAGE_SIZE, "Task: callable does not fit the inline storage (capture pointers instead of values)");
+				static_assert(alignof(Callable) <= alignof(std::max_align_t), "Task: callable alignment not supported");
+
+				new (&storage) Callable(std::forward<F>(func));
+				invokeFunc = &Task::invoke<Callable>;
+				manageFunc = &Task::manage<Callable>;
+			}
+
+			Task(Task && other)
+				:invokeFunc(nullptr), manageFunc(nullptr)
+			{
+				moveFrom(other);
+			}
+
+			Task & operator=(Task && other)
+			{
+				if (this != &other)
+				{
+					reset();
+					moveFrom(other);
+				}
+				return *this;
+			}
+
+			Task(const Task & other) = delete;
+			Task & operator=(const Task & other) = delete;
+
+			~Task()
+			{
+				reset();
+			}
+
+			bool isValid() const
+			{
+				return invokeFunc != nullptr;
+			}
+
+			void operator()()
+			{
+				invokeFunc(&storage);
+			}
+
+			void reset()
+			{
+				if (manageFunc != nullptr)
+				{
+					manageFunc(OP_DESTROY, &storage, nullptr);
+				}
+				invokeFunc = nullptr;
+				manageFunc = nullptr;
+			}
+		private:
+			void moveFrom(Task & other)
+			{
+				if (other.manageFunc != nullptr)
+				{
+					other.manageFunc(OP_MOVE, &storage, &other.storage);
+					invokeFunc = other.invokeFunc;
+					manageFunc = other.manageFunc;
+					other.reset();
+				}
+			}
+
+			template<class Callable>
+			static void invoke(void * data)
+			{
+				(*static_cast<Callable*>(data))();
+			}
+
+			template<class Callable>
+			static void manage(Operation op, void * dst, void * src)
+			{
+				if (op == OP_MOVE)
+				{
+					new (dst) Callable(std::move(*static_cast<Callable*>(src)));
+				}
+				else
+				{
+					static_cast<Callable*>(dst)->~Callable();
+				}
+			}
+		};
+
+		// ===================================================================
+		// Per worker double ended task queue. The owner pushes and pops from the back
+		// (LIFO, cache friendly), thieves steal from the front (FIFO, oldest and usually
+		// largest work). Backed by a power of two ring buffer that only grows
+		class WorkQueue
+		{
+		private:
+			std::mutex lock;
+			std::vector<Task> ring;
+			size_t head;
+			size_t tail;
+		public:
+			WorkQueue();
+
+			void push(Task && task);
+			bool pop(Task & task);
+			bool steal(Task & task);
+			bool empty();
+		};
+
+		// ===================================================================
+		// Shared state between a Future and the task computing its value
+		template<class T>
+		class FutureState
+		{
+		private:
+			std::atomic<bool> ready;
+			std::mutex lock;
+			std::condition_variable monitor;
+			typename std::aligned_storage<sizeof(T), alignof(T)>::type value;
+			std::exception_ptr error;
+			std::vector<Task> continuations;
+		public:
+			FutureState()
+				:ready(false)
+			{
+			}
+
+			virtual ~FutureState()
+			{
+				if (ready.load() && !error)
+				{
+					reinterpret_cast<T*>(&value)->~T();
+				}
+			}
+
+			bool isReady() const
+			{
+				return ready.load(std::memory_order_acquire);
+			}
+
+			template<class U>
+			void setValue(U && result)
+			{
+				new (&value) T(std::forward<U>(result));
+				complete();
+			}
+
+			void setError(std::exception_ptr e)
+			{
+				error = e;
+				complete();
+			}
+
+			T & getValue()
+			{
+				if (error)
+				{
+					std::rethrow_exception(error);
+				}
+				return *reinterpret_cast<T*>(&value);
+			}
+
+			// Blocks the calling thread for at most the given time waiting for the result
+			void waitFor(std::chrono::microseconds time)
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				if (!ready.load(std::memory_order_acquire))
+				{
+					monitor.wait_for(guard, time);
+				}
+			}
+
+			// Adds a task to be scheduled once the value is available (scheduled inmediatly if already is)
+			void addContinuation(Task && task);
+		private:
+			void complete();
+		};
+
+		// Void results are stored as an empty placeholder
+		struct VoidResult
+		{
+		};
+
+		template<class T>
+		struct FutureStorage
+		{
+			typedef T Type;
+		};
+
+		template<>
+		struct FutureStorage<void>
+		{
+			typedef VoidResult Type;
+		};
+
+		// ===================================================================
+		// Handle to the result of a task submitted to the thread pool. Waiting on a future
+		// from any thread (workers included) executes pending tasks instead of idling
+		template<class T>
+		class Future
+		{
+		public:
+			typedef typename FutureStorage<T>::Type StoredType;
+		private:
+			std::shared_ptr<FutureState<StoredType>> state;
+		public:
+			Future()
+			{
+			}
+
+			Future(std::shared_ptr<FutureState<StoredType>> st)
+				:state(std::move(st))
+			{
+			}
+
+			bool isValid() const
+			{
+				return state != nullptr;
+			}
+
+			bool isReady() const
+			{
+				return state->isReady();
+			}
+
+			// Waits until the result is available, helping the pool in the meantime
+			void wait() const;
+
+			// Waits and returns the result (rethrows if the task threw)
+			typename std::add_lvalue_reference<StoredType>::type get() const
+			{
+				wait();
+				return state->getValue();
+			}
+
+			// Schedules func(future) once this future completes. The continuation receives the
+			// completed future (so it can also inspect errors) and its result is available
+			// through the returned future
+			template<class F>
+			auto then(F && func) -> Future<typename std::result_of<typename std::decay<F>::type(Future<T> &)>::type>;
 		};
 
+		// ===================================================================
+		// Work stealing thread pool. Each worker owns a task queue, idle workers steal from
+		// the others, and threads waiting on results (futures, parallel loops) execute
+		// pending tasks while they wait. Tasks are stored inline, so scheduling a job with
+		// execute() or running parallelFor / parallelReduce does not allocate
 		class ThreadPool
 		{
 		private:
 			static ThreadPool * INSTANCE;
 		private:
-			std::list<std::thread> pool;
-			std::queue<std::unique_ptr<Runnable>> tasks;
+			std::vector<std::thread> pool;
+			std::vector<std::unique_ptr<WorkQueue>> queues;
 
-			std::mutex globalLock;
+			// Sleeping workers synchronization
+			std::mutex sleepLock;
 			std::condition_variable monitor;
+			std::atomic<unsigned int> sleepingWorkers;
+			std::atomic<unsigned int> queuedTasks;
 
-			bool active;
+			// Queue which will receive the next task submitted from outside the pool
+			std::atomic<unsigned int> nextExternalQueue;
+
+			std::atomic<bool> active;
 			unsigned int poolSize;
 		public:
 			static ThreadPool & getInstance();
@@ -42,10 +319,304 @@ namespace Engine
 
 			unsigned int getPoolSize() { return poolSize; }
 			bool isActive() { return active; }
-			void init();
-			void addTask(std::unique_ptr<Runnable> task);
+			// Starts numThreads workers (0: one per core, but the one of the calling thread). The pool
+			// must not be active
+			void init(unsigned int numThreads = 0);
 			void shutDown();
-			void pollTask();
+
+			// Index of the calling thread within the pool workers, -1 if it is not a worker
+			int getCurrentWorkerIndex() const;
+
+			// Fire and forget task
+			template<class F>
+			void execute(F && func)
+			{
+				schedule(Task(std::forward<F>(func)));
+			}
+
+			// Task whose result (or exception) is delivered through the returned future
+			template<class F>
+			auto submit(F && func) -> Future<typename std::result_of<typename std::decay<F>::type()>::type>;
+
+			// Runs a single pending task on the calling thread. Returns false if none was found
+			bool runPendingTask();
+
+			// Executes pending tasks on the calling thread until the given condition is met
+			template<class Condition>
+			void helpUntil(Condition condition)
+			{
+				unsigned int idleSpins = 0;
+				while (!condition())
+				{
+					if (runPendingTask())
+					{
+						idleSpins = 0;
+					}
+					else if (++idleSpins < 64)
+					{
+						std::this_thread::yield();
+					}
+					else
+					{
+						std::this_thread::sleep_for(std::chrono::microseconds(50));
+					}
+				}
+			}
+
+			void schedule(Task && task);
+		private:
+			void workerLoop(unsigned int index);
+			bool findTask(int index, Task & task);
 		};
+
+		// ===================================================================
+		// Task-side helpers to fill a future state
+		template<class T>
+		struct FutureRunner
+		{
+			template<class F, class... Args>
+			static void run(FutureState<T> & state, F & func, Args &... args)
+			{
+				try
+				{
+					state.setValue(func(args...));
+				}
+				catch (...)
+				{
+					state.setError(std::current_exception());
+				}
+			}
+		};
+
+		template<>
+		struct FutureRunner<void>
+		{
+			template<class F, class... Args>
+			static void run(FutureState<VoidResult> & state, F & func, Args &... args)
+			{
+				try
+				{
+					func(args...);
+					state.setValue(VoidResult());
+				}
+				catch (...)
+				{
+					state.setError(std::current_exception());
+				}
+			}
+		};
+
+		// Future state which also owns the callable, so submitting work costs a single allocation
+		// regardless of the callable size
+		template<class T, class F>
+		class PackagedState : public FutureState<typename FutureStorage<T>::Type>
+		{
+		private:
+			F func;
+		public:
+			PackagedState(F && f)
+				:func(std::move(f))
+			{
+			}
+
+			void run()
+			{
+				FutureRunner<T>::run(*this, func);
+			}
+
+			template<class Arg>
+			void run(Arg & arg)
+			{
+				FutureRunner<T>::run(*this, func, arg);
+			}
+		};
+
+		// ===================================================================
+
+		template<class T>
+		void FutureState<T>::addContinuation(Task && task)
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			if (!ready.load(std::memory_order_acquire))
+			{
+				continuations.push_back(std::move(task));
+				return;
+			}
+			guard.unlock();
+			ThreadPool::getInstance().schedule(std::move(task));
+		}
+
+		template<class T>
+		void FutureState<T>::complete()
+		{
+			std::vector<Task> pending;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				ready.store(true, std::memory_order_release);
+				pending.swap(continuations);
+			}
+			monitor.notify_all();
+
+			for (auto & task : pending)
+			{
+				ThreadPool::getInstance().schedule(std::move(task));
+			}
+		}
+
+		template<class T>
+		void Future<T>::wait() const
+		{
+			FutureState<StoredType> * st = state.get();
+			ThreadPool & tp = ThreadPool::getInstance();
+			while (!st->isReady())
+			{
+				if (!tp.runPendingTask())
+				{
+					// Nothing to help with, block until the result arrives (or new work might be available)
+					st->waitFor(std::chrono::microseconds(500));
+				}
+			}
+		}
+
+		template<class T>
+		template<class F>
+		auto Future<T>::then(F && func) -> Future<typename std::result_of<typename std::decay<F>::type(Future<T> &)>::type>
+		{
+			typedef typename std::decay<F>::type Callable;
+			typedef typename std::result_of<Callable(Future<T> &)>::type Result;
+
+			std::shared_ptr<PackagedState<Result, Callable>> next = std::make_shared<PackagedState<Result, Callable>>(Callable(std::forward<F>(func)));
+			Future<T> previous = *this;
+			state->addContinuation(Task([next, previous]() mutable
+			{
+				next->run(previous);
+			}));
+
+			return Future<Result>(next);
+		}
+
+		template<class F>
+		auto ThreadPool::submit(F && func) -> Future<typename std::result_of<typename std::decay<F>::type()>::type>
+		{
+			typedef typename std::decay<F>::type Callable;
+			typedef typename std::result_of<Callable()>::type Result;
+
+			std::shared_ptr<PackagedState<Result, Callable>> st = std::make_shared<PackagedState<Result, Callable>>(Callable(std::forward<F>(func)));
+			schedule(Task([st]()
+			{
+				st->run();
+			}));
+
+			return Future<Result>(st);
+		}
+
+		// ===================================================================
+		// Parallel algorithms. The calling thread takes part in the work, and the range is split
+		// in chunks of grainSize elements which are handed out dynamically to balance the load
+
+		// Shared data of a parallel loop. Lives on the caller stack until all helpers finished
+		struct ParallelLoopContext
+		{
+			void (*body)(void * func, size_t chunk);
+			void * func;
+			size_t numChunks;
+			std::atomic<size_t> nextChunk;
+			std::atomic<size_t> completedChunks;
+			std::atomic<unsigned int> runningHelpers;
+			std::atomic<bool> failed;
+			std::exception_ptr error;
+			std::mutex errorLock;
+
+			// Process chunks until none is left
+			void process();
+		};
+
+		// Runs body(chunkIndex) for each chunk in [0, numChunks) across the pool
+		void runParallelChunks(ParallelLoopContext & context);
+
+		// Calls func(begin, end) over consecutive subranges of [first, last)
+		template<class F>
+		void parallelForRange(size_t first, size_t last, size_t grainSize, F && func)
+		{
+			if (last <= first)
+			{
+				return;
+			}
+
+			grainSize = grainSize < 1 ? 1 : grainSize;
+			const size_t numChunks = (last - first + grainSize - 1) / grainSize;
+
+			if (numChunks == 1)
+			{
+				func(first, last);
+				return;
+			}
+
+			struct Range
+			{
+				typename std::remove_reference<F>::type * func;
+				size_t first;
+				size_t last;
+				size_t grainSize;
+			} range = { &func, first, last, grainSize };
+
+			ParallelLoopContext context;
+			context.func = &range;
+			context.numChunks = numChunks;
+			context.body = [](void * data, size_t chunk)
+			{
+				Range * r = static_cast<Range*>(data);
+				size_t begin = r->first + chunk * r->grainSize;
+				size_t end = begin + r->grainSize;
+				end = end > r->last ? r->last : end;
+				(*r->func)(begin, end);
+			};
+
+			runParallelChunks(context);
+		}
+
+		// Calls func(i) for each i in [first, last)
+		template<class F>
+		void parallelFor(size_t first, size_t last, size_t grainSize, F && func)
+		{
+			parallelForRange(first, last, grainSize, [&func](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					func(i);
+				}
+			});
+		}
+
+		// Maps each chunk of [first, last) with map(begin, end) and folds the partial results with
+		// reduce(a, b). Partial results are always combined in range order, so the result does
+		// not depend on the number of threads for a fixed grain size
+		template<class T, class Map, class Reduce>
+		T parallelReduce(size_t first, size_t last, size_t grainSize, const T & identity, Map && map, Reduce && reduce)
+		{
+			if (last <= first)
+			{
+				return identity;
+			}
+
+			grainSize = grainSize < 1 ? 1 : grainSize;
+			const size_t numChunks = (last - first + grainSize - 1) / grainSize;
+
+			std::vector<T> partials(numChunks, identity);
+			parallelFor(0, numChunks, 1, [&](size_t chunk)
+			{
+				size_t begin = first + chunk * grainSize;
+				size_t end = begin + grainSize;
+				end = end > last ? last : end;
+				partials[chunk] = map(begin, end);
+			});
+
+			T result = identity;
+			for (auto & partial : partials)
+			{
+				result = reduce(result, partial);
+			}
+			return result;
+		}
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,141 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#define GLM_FORCE_RADIANS
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "VegetationPlacement.h"
+
+namespace Engine
+{
+	/**
+	 * Vegetation instances of the terrain tiles around the camera, keyed by the tile grid
+	 * coordinates (i, j). The instances of a tile are generated on the thread pool when the tile
+	 * enters the kept area, nearest tiles first, and released when it leaves it, so both the main
+	 * and the shadow passes reuse them instead of placing the vegetation again every frame.
+	 * Every method must be called from the same thread
+	 */
+	class VegetationInstanceStore
+	{
+	public:
+		typedef struct Instance
+		{
+			glm::mat4 modelMatrix;
+			// World position on the terrain surface (xyz) and wind bending direction (w, 1 or -1),
+			// as fed to the instanced programs
+			glm::vec4 placement;
+			// Kind of vegetation (such as the tree species), given by the generator
+			unsigned int type;
+		} Instance;
+
+		// Fills the instances of the tile (i, j). Runs on the thread pool workers, and must always give
+		// the same instances for the same tile and placement
+		typedef std::function<void(const VegetationPlacement & placement, int i, int j, std::vector<Instance> & instances)> Generator;
+
+		typedef struct Statistics
+		{
+			unsigned int residentTiles;
+			unsigned int pendingTiles;
+			size_t memoryUsed;
+			// On the last update
+			unsigned int generatedTiles;
+			unsigned int releasedTiles;
+			// Since the store creation
+			unsigned long long totalGeneratedTiles;
+		} Statistics;
+	private:
+		enum TileState
+		{
+			TILE_PENDING,
+			TILE_RESIDENT
+		};
+
+		typedef struct Tile
+		{
+			TileState state;
+			std::vector<Instance> instances;
+		} Tile;
+
+		typedef struct CompletedTile
+		{
+			int i, j;
+			unsigned int generation;
+			std::vector<Instance> instances;
+		} CompletedTile;
+
+		typedef struct Request
+		{
+			int i, j;
+			float distance;
+		} Request;
+
+		Generator generator;
+		// Tiles being generated at once. Keeps the queue short so it follows the camera
+		unsigned int maxPendingTiles;
+
+		// Placement used by the tiles being generated. Replaced (and every tile dropped) when the
+		// settings change. Tasks keep their own reference
+		std::shared_ptr<const VegetationPlacement> placement;
+		unsigned int generation;
+
+		std::unordered_map<long long, Tile> tiles;
+
+		std::mutex completedLock;
+		std::vector<CompletedTile> completed;
+		std::atomic<unsigned int> pendingTasks;
+
+		// Tiles kept, [xStart, xEnd) x [yStart, yEnd), and how many of them were not requested yet
+		int xStart, xEnd, yStart, yEnd;
+		unsigned int missingTiles;
+		std::vector<Request> requests;
+
+		unsigned long long version;
+		// Tiles (i, j) which became available or were released since the last update started
+		std::vector<glm::ivec2> changedTiles;
+		// Resident tiles released by clear(), listed on the next update
+		std::vector<glm::ivec2> clearedTiles;
+		Statistics stats;
+	public:
+		VegetationInstanceStore(const Generator & generator, const VegetationPlacement::Parameters & placementParameters, unsigned int maxPendingTiles);
+		// Waits for the tiles being generated
+		~VegetationInstanceStore();
+
+		// Collects the generated tiles and keeps the tiles [xStart, xEnd) x [yStart, yEnd): requests
+		// the ones entering the area and releases the ones leaving it
+		void update(int xStart, int xEnd, int yStart, int yEnd);
+		// Drops every tile if the placement changed
+		void setPlacementParameters(const VegetationPlacement::Parameters & placementParameters);
+		// Blocks until every tile being generated is done, and collects them
+		void flush();
+		// Releases every tile
+		void clear();
+
+		// Instances of the tile (i, j). Empty until the tile is generated
+		const std::vector<Instance> & getTile(int i, int j) const;
+		// Changes whenever a tile becomes available or is released
+		unsigned long long getVersion() const;
+		// Tiles (i, j) which became available or were released on the last update (and flush() after it),
+		// such as to render again the shadows of their instances. The tiles released by clear() are listed
+		// on the next update, and every tile of the area again once it is generated
+		const std::vector<glm::ivec2> & getChangedTiles() const;
+
+		const Statistics & getStatistics() const;
+	private:
+		static long long getKey(int i, int j);
+
+		void collectCompleted();
+		void requestTiles();
+	};
+}
@@ -0,0 +1,54 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#pragma once
+
+#include <cstddef>
+
+#include "TerrainHeightField.h"
+
+namespace Engine
+{
+	/**
+	 * Decides where vegetation grows on the terrain, evaluating on the CPU the same masks the
+	 * terrain shading uses: above the water and below the maximum vegetation height, and only
+	 * where the terrain is flat enough to be shaded as grass (see terrain.frag). Also gives the
+	 * random values used to place the vegetation candidates, derived from the world seed only,
+	 * so the same world always grows the same vegetation. Safe to use from several threads
+	 */
+	class VegetationPlacement
+	{
+	public:
+		typedef struct Parameters
+		{
+			TerrainHeightField::Parameters terrain;
+			// Noise height range where vegetation grows (see TerrainHeightField::getNoiseHeight)
+			float minHeight;
+			float maxHeight;
+			// Minimum cosine between the terrain normal and the up vector
+			float minSlopeCos;
+			unsigned int seed;
+		} Parameters;
+	private:
+		Parameters params;
+		TerrainHeightField heightField;
+	public:
+		VegetationPlacement(const Parameters & parameters);
+
+		// Uses the current terrain, water and vegetation Settings, and the world seed
+		static Parameters getSettingsParameters();
+		static bool equals(const Parameters & a, const Parameters & b);
+
+		const Parameters & getParameters() const;
+
+		// Evaluates the masks at the world positions (x, z). Gives wether vegetation grows on each of
+		// them, and the world height of the terrain surface there
+		void evaluate(const float * x, const float * z, float * heights, unsigned char * accepted, size_t count) const;
+
+		// Random value in [0, 1) of the given index, for the tile (i, j) and the given kind of
+		// vegetation. Does not depend on the platform standard library
+		float random(int i, int j, unsigned int kind, unsigned int index) const;
+	};
+}
@@ -0,0 +1,106 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+namespace Engine
+{
+	// Vertex attributes a Mesh can hold
+	enum VertexAttribute
+	{
+		VERTEX_ATTRIB_POSITION,
+		VERTEX_ATTRIB_NORMAL,
+		VERTEX_ATTRIB_COLOR,
+		VERTEX_ATTRIB_EMISSION,
+		VERTEX_ATTRIB_UV,
+		VERTEX_ATTRIB_TANGENT,
+		VERTEX_ATTRIB_COUNT
+	};
+
+	// Storage type of the components of a vertex attribute on the GPU
+	enum VertexAttributeType
+	{
+		// 32 bit floats, stored as they are on the CPU
+		VERTEX_TYPE_FLOAT32,
+		// Unit vectors octahedral encoded on 2 snorm16 components (must be decoded in the shader)
+		VERTEX_TYPE_OCT16,
+		// Values in [0, 1] stored as unorm8 (padded to 4 bytes)
+		VERTEX_TYPE_UNORM8,
+		// 16 bit floats
+		VERTEX_TYPE_HALF16
+	};
+
+	// Layout of a single attribute within the vertex buffers
+	typedef struct VertexAttributeFormat
+	{
+		// Wether the mesh holds this attribute
+		bool present;
+		// Number of components of the attribute on the CPU side (and as read by the shaders)
+		unsigned int components;
+		// Number of components stored on the GPU (2 for octahedral encoded vectors)
+		unsigned int gpuComponents;
+		// Storage type on the GPU
+		VertexAttributeType type;
+		// Byte offset of the first value within its buffer
+		unsigned int offset;
+		// Byte distance between consecutive values
+		unsigned int stride;
+	} VertexAttributeFormat;
+
+	/**
+	 * Describes how the vertex attributes of a Mesh are stored on the GPU: either one
+	 * buffer per attribute (default) or all of them interleaved in a single buffer, and
+	 * the storage type of each attribute. Programs use it to configure the attribute
+	 * pointers (see Mesh::bindAttribute)
+	 */
+	class VertexFormat
+	{
+	private:
+		VertexAttributeFormat attributes[VERTEX_ATTRIB_COUNT];
+		bool interleaved;
+		// Size of a whole vertex on the interleaved buffer
+		unsigned int vertexSize;
+	public:
+		VertexFormat(bool interleaved = false);
+
+		// Compact format: octahedral normals and tangents, unorm8 colors and emission and
+		// half float uvs. Positions are kept as 32 bit floats
+		static VertexFormat quantized(bool interleaved = false);
+
+		bool isInterleaved() const { return interleaved; }
+		unsigned int getVertexSize() const { return vertexSize; }
+		const VertexAttributeFormat & getAttribute(VertexAttribute attribute) const { return attributes[attribute]; }
+
+		// Changes the storage type of an attribute. Octahedral encoding is only valid for 3 component attributes
+		void setAttributeType(VertexAttribute attribute, VertexAttributeType type);
+
+		// Computes offsets and strides for the given attributes (a null entry means the attribute is not present)
+		void computeLayout(const float * const data[VERTEX_ATTRIB_COUNT]);
+
+		// Size in bytes of a single value of the attribute on the GPU (always a multiple of 4)
+		unsigned int getAttributeSize(VertexAttribute attribute) const;
+
+		// Converts the attribute values of numVertices vertices into the GPU representation, writing them
+		// at dst + offset with the attribute stride
+		void packAttribute(VertexAttribute attribute, const float * src, unsigned int numVertices, unsigned char * dst) const;
+		// Packs all present attributes into an interleaved buffer of numVertices * getVertexSize() bytes
+		void packInterleaved(const float * const data[VERTEX_ATTRIB_COUNT], unsigned int numVertices, unsigned char * dst) const;
+
+		// GL type and normalization flag used to read the attribute
+		unsigned int getGLType(VertexAttribute attribute) const;
+		bool isNormalized(VertexAttribute attribute) const;
+	};
+
+	// Quantization helpers, used to pack the vertex data and exposed to check the encoding error
+	// Encodes a unit vector into 2 snorm16 values using octahedral mapping
+	void encodeOctahedral(const float * v, short * out);
+	// Decodes an octahedral encoded vector (returns a unit vector)
+	void decodeOctahedral(const short * in, float * v);
+	// Converts a float to IEEE 754 half precision (round to nearest even)
+	unsigned short floatToHalf(float value);
+	float halfToFloat(unsigned short value);
+	// Converts a value to unorm8, clamping it to [0, 1]
+	unsigned char floatToUnorm8(float value);
+	float unorm8ToFloat(unsigned char value);
+}
\ No newline at end of file
@@ -35,6 +35,20 @@ namespace Engine
 		static glm::vec3 lightColor;
 		static glm::vec3 realLightColor;
 		static glm::vec3 lightDirection;
+		// Cascade shadow maps levels (1 - 4), split scheme (see ShadowCascadeFit::SplitScheme), weight of
+		// the logarithmic splits on the practical scheme, shadowed view distance and shadow map texels per side
+		static unsigned int shadowCascades;
+		static unsigned int shadowSplitScheme;
+		static float shadowSplitLambda;
+		static float shadowDistance;
+		static unsigned int shadowMapResolution;
+		// Shadow map cache (see ShadowCascadeCache): levels from shadowCacheFirstLevel on are only rendered
+		// again when their slice moves more than shadowCacheThreshold texels (then only the texels not covered
+		// yet), and every shadowCacheInterval frames (0 never)
+		static bool shadowCache;
+		static unsigned int shadowCacheFirstLevel;
+		static unsigned int shadowCacheThreshold;
+		static unsigned int shadowCacheInterval;
 
 		static float worldTileScale;
 		static unsigned int worldRenderRadius;
@@ -47,6 +61,18 @@ namespace Engine
 		static float terrainScale;
 		static unsigned int terrainOctaves;
 		static float vegetationMaxHeight;
+		// Wether trees switch to simplified meshes with the distance
+		static bool treeLods;
+		// Wether the landscape is drawn as a quadtree of nodes growing with the distance instead of
+		// a grid of tessellated tiles, and the screen-space error (pixels) allowed to its nodes
+		static bool terrainQuadTree;
+		static float terrainPixelError;
+		// Wether landscape tiles sample height and normal maps generated on the thread pool
+		// instead of evaluating the terrain noise
+		static bool terrainTileCache;
+		// Wether terrain components draw all their visible tiles with a single instanced draw
+		// instead of one draw per tile
+		static bool terrainInstancing;
 		static float grassCoverage;
 		static glm::vec3 grassColor;
 		static glm::vec3 sandColor;
@@ -85,7 +111,14 @@ namespace Engine
 		static float godRaysDecay;
 		static float godRaysWeight;
 
+		// Wether the G-buffer stores octahedral encoded normals and no position, which the deferred passes
+		// rebuild from the depth buffer. Read when the renderer and the programs are initialized
+		static bool compactGBuffer;
+
 		static bool showUI;
+		// Wether the GL uniform calls are counted for the frame statistics (see FrameStatistics)
+		static bool countUniformCalls;
+		static bool dumpFrameGraph;
 	public:
 		static void update();
 	};
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "Mesh.h"
+#include "MeshCache.h"
 #include <vector>
 #include <map>
 #include <assimp\scene.h>
@@ -25,6 +26,9 @@ namespace Engine
 		// List of meshes
 		std::map<std::string, Mesh *> meshCache;
 
+		// Directory of the binary mesh cache files (empty when disabled)
+		std::string cacheDirectory;
+
 	private:
 		MeshTable();
 
@@ -33,13 +37,32 @@ namespace Engine
 
 		~MeshTable();
 
-		// Returns the mesh described by filename. If it is not present, will attempt to load from disk
+		// Returns the mesh described by filename. If it is not present, will attempt to load from disk,
+		// from the binary mesh cache if there is an up to date entry, otherwise importing the file
+		// (which is then written to the cache)
 		Mesh * getMesh(std::string fileName);
 
 		// Manually place a mesh into the cache
 		void addMeshToCache(std::string name, const Mesh & mesh);
+		// Manually place a mesh into the cache, taking ownership of it (no copy is made). Returns
+		// false, leaving the mesh to the caller, if there is already a mesh with the given name
+		bool addMeshToCache(std::string name, Mesh * mesh);
+
+		// Sets where the binary mesh cache is stored (see MeshCache). An empty directory disables it
+		void setCacheDirectory(const std::string & directory);
+		// Loads and uploads the cache entry with the given name if it was built from paramHash, otherwise
+		// returns null. Does not add the mesh to the table
+		Mesh * loadCachedMesh(const std::string & name, unsigned long long paramHash) const;
+		// Same as loadCachedMesh, but without uploading the mesh (see MeshCache::readMesh), so it can be
+		// called from any thread
+		bool readCachedMesh(const std::string & name, unsigned long long paramHash, MeshCache::Entry & entry) const;
+		// Writes the mesh as the cache entry with the given name. Can be called from any thread
+		bool storeCachedMesh(const std::string & name, unsigned long long paramHash, const Mesh & mesh) const;
 
 		// Clean all meshes (GPU & CPU)
 		void clean();
+
+	private:
+		std::string getCacheFileName(const std::string & name) const;
 	};
 }
\ No newline at end of file
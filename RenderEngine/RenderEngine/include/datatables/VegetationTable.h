@@ -6,8 +6,11 @@
 #pragma once
 
 #include "Mesh.h"
+#include "MeshSimplifier.h"
 #include "ProceduralVegetation.h"
 
+#include <vector>
+
 namespace Engine
 {
 	/*
@@ -26,5 +29,18 @@ namespace Engine
 	public:
 		// Generates a tree mesh using a fractal algorithm
 		Mesh * generateFractalTree(const TreeGenerationData & data, bool addToMeshTable =  true);
+		// Generates a batch of fractal trees. Geometry is built concurrently on the thread pool
+		// and uploaded to the GPU on the calling thread (which must own the GL context). The
+		// result is the same as calling generateFractalTree for each entry, in the same order
+		std::vector<Mesh *> generateFractalTrees(const std::vector<TreeGenerationData> & data, bool addToMeshTable = true);
+		// Geometry of the batch, built concurrently on the thread pool without the mesh cache and without uploading
+		// it. Must be called on the GL thread, as the generators fetch their base shapes from the MeshTable
+		std::vector<Mesh *> generateFractalTreesCPU(const std::vector<TreeGenerationData> & data);
+		// Builds the levels of detail of trees generated from data (trees[i] from data[i]): result[i][l] is trees[i]
+		// simplified with lods[l]. Simplification runs on the thread pool and the meshes are uploaded on the calling
+		// thread. They are kept in the mesh cache and, if requested, added to the mesh table as "<treeName>_lod<l + 1>".
+		// A level which can not be simplified is reported and replaced by trees[i] itself (not added to the mesh table)
+		std::vector<std::vector<Mesh *>> generateFractalTreeLods(const std::vector<TreeGenerationData> & data, const std::vector<Mesh *> & trees,
+			const std::vector<MeshSimplifier::LodSettings> & lods, bool addToMeshTable = true);
 	};
 }
\ No newline at end of file
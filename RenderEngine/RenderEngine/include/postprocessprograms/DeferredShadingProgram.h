@@ -32,12 +32,17 @@ namespace Engine
 		// Zenit and horizon color (used for atmospheric fog)
 		unsigned int uSkyZenitColor;
 		unsigned int uSkyHorizonColor;
+
+		// Inverse projection matrix, to rebuild the position from the depth on the compact G-buffer
+		unsigned int uInvProjMat;
 	public:
 		DeferredShadingProgram(std::string name, unsigned long long params);
 		DeferredShadingProgram(const DeferredShadingProgram & other);
 
 		void onRenderObject(const Object * obj, Camera * camera);
 		void configureProgram();
+	protected:
+		std::string getConfigString();
 	private:
 		// Updates the needed data from the directional light buffer
 		void processDirectionalLights(DirectionalLight * dl, const glm::mat4 & viewMatrix);
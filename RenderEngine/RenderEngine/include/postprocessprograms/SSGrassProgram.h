@@ -24,12 +24,17 @@ namespace Engine
 		unsigned int uGrassInfoBuffer;
 		// Fragment camera space position texture id
 		unsigned int uPosBuffer;
+		// Depth texture and inverse projection matrix ids, which replace the position on the compact G-buffer
+		unsigned int uDepthBuffer;
+		unsigned int uInvProjMat;
 	public:
 		SSGrassProgram(std::string name, unsigned long long params);
 		SSGrassProgram(const SSGrassProgram & other);
 
 		void configureProgram();
 		void onRenderObject(const Object * obj, Camera * camera);
+	protected:
+		std::string getConfigString();
 	};
 
 	// =======================================================================
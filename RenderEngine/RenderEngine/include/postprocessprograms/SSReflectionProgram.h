@@ -20,13 +20,15 @@ namespace Engine
 	private:
 		// Projection matrix id
 		unsigned int uProjMat;
+		// Inverse projection matrix id (compact G-buffer, which has no position buffer)
+		unsigned int uInvProjMat;
 		// Position texture buffer id
 		unsigned int uPosBuffer;
 		// Normal texture buffer id
 		unsigned int uNormalBuffer;
 		// Depth texture buffer id
 		unsigned int uDepthBuffer;
-		// Reflection texture buffer id
+		// Reflection texture buffer id (emissive buffer on the compact G-buffer)
 		unsigned int uSpecularBuffer;
 		// Light direction
 		unsigned int uLightDir;
@@ -36,6 +38,8 @@ namespace Engine
 
 		void configureProgram();
 		void onRenderObject(const Object * obj, Camera * camera);
+	protected:
+		std::string getConfigString();
 	};
 
 	// =====================================================================
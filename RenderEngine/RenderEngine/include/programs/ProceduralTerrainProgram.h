@@ -6,6 +6,8 @@
 #pragma once
 
 #include "Program.h"
+#include "InstanceBuffer.h"
+#include "TerrainQuadTree.h"
 
 namespace Engine
 {
@@ -25,6 +27,11 @@ namespace Engine
 		static const unsigned long long POINT_DRAW_MODE;
 		// Render shadow map depth mode
 		static const unsigned long long SHADOW_MAP;
+		// Draw quadtree nodes (grids displaced on the vertex shader) instead of tessellated tiles
+		static const unsigned long long QUADTREE_MODE;
+		// Draw every tile with a single instanced draw. Tiles are given per instance (grid position
+		// and tile cache layer) and drawn in world space
+		static const unsigned long long INSTANCED;
 	protected:
 		// Tessellation control shader path
 		std::string tcsShaderFile;
@@ -40,6 +47,8 @@ namespace Engine
 		unsigned int uInPos;
 		// Vertex texture coordinates attribute id
 		unsigned int uInUV;
+		// Per instance tile attribute id (instanced mode)
+		unsigned int uInInstance;
 
 		// Model view matrix id
 		unsigned int uModelView;
@@ -48,14 +57,16 @@ namespace Engine
 		// Normal (transpose(inverse(modelView)) matrix id
 		unsigned int uNormal;
 
-		// Cascade Shadow map level 0 projection matrix id
-		unsigned int uLightDepthMatrix;
-		// Cascade shadow map level 1 projection matrix id
-		unsigned int uLightDepthMatrix1;
-		// Cascade shadow map level 0 depth texture
-		unsigned int uDepthTexture;
-		// Cascade shadow map level 1 depth texture
-		unsigned int uDepthTexture1;
+		// Shadow map region projection matrices, layers and regions in use ids (shadow map pass)
+		unsigned int uRegionDepthMatrices;
+		unsigned int uRegionLayers;
+		unsigned int uShadowRegions;
+		// Cascade shadow maps projection matrices id
+		unsigned int uLightDepthMatrices;
+		// Cascade shadow maps depth textures id
+		unsigned int uDepthTextures;
+		// Cascade shadow maps levels in use id
+		unsigned int uCascadeLevels;
 		// Light direction id
 		unsigned int uLightDirection;
 
@@ -72,6 +83,19 @@ namespace Engine
 		// World grid position id
 		unsigned int uGridPos;
 
+		// Quadtree node area, grid resolution and morph distances ids
+		unsigned int uNodeOffset;
+		unsigned int uNodeSize;
+		unsigned int uGridResolution;
+		unsigned int uMorphRange;
+		// Camera position (in terrain tiles) id
+		unsigned int uCameraPosition;
+
+		// Tile cache height and normal map arrays, and layer of the current tile ids
+		unsigned int uTileHeights;
+		unsigned int uTileNormals;
+		unsigned int uTileLayer;
+
 		// Perlin amplitude id
 		unsigned int uAmplitude;
 		// Perlin frequency id
@@ -106,10 +130,20 @@ namespace Engine
 
 		// Set current world grid position
 		void setUniformGridPosition(unsigned int i, unsigned int j);
-		// Sets cascade shadow maps level 0 light depth matrix
-		void setUniformLightDepthMatrix(const glm::mat4 & ldm);
-		// Sets cascade shadow maps level 1 light depth matrix
-		void setUniformLightDepthMatrix1(const glm::mat4 & ldm);
+		// Sets the light depth matrix of each shadow map region being rendered (shadow map pass)
+		void setUniformRegionDepthMatrices(const glm::mat4 * rdm, unsigned int regions);
+		// Sets the light depth matrices of the cascade shadow maps levels
+		void setUniformLightDepthMatrices(const glm::mat4 * ldm, unsigned int levels);
+		// Sets the quadtree node to draw (quadtree mode)
+		void setUniformQuadTreeNode(const TerrainQuadTree::Node & node);
+		// Sets the camera position, in terrain tiles (quadtree mode)
+		void setUniformCameraPosition(const glm::vec3 & position);
+		// Sets the tile cache layer holding the maps of the current tile, -1 to evaluate the terrain noise
+		void setUniformTileLayer(int layer);
+
+		// Feeds the tiles of the instanced mode, from firstInstance on, to the bound vertex array
+		void bindInstances(InstanceBuffer & instances, size_t firstInstance = 0);
+		void unbindInstances(InstanceBuffer & instances);
 	};
 
 	// ===================================================================================
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "Program.h"
+#include "InstanceBuffer.h"
 
 namespace Engine
 {
@@ -25,6 +26,9 @@ namespace Engine
 		static const unsigned long long POINT_DRAW_MODE;
 		// Render shadow map depth mode (unused, discared to render water shadows)
 		static const unsigned long long SHADOW_MAP;
+		// Draw every tile with a single instanced draw. Tiles are given per instance (grid position,
+		// height and width) and drawn in world space
+		static const unsigned long long INSTANCED;
 	private:
 		// Geometry shader file (we need geomtry shader to draw as wireframe, even though its just 2 triangles)
 		std::string gShaderFile;
@@ -36,6 +40,8 @@ namespace Engine
 		unsigned int uInPos;
 		// Texture coordinates attribute id
 		unsigned int uInUV;
+		// Per instance tile attribute id (instanced mode)
+		unsigned int uInInstance;
 
 		// Model view matrix id
 		unsigned int uModelView;
@@ -51,14 +57,14 @@ namespace Engine
 
 		// Shadow render has been disabled for water
 		// Data is kept though
-		// Cascade shadow maps level 0 light depth matrix
+		// Shadow map light depth matrix (shadow map pass)
 		unsigned int uLightDepthMatrix;
-		// Cascade shadow maps level 1 light depth matrix
-		unsigned int uLightDepthMatrix1;
-		// Cascade shadow maps level 0 depth texture
-		unsigned int uDepthTexture;
-		// Cascade shadow maps level 1 depth texture
-		unsigned int uDepthTexture1;
+		// Cascade shadow maps levels light depth matrices
+		unsigned int uLightDepthMatrices;
+		// Cascade shadow maps levels depth textures
+		unsigned int uDepthTextures;
+		// Cascade shadow maps levels in use
+		unsigned int uCascadeLevels;
 		// Light direction id
 		unsigned int uLightDirection;
 
@@ -86,10 +92,14 @@ namespace Engine
 		
 		// Sets the world grid position
 		void setUniformGridPosition(unsigned int i, unsigned int j);
-		// Sets the cascade shadow map level 0 light projection matrix
+		// Sets the light projection matrix of the shadow map being rendered (shadow map pass)
 		void setUniformLightDepthMatrix(const glm::mat4 & ldm);
-		// Sets the cascade shadow map level 1 light projection matrix
-		void setUniformLightDepthMatrix1(const glm::mat4 & ldm);
+		// Sets the cascade shadow map levels light projection matrices
+		void setUniformLightDepthMatrices(const glm::mat4 * ldm, unsigned int levels);
+
+		// Feeds the tiles of the instanced mode to the bound vertex array
+		void bindInstances(InstanceBuffer & instances);
+		void unbindInstances(InstanceBuffer & instances);
 	};
 
 	// =========================================================
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "Program.h"
+#include "InstanceBuffer.h"
 
 namespace Engine
 {
@@ -25,6 +26,9 @@ namespace Engine
 		const static unsigned long long WIRE_MODE;
 		// Render as point mode
 		const static unsigned long long POINT_MODE;
+		// Draw many trees with a single instanced draw. Trees are given per instance (world
+		// position and wind direction) and drawn in world space
+		const static unsigned long long INSTANCED;
 	private:
 		// Geometry shader file path
 		std::string gShaderFile;
@@ -38,36 +42,21 @@ namespace Engine
 		unsigned int uModelView;
 		// Normal matrix id
 		unsigned int uNormal;
-		// Cascade shadow map level 0 light depth matrix
-		unsigned int uLightDepthMat0;
-		// Cascade shadow map level 1 light depth matrix
-		unsigned int uLightDepthMat1;
-		// Cascade shadow map level 0 depth texture
-		unsigned int uDepthMap0;
-		// Cascade shadow map level 1 depth texture
-		unsigned int uDepthMap1;
-		// Normalized 2D position within the current World grid cell id
-		unsigned int uGridUV;
+		// Shadow map regions light depth matrices, layers and regions in use (shadow map pass)
+		unsigned int uRegionDepthMats;
+		unsigned int uRegionLayers;
+		unsigned int uShadowRegions;
+		// Cascade shadow map levels light depth matrices
+		unsigned int uLightDepthMats;
+		// Cascade shadow map levels depth textures
+		unsigned int uDepthMaps;
+		// Cascade shadow map levels in use
+		unsigned int uCascadeLevels;
+		// Wind bending direction of the tree (1 or -1) id
+		unsigned int uWindSign;
 
-		// Terrain data, used to emulate terrain to compute the vegetation height 
-		// and accept/drop tree depending on its position
-		// (discarded: on water or over the max vegetaion height)
-		// Perlin amplitude id
-		unsigned int uAmplitude;
-		// Perlin frequency id
-		unsigned int uFrecuency;
-		// Perlin scale id
-		unsigned int uScale;
-		// Perlin octaves id
-		unsigned int uOctaves;
 		// Light direction id
 		unsigned int uLightDir;
-		// Normalized water height id
-		unsigned int uWaterLevel;
-		// Normalized max vegetation spawn height id
-		unsigned int uMaxHeight;
-		// World tile scale
-		unsigned int uWorldScale;
 		// Sin of elapsed time since beggining
 		unsigned int uSinTime;
 		// Wind direction vector
@@ -79,12 +68,14 @@ namespace Engine
 		unsigned int uInPos;
 		// Vertex color attribute id
 		unsigned int uInColor;
-		// Vertex normal attribute id
+		// Vertex normal attribute id (octahedral encoded, see VertexFormat::quantized)
 		unsigned int uInNormal;
 		// Vertex emission attribute id
 		unsigned int uInEmissive;
 		// Vertex texture coordinates attribute id
 		unsigned int uInUV;
+		// Per instance tree attribute id (instanced mode)
+		unsigned int uInInstance;
 	public:
 		TreeProgram(std::string name, unsigned long long params);
 		TreeProgram(const TreeProgram & other);
@@ -98,12 +89,16 @@ namespace Engine
 		void applyGlobalUniforms();
 		void onRenderObject(const Object * obj, Camera * camera);
 
-		// Sets the normalized position within the current world grid cell
-		void setUniformTileUV(float u, float v);
-		// Sets the cascade shadow map level 0 light projection matrix
-		void setUniformLightDepthMat(const glm::mat4 & ldp);
-		// Sets the cascade shadow map level 1 light projection matrix
-		void setUniformLightDepthMat1(const glm::mat4 & ldp);
+		// Sets the wind bending direction of the tree (1 or -1)
+		void setUniformWindSign(float sign);
+		// Sets the light projection matrix of each shadow map region being rendered (shadow map pass)
+		void setUniformRegionDepthMats(const glm::mat4 * rdp, unsigned int regions);
+		// Sets the cascade shadow map levels light projection matrices
+		void setUniformLightDepthMats(const glm::mat4 * ldp, unsigned int levels);
+
+		// Feeds the trees of the instanced mode, from firstInstance on, to the bound vertex array
+		void bindInstances(InstanceBuffer & instances, size_t firstInstance = 0);
+		void unbindInstances(InstanceBuffer & instances);
 
 		void destroy();
 	};
@@ -8,6 +8,7 @@
 #include "Renderer.h"
 #include "Object.h"
 #include "DeferredNodeCallbacks.h"
+#include "RenderGraph.h"
 
 #include "postprocessprograms/DeferredShadingProgram.h"
 
@@ -22,7 +23,9 @@ namespace Engine
 		Program *postProcessProgram;
 		// Mesh to render (typcipally a screen quad)
 		PostProcessObject * obj;
-		// Render target
+		// Targets written by the pass, one per color attachment. It reads the ones of the previous pass
+		std::vector<RenderGraph::TargetDesc> outputs;
+		// Render target, created by the renderer with the textures the render graph assigns to the outputs
 		DeferredRenderObject * renderBuffer;
 		// Optional initialization & execution code callback
 		DeferredCallback * callBack;
@@ -45,6 +48,11 @@ namespace Engine
 		// 1 buffer for general-purpose info
 		DeferredRenderObject * deferredPassBuffer;
 
+		// Passes from the deferred shading to the screen output, and the targets they read and write
+		RenderGraph renderGraph;
+		// Textures the render graph shares between the targets
+		std::vector<TextureInstance *> graphTextures;
+
 		// Deferred shading program instance
 		DeferredShadingProgram * deferredShading;
 
@@ -65,7 +73,8 @@ namespace Engine
 		// Function pointer that points to the current render code
 		void (DeferredRenderer::*renderFunc)();
 
-		// G-Buffer textures
+		// G-Buffer textures. The compact layout (see Settings::compactGBuffer) has no position buffer, and stores
+		// the specular on the emissive buffer alpha
 		TextureInstance * gBufferPos;
 		TextureInstance * gBufferNormal;
 		TextureInstance * gBufferEmissive;
@@ -73,6 +82,8 @@ namespace Engine
 		TextureInstance * gBufferColor;
 		TextureInstance * gBufferDepth;
 		TextureInstance * gBufferInfo;
+		// Bytes per pixel of the G-buffer textures, depth included
+		unsigned int gBufferBytesPerPixel;
 	public:
 		DeferredRenderer();
 		~DeferredRenderer();
@@ -90,6 +101,9 @@ namespace Engine
 		const TextureInstance * getGBufferColor();
 		const TextureInstance * getGBufferDepth();
 		const TextureInstance * getGBufferInfo();
+		unsigned int getGBufferBytesPerPixel() const;
+
+		const RenderGraph & getRenderGraph() const;
 	private:
 		// Render function executed once at the beggining of the execution
 		// used to execute baking passes on the GPU
@@ -97,5 +111,7 @@ namespace Engine
 		// Actual render loop function
 		void renderLoop();
 		void runPostProcesses();
+		// Builds the FBO of a pass of the render graph with the textures assigned to its writes
+		DeferredRenderObject * createPassBuffer(unsigned int pass);
 	};
 }
\ No newline at end of file
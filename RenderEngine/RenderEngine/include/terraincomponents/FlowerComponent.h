@@ -4,7 +4,9 @@
 */
 #pragma once
 
+#include "InstanceBuffer.h"
 #include "TerrainComponent.h"
+#include "VegetationInstanceStore.h"
 
 #include "programs/TreeProgram.h"
 
@@ -27,22 +29,53 @@ namespace Engine
 		// Active render shader
 		TreeProgram * activeShader;
 
+		// Same programs for the instanced flowers
+		TreeProgram * instancedFillShader;
+		TreeProgram * instancedWireShader;
+		TreeProgram * instancedPointShader;
+		TreeProgram * activeInstancedShader;
+
 		// Flower instance
 		Object * flower;
-		// Number of flowers per terrain tile
-		size_t flowersToSpawn;
+		// Candidate flower positions per terrain tile. Only the ones passing the placement masks get a flower
+		unsigned int flowersToSpawn;
+		// Model space bounds of the flower mesh
+		glm::vec3 shapeMin, shapeMax;
+
+		// Flowers of the tiles within the render radius, placed once per tile on the thread pool
+		VegetationInstanceStore * flowerStore;
+
+		// Untransformed flower, as the instanced flowers are placed in world space by the shaders
+		Object * worldFlower;
+		// Flowers of the last instanced draw, the tiles they belong to and the store version they were
+		// taken from. The upload is skipped while they do not change
+		std::vector<glm::vec4> instanceData;
+		std::vector<glm::ivec2> uploadedTiles;
+		unsigned long long uploadedVersion;
+		InstanceBuffer instances;
 	public:
 		FlowerComponent();
 
 		unsigned int getRenderRadius();
+		const char * getName();
+		void getTileBounds(int i, int j, glm::vec3 & boundsMin, glm::vec3 & boundsMax);
 
 		void initialize();
+		void updateComponent(Engine::Camera * camera);
 		void preRenderComponent();
 		void renderComponent(int i, int j, Engine::Camera * camera);
-		void renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam);
+		void renderShadow(const glm::mat4 * projections, unsigned int regions, int i, int j, Engine::Camera * cam);
 		void notifyRenderModeChange(Engine::RenderMode mode);
 
+		bool supportsInstancing();
+		void renderInstances(const std::vector<glm::ivec2> & tiles, Engine::Camera * camera);
+
 		Program * getActiveShader();
 		Program * getShadowMapShader();
+
+		const VegetationInstanceStore * getInstanceStore() const;
+	private:
+		// Places the flowers of the tile (i, j). Runs on the thread pool
+		void generateFlowers(const VegetationPlacement & placement, int i, int j, std::vector<VegetationInstanceStore::Instance> & flowers);
 	};
 }
\ No newline at end of file
@@ -4,7 +4,9 @@
 */
 #pragma once
 
+#include "InstanceBuffer.h"
 #include "TerrainComponent.h"
+#include "TerrainTileCache.h"
 
 #include "programs/ProceduralTerrainProgram.h"
 
@@ -29,20 +31,70 @@ namespace Engine
 		// Active program (shading or wire)
 		ProceduralTerrainProgram * activeShader;
 
+		// Same programs for the quadtree terrain mode
+		ProceduralTerrainProgram * quadTreeFillShader;
+		ProceduralTerrainProgram * quadTreeWireShader;
+		ProceduralTerrainProgram * quadTreePointShader;
+		ProceduralTerrainProgram * quadTreeShadowShader;
+		ProceduralTerrainProgram * activeQuadTreeShader;
+
+		// Same programs for the instanced tiles
+		ProceduralTerrainProgram * instancedFillShader;
+		ProceduralTerrainProgram * instancedWireShader;
+		ProceduralTerrainProgram * instancedPointShader;
+		ProceduralTerrainProgram * instancedShadowShader;
+		ProceduralTerrainProgram * activeInstancedShader;
+
 		// Tile instance
 		Object * landscapeTile;
+		// Unscaled tile, as the instanced tiles are placed in world space by the shaders
+		Object * worldTile;
+		// Tiles of the last instanced draw: grid position (xy) and tile cache layer (z)
+		std::vector<glm::vec4> instanceData;
+		InstanceBuffer instances;
+		// Quadtree node grid instances (full and half resolution). Scaled to tiles
+		Object * nodeGrid;
+		Object * halfNodeGrid;
+
+		// Height and normal maps of the tiles around the camera (Settings::terrainTileCache), and the
+		// texture arrays holding a layer per cache slot
+		TerrainTileCache * tileCache;
+		unsigned int tileHeightsTexture;
+		unsigned int tileNormalsTexture;
+		// Camera position (in tiles) on the last update, to prefetch along its movement
+		glm::vec2 lastCameraTile;
 	public:
 		LandscapeComponent();
 
 		unsigned int getRenderRadius();
+		const char * getName();
+		bool isTileHidden(int i, int j, float minHeight, float maxHeight, Engine::Camera * camera);
 
 		void initialize();
+		void updateComponent(Engine::Camera * camera);
 		void preRenderComponent();
 		void renderComponent(int i, int j, Engine::Camera * camera);
-		void renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam);
+		void renderShadow(const glm::mat4 * projections, unsigned int regions, int i, int j, Engine::Camera * cam);
 		void notifyRenderModeChange(Engine::RenderMode mode);
 
+		bool supportsQuadTree();
+		void renderQuadTreeNode(const TerrainQuadTree::Node & node, Engine::Camera * camera);
+		void renderQuadTreeNodeShadow(const glm::mat4 * projections, unsigned int regions, const TerrainQuadTree::Node & node, Engine::Camera * cam);
+
+		bool supportsInstancing();
+		void renderInstances(const std::vector<glm::ivec2> & tiles, Engine::Camera * camera);
+		void renderShadowInstances(const glm::mat4 * projections, unsigned int regions, const std::vector<glm::ivec2> & tiles, Engine::Camera * cam);
+
 		Program * getActiveShader();
 		Program * getShadowMapShader();
+
+		const TerrainTileCache * getTileCache() const;
+	private:
+		Object * createNodeGrid(ProceduralTerrainProgram * programs[4], unsigned int resolution);
+		void createTileCache();
+		// Tile cache layer of the tile (i, j), -1 if it is not cached
+		int getTileLayer(int i, int j);
+		// Uploads the instances of the tiles given
+		void uploadInstances(const std::vector<glm::ivec2> & tiles);
 	};
 }
\ No newline at end of file
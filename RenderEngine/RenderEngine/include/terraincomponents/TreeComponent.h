@@ -4,7 +4,9 @@
 */
 #pragma once
 
+#include "InstanceBuffer.h"
 #include "TerrainComponent.h"
+#include "VegetationInstanceStore.h"
 
 #include "programs/TreeProgram.h"
 
@@ -31,28 +33,86 @@ namespace Engine
 		// Active shader (shading or wireframe)
 		TreeProgram * activeShader;
 
+		// Same programs for the instanced trees
+		TreeProgram * instancedFillShader;
+		TreeProgram * instancedWireShader;
+		TreeProgram * instancedPointShader;
+		TreeProgram * instancedShadowShader;
+		TreeProgram * activeInstancedShader;
+
 		// List of type of trees
 		std::vector<Object *> treeTypes;
-		// Number of trees to spawn per terrain tile
-		size_t treesToSpawn;
-		// Equal amount of each tree type to spawn
-		size_t equalAmountOfTrees;
-		// shuffled jitter pattern to ensure trees are spread
-		glm::vec2 * jitterPattern;
+		// Levels of detail of each type of tree: treeLods[type][0] is the full detail tree,
+		// followed by the simplified versions
+		std::vector<std::vector<Object *>> treeLods;
+		// Distance (in tiles) from the camera to the tile center at which each simplified level starts
+		std::vector<float> lodDistances;
+		// Candidate tree positions per terrain tile, jittered on a grid to ensure trees are spread.
+		// Only the ones passing the placement masks get a tree
+		unsigned int treesToSpawn;
+		// Model space bounds enclosing every type of tree
+		glm::vec3 shapeMin, shapeMax;
+
+		// Trees of the tiles within the render radius, placed once per tile on the thread pool (the
+		// instance type is the tree type)
+		VegetationInstanceStore * treeStore;
+
+		// Trees uploaded for the instanced draws of a pass, grouped by type and level of detail
+		// (type * levels + level) so each group is a single draw
+		typedef struct TreeInstanceGroups
+		{
+			InstanceBuffer instances;
+			// Tiles (i, j) and level of detail (z) uploaded, and store version they were taken from.
+			// The upload is skipped while they do not change
+			std::vector<glm::ivec3> tiles;
+			unsigned long long version;
+			// First instance and number of instances of each group
+			std::vector<size_t> groupStart;
+			std::vector<size_t> groupCount;
+		} TreeInstanceGroups;
+
+		// Untransformed tree, as the instanced trees are placed in world space by the shaders
+		Object * worldTree;
+
+		TreeInstanceGroups mainInstances;
+		// Every shadow map region draws the same trees
+		TreeInstanceGroups shadowInstances;
+		// Upload scratch: tiles to draw, trees of each group, and every group one after another
+		std::vector<glm::ivec3> tileLods;
+		std::vector<std::vector<glm::vec4>> groupInstances;
+		std::vector<glm::vec4> instanceData;
 	public:
 		TreeComponent();
 
 		unsigned int getRenderRadius();
+		const char * getName();
+		void getTileBounds(int i, int j, glm::vec3 & boundsMin, glm::vec3 & boundsMax);
 
 		void initialize();
+		void updateComponent(Engine::Camera * camera);
 		void renderComponent(int i, int j, Engine::Camera * camera);
-		void renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam);
+		void renderShadow(const glm::mat4 * projections, unsigned int regions, int i, int j, Engine::Camera * cam);
 		void notifyRenderModeChange(Engine::RenderMode mode);
 
+		bool supportsInstancing();
+		void renderInstances(const std::vector<glm::ivec2> & tiles, Engine::Camera * camera);
+		void renderShadowInstances(const glm::mat4 * projections, unsigned int regions, const std::vector<glm::ivec2> & tiles, Engine::Camera * cam);
+
 		Program * getActiveShader();
 		Program * getShadowMapShader();
+
+		const VegetationInstanceStore * getInstanceStore() const;
 	private:
 		// Run the fractal tree generator to build a fixed number of different procedural trees
 		void initTrees();
+		// Level of detail to use for the trees of the tile (i, j)
+		unsigned int selectLod(int i, int j, Engine::Camera * cam);
+		// Places the trees of the tile (i, j). Runs on the thread pool
+		void generateTrees(const VegetationPlacement & placement, int i, int j, std::vector<VegetationInstanceStore::Instance> & trees);
+		// Uploads the trees of the tiles given, grouped by type and level of detail, unless the
+		// groups already hold them
+		void uploadInstances(TreeInstanceGroups & groups, const std::vector<glm::ivec2> & tiles, Engine::Camera * cam);
+		// Draws each group of trees uploaded with a single instanced draw
+		void drawInstances(TreeProgram * program, TreeInstanceGroups & groups, bool recordStatistics);
 	};
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 */
 #pragma once
 
+#include "InstanceBuffer.h"
 #include "TerrainComponent.h"
 
 #include "programs/ProceduralWaterProgram.h"
@@ -28,19 +29,36 @@ namespace Engine
 		// Active shader
 		ProceduralWaterProgram * activeShader;
 
+		// Same programs for the instanced tiles
+		ProceduralWaterProgram * instancedFillShader;
+		ProceduralWaterProgram * instancedWireShader;
+		ProceduralWaterProgram * instancedPointShader;
+		ProceduralWaterProgram * activeInstancedShader;
+
 		// Tile instance to render
 		Object * waterTile;
+		// Unscaled tile, as the instanced tiles are placed in world space by the shaders
+		Object * worldTile;
+		// Tiles of the last instanced draw: grid position (xy), height (z) and width (w)
+		std::vector<glm::vec4> instanceData;
+		InstanceBuffer instances;
 	public:
 		WaterComponent();
 
 		unsigned int getRenderRadius();
+		const char * getName();
+		void getTileBounds(int i, int j, glm::vec3 & boundsMin, glm::vec3 & boundsMax);
+		bool isTileHidden(int i, int j, float minHeight, float maxHeight, Engine::Camera * camera);
 
 		void initialize();
 
 		void preRenderComponent();
 		void renderComponent(int i, int j, Engine::Camera * camera);
-		void renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam);
+		void renderShadow(const glm::mat4 * projections, unsigned int regions, int i, int j, Engine::Camera * cam);
 		void postRenderComponent();
+
+		bool supportsInstancing();
+		void renderInstances(const std::vector<glm::ivec2> & tiles, Engine::Camera * camera);
 		void notifyRenderModeChange(Engine::RenderMode mode);
 
 		Program * getActiveShader();
@@ -4,6 +4,8 @@
 */
 #pragma once
 
+#include <cstddef>
+
 namespace Engine
 {
 	/**
@@ -12,5 +14,42 @@ namespace Engine
 	namespace IO
 	{
 		char * loadStringFromFile(const char * fileName, unsigned long long & fileLen);
+
+		// Creates the directory (the parent must exist). Returns true if it exists afterwards
+		bool createDirectory(const char * path);
+
+		// Size and last modification time (seconds since epoch) of a file. Returns false if it does not exist
+		bool getFileStatus(const char * fileName, unsigned long long & size, long long & modificationTime);
+
+		/**
+		 * Read only memory mapping of a whole file. The data stays valid until the
+		 * file is closed or the object destroyed
+		 */
+		class MappedFile
+		{
+		private:
+			const unsigned char * data;
+			size_t size;
+#ifdef _WIN32
+			void * fileHandle;
+			void * mappingHandle;
+#else
+			int fileDescriptor;
+#endif
+		public:
+			MappedFile();
+			~MappedFile();
+
+			MappedFile(const MappedFile &) = delete;
+			MappedFile & operator=(const MappedFile &) = delete;
+
+			// Maps the given file. Returns false if it does not exist, is empty or can not be mapped
+			bool open(const char * fileName);
+			void close();
+
+			bool isOpen() const { return data != 0; }
+			const unsigned char * getData() const { return data; }
+			size_t getSize() const { return size; }
+		};
 	}
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+/**
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+// SSE is always available on x64 (and on x86 when compiling with /arch:SSE2)
+#if defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENGINE_SIMD_SSE
+#include <emmintrin.h>
+#else
+#include <cmath>
+#endif
+
+namespace Engine
+{
+	/**
+	 * Minimal 4 wide float vector used by the geometry kernels. Maps to SSE when available
+	 * and to plain scalar code otherwise. Every operation is IEEE exact per lane (no
+	 * approximated reciprocals), so both paths produce the same results as scalar code
+	 */
+	namespace Simd
+	{
+#ifdef ENGINE_SIMD_SSE
+		typedef __m128 Float4;
+
+		inline Float4 set(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+		inline Float4 set1(float a) { return _mm_set1_ps(a); }
+		inline Float4 add(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+		inline Float4 sub(Float4 a, Float4 b) { return _mm_sub_ps(a, b); }
+		inline Float4 mul(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+		inline Float4 div(Float4 a, Float4 b) { return _mm_div_ps(a, b); }
+		inline Float4 sqrt(Float4 a) { return _mm_sqrt_ps(a); }
+		inline Float4 neg(Float4 a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+		// All bits set on the lanes where a < b
+		inline Float4 lessThan(Float4 a, Float4 b) { return _mm_cmplt_ps(a, b); }
+		// mask ? a : b
+		inline Float4 select(Float4 mask, Float4 a, Float4 b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+		inline Float4 maskOr(Float4 a, Float4 b) { return _mm_or_ps(a, b); }
+		// Bit i set if lane i of the mask is set
+		inline int maskBits(Float4 mask) { return _mm_movemask_ps(mask); }
+		inline Float4 load(const float * src) { return _mm_loadu_ps(src); }
+		inline void store(float * dst, Float4 a) { _mm_storeu_ps(dst, a); }
+		// Largest integer not greater than a, for |a| < 2^31
+		inline Float4 floor(Float4 a) { Float4 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a)); return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.0f))); }
+
+		// 4 wide 32 bit unsigned integer vector, wrapping on overflow
+		typedef __m128i Int4;
+
+		inline Int4 set1(unsigned int a) { return _mm_set1_epi32((int)a); }
+		inline Int4 add(Int4 a, Int4 b) { return _mm_add_epi32(a, b); }
+		// Low 32 bits of the products (SSE2 lacks _mm_mullo_epi32)
+		inline Int4 mul(Int4 a, Int4 b)
+		{
+			__m128i even = _mm_mul_epu32(a, b);
+			__m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+			return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+		}
+		inline Int4 bitXor(Int4 a, Int4 b) { return _mm_xor_si128(a, b); }
+		inline Int4 shiftRight(Int4 a, int bits) { return _mm_srl_epi32(a, _mm_cvtsi32_si128(bits)); }
+		// Conversions, truncating towards zero. toFloat expects values below 2^31
+		inline Int4 toInt(Float4 a) { return _mm_cvttps_epi32(a); }
+		inline Float4 toFloat(Int4 a) { return _mm_cvtepi32_ps(a); }
+#else
+		struct Float4
+		{
+			float v[4];
+		};
+
+		inline Float4 set(float a, float b, float c, float d) { Float4 r = { { a, b, c, d } }; return r; }
+		inline Float4 set1(float a) { return set(a, a, a, a); }
+
+#define ENGINE_SIMD_LANEWISE(name, expr) \
+		inline Float4 name(Float4 a, Float4 b) { Float4 r; for (int i = 0; i < 4; i++) { float x = a.v[i], y = b.v[i]; r.v[i] = (expr); } return r; }
+
+		ENGINE_SIMD_LANEWISE(add, x + y)
+		ENGINE_SIMD_LANEWISE(sub, x - y)
+		ENGINE_SIMD_LANEWISE(mul, x * y)
+		ENGINE_SIMD_LANEWISE(div, x / y)
+#undef ENGINE_SIMD_LANEWISE
+
+		inline Float4 sqrt(Float4 a) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = std::sqrt(a.v[i]); return r; }
+		inline Float4 neg(Float4 a) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = -a.v[i]; return r; }
+
+		// Masks are stored as 0 / 1 floats on the scalar path
+		inline Float4 lessThan(Float4 a, Float4 b) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] < b.v[i] ? 1.0f : 0.0f; return r; }
+		inline Float4 select(Float4 mask, Float4 a, Float4 b) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = mask.v[i] != 0.0f ? a.v[i] : b.v[i]; return r; }
+		inline Float4 maskOr(Float4 a, Float4 b) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = (a.v[i] != 0.0f || b.v[i] != 0.0f) ? 1.0f : 0.0f; return r; }
+		inline int maskBits(Float4 mask) { int r = 0; for (int i = 0; i < 4; i++) r |= (mask.v[i] != 0.0f ? 1 : 0) << i; return r; }
+		inline Float4 load(const float * src) { return set(src[0], src[1], src[2], src[3]); }
+		inline void store(float * dst, Float4 a) { for (int i = 0; i < 4; i++) dst[i] = a.v[i]; }
+		inline Float4 floor(Float4 a) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = std::floor(a.v[i]); return r; }
+
+		struct Int4
+		{
+			unsigned int v[4];
+		};
+
+		inline Int4 set1(unsigned int a) { Int4 r = { { a, a, a, a } }; return r; }
+		inline Int4 add(Int4 a, Int4 b) { Int4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] + b.v[i]; return r; }
+		inline Int4 mul(Int4 a, Int4 b) { Int4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] * b.v[i]; return r; }
+		inline Int4 bitXor(Int4 a, Int4 b) { Int4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] ^ b.v[i]; return r; }
+		inline Int4 shiftRight(Int4 a, int bits) { Int4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] >> bits; return r; }
+		inline Int4 toInt(Float4 a) { Int4 r; for (int i = 0; i < 4; i++) r.v[i] = (unsigned int)(int)a.v[i]; return r; }
+		inline Float4 toFloat(Int4 a) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = (float)(int)a.v[i]; return r; }
+#endif
+
+		// 3 component vector of Float4 (structure of arrays)
+		struct Vec3x4
+		{
+			Float4 x, y, z;
+		};
+
+		inline Vec3x4 sub(const Vec3x4 & a, const Vec3x4 & b) { Vec3x4 r = { sub(a.x, b.x), sub(a.y, b.y), sub(a.z, b.z) }; return r; }
+
+		// Same operation order as glm::dot
+		inline Float4 dot(const Vec3x4 & a, const Vec3x4 & b)
+		{
+			return add(add(mul(a.x, b.x), mul(a.y, b.y)), mul(a.z, b.z));
+		}
+
+		// Same operation order as glm::cross
+		inline Vec3x4 cross(const Vec3x4 & a, const Vec3x4 & b)
+		{
+			Vec3x4 r =
+			{
+				sub(mul(a.y, b.z), mul(b.y, a.z)),
+				sub(mul(a.z, b.x), mul(b.z, a.x)),
+				sub(mul(a.x, b.y), mul(b.x, a.y))
+			};
+			return r;
+		}
+
+		// Same operation order as glm::normalize
+		inline Vec3x4 normalize(const Vec3x4 & a)
+		{
+			Float4 invLength = div(set1(1.0f), sqrt(dot(a, a)));
+			Vec3x4 r = { mul(a.x, invLength), mul(a.y, invLength), mul(a.z, invLength) };
+			return r;
+		}
+	}
+}
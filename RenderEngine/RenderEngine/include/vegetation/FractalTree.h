@@ -20,39 +20,91 @@ namespace Engine
 	class FractalTree : public ProceduralVegetation
 	{
 	private:
-		// Vertices of the final generated tree
-		std::vector<glm::vec3> vertices;
-		// Faces of the final generated tree
-		std::vector<glm::ivec3> faces;
-		// Texture coordinates of the final generated tree
-		std::vector<glm::vec2> uvs;
-		// Per vertex color of the final generated tree
-		std::vector<glm::vec3> colors;
-		// Per vertex "emission" (actually is used to carry extra info) of the final generated tree
-		std::vector<glm::vec3> emission;
+		// Output arrays of the tree, written in place. Each subtree generated in split
+		// seed mode writes through its own GeometryBuffer, starting at its own offsets
+		struct GeometryBuffer
+		{
+			// Vertices of the final generated tree
+			float * vertices;
+			// Faces of the final generated tree
+			unsigned int * faces;
+			// Texture coordinates of the final generated tree
+			float * uvs;
+			// Per vertex color of the final generated tree
+			float * colors;
+			// Per vertex "emission" (actually is used to carry extra info) of the final generated tree
+			float * emission;
+
+			// Next vertex and face to be written
+			size_t numVertices;
+			size_t numFaces;
+		};
+
+		// Amount of geometry generated by a chunk of the tree (and all its descendants)
+		struct GeometryCount
+		{
+			size_t numVertices;
+			size_t numFaces;
+		};
+
+		// Subtree whose generation has been deferred to run as an independent task
+		struct SubtreeTask
+		{
+			glm::mat4 origin;
+			glm::vec3 scale;
+			glm::vec3 translate;
+			glm::vec3 rotation;
+			size_t vOffset;
+			unsigned int depth;
+			unsigned long long key;
+			// Output start and size within the tree arrays
+			GeometryCount offset;
+			GeometryCount size;
+		};
 		
 		// Cube base shape to build the tree
 		Mesh * base;
 		Mesh * leaf;
 
-		// Random number generator
+		// Random number generator (default mode)
 		std::uniform_real_distribution<float> randGen;
 		std::default_random_engine randEngine;
 
 	public:
+		// Must be increased whenever the geometry generated from the same TreeGenerationData changes
+		// (it is part of the hash of the cached trees)
+		static const unsigned int VERSION = 1;
+
 		FractalTree(const TreeGenerationData & data);
 		Mesh * generate();
+		Mesh * generateCPU();
+		// Size of the geometry generateCPU() writes, counted without generating it
+		void countGeometry(size_t & numVertices, size_t & numFaces);
 	private:
-		// Process a chunk of the tree, adding base shape data according to the growth and stopping at the appropiate depth
-		void processChunk(glm::mat4 mat, glm::vec3 scale, glm::vec3 translate, glm::vec3 rotation, size_t vOffset, unsigned int depth);
+		// Process a chunk of the tree, adding base shape data according to the growth and stopping at the appropiate depth.
+		// key identifies the chunk in split seed mode. If subtrees is given, chunks reaching the split depth are
+		// stored there instead of being processed
+		void processChunk(GeometryBuffer & out, glm::mat4 mat, glm::vec3 scale, glm::vec3 translate, glm::vec3 rotation, size_t vOffset, unsigned int depth, unsigned long long key, std::vector<SubtreeTask> * subtrees);
+		// Draws the main trunk rotation and returns the key of the root chunk
+		unsigned long long drawRoot(glm::vec3 & rotation);
+		// Dry run of the whole tree, restoring the random engine afterwards. Returns the size of the geometry of the
+		// main task, the size of every deferred subtree is stored on subtreeSizes in split seed mode
+		GeometryCount countTree(unsigned long long rootKey, std::vector<GeometryCount> & subtreeSizes);
+		// Counts the geometry processChunk will generate, consuming the random numbers in the same order.
+		// If subtrees is given, the size of the chunks reaching the split depth is stored there instead
+		void countChunk(GeometryCount & count, unsigned int depth, unsigned long long key, std::vector<GeometryCount> * subtrees);
 		// Adds leafs to the final tree data
-		void addLeaf(glm::mat4 mat, glm::vec3 lastScaling, size_t offset, unsigned int depth);
+		void addLeaf(GeometryBuffer & out, glm::mat4 mat, glm::vec3 lastScaling, size_t offset, unsigned int depth);
 		// Utility function used to fill the class vectors
-		void appendVerticesAndFaces(Mesh * source, glm::mat4 model, glm::vec3 scale, unsigned int depth, size_t vOffset, bool keepBase, bool isLeaf = false);
+		void appendVerticesAndFaces(GeometryBuffer & out, Mesh * source, glm::mat4 model, glm::vec3 scale, unsigned int depth, size_t vOffset, bool keepBase, bool isLeaf = false);
+		// Generates the deferred subtrees concurrently, each one on its own region of the output arrays
+		void processSubtrees(GeometryBuffer & out, const std::vector<SubtreeTask> & subtrees);
 
+		// Returns the next random number in [0, 1) from the default generator or, in split seed mode, from the given stream
+		float randNext(unsigned long long & stream);
 		// Returns a random sign (either positive or negative)
-		float randSign();
+		float randSign(unsigned long long & stream);
 		// Returns a random number within the given interval
-		float randInInterval(float a, float b);
+		float randInInterval(float a, float b, unsigned long long & stream);
 	};
-}
\ No newline at end of file
+}
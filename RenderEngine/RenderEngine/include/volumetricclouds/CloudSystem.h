@@ -44,7 +44,7 @@ namespace Engine
 		public:
 			VolumetricClouds();
 			void render(Camera * cam);
-			void renderShadow(Camera * camera, const glm::mat4 & projectionMatrix);
+			void renderShadow(Camera * camera, const glm::mat4 * projectionMatrices, unsigned int regions);
 		private:
 			void createTileMesh();
 		};
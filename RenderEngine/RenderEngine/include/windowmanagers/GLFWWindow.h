@@ -12,6 +12,11 @@
 
 namespace Engine
 {
+	namespace Concurrent
+	{
+		class TaskGraph;
+	}
+
 	namespace Window
 	{
 		/**
@@ -60,6 +65,9 @@ namespace Engine
 			void setResizeCallback(glfwResizeCallback resCb);
 
 			void onMouseClick(int button, int state);
+		private:
+			// Declares the per frame stages (and their shared resources) run by mainLoop
+			void buildFrameGraph(Engine::Concurrent::TaskGraph & graph);
 		};
 	}
 }
\ No newline at end of file
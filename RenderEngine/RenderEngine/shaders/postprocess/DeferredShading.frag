@@ -6,6 +6,16 @@ layout (location=2) out vec4 outGodRaysInfo;
 
 layout (location=0) in vec2 texCoord;
 
+#ifdef COMPACT_GBUFFER
+uniform sampler2D postProcessing_0; // color
+uniform sampler2D postProcessing_1; // octahedral normal
+uniform sampler2D postProcessing_2; // emissive (specular on alpha)
+uniform sampler2D postProcessing_3; // info
+uniform sampler2D postProcessing_4; // depth
+
+// Position rebuilt from the depth
+uniform mat4 invProjMat;
+#else
 uniform sampler2D postProcessing_0; // color
 uniform sampler2D postProcessing_1; // normal
 uniform sampler2D postProcessing_2; // specular
@@ -13,6 +23,7 @@ uniform sampler2D postProcessing_3; // emissive
 uniform sampler2D postProcessing_4; // pos
 uniform sampler2D postProcessing_5; // info
 uniform sampler2D postProcessing_6; // depth
+#endif
 
 // ===============================================
 // back ground color, used for fog effect and ambient lighting
@@ -64,6 +75,28 @@ float depth;
 float alpha = 50.0;
 vec3 ambientColor;
 
+#ifdef COMPACT_GBUFFER
+// ================================================================================
+// G-BUFFER DECODING
+
+// Inverse of the octahedral normal encoding of the terrain, water and tree shaders
+vec3 decodeNormal(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0? -t : t, n.y >= 0.0? -t : t);
+	return normalize(n);
+}
+
+// View space position of the pixel from its depth
+vec3 reconstructPosition(vec2 uv, float z)
+{
+	vec4 p = invProjMat * vec4(vec3(uv, z) * 2.0 - 1.0, 1.0);
+	return p.xyz / p.w;
+}
+#endif
+
 // ================================================================================
 // SHADING FUNCTIONALITY
 vec3 diffuseOrenNayar(vec3 ld, float roughness, vec3 albedo) 
@@ -130,6 +163,20 @@ vec3 processAtmosphericFog(in vec3 shadedColor)
 
 void main()
 {
+#ifdef COMPACT_GBUFFER
+	vec4 gbuffercolor =		texture(postProcessing_0, texCoord);
+	vec2 gbuffernormal =	texture(postProcessing_1, texCoord).xy;
+	vec4 gbufferemissive =	texture(postProcessing_2, texCoord);
+	vec4 gbufferinfo =		texture(postProcessing_3, texCoord);
+	depth =					texture(postProcessing_4, texCoord).x;
+
+	N = decodeNormal(gbuffernormal);
+	pos = reconstructPosition(texCoord, depth);
+	Ka = gbuffercolor.rgb;
+	Kd = Ka;
+	Ks = vec3(gbufferemissive.a);
+	Ke = gbufferemissive.rgb;
+#else
 	vec4 gbuffercolor =		texture(postProcessing_0, texCoord);
 	vec4 gbuffernormal =	texture(postProcessing_1, texCoord);
 	vec4 gbufferspec =		texture(postProcessing_2, texCoord);
@@ -144,6 +191,7 @@ void main()
 	Kd = Ka;
 	Ks = gbufferspec.rgb;
 	Ke = gbufferemissive.rgb;
+#endif
 
 	ambientColor = mix(horizonColor, zenitColor, 0.2);
 
@@ -9,7 +9,13 @@ uniform vec2 screenSize;
 
 uniform sampler2D postProcessing_0;
 uniform sampler2D grassBuffer;
+#ifdef COMPACT_GBUFFER
+// Position rebuilt from the depth
+uniform sampler2D depthBuffer;
+uniform mat4 invProjMat;
+#else
 uniform sampler2D posBuffer;
+#endif
 
 // Same remap value function as in the volumetric clouds, returns the valor within a range of 
 // a valor which is mapped to a different range
@@ -21,6 +27,18 @@ float blend(float val , float val0 , float val1 , float res0 , float res1)
 	return res0 + (val - val0) * (res1 - res0) / (val1 - val0);
 }
 
+// View space position of the given pixel
+vec3 getPosition(vec2 uv)
+{
+#ifdef COMPACT_GBUFFER
+	// Same reconstruction as in the deferred shading
+	vec4 p = invProjMat * vec4(vec3(uv, texture(depthBuffer, uv).x) * 2.0 - 1.0, 1.0);
+	return p.xyz / p.w;
+#else
+	return texture(posBuffer, uv).xyz;
+#endif
+}
+
 void main()
 {
 	float isGrass = texture(grassBuffer, texCoord).x;
@@ -28,7 +46,7 @@ void main()
 	// Apply the effect only if we are treating a grass pixel
 	if(isGrass > 0.9)
 	{
-		vec3 pos = texture(posBuffer, texCoord).xyz;
+		vec3 pos = getPosition(texCoord);
 		float dist = length(pos);
 
 		float ar = screenSize.x / screenSize.y;
@@ -47,7 +65,7 @@ void main()
 		float yOffset = fract(y * d) / d;
 		vec2 uvOffset = texCoord - vec2(0, yOffset * 2.0 * 1.0/(dist * 0.2));
 
-		vec3 offsetPos = texture(posBuffer, uvOffset).xyz;
+		vec3 offsetPos = getPosition(uvOffset);
 		// Make sure we dont paint grass in a zone oclude by non-grass data
 		outColor = offsetPos.z < pos.z? backColor : vec4(mix(backColor.rgb, texture(postProcessing_0, uvOffset).rgb, clamp(1 - yOffset * d / 3.4, 0, 1)), 1.0);
 		//texture(postProcessing_0, uvOffset).rgb
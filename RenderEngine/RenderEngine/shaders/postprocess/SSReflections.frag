@@ -10,11 +10,34 @@ uniform vec3 lightDirection;
 
 uniform sampler2D postProcessing_0;	// color
 
+#ifdef COMPACT_GBUFFER
+// Position rebuilt from the depth, octahedral encoded normal, and specular on the emissive buffer alpha
+uniform mat4 invProjMat;
+#else
 uniform sampler2D posBuffer;
+#endif
 uniform sampler2D depthBuffer;
 uniform sampler2D normalBuffer;
 uniform sampler2D specularBuffer;
 
+#ifdef COMPACT_GBUFFER
+// Same G-buffer decoding as in the deferred shading
+vec3 decodeNormal(vec2 e)
+{
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0? -t : t, n.y >= 0.0? -t : t);
+	return normalize(n);
+}
+
+vec3 reconstructPosition(vec2 uv, float z)
+{
+	vec4 p = invProjMat * vec4(vec3(uv, z) * 2.0 - 1.0, 1.0);
+	return p.xyz / p.w;
+}
+#endif
+
 vec3 raymarch(vec3 position, vec3 direction, float step)
 {
 	vec3 prevRaySample, raySample;
@@ -77,9 +100,15 @@ vec3 computeReflectionColor(float depth, vec3 pos, vec3 N)
 
 void main()
 {
+#ifdef COMPACT_GBUFFER
+	float depth = texture(depthBuffer, texCoord).x;
+	vec3 pos = reconstructPosition(texCoord, depth);
+	vec3 N = decodeNormal(texture(normalBuffer, texCoord).xy);
+#else
 	vec3 pos = texture(posBuffer, texCoord).xyz;
 	vec3 N = texture(normalBuffer, texCoord).xyz;
 	float depth = texture(depthBuffer, texCoord).x;
+#endif
 	float reflection = texture(specularBuffer, texCoord).w;
 
 	// Compute relfection only for specular surfaces
@@ -1,18 +1,32 @@
 #version 410 core
 
 #ifndef SHADOW_MAP
+#ifdef COMPACT_GBUFFER
+// Compact G-buffer: the specular is stored on the emissive alpha, and the position is rebuilt from the depth
+layout (location=0) out vec4 outColor;
+layout (location=1) out vec4 outNormal;
+layout (location=2) out vec4 outEmissive;
+layout (location=3) out vec4 outInfo;
+#else
 layout (location=0) out vec4 outColor;
 layout (location=1) out vec4 outNormal;
 layout (location=2) out vec4 outSpecular;
 layout (location=3) out vec4 outEmissive;
 layout (location=4) out vec4 outPos;
 layout (location=5) out vec4 outInfo;
+#endif
+
+// Cascade shadow maps levels (see CascadeShadowMaps::MAX_LEVELS)
+const int MAX_CASCADES = 4;
 
 layout (location=0) in vec2 inUV;
 layout (location=1) in vec3 inPos;
 layout (location=2) in float height;
-layout (location=3) in vec4 inShadowMapPos;
-layout (location=4) in vec4 inShadowMapPos1;
+layout (location=3) in vec4 inShadowMapPos[MAX_CASCADES];
+#ifdef INSTANCED
+// Tile grid position (xy) and tile cache layer (z)
+layout (location=7) flat in vec3 inTile;
+#endif
 
 uniform mat4 normal;
 uniform mat4 modelView;
@@ -20,8 +34,9 @@ uniform mat4 modelView;
 uniform float worldScale;
 uniform float renderRadius;
 
-uniform sampler2D depthTexture;
-uniform sampler2D depthTexture1;
+// Cascade shadow maps, a layer per level
+uniform sampler2DArray depthTextures;
+uniform int cascadeLevels;
 
 uniform vec3 lightDir;
 
@@ -41,8 +56,6 @@ uniform float time;
 
 uniform float waterHeight;
 
-uniform ivec2 gridPos;
-
 uniform float grassCoverage;
 
 uniform float amplitude;
@@ -50,12 +63,35 @@ uniform float frecuency;
 uniform float scale;
 uniform int octaves;
 
+// Tile cache normal maps, and layer of this tile (-1 if it is not cached)
+uniform sampler2DArray tileNormals;
+
+#ifdef INSTANCED
+ivec2 gridPos;
+int tileLayer;
+#else
+uniform ivec2 gridPos;
+uniform int tileLayer;
+#endif
+
 // ================================================================================
 float Random2D(in vec2 st)
 {
 	return fract(sin(dot(st.xy, vec2(12.9898, 78.233))) * 43758.5453123);
 }
 
+// Integer hash of a noise lattice point into [0, 1). TerrainHeightField evaluates the same
+// noise on the CPU, so it must not use transcendental functions
+float LatticeValue(in vec2 lattice)
+{
+	uvec2 q = uvec2(ivec2(lattice));
+	uint h = (q.x * 0x8DA6B343u) ^ (q.y * 0xD8163841u);
+	h = (h ^ (h >> 16u)) * 0x7FEB352Du;
+	h = (h ^ (h >> 15u)) * 0x846CA68Bu;
+	h ^= h >> 16u;
+	return float(h >> 8u) * (1.0 / 16777216.0);
+}
+
 //uniform float cellularScale = 1500.0;
 
 float cellularNoise(vec2 uv, float cellularScale)
@@ -96,10 +132,10 @@ float NoiseInterpolation(in vec2 i_coord, in float i_size)
 	vec2 weights = fract(grid);
 
 
-	float p0 = Random2D(randomInput);
-	float p1 = Random2D(randomInput + vec2(1.0, 0.0));
-	float p2 = Random2D(randomInput + vec2(0.0, 1.0));
-	float p3 = Random2D(randomInput + vec2(1.0, 1.0));
+	float p0 = LatticeValue(randomInput);
+	float p1 = LatticeValue(randomInput + vec2(1.0, 0.0));
+	float p2 = LatticeValue(randomInput + vec2(0.0, 1.0));
+	float p3 = LatticeValue(randomInput + vec2(1.0, 1.0));
 
 	weights = smoothstep(vec2(0.0, 0.0), vec2(1.0, 1.0), weights);
 
@@ -150,9 +186,15 @@ float bumpNoiseHeight(in vec2 pos, float localScale, int octaveCount)
 
 // =====================================================================
 // Shadow map look up
-bool whithinRange(vec2 texCoord)
+bool whithinRange(vec3 shadowMapPos)
 {
-	return texCoord.x >= 0.0 && texCoord.x <= 1.0 && texCoord.y >= 0.0 && texCoord.y <= 1.0;
+	return all(greaterThanEqual(shadowMapPos, vec3(0.0))) && all(lessThanEqual(shadowMapPos, vec3(1.0)));
+}
+
+// Depth stored on a cascade level
+float shadowMapDepth(int level, vec2 texCoord)
+{
+	return texture(depthTextures, vec3(texCoord, float(level))).x;
 }
 
 // Looks up the shadow map to tell wether the fragment is in shadow
@@ -162,30 +204,21 @@ float getShadowVisibility(vec3 rawNormal)
 	float bias = clamp(0.005 * tan(acos(dot(rawNormal, lightDir))), 0.0, 0.01);
 	float visibility = 1.0;
 
-	// Check first the highest resolution (but smaller) map
-	if(whithinRange(inShadowMapPos.xy))
-	{
-		float curDepth = inShadowMapPos.z - bias;
-		//visibility = texture(depthTexture, inShadowMapPos.xy).x < curDepth? 0.0 : 1.0;
-		
-		// Apply percentage close filter to get rid of the stair effect
-		for (int i = 0; i < 4; i++)
-		{
-			visibility -= 0.25 * ( texture(depthTexture, inShadowMapPos.xy + poissonDisk[i] / 700.0).x  <  curDepth? 1.0 : 0.0 );
-		}
-		
-	}
-	// If not there, try in the lower resolution (but bigger) map
-	else if(whithinRange(inShadowMapPos1.xy))
+	// Check first the highest resolution (but smaller) map. If not there, try in the
+	// lower resolution (but bigger) ones
+	for (int level = 0; level < cascadeLevels; level++)
 	{
-		float curDepth = inShadowMapPos1.z - bias;
-		//visibility = texture( depthTexture1, inShadowMapPos1.xy).x  <  curDepth? 0.0 : 1.0;
-		
-		for (int i = 0; i < 4; i++)
+		if(whithinRange(inShadowMapPos[level].xyz))
 		{
-			visibility -= 0.25 * ( texture( depthTexture1, inShadowMapPos1.xy + poissonDisk[i] / 700.0 ).x  <  curDepth? 1.0 : 0.0 );
+			float curDepth = inShadowMapPos[level].z - bias;
+
+			// Apply percentage close filter to get rid of the stair effect
+			for (int i = 0; i < 4; i++)
+			{
+				visibility -= 0.25 * ( shadowMapDepth(level, inShadowMapPos[level].xy + poissonDisk[i] / 700.0)  <  curDepth? 1.0 : 0.0 );
+			}
+			break;
 		}
-		
 	}
 
 	return visibility;
@@ -206,6 +239,31 @@ vec3 computeNormal()
 	return normalize(vec3(lH - rH, step * step, bH - tH));
 }
 
+// Position within the current tile, undoing the absolute value of the texture coordinates
+vec2 tileLocalUV(in vec2 uv)
+{
+	return vec2(gridPos.x >= 0 ? uv.x - float(gridPos.x) : -uv.x - float(gridPos.x),
+		gridPos.y >= 0 ? uv.y - float(gridPos.y) : -uv.y - float(gridPos.y));
+}
+
+// Tile cache maps coordinates. Texels lie on the tile edges (see TerrainTileCache)
+vec3 tileCacheCoord(in vec2 local, in int resolution)
+{
+	return vec3((local * float(resolution - 1) + 0.5) / float(resolution), float(tileLayer));
+}
+
+// Vertex normal, from the tile cache if the tile is cached
+vec3 terrainNormal()
+{
+	if (tileLayer >= 0)
+	{
+		vec2 local = clamp(tileLocalUV(inUV), 0.0, 1.0);
+		return normalize(texture(tileNormals, tileCacheCoord(local, textureSize(tileNormals, 0).x)).xyz);
+	}
+
+	return computeNormal();
+}
+
 // Creates a bump map normal of the given octaves
 // E.G., we use less octaves for sand, to give it a smoother look
 vec3 computeBumpNormal(int octaveCount)
@@ -228,6 +286,17 @@ vec3 computeCaustics(vec2 uv)
 	return vec3(val * val * 2.0);
 }
 
+#ifdef COMPACT_GBUFFER
+// Octahedral normal encoding: the normal is projected on an octahedron whose lower half is folded over
+// the upper one, and mapped to [0, 1] for the unsigned normalized normal buffer
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.z >= 0.0? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0? 1.0 : -1.0, n.y >= 0.0? 1.0 : -1.0);
+	return e * 0.5 + 0.5;
+}
+#endif
+
 #else
 layout (location=0) out vec4 lightdepth;
 #endif
@@ -239,10 +308,15 @@ void main()
 #ifdef SHADOW_MAP
 	lightdepth = vec4(gl_FragCoord.z, gl_FragCoord.z, gl_FragCoord.z, 0);
 #else
+#ifdef INSTANCED
+	gridPos = ivec2(inTile.xy);
+	tileLayer = int(inTile.z);
+#endif
+
 	// COMPUTE NORMAL FROM HEIGHTMAP
 	// ------------------------------------------------------------------------------
 	// Compute vertex normal
-	vec3 rawNormal = computeNormal();
+	vec3 rawNormal = terrainNormal();
 	vec3 up = vec3(0, 1, 0);
 	float cosV = abs(dot(rawNormal, up));
 
@@ -284,10 +358,15 @@ void main()
 	// OUTPUT G BUFFERS
 	// ------------------------------------------------------------------------------
 	outColor = vec4(heightColor, 1.0);
+#ifdef COMPACT_GBUFFER
+	outNormal = vec4(encodeNormal(normalize(n)), 0.0, 1.0);
+	outEmissive = vec4(0,0,0,0);
+#else
 	outNormal = vec4(normalize(n), 1.0);
 	outPos = vec4(inPos, 1.0);
 	outSpecular = vec4(0);
 	outEmissive = vec4(0,0,0,0);
+#endif
 	outInfo = vec4(grassData, visibility, alpha, 0);
 #endif
 }
\ No newline at end of file
@@ -3,14 +3,30 @@
 // INPUT
 layout (location=0) in vec3 inPos;
 layout (location=1) in vec2 inUV;
+#ifdef INSTANCED
+// Tile grid position (xy) and tile cache layer (z)
+layout (location=2) in vec4 inInstance;
+#endif
 
 // OUTPUT
 layout (location=0) out vec2 outUV;
+#ifdef INSTANCED
+layout (location=1) out vec3 outTile;
 
+uniform float worldScale;
+#else
 uniform ivec2 gridPos;
+#endif
 
 void main()
 {
+#ifdef INSTANCED
+	// Tiles are placed in world space, as there is no model matrix per tile
+	ivec2 gridPos = ivec2(inInstance.xy);
+	outTile = inInstance.xyz;
+	gl_Position = vec4((inPos + vec3(inInstance.x, 0.0, inInstance.y)) * worldScale, 1.0);
+#else
 	gl_Position = vec4(inPos, 1.0);
+#endif
 	outUV = abs(inUV + vec2(float(gridPos.x), float(gridPos.y)));
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+#version 410 core
+
+// Quadtree (CDLOD) terrain path. Replaces the tessellation stages: each node is a regular
+// grid, displaced here, whose vertices morph into the grid of the next level close to the
+// end of the node range (see TerrainQuadTree)
+
+// INPUT
+layout (location=0) in vec3 inPos;
+layout (location=1) in vec2 inUV;
+
+// OUTPUT
+layout (location=0) out vec2 outUV;
+layout (location=1) out float height;
+
+// Node area and morph distances, in terrain tiles
+uniform vec2 nodeOffset;
+uniform float nodeSize;
+uniform float gridResolution;
+uniform vec2 morphRange;
+uniform vec3 cameraPosition;
+
+uniform float amplitude;
+uniform float frecuency;
+uniform float scale;
+uniform int octaves;
+
+// ============================================================================
+// Integer hash of a noise lattice point into [0, 1). TerrainHeightField evaluates the same
+// noise on the CPU, so it must not use transcendental functions
+float LatticeValue(in vec2 lattice)
+{
+	uvec2 q = uvec2(ivec2(lattice));
+	uint h = (q.x * 0x8DA6B343u) ^ (q.y * 0xD8163841u);
+	h = (h ^ (h >> 16u)) * 0x7FEB352Du;
+	h = (h ^ (h >> 15u)) * 0x846CA68Bu;
+	h ^= h >> 16u;
+	return float(h >> 8u) * (1.0 / 16777216.0);
+}
+
+float NoiseInterpolation(in vec2 i_coord, in float i_size)
+{
+	vec2 grid = i_coord * i_size;
+
+	vec2 randomInput = floor(grid);
+	vec2 weights = fract(grid);
+
+
+	float p0 = LatticeValue(randomInput);
+	float p1 = LatticeValue(randomInput + vec2(1.0, 0.0));
+	float p2 = LatticeValue(randomInput + vec2(0.0, 1.0));
+	float p3 = LatticeValue(randomInput + vec2(1.0, 1.0));
+
+	weights = smoothstep(vec2(0.0, 0.0), vec2(1.0, 1.0), weights);
+
+	return p0 +
+		(p1 - p0) * (weights.x) +
+		(p2 - p0) * (weights.y) * (1.0 - weights.x) +
+		(p3 - p1) * (weights.y * weights.x);
+}
+
+float noiseHeight(in vec2 pos)
+{
+
+	float noiseValue = 0.0;
+
+	float localAplitude = amplitude;
+	float localFrecuency = frecuency;
+
+	for (int index = 0; index < octaves; index++)
+	{
+
+		noiseValue += NoiseInterpolation(pos, scale * localFrecuency) * localAplitude;
+
+		localAplitude /= 2.0;
+		localFrecuency *= 2.0;
+	}
+
+	return noiseValue * noiseValue * noiseValue;
+}
+
+//=======================================================================
+
+void main()
+{
+	// Unmorphed position, to know how far it is from the camera
+	vec2 gridPos = inPos.xz;
+	vec2 tilePos = nodeOffset + gridPos * nodeSize;
+	float unmorphedHeight = noiseHeight(abs(tilePos)) * 1.5;
+	float distance = length(vec3(tilePos.x, unmorphedHeight, tilePos.y) - cameraPosition);
+
+	// Odd vertices slide onto the edge between their even neighbours, which is the grid of the next level
+	float morph = clamp((distance - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+	vec2 oddOffset = fract(gridPos * gridResolution * 0.5) * 2.0 / gridResolution;
+	gridPos -= oddOffset * morph;
+	tilePos = nodeOffset + gridPos * nodeSize;
+
+	// Same coordinates as the tiles (see terrain.vert)
+	outUV = abs(tilePos);
+	height = noiseHeight(outUV);
+
+	vec3 final = vec3(tilePos.x, height * 1.5, tilePos.y);
+
+	// Projected by the geometry shader, on the camera or on the shadow map regions
+	gl_Position = vec4(final, 1);
+}
@@ -1,23 +1,34 @@
 #version 430 core
 
 #ifndef SHADOW_MAP
+#ifdef COMPACT_GBUFFER
+// Compact G-buffer: the specular is stored on the emissive alpha, and the position is rebuilt from the depth
+layout (location=0) out vec4 outColor;
+layout (location=1) out vec4 outNormal;
+layout (location=2) out vec4 outEmissive;
+layout (location=3) out vec4 outInfo;
+#else
 layout (location=0) out vec4 outColor;
 layout (location=1) out vec4 outNormal;
 layout (location=2) out vec4 outSpecular;
 layout (location=3) out vec4 outEmissive;
 layout (location=4) out vec4 outPos;
 layout (location=5) out vec4 outInfo;
+#endif
+
+// Cascade shadow maps levels (see CascadeShadowMaps::MAX_LEVELS)
+const int MAX_CASCADES = 4;
 
 layout (location=0) in vec3 inPos;
 layout (location=1) in vec3 inColor;
 layout (location=2) in vec3 inNormal;
 layout (location=3) in vec3 inEmission;
-layout (location=4) in vec3 inShadowMapPos;
-layout (location=5) in vec3 inShadowMapPos1;
-layout (location=6) in vec2 inTexCoord;
+layout (location=4) in vec3 inShadowMapPos[MAX_CASCADES];
+layout (location=8) in vec2 inTexCoord;
 
-uniform sampler2D depthTexture;
-uniform sampler2D depthTexture1;
+// Cascade shadow maps, a layer per level
+uniform sampler2DArray depthTextures;
+uniform int cascadeLevels;
 
 uniform mat4 normal;
 
@@ -30,9 +41,15 @@ uniform vec2 poissonDisk[4] = vec2[](
   vec2( 0.34495938, 0.29387760 )
 );
 
-bool whithinRange(vec2 texCoord)
+bool whithinRange(vec3 shadowMapPos)
 {
-	return texCoord.x >= 0.0 && texCoord.x <= 1.0 && texCoord.y >= 0.0 && texCoord.y <= 1.0;
+	return all(greaterThanEqual(shadowMapPos, vec3(0.0))) && all(lessThanEqual(shadowMapPos, vec3(1.0)));
+}
+
+// Depth stored on a cascade level
+float shadowMapDepth(int level, vec2 texCoord)
+{
+	return texture(depthTextures, vec3(texCoord, float(level))).x;
 }
 
 // Looks up the shadow maps, checking if the point is inside of any of the light
@@ -43,22 +60,27 @@ float getShadowVisibility(vec3 rawNormal)
 	float bias = clamp(0.005 * tan(acos(dot(rawNormal, lightDir))), 0.0, 0.01);
 	// Point is visible by default
 	float visibility = 1.0;
-	if(whithinRange(inShadowMapPos.xy))
+	if(whithinRange(inShadowMapPos[0]))
 	{
-		float curDepth = inShadowMapPos.z - bias;
+		float curDepth = inShadowMapPos[0].z - bias;
 		// Percentage close filter
 		for (int i = 0; i < 4; i++)
 		{
-			visibility -= 0.25 * ( texture(depthTexture, inShadowMapPos.xy + poissonDisk[i] / 700.0).x  <  curDepth? 1.0 : 0.0 );
+			visibility -= 0.25 * ( shadowMapDepth(0, inShadowMapPos[0].xy + poissonDisk[i] / 700.0)  <  curDepth? 1.0 : 0.0 );
 		}
+		return visibility;
 	}
-	// Level 2 cascade shadow map is too low res for the high frequency details of the trees
-	else if(whithinRange(inShadowMapPos1.xy))
+
+	// Further cascade shadow map levels are too low res for the high frequency details of the trees
+	for (int level = 1; level < cascadeLevels; level++)
 	{
-		// Do not apply PCF on level 2 shadow maps for trees, as it produces weird effects given the size
-		// of the trees vs the size of the shadow map texels
-		float curDepth = inShadowMapPos1.z - bias;
-		visibility = texture(depthTexture1, inShadowMapPos1.xy).x < curDepth? 0.0 : 1.0;
+		if(whithinRange(inShadowMapPos[level]))
+		{
+			// Do not apply PCF on further levels for trees, as it produces weird effects given the size
+			// of the trees vs the size of the shadow map texels
+			float curDepth = inShadowMapPos[level].z - bias;
+			return shadowMapDepth(level, inShadowMapPos[level].xy) < curDepth? 0.0 : 1.0;
+		}
 	}
 
 	return visibility;
@@ -115,6 +137,16 @@ float noise(in vec2 pos, float f, float a, float s)
 	return noiseValue;// * noiseValue * noiseValue * 0.01;
 }
 
+#ifdef COMPACT_GBUFFER
+// Same octahedral normal encoding as in the terrain shader
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.z >= 0.0? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0? 1.0 : -1.0, n.y >= 0.0? 1.0 : -1.0);
+	return e * 0.5 + 0.5;
+}
+#endif
+
 #else
 layout (location=0) out vec4 lightdepth;
 #endif
@@ -125,10 +157,15 @@ void main()
 	vec3 rawNormal = normalize(inNormal);
 #if defined WIRE_MODE || defined POINT_MODE
 	outColor = vec4(0,0,0,1);
+#ifdef COMPACT_GBUFFER
+	outNormal = vec4(encodeNormal(rawNormal), 0.0, 1.0);
+	outEmissive = vec4(0,0,0,0);
+#else
 	outNormal = vec4(rawNormal, 0);
 	outSpecular = vec4(0,0,0,0);
 	outEmissive = vec4(0,0,0,0);
 	outPos = vec4(inPos, 1);
+#endif
 	outInfo = vec4(0);
 #else
 	// Apply leaf effect. If we are treating a leaf (info is crompressed into emission vertex info), compute perlin
@@ -141,10 +178,15 @@ void main()
 	float visibility = getShadowVisibility(rawNormal);
 
 	outColor = vec4(inColor, 1.0);
+#ifdef COMPACT_GBUFFER
+	outNormal = vec4(encodeNormal(rawNormal), 0.0, 1.0);
+	outEmissive = vec4(inEmission.y > 0.0? inColor * 0.5 : vec3(0),0);
+#else
 	outNormal = vec4(rawNormal, 1);
 	outSpecular = vec4(0,0,0,0);
 	outEmissive = vec4(inEmission.y > 0.0? inColor * 0.5 : vec3(0),1);
 	outPos = vec4(inPos, 1);
+#endif
 	outInfo = vec4(0.0, visibility,0,1);
 #endif
 #else
@@ -2,9 +2,14 @@
 
 layout (location=0) in vec3 inPos;	
 layout (location=1) in vec3 inColor;
-layout (location=2) in vec3 inNormal;
+// Octahedral encoded normal (see VertexFormat::quantized)
+layout (location=2) in vec2 inNormal;
 layout (location=3) in vec3 inEmission;
 layout (location=4) in vec2 inTexCoord;
+#ifdef INSTANCED
+// World position on the terrain surface (xyz) and wind bending direction (w) of the tree
+layout (location=5) in vec4 inInstance;
+#endif
 
 layout(location = 0) out vec3 outColor;
 layout(location = 1) out vec3 outNormal;
@@ -15,26 +20,41 @@ layout(location = 3) out vec2 outTexCoord;
 uniform float sinTime;
 uniform vec3 windDirection;
 uniform float windStrength;
-uniform vec2 tileUV;
+#ifndef INSTANCED
+// Wind bending direction of the tree (1 or -1)
+uniform float windSign;
+#endif
 
-float Random2D(in vec2 st)
+vec3 DecodeOctahedral(in vec2 e)
 {
-	float val = (sin(dot(st.xy, vec2(12.9898, 78.233))) * 43758.5453123);
-	return val < 0.0? -1.0 : 1.0;
+	vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
 }
 
 void main()
 {
+#ifdef INSTANCED
+	float windSign = inInstance.w;
+#endif
+
 	// Make wind direction y 0 to avoid stretching and squashing on the trees
 	vec3 wd = vec3(windDirection.x, 0, windDirection.z);
 
 	// Modify base pos by the wind dir/strength, vertex height and some randomness
-	vec3 pos = inPos + sinTime * 0.01 * wd * windStrength * inPos.y * Random2D(tileUV);
+	vec3 pos = inPos + sinTime * 0.01 * wd * windStrength * inPos.y * windSign;
 
 	outColor = inColor;
 	outEmission = inEmission;
-	outNormal = inNormal;
+	outNormal = DecodeOctahedral(inNormal);
 	outTexCoord = inTexCoord;
 
+#ifdef INSTANCED
+	// Trees are placed in world space, as there is no model matrix per tree
+	pos += inInstance.xyz;
+#endif
+
 	gl_Position = vec4(pos, 1);
 }
@@ -1,22 +1,37 @@
 #version 410 core
 
 #ifndef SHADOW_MAP
+#ifdef COMPACT_GBUFFER
+// Compact G-buffer: the specular is stored on the emissive alpha, and the position is rebuilt from the depth
+layout (location=0) out vec4 outColor;
+layout (location=1) out vec4 outNormal;
+layout (location=2) out vec4 outEmissive;
+layout (location=3) out vec4 outInfo;
+#else
 layout (location=0) out vec4 outColor;
 layout (location=1) out vec4 outNormal;
 layout (location=2) out vec4 outSpecular;
 layout (location=3) out vec4 outEmissive;
 layout (location=4) out vec4 outPos;
 layout (location=5) out vec4 outInfo;
+#endif
+
+// Cascade shadow maps levels (see CascadeShadowMaps::MAX_LEVELS)
+const int MAX_CASCADES = 4;
 
 layout (location=0) in vec2 inUV;
 layout (location=1) in vec3 inPos;
-layout (location=2) in vec4 inShadowMapPos;
-layout (location=3) in vec4 inShadowMapPos1;
+layout (location=2) in vec4 inShadowMapPos[MAX_CASCADES];
+#ifdef INSTANCED
+// Tile grid position (see water.vert)
+layout (location=6) flat in vec2 inGridPos;
+#endif
 
 uniform mat4 normal;
 
-uniform sampler2D depthTexture;
-uniform sampler2D depthTexture1;
+// Cascade shadow maps, a layer per level
+uniform sampler2DArray depthTextures;
+uniform int cascadeLevels;
 
 uniform sampler2D inInfo;
 uniform vec2 screenSize;
@@ -29,7 +44,9 @@ vec2 poissonDisk[4] = vec2[](
   vec2( 0.34495938, 0.29387760 )
 );
 
+#ifndef INSTANCED
 uniform ivec2 gridPos;
+#endif
 
 uniform float time;
 uniform vec3 watercolor;
@@ -93,9 +110,15 @@ float noiseHeight(in vec2 pos)
 
 // =====================================================================
 // Shadow map look up
-bool whithinRange(vec2 texCoord)
+bool whithinRange(vec3 shadowMapPos)
 {
-	return texCoord.x >= 0.0 && texCoord.x <= 1.0 && texCoord.y >= 0.0 && texCoord.y <= 1.0;
+	return all(greaterThanEqual(shadowMapPos, vec3(0.0))) && all(lessThanEqual(shadowMapPos, vec3(1.0)));
+}
+
+// Depth stored on a cascade level
+float shadowMapDepth(int level, vec2 texCoord)
+{
+	return texture(depthTextures, vec3(texCoord, float(level))).x;
 }
 
 float getShadowVisibility(vec3 rawNormal)
@@ -103,32 +126,33 @@ float getShadowVisibility(vec3 rawNormal)
 	float bias = clamp(0.005 * tan(acos(dot(rawNormal, lightDir))), 0.0, 0.01);
 	float visibility = 1.0;
 
-	if(whithinRange(inShadowMapPos.xy))
-	{
-		float curDepth = inShadowMapPos.z - bias;
-		//visibility = texture(depthTexture, inShadowMapPos.xy).x  <  curDepth? 0.0 : 1.0;
-		
-		for (int i = 0; i < 4; i++)
-		{
-			visibility -= 0.25 * ( texture(depthTexture, inShadowMapPos.xy + poissonDisk[i] / 700.0).x  <  curDepth? 1.0 : 0.0 );
-		}
-		
-	}
-	else if(whithinRange(inShadowMapPos1.xy))
+	for (int level = 0; level < cascadeLevels; level++)
 	{
-		float curDepth = inShadowMapPos1.z - bias;
-		//visibility = texture(depthTexture1, inShadowMapPos1.xy).x  <  curDepth? 0.0 : 1.0;
-	
-		for (int i = 0; i < 4; i++)
+		if(whithinRange(inShadowMapPos[level].xyz))
 		{
-			visibility -= 0.25 * ( texture( depthTexture1, inShadowMapPos1.xy + poissonDisk[i] / 700.0 ).x  <  curDepth? 1.0 : 0.0 );
+			float curDepth = inShadowMapPos[level].z - bias;
+
+			for (int i = 0; i < 4; i++)
+			{
+				visibility -= 0.25 * ( shadowMapDepth(level, inShadowMapPos[level].xy + poissonDisk[i] / 700.0)  <  curDepth? 1.0 : 0.0 );
+			}
+			break;
 		}
-		
 	}
 
 	return visibility;
 }
 
+#ifdef COMPACT_GBUFFER
+// Same octahedral normal encoding as in the terrain shader
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.z >= 0.0? n.xy : (1.0 - abs(n.yx)) * vec2(n.x >= 0.0? 1.0 : -1.0, n.y >= 0.0? 1.0 : -1.0);
+	return e * 0.5 + 0.5;
+}
+#endif
+
 #else
 layout (location=0) out vec4 lightdepth;
 #endif
@@ -158,6 +182,9 @@ void main()
 	vec3 rawNormal = normalize(vec3(lH - rH, step * step, bH - tH));
 
 	// Correct normal if we have pass from +X to -X, from +Z to -Z, viceversa, or both
+#ifdef INSTANCED
+	ivec2 gridPos = ivec2(inGridPos);
+#endif
 	int xSign = sign(gridPos.x);
 	int ySign = sign(gridPos.y);
 	rawNormal.x = xSign != 0 ? rawNormal.x * xSign : rawNormal.x;
@@ -182,9 +209,19 @@ void main()
 	// OUTPUT TO G-BUFFERS
 	// ------------------------------------------------------------------------------
 	outColor = vec4(color, alpha);
+	outInfo = vec4(0, visibility, 0, alpha);
+#ifdef COMPACT_GBUFFER
+	// The emissive color below the water is kept while its alpha, the specular, is replaced
+	// (see WaterComponent::preRenderComponent)
+	outNormal = vec4(encodeNormal(n), 0.0, 1.0);
+#if defined WIRE_MODE || defined POINT_MODE
+	outEmissive = vec4(0);
+#else
+	outEmissive = vec4(0,0,0,0.5);
+#endif
+#else
 	outNormal = vec4(n, 1.0);
 	outPos = vec4(inPos, 1.0);
-	outInfo = vec4(0, visibility, 0, alpha);
 #if defined WIRE_MODE || defined POINT_MODE
 	outSpecular = vec4(0);
 	outEmissive = vec4(0);
@@ -193,4 +230,5 @@ void main()
 	outEmissive = vec4(0);
 #endif
 #endif
+#endif
 }
\ No newline at end of file
@@ -3,29 +3,51 @@
 // INPUT
 layout (location=0) in vec3 inPos;
 layout (location=1) in vec2 inUV;
+#ifdef INSTANCED
+// Tile grid position (xy), water height (z) and tile width (w)
+layout (location=2) in vec4 inInstance;
+#endif
+
+// Cascade shadow maps levels (see CascadeShadowMaps::MAX_LEVELS)
+const int MAX_CASCADES = 4;
 
 // OUTPUT
 layout (location=0) out vec2 outUV;
 layout (location=1) out vec3 outPos;
-layout (location=2) out vec4 outShadowMapPos;
-layout (location=3) out vec4 outShadowMapPos1;
-
+layout (location=2) out vec4 outShadowMapPos[MAX_CASCADES];
+#ifdef INSTANCED
+layout (location=6) flat out vec2 outGridPos;
+#else
 uniform ivec2 gridPos;
+#endif
 
 uniform mat4 modelView;
 uniform mat4 modelViewProj;
+// Shadow map being rendered (shadow map pass) and cascade shadow maps levels
 uniform mat4 lightDepthMat;
-uniform mat4 lightDepthMat1;
+uniform mat4 lightDepthMats[MAX_CASCADES];
+uniform int cascadeLevels;
 
 void main()
 {
+#ifdef INSTANCED
+	// Tiles are placed in world space, as there is no model matrix per tile
+	ivec2 gridPos = ivec2(inInstance.xy);
+	outGridPos = inInstance.xy;
+	vec4 pos = vec4((inPos + vec3(inInstance.x, 0.0, inInstance.y)) * inInstance.w + vec3(0.0, inInstance.z, 0.0), 1.0);
+#else
+	vec4 pos = vec4(inPos, 1.0);
+#endif
+
 #ifndef SHADOW_MAP
-	gl_Position = modelViewProj * vec4(inPos, 1.0);
-	outPos = (modelView * vec4(inPos, 1.0)).xyz;
+	gl_Position = modelViewProj * pos;
+	outPos = (modelView * pos).xyz;
 	outUV = abs(inUV + vec2(float(gridPos.x), float(gridPos.y)));
-	outShadowMapPos = lightDepthMat * vec4(inPos, 1.0);
-	outShadowMapPos1 = lightDepthMat1 * vec4(inPos, 1.0);
+	for (int i = 0; i < cascadeLevels; i++)
+	{
+		outShadowMapPos[i] = lightDepthMats[i] * pos;
+	}
 #else
-	gl_Position = lightDepthMat * vec4(inPos, 1);
+	gl_Position = lightDepthMat * pos;
 #endif
 }
\ No newline at end of file
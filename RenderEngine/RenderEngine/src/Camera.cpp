@@ -13,7 +13,7 @@
 #include <math.h>
 #include <iostream>
 
-Engine::Camera::Camera(float n, float f, float fov) :nearPlane(n), farPlane(f), fovy(fov)
+Engine::Camera::Camera(float n, float f, float fov) :nearPlane(n), farPlane(f), fovy(fov), viewportHeight(1.0f)
 {
 	// Initialize projection matrix
 	initProjectionMatrix();
@@ -26,6 +26,7 @@ Engine::Camera::Camera(const Engine::Camera & other)
 	nearPlane = other.nearPlane;
 	fovy = other.fovy;
 	projMatrix = other.projMatrix;
+	viewportHeight = other.viewportHeight;
 	translation = other.translation;
 	rotation = other.rotation;
 	viewMatrix = other.viewMatrix;
@@ -113,6 +114,7 @@ void Engine::Camera::onWindowResize(int width, int height)
 {
 	float fWidth = (float)width;
 	float fHeight = (float)height;
+	viewportHeight = fHeight;
 
 	float hAngle = fovy;
 	float vAngle = fovy;
@@ -162,4 +164,19 @@ glm::mat4 & Engine::Camera::getOldViewMatrix()
 float Engine::Camera::getFOV()
 {
 	return fovy;
+}
+
+float Engine::Camera::getViewportHeight() const
+{
+	return viewportHeight;
+}
+
+float Engine::Camera::getNearPlane() const
+{
+	return nearPlane;
+}
+
+float Engine::Camera::getFarPlane() const
+{
+	return farPlane;
 }
\ No newline at end of file
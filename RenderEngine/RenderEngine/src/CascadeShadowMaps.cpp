@@ -1,8 +1,20 @@
 #include "CascadeShadowMaps.h"
 
+#include <GL/glew.h>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "FrameStatistics.h"
 #include "Scene.h"
+#include "WorldConfig.h"
+
+namespace
+{
+	// Casters this far towards the light from the slice of a level are rendered on it
+	const float CASTER_DISTANCE = 50.0f;
+	// Depth covered beyond the needed range by the cached levels, times the slice sphere radius. Lets the
+	// levels scroll while the camera moves along the light direction, at the cost of a coarser depth
+	const float CACHE_DEPTH_SLACK = 0.25f;
+}
 
 Engine::CascadeShadowMaps * Engine::CascadeShadowMaps::INSTANCE = new Engine::CascadeShadowMaps();
 
@@ -12,7 +24,12 @@ Engine::CascadeShadowMaps & Engine::CascadeShadowMaps::getInstance()
 }
 
 Engine::CascadeShadowMaps::CascadeShadowMaps()
+	:numLevels(0), resolution(0), depthTexture(0), depthLayers(0), layeredFbo(0), spareTexture(0), spareFbo(0), numRegions(0), shadowDrawCalls(0)
 {
+	for (unsigned int i = 0; i < MAX_LEVELS; i++)
+	{
+		layerFbos[i] = 0;
+	}
 }
 
 void Engine::CascadeShadowMaps::init()
@@ -25,44 +42,142 @@ void Engine::CascadeShadowMaps::init()
 		0.5, 0.5, 0.5, 1.0
 	);
 
-	// Initialize shadow maps
-	initializeShadowMap(0, -5.0f, 5.0f, -5.0f, 5.0f, 0.1f, 70.0f);
-	initializeShadowMap(1, -40.0f, 40.0f, -40.0f, 40.0f, 0.1f, 120.0f);
+	// Shadow maps are created on the first frame, they are fitted to the camera
+
+	Engine::RenderableNotifier::getInstance().registerRenderable(this);
 }
 
-void Engine::CascadeShadowMaps::initializeShadowMap(int level, float minX, float maxX, float minY, float maxY, float minZ, float maxZ)
+void Engine::CascadeShadowMaps::allocateShadowMaps()
 {
-	shadowMaps[level].proj = glm::ortho<float>(minX, maxX, minY, maxY, minZ, maxZ);
-	shadowMaps[level].rtt = new Engine::DeferredRenderObject(0, true);
-	shadowMaps[level].shadowMap = shadowMaps[level].rtt->addDepthBuffer24(1024, 1024);
-	shadowMaps[level].rtt->initialize();
+	if (depthTexture == 0)
+	{
+		glGenTextures(1, &depthTexture);
+		glGenTextures(1, &spareTexture);
+		glGenFramebuffers(1, &layeredFbo);
+		glGenFramebuffers(MAX_LEVELS, layerFbos);
+		glGenFramebuffers(1, &spareFbo);
+	}
+
+	// Same format and sampling as the depth buffers of DeferredRenderObject
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, numLevels, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glBindTexture(GL_TEXTURE_2D, spareTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, resolution, resolution, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Depth only framebuffers
+	glBindFramebuffer(GL_FRAMEBUFFER, layeredFbo);
+	glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_FRAMEBUFFER))
+	{
+		exit(-1);
+	}
+
+	for (unsigned int i = 0; i < numLevels; i++)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, layerFbos[i]);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, i);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		if (GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_FRAMEBUFFER))
+		{
+			exit(-1);
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, spareFbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, spareTexture, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus(GL_FRAMEBUFFER))
+	{
+		exit(-1);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	depthLayers = numLevels;
+}
+
+void Engine::CascadeShadowMaps::configure(Engine::Camera * eye)
+{
+	Engine::ShadowCascadeFit::Parameters params;
+	params.levels = Engine::Settings::shadowCascades;
+	params.scheme = Engine::ShadowCascadeFit::SplitScheme(Engine::Settings::shadowSplitScheme);
+	params.lambda = Engine::Settings::shadowSplitLambda;
+	params.nearDistance = eye->getNearPlane();
+	params.shadowDistance = glm::min(Engine::Settings::shadowDistance, eye->getFarPlane());
+	params.resolution = Engine::Settings::shadowMapResolution;
+	params.casterDistance = CASTER_DISTANCE;
+	// The cached levels cover the threshold texels more, as they are reused while the slice moves that much.
+	// Enabling or disabling the cache changes the texel size, so every level is rendered again
+	params.marginTexels = Engine::Settings::shadowCache ? Engine::Settings::shadowCacheThreshold + 1 : 1;
+	params.depthSlack = Engine::Settings::shadowCache ? CACHE_DEPTH_SLACK : 0.0f;
+	cascadeFit.configure(params);
+
+	Engine::ShadowCascadeCache::Parameters cacheParams;
+	cacheParams.firstLevel = Engine::Settings::shadowCache ? Engine::Settings::shadowCacheFirstLevel : MAX_LEVELS;
+	cacheParams.interval = Engine::Settings::shadowCacheInterval;
+	shadowCache.configure(cacheParams);
+
+	// The fit clamps the settings to the supported ranges
+	numLevels = cascadeFit.getParameters().levels;
+	const unsigned int newResolution = cascadeFit.getParameters().resolution;
+
+	// The texture array holds the levels in use only, so it is created again (empty) when they change
+	if (newResolution != resolution || numLevels != depthLayers)
+	{
+		resolution = newResolution;
+		allocateShadowMaps();
+		shadowCache.invalidate();
+	}
 }
 
 void Engine::CascadeShadowMaps::initializeFrame(Engine::Camera * eye)
 {
+	configure(eye);
+
 	Engine::DirectionalLight * dl = Engine::SceneManager::getInstance().getActiveScene()->getDirectionalLight();
-	const glm::vec3 & cameraPosition = eye->getPosition();
-	glm::vec3 target = glm::vec3(-cameraPosition.x, 0, -cameraPosition.z);
-	glm::mat4 depthViewMatrix = glm::lookAt(target + (dl->getDirection() * 50.0f), target, glm::vec3(0, 1, 0));
+	cascadeFit.fit(glm::inverse(eye->getViewMatrix()), eye->getProjectionMatrix(), dl->getDirection());
+	shadowCache.update(cascadeFit);
 
-	for (unsigned int i = 0; i < getCascadeLevels(); i++)
+	// The levels reused keep the fit they were rendered with
+	for (unsigned int i = 0; i < numLevels; i++)
 	{
-		shadowMaps[i].depth = shadowMaps[i].proj * depthViewMatrix;
+		const Engine::ShadowCascadeFit::Cascade & cascade = shadowCache.getLevels()[i].cascade;
+		levelProjections[i] = cascade.projection * cascade.view;
+		depthMatrices[i] = biasMatrix * levelProjections[i];
 	}
 
 	renderShadows(eye);
 }
 
-void Engine::CascadeShadowMaps::beginShadowRender(int level)
+void Engine::CascadeShadowMaps::beginShadowRender()
 {
-	currentLevel = level;
-	glBindFramebuffer(GL_FRAMEBUFFER, shadowMaps[currentLevel].rtt->getFrameBufferId());
-	glClear(GL_DEPTH_BUFFER_BIT);
+	glBindFramebuffer(GL_FRAMEBUFFER, layeredFbo);
+	for (unsigned int i = 0; i < numRegions; i++)
+	{
+		const Engine::ShadowCascadeCache::Region & area = regionAreas[i];
+		glViewportIndexedf(i, float(area.x), float(area.y), float(area.width), float(area.height));
+		glScissorIndexed(i, area.x, area.y, area.width, area.height);
+	}
+	// Only the areas given by the cache are rendered, each on its own viewport
+	glEnable(GL_SCISSOR_TEST);
 }
 
 void Engine::CascadeShadowMaps::endShadowRender()
 {
-	shadowMaps[currentLevel].depth = biasMatrix * shadowMaps[currentLevel].depth;
+	glDisable(GL_SCISSOR_TEST);
 }
 
 const glm::mat4 & Engine::CascadeShadowMaps::getBiasMat()
@@ -70,34 +185,93 @@ const glm::mat4 & Engine::CascadeShadowMaps::getBiasMat()
 	return biasMatrix;
 }
 
-const glm::mat4 & Engine::CascadeShadowMaps::getShadowProjectionMat()
+const glm::mat4 & Engine::CascadeShadowMaps::getShadowProjectionMat(unsigned int level)
 {
-	return shadowMaps[currentLevel].depth;
+	return levelProjections[level];
 }
 
 unsigned int Engine::CascadeShadowMaps::getCascadeLevels()
 {
-	return 2;
+	return numLevels;
+}
+
+unsigned int Engine::CascadeShadowMaps::getShadowRegions()
+{
+	return numRegions;
+}
+
+unsigned int Engine::CascadeShadowMaps::getRegionLevel(unsigned int region)
+{
+	return (unsigned int)regionLayers[region];
+}
+
+void Engine::CascadeShadowMaps::setRegionUniforms(unsigned int layersUniform, unsigned int regionsUniform)
+{
+	glUniform1iv(layersUniform, numRegions, regionLayers);
+	glUniform1i(regionsUniform, numRegions);
+}
+
+const glm::mat4 & Engine::CascadeShadowMaps::getDepthMatrix(unsigned int level)
+{
+	return depthMatrices[level];
+}
+
+const glm::mat4 * Engine::CascadeShadowMaps::getDepthMatrices()
+{
+	return depthMatrices;
+}
+
+unsigned int Engine::CascadeShadowMaps::getDepthMatrices(const glm::mat4 & model, glm::mat4 * result)
+{
+	for (unsigned int i = 0; i < numLevels; i++)
+	{
+		result[i] = depthMatrices[i] * model;
+	}
+
+	return numLevels;
+}
+
+void Engine::CascadeShadowMaps::bindDepthTextures(unsigned int samplerUniform)
+{
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthTexture);
+	glUniform1i(samplerUniform, 0);
+}
+
+const Engine::ShadowCascadeFit & Engine::CascadeShadowMaps::getCascadeFit() const
+{
+	return cascadeFit;
+}
+
+const Engine::ShadowCascadeCache & Engine::CascadeShadowMaps::getCascadeCache() const
+{
+	return shadowCache;
+}
+
+unsigned int Engine::CascadeShadowMaps::getShadowDrawCalls() const
+{
+	return shadowDrawCalls;
 }
 
-const glm::mat4 & Engine::CascadeShadowMaps::getDepthMatrix0()
+size_t Engine::CascadeShadowMaps::getMemoryUsage() const
 {
-	return shadowMaps[0].depth;
+	// 24 bit depth textures take 4 bytes per texel
+	const size_t maps = size_t(depthLayers) + (spareTexture != 0 ? 1 : 0);
+	return maps * resolution * resolution * 4;
 }
 
-const glm::mat4 & Engine::CascadeShadowMaps::getDepthMatrix1()
+void Engine::CascadeShadowMaps::notifyRenderModeUpdate(Engine::RenderMode mode)
 {
-	return shadowMaps[1].depth;
 }
 
-const Engine::TextureInstance * Engine::CascadeShadowMaps::getDepthTexture0()
+void Engine::CascadeShadowMaps::notifyLightUpdate()
 {
-	return shadowMaps[0].shadowMap;
+	shadowCache.invalidate();
 }
 
-const Engine::TextureInstance * Engine::CascadeShadowMaps::getDepthTexture1()
+void Engine::CascadeShadowMaps::notifyCasterUpdate(const glm::vec3 & boundsMin, const glm::vec3 & boundsMax)
 {
-	return shadowMaps[1].shadowMap;
+	shadowCache.invalidateBounds(boundsMin, boundsMax);
 }
 
 void Engine::CascadeShadowMaps::registerShadowCaster(Engine::ShadowCaster * caster)
@@ -105,21 +279,91 @@ void Engine::CascadeShadowMaps::registerShadowCaster(Engine::ShadowCaster * cast
 	shadowCasters.push_back(caster);
 }
 
+void Engine::CascadeShadowMaps::scrollShadowMap(unsigned int level, int shiftX, int shiftY)
+{
+	// Texels kept are copied to the spare map, and then back to the level layer, already moved
+	const int size = int(resolution);
+	const int width = size - abs(shiftX);
+	const int height = size - abs(shiftY);
+	const int srcX = shiftX > 0 ? shiftX : 0;
+	const int srcY = shiftY > 0 ? shiftY : 0;
+	const int dstX = shiftX > 0 ? 0 : -shiftX;
+	const int dstY = shiftY > 0 ? 0 : -shiftY;
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, layerFbos[level]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, spareFbo);
+	glBlitFramebuffer(srcX, srcY, srcX + width, srcY + height, dstX, dstY, dstX + width, dstY + height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, spareFbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, layerFbos[level]);
+	glBlitFramebuffer(dstX, dstY, dstX + width, dstY + height, dstX, dstY, dstX + width, dstY + height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+}
+
+void Engine::CascadeShadowMaps::addRegion(unsigned int level, const Engine::ShadowCascadeCache::Region & region)
+{
+	// The scissor test is only enabled for the clear, as it also limits the scroll blits
+	glBindFramebuffer(GL_FRAMEBUFFER, layerFbos[level]);
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(region.x, region.y, region.width, region.height);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glDisable(GL_SCISSOR_TEST);
+
+	// Crop the projection to the region, which its viewport places back on its texels. Casters
+	// are culled against the cropped volume as well
+	regionProjections[numRegions] = Engine::ShadowCascadeCache::getRegionCrop(region, resolution) * levelProjections[level];
+	regionLayers[numRegions] = int(level);
+	regionAreas[numRegions] = region;
+	numRegions++;
+}
+
 void Engine::CascadeShadowMaps::renderShadows(Engine::Camera * cam)
 {
 	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFrameBuffer);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
 
+	// Scrolls and clears go level by level, before drawing on all of them
+	numRegions = 0;
 	for (unsigned int i = 0; i < getCascadeLevels(); i++)
 	{
-		beginShadowRender(i);
+		const Engine::ShadowCascadeCache::Level & cached = shadowCache.getLevels()[i];
+		if (cached.update == Engine::ShadowCascadeCache::UPDATE_NONE)
+		{
+			continue;
+		}
+
+		if (cached.update == Engine::ShadowCascadeCache::UPDATE_SCROLL)
+		{
+			scrollShadowMap(i, cached.shiftX, cached.shiftY);
+		}
+
+		for (auto & region : cached.regions)
+		{
+			addRegion(i, region);
+		}
+	}
+
+	const unsigned long long drawCalls = Engine::FrameStatistics::getDrawCallCount();
+
+	if (numRegions > 0)
+	{
+		// Casters are culled against the region volumes extruded towards the light (see Terrain::renderTiledComponentShadow()),
+		// so the ones closer to the light than the near plane are clamped to it instead of clipped
+		glEnable(GL_DEPTH_CLAMP);
+
+		beginShadowRender();
 
 		for (auto & v : shadowCasters)
 		{
-			v->renderShadow(cam, getShadowProjectionMat());
+			v->renderShadow(cam, regionProjections, numRegions);
 		}
 
 		endShadowRender();
+
+		glDisable(GL_DEPTH_CLAMP);
 	}
 
+	shadowDrawCalls = (unsigned int)(Engine::FrameStatistics::getDrawCallCount() - drawCalls);
+
 	glBindFramebuffer(GL_FRAMEBUFFER, previousFrameBuffer);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
 }
\ No newline at end of file
@@ -35,10 +35,16 @@ Engine::DeferredRenderObject::DeferredRenderObject(unsigned int numBuffers, bool
 	if (numBuffers > 0)
 	{
 		colorBuffers = new Engine::BufferInfo[numBuffers];
+		for (unsigned int i = 0; i < numBuffers; i++)
+		{
+			colorBuffers[i].texture = NULL;
+			colorBuffers[i].shared = false;
+		}
 	}
 	usedColorBuffers = 0;
 
 	depthBuffer.texture = 0;
+	depthBuffer.shared = false;
 
 	Engine::DeferredObjectsTable::getInstance().registerDeferredObject(this);
 
@@ -52,7 +58,7 @@ Engine::DeferredRenderObject::~DeferredRenderObject()
 		for (unsigned int i = 0; i < colorBuffersSize; i++)
 		{
 			BufferInfo bi = colorBuffers[i];
-			if (bi.texture != NULL)
+			if (bi.texture != NULL && !bi.shared)
 			{
 				if (bi.texture->getTexture() != NULL)
 				{
@@ -65,7 +71,7 @@ Engine::DeferredRenderObject::~DeferredRenderObject()
 		delete[] colorBuffers;
 	}
 
-	if (depthBuffer.texture != NULL)
+	if (depthBuffer.texture != NULL && !depthBuffer.shared)
 	{
 		if (depthBuffer.texture->getTexture() != NULL)
 		{
@@ -88,6 +94,41 @@ Engine::TextureInstance * Engine::DeferredRenderObject::addColorBuffer(unsigned
 	GLenum colorAttachment = COLOR_ATTACHMENTS[usedColorBuffers];
 	usedColorBuffers++;
 
+	Engine::TextureInstance * ti = createRenderTexture(gpuTextureFormat, inputTextureFormat, pixelFormat, w, h, name, filterMethod);
+
+	colorBuffers[index].bufferType = colorAttachment;
+	colorBuffers[index].texture = ti;
+	colorBuffers[index].shared = false;
+
+	gBufferMap[name] = ti;
+
+	return ti;
+}
+
+void Engine::DeferredRenderObject::attachColorBuffer(unsigned int index, Engine::TextureInstance * texture, std::string name)
+{
+	if (index >= colorBuffersSize || usedColorBuffers >= 8)
+		exit(-1);
+
+	colorBuffers[index].bufferType = COLOR_ATTACHMENTS[usedColorBuffers];
+	colorBuffers[index].texture = texture;
+	colorBuffers[index].shared = true;
+	usedColorBuffers++;
+
+	gBufferMap[name] = texture;
+}
+
+void Engine::DeferredRenderObject::attachDepthBuffer(Engine::TextureInstance * texture)
+{
+	depthBuffer.bufferType = GL_DEPTH_ATTACHMENT;
+	depthBuffer.texture = texture;
+	depthBuffer.shared = true;
+
+	gBufferMap[Engine::DeferredRenderObject::G_BUFFER_DEPTH] = texture;
+}
+
+Engine::TextureInstance * Engine::DeferredRenderObject::createRenderTexture(GLenum gpuTextureFormat, GLenum inputTextureFormat, GLenum pixelFormat, unsigned int w, unsigned int h, std::string name, int filterMethod)
+{
 	Engine::Texture2D * texture = new Engine::Texture2D(name, 0, w, h);
 	texture->setGenerateMipMaps(false);
 	texture->setMemoryLayoutFormat(gpuTextureFormat);
@@ -101,11 +142,6 @@ Engine::TextureInstance * Engine::DeferredRenderObject::addColorBuffer(unsigned
 	ti->setSComponentWrapType(GL_CLAMP_TO_EDGE);
 	ti->setTComponentWrapType(GL_CLAMP_TO_EDGE);
 
-	colorBuffers[index].bufferType = colorAttachment;
-	colorBuffers[index].texture = ti;
-
-	gBufferMap[name] = ti;
-
 	return ti;
 }
 
@@ -132,6 +168,7 @@ Engine::TextureInstance * Engine::DeferredRenderObject::addDepthBuffer24(unsigne
 	
 	depthBuffer.bufferType = GL_DEPTH_ATTACHMENT;
 	depthBuffer.texture = textureInstance;
+	depthBuffer.shared = false;
 
 	gBufferMap[Engine::DeferredRenderObject::G_BUFFER_DEPTH] = textureInstance;
 
@@ -160,6 +197,7 @@ Engine::TextureInstance * Engine::DeferredRenderObject::addDepthBuffer32(unsigne
 
 	depthBuffer.bufferType = GL_DEPTH_ATTACHMENT;
 	depthBuffer.texture = textureInstance;
+	depthBuffer.shared = false;
 
 	gBufferMap[Engine::DeferredRenderObject::G_BUFFER_DEPTH] = textureInstance;
 	
@@ -181,12 +219,18 @@ void Engine::DeferredRenderObject::initialize()
 	glGenFramebuffers(1, &fbo);
 	for (unsigned int i = 0; i < colorBuffersSize; i++)
 	{
-		colorBuffers[i].texture->generateTexture();
-		colorBuffers[i].texture->configureTexture();
+		if (!colorBuffers[i].shared)
+		{
+			colorBuffers[i].texture->generateTexture();
+			colorBuffers[i].texture->configureTexture();
+		}
 	}
 
-	depthBuffer.texture->generateTexture();
-	depthBuffer.texture->configureTexture();
+	if (depthBuffer.texture != NULL && !depthBuffer.shared)
+	{
+		depthBuffer.texture->generateTexture();
+		depthBuffer.texture->configureTexture();
+	}
 }
 
 void Engine::DeferredRenderObject::setResizeMod(float wm, float hm)
@@ -204,10 +248,16 @@ void Engine::DeferredRenderObject::resizeFBO(unsigned int w, unsigned int h)
 
 	for (unsigned int i = 0; i < colorBuffersSize; i++)
 	{
-		colorBuffers[i].texture->resize(w, h);
+		if (!colorBuffers[i].shared)
+		{
+			colorBuffers[i].texture->resize(w, h);
+		}
 	}
 
-	depthBuffer.texture->resize(w, h);
+	if (depthBuffer.texture != NULL && !depthBuffer.shared)
+	{
+		depthBuffer.texture->resize(w, h);
+	}
 
 	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
@@ -218,7 +268,8 @@ void Engine::DeferredRenderObject::resizeFBO(unsigned int w, unsigned int h)
 		buffers[i] = colorBuffers[i].bufferType;
 	}
 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthBuffer.texture->getTexture()->getTextureId(), 0); 
+	// FBOs without depth buffer do not depth test
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthBuffer.texture != NULL ? depthBuffer.texture->getTexture()->getTextureId() : 0, 0);
 	
 	if (colorBuffersSize > 0)
 	{
@@ -244,7 +295,7 @@ void Engine::DeferredRenderObject::populateDeferredObject(Engine::PostProcessObj
 		object->addTexture("color_" + std::to_string(i), colorBuffers[i].texture);
 	}
 
-	if (renderDepth)
+	if (renderDepth && depthBuffer.texture != NULL)
 	{
 		object->addTexture("depth", depthBuffer.texture);
 	}
@@ -0,0 +1,131 @@
+#include "FrameStatistics.h"
+
+#include <GL/glew.h>
+
+unsigned int Engine::FrameStatistics::currentDrawCalls = 0;
+unsigned long long Engine::FrameStatistics::currentTriangles = 0;
+unsigned long long Engine::FrameStatistics::currentFullDetailTriangles = 0;
+
+unsigned int Engine::FrameStatistics::drawCalls = 0;
+unsigned long long Engine::FrameStatistics::triangles = 0;
+unsigned long long Engine::FrameStatistics::fullDetailTriangles = 0;
+
+unsigned long long Engine::FrameStatistics::totalDrawCalls = 0;
+
+namespace
+{
+	// Counting versions of the GLEW uniform entry points. Each one keeps the driver function it replaces
+	unsigned long long uniformCalls = 0;
+
+#define COUNTED_UNIFORM(NAME, PROC, PARAMS, ARGS) \
+	PROC driver##NAME = 0; \
+	void GLAPIENTRY counted##NAME PARAMS \
+	{ \
+		uniformCalls++; \
+		driver##NAME ARGS; \
+	}
+
+	COUNTED_UNIFORM(Uniform1f, PFNGLUNIFORM1FPROC, (GLint location, GLfloat v0), (location, v0))
+	COUNTED_UNIFORM(Uniform2f, PFNGLUNIFORM2FPROC, (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1))
+	COUNTED_UNIFORM(Uniform3f, PFNGLUNIFORM3FPROC, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2), (location, v0, v1, v2))
+	COUNTED_UNIFORM(Uniform4f, PFNGLUNIFORM4FPROC, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3), (location, v0, v1, v2, v3))
+	COUNTED_UNIFORM(Uniform1i, PFNGLUNIFORM1IPROC, (GLint location, GLint v0), (location, v0))
+	COUNTED_UNIFORM(Uniform2i, PFNGLUNIFORM2IPROC, (GLint location, GLint v0, GLint v1), (location, v0, v1))
+	COUNTED_UNIFORM(Uniform1iv, PFNGLUNIFORM1IVPROC, (GLint location, GLsizei count, const GLint * value), (location, count, value))
+	COUNTED_UNIFORM(Uniform1fv, PFNGLUNIFORM1FVPROC, (GLint location, GLsizei count, const GLfloat * value), (location, count, value))
+	COUNTED_UNIFORM(Uniform2fv, PFNGLUNIFORM2FVPROC, (GLint location, GLsizei count, const GLfloat * value), (location, count, value))
+	COUNTED_UNIFORM(Uniform3fv, PFNGLUNIFORM3FVPROC, (GLint location, GLsizei count, const GLfloat * value), (location, count, value))
+	COUNTED_UNIFORM(Uniform4fv, PFNGLUNIFORM4FVPROC, (GLint location, GLsizei count, const GLfloat * value), (location, count, value))
+	COUNTED_UNIFORM(UniformMatrix3fv, PFNGLUNIFORMMATRIX3FVPROC, (GLint location, GLsizei count, GLboolean transpose, const GLfloat * value), (location, count, transpose, value))
+	COUNTED_UNIFORM(UniformMatrix4fv, PFNGLUNIFORMMATRIX4FVPROC, (GLint location, GLsizei count, GLboolean transpose, const GLfloat * value), (location, count, transpose, value))
+
+#undef COUNTED_UNIFORM
+
+	template<class PROC>
+	void replaceEntryPoint(PROC & entryPoint, PROC & driver, PROC counted)
+	{
+		// Entry points missing from the context stay missing
+		if (entryPoint != 0 && entryPoint != counted)
+		{
+			driver = entryPoint;
+			entryPoint = counted;
+		}
+	}
+
+	template<class PROC>
+	void restoreEntryPoint(PROC & entryPoint, PROC driver, PROC counted)
+	{
+		if (entryPoint == counted)
+		{
+			entryPoint = driver;
+		}
+	}
+}
+
+void Engine::FrameStatistics::recordDraw(unsigned long long triangles, unsigned long long fullDetailTriangles)
+{
+	currentDrawCalls++;
+	currentTriangles += triangles;
+	currentFullDetailTriangles += fullDetailTriangles;
+	totalDrawCalls++;
+}
+
+void Engine::FrameStatistics::endFrame()
+{
+	drawCalls = currentDrawCalls;
+	triangles = currentTriangles;
+	fullDetailTriangles = currentFullDetailTriangles;
+
+	currentDrawCalls = 0;
+	currentTriangles = 0;
+	currentFullDetailTriangles = 0;
+}
+
+void Engine::FrameStatistics::countDrawCall()
+{
+	totalDrawCalls++;
+}
+
+void Engine::FrameStatistics::installUniformCounter()
+{
+	replaceEntryPoint(__glewUniform1f, driverUniform1f, countedUniform1f);
+	replaceEntryPoint(__glewUniform2f, driverUniform2f, countedUniform2f);
+	replaceEntryPoint(__glewUniform3f, driverUniform3f, countedUniform3f);
+	replaceEntryPoint(__glewUniform4f, driverUniform4f, countedUniform4f);
+	replaceEntryPoint(__glewUniform1i, driverUniform1i, countedUniform1i);
+	replaceEntryPoint(__glewUniform2i, driverUniform2i, countedUniform2i);
+	replaceEntryPoint(__glewUniform1iv, driverUniform1iv, countedUniform1iv);
+	replaceEntryPoint(__glewUniform1fv, driverUniform1fv, countedUniform1fv);
+	replaceEntryPoint(__glewUniform2fv, driverUniform2fv, countedUniform2fv);
+	replaceEntryPoint(__glewUniform3fv, driverUniform3fv, countedUniform3fv);
+	replaceEntryPoint(__glewUniform4fv, driverUniform4fv, countedUniform4fv);
+	replaceEntryPoint(__glewUniformMatrix3fv, driverUniformMatrix3fv, countedUniformMatrix3fv);
+	replaceEntryPoint(__glewUniformMatrix4fv, driverUniformMatrix4fv, countedUniformMatrix4fv);
+}
+
+void Engine::FrameStatistics::removeUniformCounter()
+{
+	restoreEntryPoint(__glewUniform1f, driverUniform1f, countedUniform1f);
+	restoreEntryPoint(__glewUniform2f, driverUniform2f, countedUniform2f);
+	restoreEntryPoint(__glewUniform3f, driverUniform3f, countedUniform3f);
+	restoreEntryPoint(__glewUniform4f, driverUniform4f, countedUniform4f);
+	restoreEntryPoint(__glewUniform1i, driverUniform1i, countedUniform1i);
+	restoreEntryPoint(__glewUniform2i, driverUniform2i, countedUniform2i);
+	restoreEntryPoint(__glewUniform1iv, driverUniform1iv, countedUniform1iv);
+	restoreEntryPoint(__glewUniform1fv, driverUniform1fv, countedUniform1fv);
+	restoreEntryPoint(__glewUniform2fv, driverUniform2fv, countedUniform2fv);
+	restoreEntryPoint(__glewUniform3fv, driverUniform3fv, countedUniform3fv);
+	restoreEntryPoint(__glewUniform4fv, driverUniform4fv, countedUniform4fv);
+	restoreEntryPoint(__glewUniformMatrix3fv, driverUniformMatrix3fv, countedUniformMatrix3fv);
+	restoreEntryPoint(__glewUniformMatrix4fv, driverUniformMatrix4fv, countedUniformMatrix4fv);
+}
+
+unsigned long long Engine::FrameStatistics::getDrawCallCount()
+{
+	return totalDrawCalls;
+}
+
+unsigned long long Engine::FrameStatistics::getUniformCallCount()
+{
+	return uniformCalls;
+}
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "Frustum.h"
+
+#include "util/Simd.h"
+
+void Engine::BoundingBoxList::clear()
+{
+	minX.clear(); minY.clear(); minZ.clear();
+	maxX.clear(); maxY.clear(); maxZ.clear();
+}
+
+void Engine::BoundingBoxList::reserve(size_t count)
+{
+	minX.reserve(count); minY.reserve(count); minZ.reserve(count);
+	maxX.reserve(count); maxY.reserve(count); maxZ.reserve(count);
+}
+
+void Engine::BoundingBoxList::add(const glm::vec3 & boundsMin, const glm::vec3 & boundsMax)
+{
+	minX.push_back(boundsMin.x); minY.push_back(boundsMin.y); minZ.push_back(boundsMin.z);
+	maxX.push_back(boundsMax.x); maxY.push_back(boundsMax.y); maxZ.push_back(boundsMax.z);
+}
+
+size_t Engine::BoundingBoxList::size() const
+{
+	return minX.size();
+}
+
+glm::vec3 Engine::BoundingBoxList::getMin(size_t index) const
+{
+	return glm::vec3(minX[index], minY[index], minZ[index]);
+}
+
+glm::vec3 Engine::BoundingBoxList::getMax(size_t index) const
+{
+	return glm::vec3(maxX[index], maxY[index], maxZ[index]);
+}
+
+// ====================================================================================================================
+
+Engine::Frustum::Frustum()
+{
+	update(glm::mat4(1.0f));
+}
+
+Engine::Frustum::Frustum(const glm::mat4 & viewProjection)
+{
+	update(viewProjection);
+}
+
+void Engine::Frustum::update(const glm::mat4 & viewProjection)
+{
+	// glm matrices are column major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+	planes[PLANE_LEFT] = row3 + row0;
+	planes[PLANE_RIGHT] = row3 - row0;
+	planes[PLANE_BOTTOM] = row3 + row1;
+	planes[PLANE_TOP] = row3 - row1;
+	planes[PLANE_NEAR] = row3 + row2;
+	planes[PLANE_FAR] = row3 - row2;
+
+	for (unsigned int p = 0; p < PLANE_COUNT; p++)
+	{
+		const float length = glm::length(glm::vec3(planes[p]));
+		planes[p] = length > 0.0f ? planes[p] / length : planes[p];
+	}
+}
+
+const glm::vec4 & Engine::Frustum::getPlane(Engine::Frustum::FrustumPlane plane) const
+{
+	return planes[plane];
+}
+
+void Engine::Frustum::extrude(Engine::Frustum::FrustumPlane plane)
+{
+	// Every point lies in front of a plane with no normal and a positive distance
+	planes[plane] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+bool Engine::Frustum::intersects(const glm::vec3 & boundsMin, const glm::vec3 & boundsMax) const
+{
+	// The box is outside a plane if its corner farthest along the plane normal is behind it
+	for (unsigned int p = 0; p < PLANE_COUNT; p++)
+	{
+		const glm::vec4 & plane = planes[p];
+		const float x = plane.x >= 0.0f ? boundsMax.x : boundsMin.x;
+		const float y = plane.y >= 0.0f ? boundsMax.y : boundsMin.y;
+		const float z = plane.z >= 0.0f ? boundsMax.z : boundsMin.z;
+		if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+size_t Engine::Frustum::intersects(const Engine::BoundingBoxList & boxes, unsigned char * visible) const
+{
+	using namespace Engine::Simd;
+
+	const size_t count = boxes.size();
+
+	// The farthest corner of every box uses the same min or max coordinates for a given plane,
+	// so each plane only needs the 3 matching streams
+	const float * streams[PLANE_COUNT][3];
+	Float4 planeData[PLANE_COUNT][4];
+	for (unsigned int p = 0; p < PLANE_COUNT; p++)
+	{
+		const glm::vec4 & plane = planes[p];
+		streams[p][0] = plane.x >= 0.0f ? boxes.maxX.data() : boxes.minX.data();
+		streams[p][1] = plane.y >= 0.0f ? boxes.maxY.data() : boxes.minY.data();
+		streams[p][2] = plane.z >= 0.0f ? boxes.maxZ.data() : boxes.minZ.data();
+		for (unsigned int c = 0; c < 4; c++)
+		{
+			planeData[p][c] = set1(plane[c]);
+		}
+	}
+
+	const Float4 zero = set1(0.0f);
+	size_t numVisible = 0;
+	for (size_t b = 0; b < count; b += 4)
+	{
+		// The last group is padded by repeating its last box
+		const size_t groupSize = count - b < 4 ? count - b : 4;
+
+		Float4 outside = lessThan(zero, zero);
+		for (unsigned int p = 0; p < PLANE_COUNT; p++)
+		{
+			Float4 corner[3];
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				if (groupSize == 4)
+				{
+					corner[c] = load(streams[p][c] + b);
+				}
+				else
+				{
+					float padded[4];
+					for (size_t k = 0; k < 4; k++)
+					{
+						padded[k] = streams[p][c][b + (k < groupSize ? k : groupSize - 1)];
+					}
+					corner[c] = load(padded);
+				}
+			}
+
+			const Float4 distance = add(add(add(mul(planeData[p][0], corner[0]), mul(planeData[p][1], corner[1])), mul(planeData[p][2], corner[2])), planeData[p][3]);
+			outside = maskOr(outside, lessThan(distance, zero));
+		}
+
+		const int outsideBits = maskBits(outside);
+		for (size_t k = 0; k < groupSize; k++)
+		{
+			visible[b + k] = (outsideBits & (1 << k)) == 0 ? 1 : 0;
+			numVisible += visible[b + k];
+		}
+	}
+
+	return numVisible;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "InstanceBuffer.h"
+
+#include <GL/glew.h>
+
+Engine::InstanceBuffer::InstanceBuffer()
+	:vbo(0), capacity(0), numInstances(0)
+{
+}
+
+void Engine::InstanceBuffer::upload(const std::vector<glm::vec4> & instances)
+{
+	if (vbo == 0)
+	{
+		glGenBuffers(1, &vbo);
+	}
+
+	numInstances = instances.size();
+	if (numInstances == 0)
+	{
+		return;
+	}
+
+	if (numInstances > capacity)
+	{
+		// Grow with some room, so the buffer settles after a few frames
+		capacity = numInstances + numInstances / 2;
+	}
+
+	// Orphan the previous storage
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(glm::vec4), 0, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, numInstances * sizeof(glm::vec4), &instances[0]);
+}
+
+void Engine::InstanceBuffer::bind(unsigned int location, size_t firstInstance)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)(firstInstance * sizeof(glm::vec4)));
+	glVertexAttribDivisor(location, 1);
+	glEnableVertexAttribArray(location);
+}
+
+void Engine::InstanceBuffer::unbind(unsigned int location)
+{
+	glVertexAttribDivisor(location, 0);
+	glDisableVertexAttribArray(location);
+}
+
+size_t Engine::InstanceBuffer::getNumInstances() const
+{
+	return numInstances;
+}
+
+void Engine::InstanceBuffer::destroy()
+{
+	if (vbo != 0)
+	{
+		glDeleteBuffers(1, &vbo);
+		vbo = 0;
+	}
+	capacity = numInstances = 0;
+}
\ No newline at end of file
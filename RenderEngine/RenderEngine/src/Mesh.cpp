@@ -5,28 +5,328 @@
 
 #include "Mesh.h"
 
-#include "CustomMaths.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Threadpool.h"
+#include "util/Simd.h"
 
-#include <glm/glm.hpp>
 #include <vector>
+#include <memory>
+#include <cmath>
 #include <iostream>
 
 #include <gl\glew.h>
 
+// ====================================================================================================================
+// Normal and tangent computation kernels
+// Faces are processed in blocks of 4 (one per SIMD lane). Each block stores its results as structure of arrays:
+// value k of the block is at [k * 4 + lane]. Every vertex then sums the contributions of its face corners in face
+// order, so the result does not depend on the number of threads. The operations mirror voronoiTriangleAreas /
+// cotangent / tangent (CustomMaths) and glm, so the results are the same as computing them face by face
+
+namespace
+{
+	// Where the per corner results are stored within a face block
+	struct FaceBlockLayout
+	{
+		// Floats per block
+		size_t size;
+		// Distance between the vectors of consecutive corners (0 if all corners share the face vector)
+		size_t cornerVectorStride;
+		// Start of the corner weights
+		size_t weightStart;
+	};
+
+	// Face normal, then the weights of the 3 corners
+	const FaceBlockLayout NORMAL_BLOCK = { 6 * 4, 0, 3 * 4 };
+	// Tangent of each corner, then the weights of the 3 corners
+	const FaceBlockLayout TANGENT_BLOCK = { 12 * 4, 3 * 4, 9 * 4 };
+	const size_t MAX_BLOCK_SIZE = 12 * 4;
+
+	// Face blocks and vertices processed by each parallel task
+	const size_t FACE_BLOCK_GRAIN = 2048;
+	const size_t VERTEX_GRAIN = 8192;
+	// Below this amount of faces splitting the work costs more than it saves
+	const unsigned int MIN_PARALLEL_FACES = 65536;
+
+	// Indices of the given corner of the 4 faces starting at firstFace (the last face is repeated past the end)
+	void loadCornerIndices(const unsigned int * faces, unsigned int numFaces, size_t firstFace, unsigned int corner, unsigned int indices[4])
+	{
+		for (unsigned int lane = 0; lane < 4; lane++)
+		{
+			size_t face = firstFace + lane;
+			face = face < numFaces ? face : numFaces - 1;
+			indices[lane] = faces[face * 3 + corner];
+		}
+	}
+
+	Engine::Simd::Vec3x4 loadVec3(const float * data, const unsigned int indices[4])
+	{
+		const float * a = data + size_t(indices[0]) * 3;
+		const float * b = data + size_t(indices[1]) * 3;
+		const float * c = data + size_t(indices[2]) * 3;
+		const float * d = data + size_t(indices[3]) * 3;
+		Engine::Simd::Vec3x4 r =
+		{
+			Engine::Simd::set(a[0], b[0], c[0], d[0]),
+			Engine::Simd::set(a[1], b[1], c[1], d[1]),
+			Engine::Simd::set(a[2], b[2], c[2], d[2])
+		};
+		return r;
+	}
+
+	void loadVec2(const float * data, const unsigned int indices[4], Engine::Simd::Float4 & s, Engine::Simd::Float4 & t)
+	{
+		const float * a = data + size_t(indices[0]) * 2;
+		const float * b = data + size_t(indices[1]) * 2;
+		const float * c = data + size_t(indices[2]) * 2;
+		const float * d = data + size_t(indices[3]) * 2;
+		s = Engine::Simd::set(a[0], b[0], c[0], d[0]);
+		t = Engine::Simd::set(a[1], b[1], c[1], d[1]);
+	}
+
+	// Batched Engine::cotangent. As in the scalar version, the sine is the glm vector length() (component count)
+	Engine::Simd::Float4 cotangent4(const Engine::Simd::Vec3x4 & pa, const Engine::Simd::Vec3x4 & pb)
+	{
+		using namespace Engine::Simd;
+		return div(dot(normalize(pa), normalize(pb)), set1(3.0f));
+	}
+
+	// Batched Engine::voronoiTriangleAreas
+	void voronoiTriangleAreas4(const Engine::Simd::Vec3x4 & A, const Engine::Simd::Vec3x4 & B, const Engine::Simd::Vec3x4 & C, Engine::Simd::Float4 weights[3])
+	{
+		using namespace Engine::Simd;
+
+		const Vec3x4 AB = sub(B, A), AC = sub(C, A);
+		const Vec3x4 BA = sub(A, B), BC = sub(C, B);
+		const Vec3x4 CA = sub(A, C), CB = sub(B, C);
+
+		const Float4 zero = set1(0.0f);
+		const Float4 obtuseA = lessThan(dot(AB, AC), zero);
+		const Float4 obtuseB = lessThan(dot(BA, BC), zero);
+		const Float4 obtuseC = lessThan(dot(CA, CB), zero);
+
+		// Non obtuse triangles. Squared edge lengths come from glm length() too (3 * 3)
+		const Float4 ctngA = cotangent4(AB, AC);
+		const Float4 ctngB = cotangent4(BA, BC);
+		const Float4 ctngC = cotangent4(CA, CB);
+		const Float4 nine = set1(9.0f);
+		const Float4 eighth = set1(0.125f);
+		weights[0] = mul(eighth, add(mul(nine, ctngC), mul(nine, ctngB)));
+		weights[1] = mul(eighth, add(mul(nine, ctngC), mul(nine, ctngA)));
+		weights[2] = mul(eighth, add(mul(nine, ctngB), mul(nine, ctngA)));
+
+		// Obtuse triangles, applied from the lowest to the highest priority
+		const Float4 obtuseCornerWeight = set1(0.75f);
+		const Float4 otherCornerWeight = set1(0.375f);
+		const Float4 obtuse[3] = { obtuseA, obtuseB, obtuseC };
+		for (int i = 2; i >= 0; i--)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				weights[j] = select(obtuse[i], i == j ? obtuseCornerWeight : otherCornerWeight, weights[j]);
+			}
+		}
+	}
+
+	// Batched Engine::tangent, normalized
+	Engine::Simd::Vec3x4 tangent4(Engine::Simd::Float4 s1, Engine::Simd::Float4 t1, Engine::Simd::Float4 s2, Engine::Simd::Float4 t2, const Engine::Simd::Vec3x4 & Q1, const Engine::Simd::Vec3x4 & Q2)
+	{
+		using namespace Engine::Simd;
+
+		const Float4 stDet = div(set1(1.0f), sub(mul(s1, t2), mul(t1, s2)));
+		const Float4 row1x = t2;
+		const Float4 row1y = neg(t1);
+		Vec3x4 t =
+		{
+			mul(stDet, add(mul(row1x, Q1.x), mul(row1y, Q2.x))),
+			mul(stDet, add(mul(row1x, Q1.y), mul(row1y, Q2.y))),
+			mul(stDet, add(mul(row1x, Q1.z), mul(row1y, Q2.z)))
+		};
+		return normalize(t);
+	}
+
+	void storeVec3(float * dst, const Engine::Simd::Vec3x4 & v)
+	{
+		Engine::Simd::store(dst, v.x);
+		Engine::Simd::store(dst + 4, v.y);
+		Engine::Simd::store(dst + 8, v.z);
+	}
+
+	void computeFaceNormals(const unsigned int * faces, const float * vertices, unsigned int numFaces, size_t firstFace, float * out)
+	{
+		using namespace Engine::Simd;
+
+		unsigned int a[4], b[4], c[4];
+		loadCornerIndices(faces, numFaces, firstFace, 0, a);
+		loadCornerIndices(faces, numFaces, firstFace, 1, b);
+		loadCornerIndices(faces, numFaces, firstFace, 2, c);
+
+		const Vec3x4 A = loadVec3(vertices, a);
+		const Vec3x4 B = loadVec3(vertices, b);
+		const Vec3x4 C = loadVec3(vertices, c);
+
+		Float4 weights[3];
+		voronoiTriangleAreas4(A, B, C, weights);
+
+		storeVec3(out, normalize(cross(sub(B, A), sub(C, A))));
+		store(out + 12, weights[0]);
+		store(out + 16, weights[1]);
+		store(out + 20, weights[2]);
+	}
+
+	void computeFaceTangents(const unsigned int * faces, const float * vertices, const float * uvs, unsigned int numFaces, size_t firstFace, float * out)
+	{
+		using namespace Engine::Simd;
+
+		unsigned int a[4], b[4], c[4];
+		loadCornerIndices(faces, numFaces, firstFace, 0, a);
+		loadCornerIndices(faces, numFaces, firstFace, 1, b);
+		loadCornerIndices(faces, numFaces, firstFace, 2, c);
+
+		const Vec3x4 A = loadVec3(vertices, a);
+		const Vec3x4 B = loadVec3(vertices, b);
+		const Vec3x4 C = loadVec3(vertices, c);
+
+		Float4 sA, tA, sB, tB, sC, tC;
+		loadVec2(uvs, a, sA, tA);
+		loadVec2(uvs, b, sB, tB);
+		loadVec2(uvs, c, sC, tC);
+
+		storeVec3(out, tangent4(sub(sB, sA), sub(tB, tA), sub(sC, sA), sub(tC, tA), sub(B, A), sub(C, A)));
+		storeVec3(out + 12, tangent4(sub(sA, sB), sub(tA, tB), sub(sC, sB), sub(tC, tB), sub(A, B), sub(C, B)));
+		storeVec3(out + 24, tangent4(sub(sA, sC), sub(tA, tC), sub(sB, sC), sub(tB, tC), sub(A, C), sub(B, C)));
+
+		Float4 weights[3];
+		voronoiTriangleAreas4(A, B, C, weights);
+		store(out + 36, weights[0]);
+		store(out + 40, weights[1]);
+		store(out + 44, weights[2]);
+	}
+
+	// Adds the contribution of a face corner to a vertex
+	void accumulateCorner(const float * block, const FaceBlockLayout & layout, unsigned int lane, unsigned int corner, float * sum)
+	{
+		const float * vector = block + corner * layout.cornerVectorStride + lane;
+		const float weight = block[layout.weightStart + corner * 4 + lane];
+		sum[0] += vector[0] * weight;
+		sum[1] += vector[4] * weight;
+		sum[2] += vector[8] * weight;
+		sum[3] += weight;
+	}
+
+	// Averages the accumulated vector by the accumulated area and normalizes it (as glm::normalize)
+	void normalizeWeightedSum(float sum[4], float * out)
+	{
+		sum[0] /= sum[3];
+		sum[1] /= sum[3];
+		sum[2] /= sum[3];
+
+		const float invLength = 1.0f / sqrtf(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+		out[0] = sum[0] * invLength;
+		out[1] = sum[1] * invLength;
+		out[2] = sum[2] * invLength;
+	}
+
+	// Computes a per vertex vector as the normalized, voronoi weighted average of the per face corner vectors
+	// produced by faceKernel(firstFace, block). Big meshes run the face kernel on the pool, storing its results,
+	// and then accumulate them per vertex range. Otherwise the results are accumulated right away
+	template<class FaceKernel>
+	void computeVertexVectors(const unsigned int * faces, unsigned int numFaces, unsigned int numVertices, const FaceBlockLayout & layout, FaceKernel faceKernel, float * out)
+	{
+		const size_t numBlocks = (size_t(numFaces) + 3) / 4;
+
+		if (numFaces < MIN_PARALLEL_FACES || Engine::Concurrent::ThreadPool::getInstance().getPoolSize() < 2)
+		{
+			std::unique_ptr<float[]> sums(new float[size_t(numVertices) * 4]);
+			memset(sums.get(), 0, size_t(numVertices) * 4 * sizeof(float));
+
+			float block[MAX_BLOCK_SIZE];
+			for (size_t b = 0; b < numBlocks; b++)
+			{
+				const size_t firstFace = b * 4;
+				faceKernel(firstFace, block);
+
+				const unsigned int lanes = numFaces - firstFace < 4 ? (unsigned int)(numFaces - firstFace) : 4;
+				for (unsigned int lane = 0; lane < lanes; lane++)
+				{
+					const unsigned int * face = faces + (firstFace + lane) * 3;
+					for (unsigned int corner = 0; corner < 3; corner++)
+					{
+						accumulateCorner(block, layout, lane, corner, sums.get() + size_t(face[corner]) * 4);
+					}
+				}
+			}
+
+			float * s = sums.get();
+			Engine::Concurrent::parallelForRange(0, numVertices, VERTEX_GRAIN, [s, out](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					normalizeWeightedSum(s + i * 4, out + i * 3);
+				}
+			});
+			return;
+		}
+
+		// Face pass
+		std::unique_ptr<float[]> faceData(new float[numBlocks * layout.size]);
+		float * data = faceData.get();
+		const size_t blockSize = layout.size;
+		Engine::Concurrent::parallelForRange(0, numBlocks, FACE_BLOCK_GRAIN, [data, blockSize, &faceKernel](size_t begin, size_t end)
+		{
+			for (size_t b = begin; b < end; b++)
+			{
+				faceKernel(b * 4, data + b * blockSize);
+			}
+		});
+
+		// Vertex pass: each vertex walks its own corners through the adjacency, which lists them in face order,
+		// so no data is shared and sums are the same as on the serial path
+		Engine::MeshOptimizer::VertexAdjacency adjacency;
+		Engine::MeshOptimizer::buildVertexAdjacency(adjacency, faces, size_t(numFaces) * 3, numVertices);
+		const unsigned int * start = adjacency.start.data();
+		const unsigned int * corners = adjacency.corners.data();
+		const FaceBlockLayout * l = &layout;
+		Engine::Concurrent::parallelForRange(0, numVertices, VERTEX_GRAIN, [=](size_t first, size_t last)
+		{
+			for (size_t v = first; v < last; v++)
+			{
+				float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				for (unsigned int a = start[v]; a < start[v + 1]; a++)
+				{
+					const size_t f = corners[a] / 3;
+					accumulateCorner(data + (f / 4) * l->size, *l, (unsigned int)(f & 3), corners[a] % 3, sum);
+				}
+				normalizeWeightedSum(sum, out + v * 3);
+			}
+		});
+	}
+}
+
+// ====================================================================================================================
+
 Engine::Mesh::Mesh()
 {
 	faces = 0;
 	vertices = colors = normals = tangents = uvs = emission = 0;
+	vboInterleaved = -1;
+	indexType = GL_UNSIGNED_INT;
 }
 
-Engine::Mesh::Mesh(aiMesh * mesh)
+Engine::Mesh::Mesh(aiMesh * mesh, bool uploadToGPU)
 {
 	faces = 0;
 	vertices = colors = normals = tangents = uvs = emission = 0;
+	vboInterleaved = -1;
+	indexType = GL_UNSIGNED_INT;
 
 	loadFromMesh(mesh);
 
-	syncGPU();
+	if (uploadToGPU)
+	{
+		syncGPU();
+	}
 }
 
 Engine::Mesh::Mesh(const Engine::Mesh &other)
@@ -70,6 +370,12 @@ Engine::Mesh::Mesh(const Engine::Mesh &other)
 		memcpy(tangents, other.tangents, copySize);
 	}
 
+	if (other.emission != 0)
+	{
+		emission = new float[bufferSize];
+		memcpy(emission, other.emission, copySize);
+	}
+
 	if (other.uvs != 0)
 	{
 		uvs = new float[numVertices * 2];
@@ -85,13 +391,75 @@ Engine::Mesh::Mesh(const Engine::Mesh &other)
 	vboTangents = other.vboTangents;
 	vboUVs = other.vboUVs;
 	vboVertices = other.vboVertices;
+	vboEmission = other.vboEmission;
+	vboInterleaved = other.vboInterleaved;
+
+	format = other.format;
+	indexType = other.indexType;
+}
+
+Engine::Mesh::Mesh(Engine::Mesh &&other)
+	:numFaces(other.numFaces), numVertices(other.numVertices), verticesPerFace(other.verticesPerFace)
+{
+	faces = other.faces;
+	vertices = other.vertices;
+	normals = other.normals;
+	colors = other.colors;
+	emission = other.emission;
+	uvs = other.uvs;
+	tangents = other.tangents;
+
+	vao = other.vao;
+	vboFaces = other.vboFaces;
+	vboVertices = other.vboVertices;
+	vboNormals = other.vboNormals;
+	vboColors = other.vboColors;
+	vboEmission = other.vboEmission;
+	vboUVs = other.vboUVs;
+	vboTangents = other.vboTangents;
+	vboInterleaved = other.vboInterleaved;
+
+	format = other.format;
+	indexType = other.indexType;
+
+	other.numFaces = other.numVertices = 0;
+	other.faces = 0;
+	other.vertices = other.colors = other.normals = other.tangents = other.uvs = other.emission = 0;
+	other.vao = other.vboFaces = other.vboVertices = other.vboNormals = other.vboColors = other.vboEmission = other.vboUVs = other.vboTangents = other.vboInterleaved = -1;
 }
 
-Engine::Mesh::Mesh(const unsigned int numF, const unsigned int numV, const unsigned int *f, const float *v, const float *c, const float *n, const float *uv, const float *t, const float *e)
+Engine::Mesh::Mesh(Engine::AdoptBuffersTag, const unsigned int numF, const unsigned int numV, unsigned int *f, float *v, float *c, float *n, float *uv, float *t, float *e, bool uploadToGPU)
+	:numFaces(numF), numVertices(numV), verticesPerFace(3)
+{
+	vboInterleaved = -1;
+	indexType = GL_UNSIGNED_INT;
+
+	faces = f;
+	vertices = v;
+	colors = c;
+	normals = n;
+	uvs = uv;
+	tangents = t;
+	emission = e;
+
+	if (numVertices > 0 && normals == 0)
+	{
+		computeNormals();
+	}
+
+	if (uploadToGPU)
+	{
+		syncGPU();
+	}
+}
+
+Engine::Mesh::Mesh(const unsigned int numF, const unsigned int numV, const unsigned int *f, const float *v, const float *c, const float *n, const float *uv, const float *t, const float *e, bool uploadToGPU)
 	:numFaces(numF), numVertices(numV)
 {
 	faces = 0;
 	vertices = colors = normals = tangents = uvs = emission = 0;
+	vboInterleaved = -1;
+	indexType = GL_UNSIGNED_INT;
 
 	if (numFaces > 0)
 	{
@@ -147,7 +515,10 @@ Engine::Mesh::Mesh(const unsigned int numF, const unsigned int numV, const unsig
 		}
 	}
 
-	syncGPU();
+	if (uploadToGPU)
+	{
+		syncGPU();
+	}
 }
 
 void Engine::Mesh::loadFromMesh(aiMesh * mesh)
@@ -209,123 +580,133 @@ void Engine::Mesh::extractGeometry(aiMesh * mesh)
 
 void Engine::Mesh::computeNormals()
 {
-	std::vector<glm::vec3> perfaceNormals;
-	perfaceNormals.resize(numVertices, glm::vec3(0, 0, 0));
-
-	std::vector<float> voronoiArea;
-	voronoiArea.resize(numVertices, 0.0f);
-
-	for (unsigned int i = 0; i < numFaces; i++)
-	{
-		const int start = i * 3;
-
-		// Vertex indexes
-		unsigned int raw_a = faces[start];
-		unsigned int raw_b = faces[start + 1];
-		unsigned int raw_c = faces[start + 2];
-
-		// Vertex indexes within our array
-		unsigned int a = raw_a * 3;
-		unsigned int b = raw_b * 3;
-		unsigned int c = raw_c * 3;
-
-		glm::vec3 A(vertices[a], vertices[a + 1], vertices[a + 2]);
-		glm::vec3 B(vertices[b], vertices[b + 1], vertices[b + 2]);
-		glm::vec3 C(vertices[c], vertices[c + 1], vertices[c + 2]);
-
-		glm::vec3 faceNormal = glm::normalize(glm::cross(B - A, C - A));
-		
-		glm::vec3 faceAreas = voronoiTriangleAreas(A, B, C);
-
-		perfaceNormals[raw_a] += faceNormal * faceAreas.x;
-		perfaceNormals[raw_b] += faceNormal * faceAreas.y;
-		perfaceNormals[raw_c] += faceNormal * faceAreas.z;
-
-		voronoiArea[raw_a] += faceAreas.x;
-		voronoiArea[raw_b] += faceAreas.y;
-		voronoiArea[raw_c] += faceAreas.z;
-	}
+	const unsigned int * f = faces;
+	const float * v = vertices;
+	const unsigned int nf = numFaces;
 
+	delete[] normals;
 	normals = new float[numVertices * 3];
-	for (unsigned int i = 0; i < numVertices; i++)
+	computeVertexVectors(faces, numFaces, numVertices, NORMAL_BLOCK, [f, v, nf](size_t firstFace, float * block)
 	{
-		perfaceNormals[i] /= voronoiArea[i];
-
-		glm::vec3 normal = glm::normalize(perfaceNormals[i]);
-		
-		const int start = i * 3;
-		normals[start] = normal.x;
-		normals[start + 1] = normal.y;
-		normals[start + 2] = normal.z;
-	}
+		computeFaceNormals(f, v, nf, firstFace, block);
+	}, normals);
 }
 
 void Engine::Mesh::computeTangents()
 {
-	std::vector<glm::vec3> perFaceTangents;
-	perFaceTangents.resize(numVertices, glm::vec3(0, 0, 0));
+	const unsigned int * f = faces;
+	const float * v = vertices;
+	const float * uv = uvs;
+	const unsigned int nf = numFaces;
 
-	std::vector<float> voronoiArea;
-	voronoiArea.resize(numVertices, 0.0f);
+	delete[] tangents;
+	tangents = new float[numVertices * 3];
+	computeVertexVectors(faces, numFaces, numVertices, TANGENT_BLOCK, [f, v, uv, nf](size_t firstFace, float * block)
+	{
+		computeFaceTangents(f, v, uv, nf, firstFace, block);
+	}, tangents);
+}
 
-	for (unsigned int i = 0; i < numFaces; i++)
+void Engine::Mesh::optimize(bool reduceOverdraw)
+{
+	if (faces == 0 || numFaces == 0 || verticesPerFace != 3)
 	{
-		const int start = i * 3;
+		return;
+	}
 
-		// Vertex indexes
-		unsigned int raw_a = faces[start];
-		unsigned int raw_b = faces[start + 1];
-		unsigned int raw_c = faces[start + 2];
+	const size_t numIndices = size_t(numFaces) * 3;
+	const std::vector<unsigned int> inputFaces(faces, faces + numIndices);
+	MeshOptimizer::optimizeVertexCache(faces, numIndices, numVertices);
 
-		// Vertex indexes within our array
-		unsigned int a = raw_a * 3;
-		unsigned int b = raw_b * 3;
-		unsigned int c = raw_c * 3;
+	if (reduceOverdraw && vertices != 0)
+	{
+		MeshOptimizer::optimizeOverdraw(faces, numIndices, vertices, numVertices);
+	}
 
-		glm::vec3 A(vertices[a], vertices[a + 1], vertices[a + 2]);
-		glm::vec3 B(vertices[b], vertices[b + 1], vertices[b + 2]);
-		glm::vec3 C(vertices[c], vertices[c + 1], vertices[c + 2]);
+	// The overdraw pass trades some cache efficiency, which may leave an already optimized order worse than it was
+	if (MeshOptimizer::analyzeVertexCache(faces, numIndices, numVertices).acmr > MeshOptimizer::analyzeVertexCache(inputFaces.data(), numIndices, numVertices).acmr)
+	{
+		memcpy(faces, inputFaces.data(), numIndices * sizeof(unsigned int));
+	}
 
-		int aStart = raw_a * 2;
-		int bStart = raw_b * 2;
-		int cStart = raw_c * 2;
+	// Store the vertices in the order they are first used
+	std::vector<unsigned int> remap(numVertices);
+	MeshOptimizer::computeVertexFetchRemap(remap.data(), faces, numIndices, numVertices);
 
-		glm::vec2 st1A(uvs[bStart] - uvs[aStart], uvs[bStart + 1] - uvs[aStart + 1]);
-		glm::vec2 st2A(uvs[cStart] - uvs[aStart], uvs[cStart + 1] - uvs[aStart + 1]);
+	for (size_t i = 0; i < numIndices; i++)
+	{
+		faces[i] = remap[faces[i]];
+	}
 
-		glm::vec2 st1B(uvs[aStart] - uvs[bStart], uvs[aStart + 1] - uvs[bStart + 1]);
-		glm::vec2 st2B(uvs[cStart] - uvs[bStart], uvs[cStart + 1] - uvs[bStart + 1]);
+	float * attributes[] = { vertices, normals, colors, emission, tangents, uvs };
+	const unsigned int components[] = { 3, 3, 3, 3, 3, 2 };
+	std::vector<float> reordered(size_t(numVertices) * 3);
+	for (unsigned int a = 0; a < 6; a++)
+	{
+		if (attributes[a] == 0)
+		{
+			continue;
+		}
 
-		glm::vec2 st1C(uvs[aStart] - uvs[cStart], uvs[aStart + 1] - uvs[cStart + 1]);
-		glm::vec2 st2C(uvs[bStart] - uvs[cStart], uvs[bStart + 1] - uvs[cStart + 1]);
+		const unsigned int c = components[a];
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			memcpy(&reordered[size_t(remap[v]) * c], attributes[a] + v * c, c * sizeof(float));
+		}
+		memcpy(attributes[a], reordered.data(), size_t(numVertices) * c * sizeof(float));
+	}
+}
 
-		glm::vec3 tangentA = glm::normalize(tangent(st1A, st2A, B - A, C - A));
-		glm::vec3 tangentB = glm::normalize(tangent(st1B, st2B, A - B, C - B));
-		glm::vec3 tangentC = glm::normalize(tangent(st1C, st2C, A - C, B - C));
+Engine::Mesh * Engine::Mesh::simplify(unsigned int targetFaces, float targetError, float * resultError) const
+{
+	if (faces == 0 || vertices == 0 || verticesPerFace != 3)
+	{
+		return 0;
+	}
 
-		glm::vec3 faceAreas = voronoiTriangleAreas(A, B, C);
+	const size_t numIndices = size_t(numFaces) * 3;
+	std::vector<unsigned int> indices(numIndices);
+	const size_t simplifiedIndices = MeshSimplifier::simplify(indices.data(), faces, numIndices, vertices, numVertices, size_t(targetFaces) * 3, targetError, resultError);
+	MeshOptimizer::optimizeVertexCache(indices.data(), simplifiedIndices, numVertices);
 
-		perFaceTangents[raw_a] += tangentA * faceAreas.x;
-		perFaceTangents[raw_b] += tangentB * faceAreas.y;
-		perFaceTangents[raw_c] += tangentC * faceAreas.z;
+	// Keep only the used vertices, in the order they are first used
+	std::vector<unsigned int> remap(numVertices);
+	MeshOptimizer::computeVertexFetchRemap(remap.data(), indices.data(), simplifiedIndices, numVertices);
 
-		voronoiArea[raw_a] += faceAreas.x;
-		voronoiArea[raw_b] += faceAreas.y;
-		voronoiArea[raw_c] += faceAreas.z;
+	unsigned int usedVertices = 0;
+	unsigned int * newFaces = new unsigned int[simplifiedIndices];
+	for (size_t i = 0; i < simplifiedIndices; i++)
+	{
+		newFaces[i] = remap[indices[i]];
+		usedVertices = newFaces[i] + 1 > usedVertices ? newFaces[i] + 1 : usedVertices;
 	}
 
-	tangents = new float[numVertices * 3];
-	for (unsigned int i = 0; i < numVertices; i++)
+	const float * attributes[] = { vertices, normals, colors, emission, tangents, uvs };
+	const unsigned int components[] = { 3, 3, 3, 3, 3, 2 };
+	float * newAttributes[6] = { 0, 0, 0, 0, 0, 0 };
+	for (unsigned int a = 0; a < 6; a++)
 	{
-		perFaceTangents[i] /= voronoiArea[i];
-
-		glm::vec3 normal = glm::normalize(perFaceTangents[i]);
+		if (attributes[a] == 0)
+		{
+			continue;
+		}
 
-		const int start = i * 3;
-		tangents[start] = normal.x;
-		tangents[start + 1] = normal.y;
-		tangents[start + 2] = normal.z;
+		const unsigned int c = components[a];
+		newAttributes[a] = new float[size_t(usedVertices) * c];
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			if (remap[v] < usedVertices)
+			{
+				memcpy(newAttributes[a] + size_t(remap[v]) * c, attributes[a] + v * c, c * sizeof(float));
+			}
+		}
 	}
+
+	Engine::Mesh * result = new Engine::Mesh(ADOPT_BUFFERS, (unsigned int)(simplifiedIndices / 3), usedVertices, newFaces,
+		newAttributes[0], newAttributes[2], newAttributes[1], newAttributes[5], newAttributes[4], newAttributes[3], false);
+	result->setVertexFormat(format);
+
+	return result;
 }
 
 const unsigned int Engine::Mesh::getNumFaces() const
@@ -378,7 +759,70 @@ const float * Engine::Mesh::getEmissive() const
 	return emission;
 }
 
-void Engine::Mesh::syncGPU()
+void Engine::Mesh::computeBounds(float boundsMin[3], float boundsMax[3]) const
+{
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		boundsMin[i] = boundsMax[i] = numVertices > 0 && vertices != 0 ? vertices[i] : 0.0f;
+	}
+
+	for (unsigned int v = 1; vertices != 0 && v < numVertices; v++)
+	{
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			const float value = vertices[v * 3 + i];
+			boundsMin[i] = value < boundsMin[i] ? value : boundsMin[i];
+			boundsMax[i] = value > boundsMax[i] ? value : boundsMax[i];
+		}
+	}
+}
+
+void Engine::Mesh::setVertexFormat(const Engine::VertexFormat & newFormat)
+{
+	format = newFormat;
+}
+
+const Engine::VertexFormat & Engine::Mesh::getVertexFormat() const
+{
+	return format;
+}
+
+unsigned int Engine::Mesh::getIndexType() const
+{
+	return indexType;
+}
+
+void Engine::Mesh::getAttributeData(const float * data[Engine::VERTEX_ATTRIB_COUNT]) const
+{
+	data[VERTEX_ATTRIB_POSITION] = vertices;
+	data[VERTEX_ATTRIB_NORMAL] = normals;
+	data[VERTEX_ATTRIB_COLOR] = colors;
+	data[VERTEX_ATTRIB_EMISSION] = emission;
+	data[VERTEX_ATTRIB_UV] = uvs;
+	data[VERTEX_ATTRIB_TANGENT] = tangents;
+}
+
+unsigned int Engine::Mesh::getAttributeBuffer(Engine::VertexAttribute attribute) const
+{
+	switch (attribute)
+	{
+	case VERTEX_ATTRIB_POSITION:
+		return vboVertices;
+	case VERTEX_ATTRIB_NORMAL:
+		return vboNormals;
+	case VERTEX_ATTRIB_COLOR:
+		return vboColors;
+	case VERTEX_ATTRIB_EMISSION:
+		return vboEmission;
+	case VERTEX_ATTRIB_UV:
+		return vboUVs;
+	case VERTEX_ATTRIB_TANGENT:
+	default:
+		return vboTangents;
+	}
+}
+
+void Engine::Mesh::syncGPU(const unsigned char * packedVertices)
 {
 	glGenVertexArrays(1, &vao);
 	glBindVertexArray(vao);
@@ -386,51 +830,89 @@ void Engine::Mesh::syncGPU()
 	unsigned int numFaces = getNumFaces();
 	unsigned int numVertex = getNumVertices();
 
-	glGenBuffers(1, &vboVertices);
-	glBindBuffer(GL_ARRAY_BUFFER, vboVertices);
-	glBufferData(GL_ARRAY_BUFFER, numVertex * sizeof(float) * 3, getVertices(), GL_STATIC_DRAW);
+	const float * data[VERTEX_ATTRIB_COUNT];
+	getAttributeData(data);
+	format.computeLayout(data);
 
-	if (colors != 0)
+	if (format.isInterleaved())
 	{
-		glGenBuffers(1, &vboColors);
-		glBindBuffer(GL_ARRAY_BUFFER, vboColors);
-		glBufferData(GL_ARRAY_BUFFER, numVertex * sizeof(float) * 3, colors, GL_STATIC_DRAW);
-	}
+		// All attributes on a single buffer
+		const size_t bufferSize = size_t(numVertex) * format.getVertexSize();
+		std::vector<unsigned char> packed;
+		if (packedVertices == 0)
+		{
+			packed.resize(bufferSize);
+			format.packInterleaved(data, numVertex, packed.data());
+			packedVertices = packed.data();
+		}
 
-	if (normals != 0)
-	{
-		glGenBuffers(1, &vboNormals);
-		glBindBuffer(GL_ARRAY_BUFFER, vboNormals);
-		glBufferData(GL_ARRAY_BUFFER, numVertex * sizeof(float) * 3, normals, GL_STATIC_DRAW);
+		glGenBuffers(1, &vboInterleaved);
+		glBindBuffer(GL_ARRAY_BUFFER, vboInterleaved);
+		glBufferData(GL_ARRAY_BUFFER, bufferSize, packedVertices, GL_STATIC_DRAW);
 	}
-
-	if (uvs != 0)
+	else
 	{
-		glGenBuffers(1, &vboUVs);
-		glBindBuffer(GL_ARRAY_BUFFER, vboUVs);
-		glBufferData(GL_ARRAY_BUFFER, numVertex * sizeof(float) * 2, uvs, GL_STATIC_DRAW);
+		// One buffer per attribute
+		unsigned int * buffers[VERTEX_ATTRIB_COUNT] = { &vboVertices, &vboNormals, &vboColors, &vboEmission, &vboUVs, &vboTangents };
+		std::vector<unsigned char> packed;
+		for (unsigned int i = 0; i < VERTEX_ATTRIB_COUNT; i++)
+		{
+			if (data[i] == 0)
+			{
+				continue;
+			}
+
+			VertexAttribute attribute = VertexAttribute(i);
+			const size_t bufferSize = size_t(numVertex) * format.getAttribute(attribute).stride;
+
+			glGenBuffers(1, buffers[i]);
+			glBindBuffer(GL_ARRAY_BUFFER, *buffers[i]);
+
+			if (format.getAttribute(attribute).type == VERTEX_TYPE_FLOAT32)
+			{
+				glBufferData(GL_ARRAY_BUFFER, bufferSize, data[i], GL_STATIC_DRAW);
+			}
+			else
+			{
+				packed.resize(bufferSize);
+				format.packAttribute(attribute, data[i], numVertex, packed.data());
+				glBufferData(GL_ARRAY_BUFFER, bufferSize, packed.data(), GL_STATIC_DRAW);
+			}
+		}
 	}
 
-	if (tangents != 0)
+	if (faces != 0)
 	{
-		glGenBuffers(1, &vboTangents);
-		glBindBuffer(GL_ARRAY_BUFFER, vboTangents);
-		glBufferData(GL_ARRAY_BUFFER, numVertex * sizeof(float) * 3, tangents, GL_STATIC_DRAW);
-	}
+		glGenBuffers(1, &vboFaces);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboFaces);
 
-	if (emission != 0)
-	{
-		glGenBuffers(1, &vboEmission);
-		glBindBuffer(GL_ARRAY_BUFFER, vboEmission);
-		glBufferData(GL_ARRAY_BUFFER, numVertex * sizeof(float) * 3, emission, GL_STATIC_DRAW);
+		const size_t numIndices = size_t(numFaces) * 3;
+		if (numVertex <= 0xffff)
+		{
+			// Every vertex can be addressed with 16 bits, halve the index buffer
+			std::vector<unsigned short> shortFaces(faces, faces + numIndices);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned short), shortFaces.data(), GL_STATIC_DRAW);
+			indexType = GL_UNSIGNED_SHORT;
+		}
+		else
+		{
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned int), faces, GL_STATIC_DRAW);
+			indexType = GL_UNSIGNED_INT;
+		}
 	}
+}
 
-	if (faces != 0)
+void Engine::Mesh::bindAttribute(Engine::VertexAttribute attribute, unsigned int location) const
+{
+	const VertexAttributeFormat & attributeFormat = format.getAttribute(attribute);
+	if (!attributeFormat.present)
 	{
-		glGenBuffers(1, &vboFaces);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboFaces);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, numFaces * sizeof(unsigned int) * 3, faces, GL_STATIC_DRAW);
+		return;
 	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, format.isInterleaved() ? vboInterleaved : getAttributeBuffer(attribute));
+	glVertexAttribPointer(location, attributeFormat.gpuComponents, format.getGLType(attribute), format.isNormalized(attribute) ? GL_TRUE : GL_FALSE, attributeFormat.stride, (void*)size_t(attributeFormat.offset));
+	glEnableVertexAttribArray(location);
 }
 
 void Engine::Mesh::releaseCPU()
@@ -515,6 +997,11 @@ void Engine::Mesh::releaseGPU()
 		glDeleteBuffers(1, &vboEmission);
 	}
 
+	if (vboInterleaved != -1)
+	{
+		glDeleteBuffers(1, &vboInterleaved);
+	}
+
 	if (vao != -1)
 	{
 		glDeleteVertexArrays(1, &vao);
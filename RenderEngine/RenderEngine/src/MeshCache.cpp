@@ -0,0 +1,268 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#include "MeshCache.h"
+
+#include "util/IOUtils.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	// "REMC" (render engine mesh cache)
+	const unsigned int MAGIC = 0x434d4552;
+
+	static_assert(sizeof(Engine::MeshCache::Header) == 80, "Mesh cache header layout must not depend on the compiler");
+
+	const unsigned int ATTRIBUTE_COMPONENTS[Engine::VERTEX_ATTRIB_COUNT] = { 3, 3, 3, 3, 2, 3 };
+
+	void getAttributeData(const Engine::Mesh & mesh, const float * data[Engine::VERTEX_ATTRIB_COUNT])
+	{
+		data[Engine::VERTEX_ATTRIB_POSITION] = mesh.getVertices();
+		data[Engine::VERTEX_ATTRIB_NORMAL] = mesh.getNormals();
+		data[Engine::VERTEX_ATTRIB_COLOR] = mesh.getColor();
+		data[Engine::VERTEX_ATTRIB_EMISSION] = mesh.getEmissive();
+		data[Engine::VERTEX_ATTRIB_UV] = mesh.getUVs();
+		data[Engine::VERTEX_ATTRIB_TANGENT] = mesh.getTangetns();
+	}
+
+	// Validates the mapped cache file and builds the CPU mesh out of it. Returns null if the file is not valid.
+	// packedVertices points to the packed vertex buffer within the mapping (null if there is none)
+	Engine::Mesh * parseMesh(const Engine::IO::MappedFile & file, unsigned long long paramHash, Engine::MeshCache::Header & header, const unsigned char *& packedVertices)
+	{
+		using namespace Engine;
+
+		if (file.getSize() < sizeof(MeshCache::Header))
+		{
+			return 0;
+		}
+
+		memcpy(&header, file.getData(), sizeof(MeshCache::Header));
+		if (header.magic != MAGIC || header.version != MeshCache::VERSION || header.paramHash != paramHash || (header.attributeMask & (1u << VERTEX_ATTRIB_POSITION)) == 0)
+		{
+			return 0;
+		}
+
+		const float * data[VERTEX_ATTRIB_COUNT];
+		VertexFormat format(header.interleaved != 0);
+		unsigned long long expectedSize = (unsigned long long)header.numFaces * 3 * sizeof(unsigned int);
+		for (unsigned int a = 0; a < VERTEX_ATTRIB_COUNT; a++)
+		{
+			// Non null marks the attribute as present for computeLayout. The actual pointers are set
+			// once the file size is known to be right
+			data[a] = 0;
+			if (header.attributeMask & (1u << a))
+			{
+				data[a] = (const float *)file.getData();
+				expectedSize += (unsigned long long)header.numVertices * ATTRIBUTE_COMPONENTS[a] * sizeof(float);
+
+				if (header.attributeTypes[a] > VERTEX_TYPE_HALF16)
+				{
+					return 0;
+				}
+				else if (header.attributeTypes[a] != VERTEX_TYPE_FLOAT32)
+				{
+					format.setAttributeType((VertexAttribute)a, (VertexAttributeType)header.attributeTypes[a]);
+				}
+			}
+		}
+
+		// The packed buffer is only valid if the vertex format still has the same layout
+		format.computeLayout(data);
+		if (header.interleaved != 0 && header.vertexSize != format.getVertexSize())
+		{
+			return 0;
+		}
+		expectedSize += (unsigned long long)header.numVertices * header.vertexSize;
+
+		if (expectedSize != header.dataSize || expectedSize != file.getSize() - sizeof(MeshCache::Header))
+		{
+			return 0;
+		}
+
+		// The header keeps the streams 4 byte aligned within the mapping
+		const unsigned char * cursor = file.getData() + sizeof(MeshCache::Header);
+		const unsigned int * faces = (const unsigned int *)cursor;
+		cursor += size_t(header.numFaces) * 3 * sizeof(unsigned int);
+
+		for (unsigned int a = 0; a < VERTEX_ATTRIB_COUNT; a++)
+		{
+			if (data[a] != 0)
+			{
+				data[a] = (const float *)cursor;
+				cursor += size_t(header.numVertices) * ATTRIBUTE_COMPONENTS[a] * sizeof(float);
+			}
+		}
+
+		packedVertices = header.vertexSize > 0 ? cursor : 0;
+
+		Mesh * mesh = new Mesh(header.numFaces, header.numVertices, faces, data[VERTEX_ATTRIB_POSITION], data[VERTEX_ATTRIB_COLOR], data[VERTEX_ATTRIB_NORMAL],
+			data[VERTEX_ATTRIB_UV], data[VERTEX_ATTRIB_TANGENT], data[VERTEX_ATTRIB_EMISSION], false);
+		mesh->setVertexFormat(format);
+
+		return mesh;
+	}
+}
+
+unsigned long long Engine::MeshCache::hash(const void * data, size_t size, unsigned long long seed)
+{
+	const unsigned char * bytes = (const unsigned char *)data;
+	unsigned long long h = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		h ^= bytes[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+unsigned long long Engine::MeshCache::hashMesh(const Engine::Mesh & mesh, unsigned long long seed)
+{
+	const unsigned int sizes[] = { mesh.getNumFaces(), mesh.getNumVertices(), mesh.getNumVerticesPerFace() };
+	unsigned long long h = hash(sizes, sizeof(sizes), seed);
+	if (mesh.getFaces() != 0)
+	{
+		h = hash(mesh.getFaces(), size_t(mesh.getNumFaces()) * mesh.getNumVerticesPerFace() * sizeof(unsigned int), h);
+	}
+
+	const float * streams[] = { mesh.getVertices(), mesh.getNormals(), mesh.getColor(), mesh.getEmissive(), mesh.getUVs(), mesh.getTangetns() };
+	const unsigned int components[] = { 3, 3, 3, 3, 2, 3 };
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		// Missing streams are hashed as a marker, so they can not be confused with the next one
+		const unsigned char present = streams[i] != 0 ? 1 : 0;
+		h = hash(&present, sizeof(present), h);
+		if (present)
+		{
+			h = hash(streams[i], size_t(mesh.getNumVertices()) * components[i] * sizeof(float), h);
+		}
+	}
+
+	return h;
+}
+
+bool Engine::MeshCache::writeMesh(const std::string & fileName, const Engine::Mesh & mesh, unsigned long long paramHash)
+{
+	if (mesh.getFaces() == 0 || mesh.getVertices() == 0 || mesh.getNumVerticesPerFace() != 3)
+	{
+		return false;
+	}
+
+	const float * data[VERTEX_ATTRIB_COUNT];
+	getAttributeData(mesh, data);
+
+	Header header;
+	memset(&header, 0, sizeof(Header));
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.paramHash = paramHash;
+	header.numFaces = mesh.getNumFaces();
+	header.numVertices = mesh.getNumVertices();
+	header.interleaved = mesh.getVertexFormat().isInterleaved() ? 1 : 0;
+	header.dataSize = (unsigned long long)header.numFaces * 3 * sizeof(unsigned int);
+
+	// Interleaved meshes are stored already packed, which saves converting every vertex when loading
+	std::vector<unsigned char> packed;
+	if (header.interleaved != 0)
+	{
+		VertexFormat format = mesh.getVertexFormat();
+		format.computeLayout(data);
+		header.vertexSize = format.getVertexSize();
+		packed.resize(size_t(header.numVertices) * header.vertexSize);
+		format.packInterleaved(data, header.numVertices, packed.data());
+		header.dataSize += packed.size();
+	}
+
+	for (unsigned int a = 0; a < VERTEX_ATTRIB_COUNT; a++)
+	{
+		if (data[a] != 0)
+		{
+			header.attributeMask |= 1u << a;
+			header.attributeTypes[a] = (unsigned char)mesh.getVertexFormat().getAttribute((VertexAttribute)a).type;
+			header.dataSize += (unsigned long long)header.numVertices * ATTRIBUTE_COMPONENTS[a] * sizeof(float);
+		}
+	}
+
+	mesh.computeBounds(header.boundsMin, header.boundsMax);
+
+	// Write to a temporary file and move it into place, so a crash never leaves a truncated cache file behind
+	const std::string tempFileName = fileName + ".tmp";
+	std::ofstream file(tempFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		return false;
+	}
+
+	file.write((const char *)&header, sizeof(Header));
+	file.write((const char *)mesh.getFaces(), std::streamsize(header.numFaces) * 3 * sizeof(unsigned int));
+	for (unsigned int a = 0; a < VERTEX_ATTRIB_COUNT; a++)
+	{
+		if (data[a] != 0)
+		{
+			file.write((const char *)data[a], std::streamsize(header.numVertices) * ATTRIBUTE_COMPONENTS[a] * sizeof(float));
+		}
+	}
+	file.write((const char *)packed.data(), std::streamsize(packed.size()));
+	file.close();
+
+	if (!file)
+	{
+		std::remove(tempFileName.c_str());
+		return false;
+	}
+
+	std::remove(fileName.c_str());
+	if (std::rename(tempFileName.c_str(), fileName.c_str()) != 0)
+	{
+		std::remove(tempFileName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool Engine::MeshCache::readMesh(const std::string & fileName, unsigned long long paramHash, Engine::MeshCache::Entry & entry)
+{
+	Engine::IO::MappedFile file;
+	if (!file.open(fileName.c_str()))
+	{
+		return false;
+	}
+
+	Header header;
+	const unsigned char * packedVertices = 0;
+	entry.mesh = parseMesh(file, paramHash, header, packedVertices);
+	if (entry.mesh == 0)
+	{
+		return false;
+	}
+
+	entry.packedVertices.assign(packedVertices, packedVertices + size_t(header.numVertices) * header.vertexSize);
+	memcpy(entry.boundsMin, header.boundsMin, 3 * sizeof(float));
+	memcpy(entry.boundsMax, header.boundsMax, 3 * sizeof(float));
+
+	return true;
+}
+
+Engine::Mesh * Engine::MeshCache::loadMesh(const std::string & fileName, unsigned long long paramHash)
+{
+	Engine::IO::MappedFile file;
+	if (!file.open(fileName.c_str()))
+	{
+		return 0;
+	}
+
+	Header header;
+	const unsigned char * packedVertices = 0;
+	Engine::Mesh * mesh = parseMesh(file, paramHash, header, packedVertices);
+	if (mesh != 0)
+	{
+		mesh->syncGPU(packedVertices);
+	}
+
+	return mesh;
+}
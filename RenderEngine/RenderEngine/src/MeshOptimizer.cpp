@@ -0,0 +1,367 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#include "MeshOptimizer.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// FIFO post-transform cache simulation. A vertex stays in the cache until cacheSize other vertices
+	// have been transformed after it
+	class VertexCacheSimulator
+	{
+	private:
+		std::vector<unsigned int> cacheTime;
+		unsigned int cacheSize;
+		unsigned int time;
+	public:
+		VertexCacheSimulator(size_t numVertices, unsigned int cacheSize)
+			:cacheTime(numVertices, 0), cacheSize(cacheSize), time(cacheSize + 1)
+		{
+		}
+
+		// Returns the number of vertices of the face which had to be transformed
+		unsigned int processFace(const unsigned int * face)
+		{
+			unsigned int misses = 0;
+			for (unsigned int i = 0; i < 3; i++)
+			{
+				if (time - cacheTime[face[i]] > cacheSize)
+				{
+					cacheTime[face[i]] = time++;
+					misses++;
+				}
+			}
+			return misses;
+		}
+
+		// Empties the cache
+		void flush()
+		{
+			time += cacheSize + 1;
+		}
+	};
+}
+
+Engine::MeshOptimizer::VertexCacheStatistics Engine::MeshOptimizer::analyzeVertexCache(const unsigned int * indices, size_t numIndices, size_t numVertices, unsigned int cacheSize)
+{
+	VertexCacheSimulator cache(numVertices, cacheSize);
+	std::vector<bool> referenced(numVertices, false);
+
+	unsigned int misses = 0;
+	unsigned int numReferenced = 0;
+	for (size_t i = 0; i + 2 < numIndices; i += 3)
+	{
+		misses += cache.processFace(indices + i);
+		for (unsigned int j = 0; j < 3; j++)
+		{
+			if (!referenced[indices[i + j]])
+			{
+				referenced[indices[i + j]] = true;
+				numReferenced++;
+			}
+		}
+	}
+
+	VertexCacheStatistics stats;
+	stats.verticesTransformed = misses;
+	stats.acmr = numIndices >= 3 ? float(misses) / float(numIndices / 3) : 0.0f;
+	stats.atvr = numReferenced > 0 ? float(misses) / float(numReferenced) : 0.0f;
+	return stats;
+}
+
+void Engine::MeshOptimizer::buildVertexAdjacency(VertexAdjacency & adjacency, const unsigned int * indices, size_t numIndices, size_t numVertices)
+{
+	const size_t numCorners = numIndices - numIndices % 3;
+	adjacency.start.assign(numVertices + 1, 0);
+	for (size_t i = 0; i < numCorners; i++)
+	{
+		adjacency.start[indices[i] + 1]++;
+	}
+
+	for (size_t v = 0; v < numVertices; v++)
+	{
+		adjacency.start[v + 1] += adjacency.start[v];
+	}
+
+	adjacency.corners.resize(numCorners);
+	std::vector<unsigned int> cursor(adjacency.start.begin(), adjacency.start.end() - 1);
+	for (size_t i = 0; i < numCorners; i++)
+	{
+		adjacency.corners[cursor[indices[i]]++] = (unsigned int)i;
+	}
+}
+
+void Engine::MeshOptimizer::optimizeVertexCache(unsigned int * indices, size_t numIndices, size_t numVertices, unsigned int cacheSize)
+{
+	const size_t numFaces = numIndices / 3;
+	if (numFaces == 0)
+	{
+		return;
+	}
+
+	// Vertex to face adjacency and live (not yet emitted) faces per vertex
+	VertexAdjacency adjacency;
+	buildVertexAdjacency(adjacency, indices, numFaces * 3, numVertices);
+	std::vector<unsigned int> liveFaces(numVertices);
+	for (size_t v = 0; v < numVertices; v++)
+	{
+		liveFaces[v] = adjacency.start[v + 1] - adjacency.start[v];
+	}
+
+	std::vector<unsigned int> cacheTime(numVertices, 0);
+	unsigned int time = cacheSize + 1;
+
+	std::vector<bool> emitted(numFaces, false);
+	std::vector<unsigned int> deadEnd;
+	deadEnd.reserve(numFaces * 3);
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(numFaces * 3);
+
+	size_t inputCursor = 0;
+	long long fanning = indices[0];
+
+	while (fanning >= 0)
+	{
+		// Emit all the remaining faces around the fanning vertex
+		candidates.clear();
+		const unsigned int fanningVertex = (unsigned int)fanning;
+		for (unsigned int a = adjacency.start[fanningVertex]; a < adjacency.start[fanningVertex + 1]; a++)
+		{
+			const unsigned int face = adjacency.corners[a] / 3;
+			if (emitted[face])
+			{
+				continue;
+			}
+
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				const unsigned int v = indices[face * 3 + k];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveFaces[v]--;
+
+				if (time - cacheTime[v] > cacheSize)
+				{
+					cacheTime[v] = time++;
+				}
+			}
+
+			emitted[face] = true;
+		}
+
+		// Next fanning vertex: the one among the just used which will still be in the cache
+		// after emitting its faces and has been there the longest
+		fanning = -1;
+		long long bestPriority = -1;
+		for (auto v : candidates)
+		{
+			if (liveFaces[v] == 0)
+			{
+				continue;
+			}
+
+			long long priority = 0;
+			if (time - cacheTime[v] + 2 * liveFaces[v] <= cacheSize)
+			{
+				priority = time - cacheTime[v];
+			}
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				fanning = v;
+			}
+		}
+
+		// Dead end: go back to recently used vertices, or to the next vertex in input order
+		while (fanning < 0 && !deadEnd.empty())
+		{
+			const unsigned int v = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveFaces[v] > 0)
+			{
+				fanning = v;
+			}
+		}
+
+		while (fanning < 0 && inputCursor < numVertices)
+		{
+			if (liveFaces[inputCursor] > 0)
+			{
+				fanning = (long long)inputCursor;
+			}
+			inputCursor++;
+		}
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void Engine::MeshOptimizer::optimizeOverdraw(unsigned int * indices, size_t numIndices, const float * positions, size_t numVertices, float threshold, unsigned int cacheSize)
+{
+	const size_t numFaces = numIndices / 3;
+	if (numFaces == 0)
+	{
+		return;
+	}
+
+	VertexCacheSimulator cache(numVertices, cacheSize);
+
+	// Hard boundaries: faces where the whole cache is missed (jumps of the cache optimization)
+	std::vector<size_t> hardClusters;
+	for (size_t f = 0; f < numFaces; f++)
+	{
+		if (cache.processFace(indices + f * 3) == 3 || f == 0)
+		{
+			hardClusters.push_back(f);
+		}
+	}
+	hardClusters.push_back(numFaces);
+
+	// Soft boundaries: split the hard clusters wherever the part processed so far, starting with an empty
+	// cache, is already as efficient as the whole cluster (within the threshold)
+	std::vector<size_t> clusters;
+	for (size_t c = 0; c + 1 < hardClusters.size(); c++)
+	{
+		const size_t start = hardClusters[c];
+		const size_t end = hardClusters[c + 1];
+
+		cache.flush();
+		unsigned int clusterMisses = 0;
+		for (size_t f = start; f < end; f++)
+		{
+			clusterMisses += cache.processFace(indices + f * 3);
+		}
+		const float clusterThreshold = threshold * float(clusterMisses) / float(end - start);
+
+		cache.flush();
+		clusters.push_back(start);
+		size_t runStart = start;
+		unsigned int runMisses = 0;
+		for (size_t f = start; f < end; f++)
+		{
+			runMisses += cache.processFace(indices + f * 3);
+			if (f + 1 < end && float(runMisses) <= clusterThreshold * float(f + 1 - runStart))
+			{
+				clusters.push_back(f + 1);
+				runStart = f + 1;
+				runMisses = 0;
+				cache.flush();
+			}
+		}
+	}
+	clusters.push_back(numFaces);
+
+	// Area weighted centroid and normal of each cluster
+	const size_t numClusters = clusters.size() - 1;
+	std::vector<float> clusterData(numClusters * 7, 0.0f);
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < numClusters; c++)
+	{
+		float * data = &clusterData[c * 7];
+		for (size_t f = clusters[c]; f < clusters[c + 1]; f++)
+		{
+			const float * p0 = positions + size_t(indices[f * 3]) * 3;
+			const float * p1 = positions + size_t(indices[f * 3 + 1]) * 3;
+			const float * p2 = positions + size_t(indices[f * 3 + 2]) * 3;
+
+			const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			const float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			for (unsigned int i = 0; i < 3; i++)
+			{
+				data[i] += (p0[i] + p1[i] + p2[i]) / 3.0f * area;
+				data[3 + i] += n[i];
+			}
+			data[6] += area;
+		}
+
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			meshCentroid[i] += data[i];
+		}
+		meshArea += data[6];
+	}
+
+	if (meshArea <= 0.0f)
+	{
+		return;
+	}
+
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		meshCentroid[i] /= meshArea;
+	}
+
+	// Clusters whose normal points away from the mesh center are more likely to occlude the others
+	std::vector<float> sortKey(numClusters, 0.0f);
+	for (size_t c = 0; c < numClusters; c++)
+	{
+		const float * data = &clusterData[c * 7];
+		const float normalLength = sqrtf(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+		if (data[6] <= 0.0f || normalLength <= 0.0f)
+		{
+			continue;
+		}
+
+		float key = 0.0f;
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			key += (data[i] / data[6] - meshCentroid[i]) * data[3 + i];
+		}
+		sortKey[c] = key / normalLength;
+	}
+
+	std::vector<size_t> order(numClusters);
+	for (size_t c = 0; c < numClusters; c++)
+	{
+		order[c] = c;
+	}
+	std::stable_sort(order.begin(), order.end(), [&sortKey](size_t a, size_t b)
+	{
+		return sortKey[a] > sortKey[b];
+	});
+
+	std::vector<unsigned int> output;
+	output.reserve(numFaces * 3);
+	for (auto c : order)
+	{
+		output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void Engine::MeshOptimizer::computeVertexFetchRemap(unsigned int * remap, const unsigned int * indices, size_t numIndices, size_t numVertices)
+{
+	const unsigned int unused = ~0u;
+	std::fill(remap, remap + numVertices, unused);
+
+	unsigned int next = 0;
+	for (size_t i = 0; i < numIndices; i++)
+	{
+		if (remap[indices[i]] == unused)
+		{
+			remap[indices[i]] = next++;
+		}
+	}
+
+	for (size_t v = 0; v < numVertices; v++)
+	{
+		if (remap[v] == unused)
+		{
+			remap[v] = next++;
+		}
+	}
+}
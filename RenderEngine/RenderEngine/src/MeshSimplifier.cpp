@@ -0,0 +1,363 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#include "MeshSimplifier.h"
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+
+namespace
+{
+	// Boundary edges are kept in place by a plane perpendicular to their face, weighted by this factor
+	const double BOUNDARY_WEIGHT = 10.0;
+	// Collapses may not rotate a face normal beyond ~75 degrees (flips and slivers)
+	const double MIN_NORMAL_COSINE = 0.25;
+
+	// Symmetric 4x4 matrix of the sum of squared distances to a set of planes, plus the total weight
+	struct Quadric
+	{
+		double a00, a01, a02, a03;
+		double a11, a12, a13;
+		double a22, a23;
+		double a33;
+		double weight;
+
+		Quadric()
+			:a00(0), a01(0), a02(0), a03(0), a11(0), a12(0), a13(0), a22(0), a23(0), a33(0), weight(0)
+		{
+		}
+
+		// Adds the plane n . p + d = 0 (n unit length) with the given weight
+		void addPlane(const double n[3], double d, double w)
+		{
+			a00 += w * n[0] * n[0]; a01 += w * n[0] * n[1]; a02 += w * n[0] * n[2]; a03 += w * n[0] * d;
+			a11 += w * n[1] * n[1]; a12 += w * n[1] * n[2]; a13 += w * n[1] * d;
+			a22 += w * n[2] * n[2]; a23 += w * n[2] * d;
+			a33 += w * d * d;
+			weight += w;
+		}
+
+		void add(const Quadric & q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+			a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23;
+			a33 += q.a33;
+			weight += q.weight;
+		}
+
+		// Weighted sum of squared distances from p to the planes
+		double evaluate(const float * p) const
+		{
+			const double x = p[0], y = p[1], z = p[2];
+			const double result = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+				+ a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+				+ a22 * z * z + 2.0 * a23 * z
+				+ a33;
+			return result < 0.0 ? 0.0 : result;
+		}
+	};
+
+	void triangleNormal(const float * p0, const float * p1, const float * p2, double n[3])
+	{
+		const double e1[3] = { double(p1[0]) - p0[0], double(p1[1]) - p0[1], double(p1[2]) - p0[2] };
+		const double e2[3] = { double(p2[0]) - p0[0], double(p2[1]) - p0[1], double(p2[2]) - p0[2] };
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	}
+
+	double length(const double v[3])
+	{
+		return sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	}
+
+	unsigned long long edgeKey(unsigned int a, unsigned int b)
+	{
+		return a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+	}
+
+	void computeQuadrics(std::vector<Quadric> & quadrics, const unsigned int * indices, size_t numIndices, const float * positions)
+	{
+		std::unordered_map<unsigned long long, unsigned int> edgeFaces;
+		edgeFaces.reserve(numIndices);
+		for (size_t i = 0; i < numIndices; i += 3)
+		{
+			for (unsigned int e = 0; e < 3; e++)
+			{
+				edgeFaces[edgeKey(indices[i + e], indices[i + (e + 1) % 3])]++;
+			}
+		}
+
+		for (size_t i = 0; i < numIndices; i += 3)
+		{
+			const float * p[3] = { positions + size_t(indices[i]) * 3, positions + size_t(indices[i + 1]) * 3, positions + size_t(indices[i + 2]) * 3 };
+
+			double n[3];
+			triangleNormal(p[0], p[1], p[2], n);
+			const double doubleArea = length(n);
+			if (doubleArea == 0.0)
+			{
+				continue;
+			}
+
+			n[0] /= doubleArea; n[1] /= doubleArea; n[2] /= doubleArea;
+			const double d = -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]);
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				quadrics[indices[i + k]].addPlane(n, d, doubleArea * 0.5);
+			}
+
+			// Open borders would otherwise collapse freely along the face plane
+			for (unsigned int e = 0; e < 3; e++)
+			{
+				const unsigned int a = indices[i + e];
+				const unsigned int b = indices[i + (e + 1) % 3];
+				if (edgeFaces[edgeKey(a, b)] != 1)
+				{
+					continue;
+				}
+
+				const double edge[3] = { double(p[(e + 1) % 3][0]) - p[e][0], double(p[(e + 1) % 3][1]) - p[e][1], double(p[(e + 1) % 3][2]) - p[e][2] };
+				double bn[3] = { edge[1] * n[2] - edge[2] * n[1], edge[2] * n[0] - edge[0] * n[2], edge[0] * n[1] - edge[1] * n[0] };
+				const double edgeLength = length(bn);
+				if (edgeLength == 0.0)
+				{
+					continue;
+				}
+
+				bn[0] /= edgeLength; bn[1] /= edgeLength; bn[2] /= edgeLength;
+				const double bd = -(bn[0] * p[e][0] + bn[1] * p[e][1] + bn[2] * p[e][2]);
+				quadrics[a].addPlane(bn, bd, edgeLength * edgeLength * BOUNDARY_WEIGHT);
+				quadrics[b].addPlane(bn, bd, edgeLength * edgeLength * BOUNDARY_WEIGHT);
+			}
+		}
+	}
+
+	// Mean squared distance moved when collapsing a vertex with quadric qa onto the vertex at p with quadric qb
+	double collapseCost(const Quadric & qa, const Quadric & qb, const float * p)
+	{
+		Quadric q = qa;
+		q.add(qb);
+		return q.weight > 0.0 ? q.evaluate(p) / q.weight : 0.0;
+	}
+
+	// Whether moving vertex from onto vertex to keeps the orientation of the triangles around from
+	bool preservesOrientation(unsigned int from, unsigned int to, const unsigned int * triangles, size_t numTriangles, const unsigned int * indices, const float * positions)
+	{
+		for (size_t t = 0; t < numTriangles; t++)
+		{
+			const unsigned int * tri = indices + size_t(triangles[t]) * 3;
+			if (tri[0] == to || tri[1] == to || tri[2] == to)
+			{
+				// Becomes degenerate and is removed
+				continue;
+			}
+
+			const float * before[3];
+			const float * after[3];
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				before[k] = positions + size_t(tri[k]) * 3;
+				after[k] = tri[k] == from ? positions + size_t(to) * 3 : before[k];
+			}
+
+			double n0[3], n1[3];
+			triangleNormal(before[0], before[1], before[2], n0);
+			triangleNormal(after[0], after[1], after[2], n1);
+
+			const double l0 = length(n0);
+			const double l1 = length(n1);
+			if (l0 == 0.0)
+			{
+				continue;
+			}
+
+			if (l1 == 0.0 || n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] < MIN_NORMAL_COSINE * l0 * l1)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+size_t Engine::MeshSimplifier::simplify(unsigned int * destination, const unsigned int * indices, size_t numIndices, const float * positions, size_t numVertices,
+	size_t targetIndexCount, float targetError, float * resultError)
+{
+	numIndices -= numIndices % 3;
+	std::copy(indices, indices + numIndices, destination);
+
+	if (resultError != 0)
+	{
+		*resultError = 0.0f;
+	}
+
+	if (numIndices <= targetIndexCount || numVertices == 0)
+	{
+		return numIndices;
+	}
+
+	float boundsMin[3] = { positions[0], positions[1], positions[2] };
+	float boundsMax[3] = { positions[0], positions[1], positions[2] };
+	for (size_t v = 1; v < numVertices; v++)
+	{
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			boundsMin[i] = std::min(boundsMin[i], positions[v * 3 + i]);
+			boundsMax[i] = std::max(boundsMax[i], positions[v * 3 + i]);
+		}
+	}
+
+	const double extent = std::max(std::max(boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1]), boundsMax[2] - boundsMin[2]);
+	if (extent <= 0.0)
+	{
+		return numIndices;
+	}
+
+	// Costs are mean squared distances
+	const double maxCost = double(targetError) * extent * double(targetError) * extent;
+	double currentCost = 0.0;
+
+	std::vector<Quadric> quadrics(numVertices);
+	computeQuadrics(quadrics, destination, numIndices, positions);
+
+	std::vector<unsigned int> triangleStart(numVertices + 1);
+	std::vector<unsigned int> triangleCursor(numVertices);
+	std::vector<unsigned int> vertexTriangles(numIndices);
+	std::vector<unsigned int> bestTarget(numVertices);
+	std::vector<double> bestCost(numVertices);
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> remap(numVertices);
+	std::vector<bool> locked(numVertices);
+
+	// Every pass collapses the cheapest edges not touching each other, then the index buffer is rebuilt
+	while (numIndices > targetIndexCount)
+	{
+		const size_t numTriangles = numIndices / 3;
+
+		// Vertex to triangle adjacency
+		std::fill(triangleStart.begin(), triangleStart.end(), 0);
+		for (size_t i = 0; i < numIndices; i++)
+		{
+			triangleStart[destination[i] + 1]++;
+		}
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			triangleStart[v + 1] += triangleStart[v];
+		}
+		std::copy(triangleStart.begin(), triangleStart.end() - 1, triangleCursor.begin());
+		for (size_t i = 0; i < numIndices; i++)
+		{
+			vertexTriangles[triangleCursor[destination[i]]++] = (unsigned int)(i / 3);
+		}
+
+		// Best collapse of every vertex along its edges
+		std::fill(bestTarget.begin(), bestTarget.end(), ~0u);
+		for (size_t i = 0; i < numIndices; i++)
+		{
+			const unsigned int from = destination[i];
+			const size_t triangleBase = i - i % 3;
+			for (unsigned int k = 1; k < 3; k++)
+			{
+				const unsigned int to = destination[triangleBase + (i % 3 + k) % 3];
+				const double cost = collapseCost(quadrics[from], quadrics[to], positions + size_t(to) * 3);
+				if (bestTarget[from] == ~0u || cost < bestCost[from])
+				{
+					bestTarget[from] = to;
+					bestCost[from] = cost;
+				}
+			}
+		}
+
+		candidates.clear();
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			if (bestTarget[v] != ~0u && bestCost[v] <= maxCost)
+			{
+				candidates.push_back((unsigned int)v);
+			}
+		}
+		std::sort(candidates.begin(), candidates.end(), [&bestCost](unsigned int a, unsigned int b)
+		{
+			return bestCost[a] < bestCost[b];
+		});
+
+		for (size_t v = 0; v < numVertices; v++)
+		{
+			remap[v] = (unsigned int)v;
+		}
+		std::fill(locked.begin(), locked.end(), false);
+
+		// Triangles around an unlocked vertex have not been modified during the pass, as every
+		// collapse locks all the vertices of the triangles around the collapsed vertex
+		size_t removedTriangles = 0;
+		size_t collapses = 0;
+		for (auto from : candidates)
+		{
+			const unsigned int to = bestTarget[from];
+			if (locked[from] || locked[to])
+			{
+				continue;
+			}
+
+			const unsigned int * triangles = &vertexTriangles[triangleStart[from]];
+			const size_t vertexNumTriangles = triangleStart[from + 1] - triangleStart[from];
+			if (!preservesOrientation(from, to, triangles, vertexNumTriangles, destination, positions))
+			{
+				continue;
+			}
+
+			remap[from] = to;
+			quadrics[to].add(quadrics[from]);
+			currentCost = std::max(currentCost, bestCost[from]);
+			collapses++;
+
+			for (size_t t = 0; t < vertexNumTriangles; t++)
+			{
+				const unsigned int * tri = destination + size_t(triangles[t]) * 3;
+				removedTriangles += (tri[0] == to || tri[1] == to || tri[2] == to) ? 1 : 0;
+				locked[tri[0]] = locked[tri[1]] = locked[tri[2]] = true;
+			}
+
+			if ((numTriangles - removedTriangles) * 3 <= targetIndexCount)
+			{
+				break;
+			}
+		}
+
+		if (collapses == 0)
+		{
+			break;
+		}
+
+		// Collapsed vertices are never targets within the same pass, so a single remap is enough
+		size_t written = 0;
+		for (size_t i = 0; i < numIndices; i += 3)
+		{
+			const unsigned int a = remap[destination[i]];
+			const unsigned int b = remap[destination[i + 1]];
+			const unsigned int c = remap[destination[i + 2]];
+			if (a != b && b != c && a != c)
+			{
+				destination[written] = a;
+				destination[written + 1] = b;
+				destination[written + 2] = c;
+				written += 3;
+			}
+		}
+		numIndices = written;
+	}
+
+	if (resultError != 0)
+	{
+		*resultError = float(sqrt(currentCost) / extent);
+	}
+
+	return numIndices;
+}
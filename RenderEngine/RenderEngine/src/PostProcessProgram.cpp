@@ -55,13 +55,8 @@ void Engine::PostProcessProgram::configureMeshBuffers(Engine::Mesh * data)
 {
 	data->use();
 	
-	glBindBuffer(GL_ARRAY_BUFFER, data->vboVertices);
-	glVertexAttribPointer(inPos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(inPos);
-
-	glBindBuffer(GL_ARRAY_BUFFER, data->vboUVs);
-	glVertexAttribPointer(inTexCoord, 2, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(inTexCoord);
+	data->bindAttribute(Engine::VERTEX_ATTRIB_POSITION, inPos);
+	data->bindAttribute(Engine::VERTEX_ATTRIB_UV, inTexCoord);
 }
 
 void Engine::PostProcessProgram::onRenderObject(const Engine::Object * obj, Engine::Camera * camera)
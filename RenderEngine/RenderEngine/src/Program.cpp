@@ -39,8 +39,9 @@ void Engine::Program::initialize()
 		return;
 	}
 
-	vShader = loadShader(vShaderFile, GL_VERTEX_SHADER);
-	fShader = loadShader(fShaderFile, GL_FRAGMENT_SHADER);
+	const std::string configString = getConfigString();
+	vShader = loadShader(vShaderFile, GL_VERTEX_SHADER, configString);
+	fShader = loadShader(fShaderFile, GL_FRAGMENT_SHADER, configString);
 
 	glProgram = glCreateProgram();
 
@@ -74,6 +75,11 @@ unsigned int Engine::Program::getProgramId() const
 	return glProgram;
 }
 
+std::string Engine::Program::getConfigString()
+{
+	return "";
+}
+
 unsigned int Engine::Program::loadShader(std::string fileName, GLenum type, std::string configString, bool outputToFile, std::string outputFileName)
 {
 	size_t fileLen;
@@ -0,0 +1,243 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+Engine::RenderGraph::RenderGraph()
+{
+}
+
+unsigned int Engine::RenderGraph::addTarget(const std::string & name, const Engine::RenderGraph::TargetDesc & desc)
+{
+	Target target;
+	target.name = name;
+	target.desc = desc;
+	target.firstPass = target.lastPass = target.texture = -1;
+	targets.push_back(target);
+	return (unsigned int)targets.size() - 1;
+}
+
+unsigned int Engine::RenderGraph::addPass(const std::string & name, const std::vector<unsigned int> & reads, const std::vector<unsigned int> & writes)
+{
+	Pass pass;
+	pass.name = name;
+	pass.reads = reads;
+	pass.writes = writes;
+	passes.push_back(pass);
+	return (unsigned int)passes.size() - 1;
+}
+
+bool Engine::RenderGraph::compile(bool alias)
+{
+	for (auto & target : targets)
+	{
+		target.firstPass = target.lastPass = target.texture = -1;
+	}
+	textures.clear();
+
+	for (unsigned int p = 0; p < passes.size(); p++)
+	{
+		for (unsigned int t : passes[p].writes)
+		{
+			if (targets[t].firstPass < 0)
+			{
+				targets[t].firstPass = int(p);
+			}
+			targets[t].lastPass = int(p);
+		}
+
+		for (unsigned int t : passes[p].reads)
+		{
+			if (targets[t].firstPass < 0)
+			{
+				std::cerr << "RenderGraph: " << passes[p].name << " reads " << targets[t].name << " before any pass writes it" << std::endl;
+				return false;
+			}
+			targets[t].lastPass = int(p);
+		}
+	}
+
+	// Assigning the targets in the order they start to the first compatible texture free by then uses
+	// as many textures of each description as targets of it are alive at once
+	std::vector<unsigned int> order;
+	for (unsigned int t = 0; t < targets.size(); t++)
+	{
+		if (targets[t].firstPass >= 0)
+		{
+			order.push_back(t);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [this](unsigned int a, unsigned int b)
+	{
+		return targets[a].firstPass < targets[b].firstPass;
+	});
+
+	std::vector<int> textureLastPass;
+	for (unsigned int t : order)
+	{
+		Target & target = targets[t];
+
+		if (alias)
+		{
+			for (unsigned int i = 0; i < textures.size(); i++)
+			{
+				if (textureLastPass[i] < target.firstPass && isCompatible(textures[i], target.desc))
+				{
+					target.texture = int(i);
+					textureLastPass[i] = target.lastPass;
+					break;
+				}
+			}
+		}
+
+		if (target.texture < 0)
+		{
+			target.texture = int(textures.size());
+			textures.push_back(target.desc);
+			textureLastPass.push_back(target.lastPass);
+		}
+	}
+
+	return true;
+}
+
+const std::vector<Engine::RenderGraph::Target> & Engine::RenderGraph::getTargets() const
+{
+	return targets;
+}
+
+const std::vector<Engine::RenderGraph::Pass> & Engine::RenderGraph::getPasses() const
+{
+	return passes;
+}
+
+unsigned int Engine::RenderGraph::getNumTextures() const
+{
+	return (unsigned int)textures.size();
+}
+
+const Engine::RenderGraph::TargetDesc & Engine::RenderGraph::getTextureDesc(unsigned int texture) const
+{
+	return textures[texture];
+}
+
+int Engine::RenderGraph::getTexture(unsigned int target) const
+{
+	return targets[target].texture;
+}
+
+size_t Engine::RenderGraph::getMemoryUsage(unsigned int width, unsigned int height, bool aliased) const
+{
+	const size_t texels = size_t(width) * size_t(height);
+	size_t bytes = 0;
+	if (aliased)
+	{
+		for (const auto & desc : textures)
+		{
+			bytes += texels * getBytesPerTexel(desc.gpuTextureFormat);
+		}
+	}
+	else
+	{
+		for (const auto & target : targets)
+		{
+			if (target.texture >= 0)
+			{
+				bytes += texels * getBytesPerTexel(target.desc.gpuTextureFormat);
+			}
+		}
+	}
+	return bytes;
+}
+
+void Engine::RenderGraph::dump(std::ostream & os) const
+{
+	unsigned int used = 0;
+	for (const auto & target : targets)
+	{
+		used += target.texture >= 0 ? 1 : 0;
+	}
+
+	os << "RenderGraph: " << passes.size() << " pass(es), " << used << " target(s) in " << textures.size() << " texture(s)" << std::endl;
+	for (unsigned int p = 0; p < passes.size(); p++)
+	{
+		const Pass & pass = passes[p];
+		os << "   " << std::setw(2) << p << " " << std::left << std::setw(24) << pass.name << std::right << " reads:";
+		if (pass.reads.empty())
+		{
+			os << " -";
+		}
+		for (unsigned int r : pass.reads)
+		{
+			os << " " << targets[r].name;
+		}
+		os << " | writes:";
+		if (pass.writes.empty())
+		{
+			os << " -";
+		}
+		for (unsigned int w : pass.writes)
+		{
+			os << " " << targets[w].name;
+		}
+		os << std::endl;
+	}
+
+	for (const auto & target : targets)
+	{
+		os << "   " << std::left << std::setw(24) << target.name << std::right;
+		if (target.texture < 0)
+		{
+			os << " unused" << std::endl;
+			continue;
+		}
+		os << " passes " << target.firstPass << " - " << target.lastPass << ", texture " << target.texture
+			<< " (" << getBytesPerTexel(target.desc.gpuTextureFormat) << " bytes per texel)" << std::endl;
+	}
+}
+
+bool Engine::RenderGraph::isDepthFormat(GLenum gpuTextureFormat)
+{
+	switch (gpuTextureFormat)
+	{
+	case GL_DEPTH_COMPONENT16:
+	case GL_DEPTH_COMPONENT24:
+	case GL_DEPTH_COMPONENT32:
+	case GL_DEPTH_COMPONENT32F:
+		return true;
+	default:
+		return false;
+	}
+}
+
+unsigned int Engine::RenderGraph::getBytesPerTexel(GLenum gpuTextureFormat)
+{
+	switch (gpuTextureFormat)
+	{
+	case GL_R8:
+		return 1;
+	case GL_RG8:
+	case GL_R16F:
+	case GL_DEPTH_COMPONENT16:
+		return 2;
+	case GL_RGB16F:
+		return 6;
+	case GL_RGBA16F:
+	case GL_RG32F:
+		return 8;
+	case GL_RGB32F:
+		return 12;
+	case GL_RGBA32F:
+		return 16;
+	default:
+		// GL_RGBA8, GL_R32F, GL_RG16, GL_RG16F, and 24 bit depth, which takes 4 bytes per texel
+		return 4;
+	}
+}
+
+bool Engine::RenderGraph::isCompatible(const Engine::RenderGraph::TargetDesc & a, const Engine::RenderGraph::TargetDesc & b)
+{
+	return a.gpuTextureFormat == b.gpuTextureFormat && a.inputTextureFormat == b.inputTextureFormat
+		&& a.pixelFormat == b.pixelFormat && a.filterMethod == b.filterMethod;
+}
\ No newline at end of file
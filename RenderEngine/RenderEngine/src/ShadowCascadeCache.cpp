@@ -0,0 +1,187 @@
+#include "ShadowCascadeCache.h"
+
+#include <cmath>
+#include <cstdlib>
+
+Engine::ShadowCascadeCache::ShadowCascadeCache()
+{
+	Parameters defaults = { 1, 30 };
+	configure(defaults);
+}
+
+void Engine::ShadowCascadeCache::configure(const Engine::ShadowCascadeCache::Parameters & parameters)
+{
+	params = parameters;
+}
+
+void Engine::ShadowCascadeCache::invalidate()
+{
+	for (auto & level : levels)
+	{
+		level.valid = false;
+	}
+	changedBounds.clear();
+}
+
+void Engine::ShadowCascadeCache::invalidateBounds(const glm::vec3 & boundsMin, const glm::vec3 & boundsMax)
+{
+	// The levels are rendered entirely anyway, drop the bounds so they do not pile up without updates
+	if (changedBounds.size() >= MAX_CHANGED_BOUNDS)
+	{
+		invalidate();
+		return;
+	}
+
+	changedBounds.add(boundsMin, boundsMax);
+}
+
+void Engine::ShadowCascadeCache::update(const Engine::ShadowCascadeFit & fit)
+{
+	const std::vector<Engine::ShadowCascadeFit::Cascade> & cascades = fit.getCascades();
+	const Engine::ShadowCascadeFit::Parameters & fitParams = fit.getParameters();
+	const int resolution = int(fitParams.resolution);
+	const int margin = int(fitParams.marginTexels);
+
+	while (levels.size() < cascades.size())
+	{
+		Level level = {};
+		level.valid = false;
+		level.update = UPDATE_FULL;
+		level.shiftX = level.shiftY = 0;
+		level.age = 0;
+		level.frames = level.reused = level.scrolled = level.rendered = 0;
+		levels.push_back(level);
+	}
+
+	for (unsigned int i = 0; i < cascades.size(); i++)
+	{
+		const Engine::ShadowCascadeFit::Cascade & target = cascades[i];
+		Level & level = levels[i];
+		level.frames++;
+		level.regions.clear();
+		level.shiftX = level.shiftY = 0;
+
+		bool full = !level.valid || i < params.firstLevel || (params.interval > 0 && level.age >= params.interval)
+			|| target.texelDensity != level.cascade.texelDensity || target.nearDistance != level.cascade.nearDistance
+			|| target.farDistance != level.cascade.farDistance;
+
+		int shiftX = 0, shiftY = 0;
+		if (!full)
+		{
+			// Both centers are snapped to the same texel grid, so they are whole texels apart
+			const float texelSize = 1.0f / target.texelDensity;
+			const glm::vec3 from = glm::vec3(level.cascade.view * glm::vec4(level.cascade.center, 1.0f));
+			const glm::vec3 to = glm::vec3(target.view * glm::vec4(target.center, 1.0f));
+			shiftX = int(floorf((to.x - from.x) / texelSize + 0.5f));
+			shiftY = int(floorf((to.y - from.y) / texelSize + 0.5f));
+
+			// Scrolls keep the depth range, as the depth of the texels kept must not change
+			float nearDepth, farDepth;
+			getDepthRange(level.cascade.projection, nearDepth, farDepth);
+			const float neededNear = -to.z - target.radius - fitParams.casterDistance;
+			const float neededFar = -to.z + target.radius;
+
+			full = neededNear < nearDepth || neededFar > farDepth || abs(shiftX) >= resolution || abs(shiftY) >= resolution;
+
+			// The texels kept hold the casters of the old fit, and the exposed ones get the casters of the new fit
+			full = full || containsChangedBounds(level.cascade) || containsChangedBounds(target);
+		}
+
+		if (full)
+		{
+			// Levels rendered at once (such as after invalidate()) start with different ages, so they
+			// are not rendered again on the same frame later
+			level.age = level.valid || params.interval == 0 ? 0 : (params.interval * i) / (unsigned int)cascades.size();
+			level.valid = true;
+			level.cascade = target;
+			level.update = UPDATE_FULL;
+			level.regions.push_back({ 0, 0, resolution, resolution });
+			level.rendered++;
+			continue;
+		}
+
+		level.age++;
+
+		// The sphere stays inside the map while the center is less than the margin away, as the
+		// snapped center is already up to a texel away from the real one
+		if (abs(shiftX) < margin && abs(shiftY) < margin)
+		{
+			level.update = UPDATE_NONE;
+			level.reused++;
+			continue;
+		}
+
+		const glm::mat4 projection = level.cascade.projection;
+		level.cascade = target;
+		level.cascade.projection[2][2] = projection[2][2];
+		level.cascade.projection[3][2] = projection[3][2];
+		level.update = UPDATE_SCROLL;
+		level.shiftX = shiftX;
+		level.shiftY = shiftY;
+		level.scrolled++;
+
+		// Columns exposed on the side the map moved towards, then the rows exposed besides them
+		if (shiftX != 0)
+		{
+			level.regions.push_back({ shiftX > 0 ? resolution - shiftX : 0, 0, abs(shiftX), resolution });
+		}
+		if (shiftY != 0)
+		{
+			level.regions.push_back({ shiftX > 0 ? 0 : -shiftX, shiftY > 0 ? resolution - shiftY : 0, resolution - abs(shiftX), abs(shiftY) });
+		}
+	}
+
+	changedBounds.clear();
+}
+
+void Engine::ShadowCascadeCache::resetStatistics()
+{
+	for (auto & level : levels)
+	{
+		level.frames = level.reused = level.scrolled = level.rendered = 0;
+	}
+}
+
+const Engine::ShadowCascadeCache::Parameters & Engine::ShadowCascadeCache::getParameters() const
+{
+	return params;
+}
+
+const std::vector<Engine::ShadowCascadeCache::Level> & Engine::ShadowCascadeCache::getLevels() const
+{
+	return levels;
+}
+
+bool Engine::ShadowCascadeCache::containsChangedBounds(const Engine::ShadowCascadeFit::Cascade & cascade)
+{
+	if (changedBounds.size() == 0)
+	{
+		return false;
+	}
+
+	// Same volume the casters are culled against (see Terrain::renderShadow())
+	Engine::Frustum volume(cascade.projection * cascade.view);
+	volume.extrude(Engine::Frustum::PLANE_NEAR);
+	changedVisibility.resize(changedBounds.size());
+	return volume.intersects(changedBounds, changedVisibility.data()) > 0;
+}
+
+void Engine::ShadowCascadeCache::getDepthRange(const glm::mat4 & projection, float & nearDepth, float & farDepth)
+{
+	// glm::ortho() sets [2][2] = -2 / (far - near) and [3][2] = -(far + near) / (far - near)
+	nearDepth = (projection[3][2] + 1.0f) / projection[2][2];
+	farDepth = (projection[3][2] - 1.0f) / projection[2][2];
+}
+
+glm::mat4 Engine::ShadowCascadeCache::getRegionCrop(const Engine::ShadowCascadeCache::Region & region, unsigned int resolution)
+{
+	const float size = float(resolution);
+	const float centerX = -1.0f + float(2 * region.x + region.width) / size;
+	const float centerY = -1.0f + float(2 * region.y + region.height) / size;
+	glm::mat4 crop(1.0f);
+	crop[0][0] = size / float(region.width);
+	crop[1][1] = size / float(region.height);
+	crop[3][0] = -centerX * crop[0][0];
+	crop[3][1] = -centerY * crop[1][1];
+	return crop;
+}
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "ShadowCascadeFit.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+
+Engine::ShadowCascadeFit::ShadowCascadeFit()
+{
+	Parameters defaults = { 2, SPLIT_PRACTICAL, 0.75f, 0.5f, 100.0f, 1024, 50.0f, 1, 0.0f };
+	configure(defaults);
+}
+
+void Engine::ShadowCascadeFit::configure(const Engine::ShadowCascadeFit::Parameters & parameters)
+{
+	params = parameters;
+	params.levels = params.levels < 1 ? 1 : params.levels > MAX_LEVELS ? MAX_LEVELS : params.levels;
+	params.lambda = params.lambda < 0.0f ? 0.0f : params.lambda > 1.0f ? 1.0f : params.lambda;
+	params.resolution = params.resolution < 4 ? 4 : params.resolution;
+	params.marginTexels = params.marginTexels < 1 ? 1 : params.marginTexels > params.resolution / 4 ? params.resolution / 4 : params.marginTexels;
+	params.depthSlack = params.depthSlack < 0.0f ? 0.0f : params.depthSlack;
+	params.shadowDistance = params.shadowDistance > params.nearDistance ? params.shadowDistance : params.nearDistance + 1.0f;
+
+	computeSplits(params.scheme, params.lambda, params.levels, params.nearDistance, params.shadowDistance, splits);
+	cascades.resize(params.levels);
+}
+
+void Engine::ShadowCascadeFit::fit(const glm::mat4 & invViewMatrix, const glm::mat4 & projectionMatrix, const glm::vec3 & lightDirection)
+{
+	const glm::vec3 eye = glm::vec3(invViewMatrix[3]);
+	const glm::vec3 forward = -glm::normalize(glm::vec3(invViewMatrix[2]));
+	const float tanHalfX = 1.0f / projectionMatrix[0][0];
+	const float tanHalfY = 1.0f / projectionMatrix[1][1];
+
+	const glm::mat4 lightRotation = getLightRotation(lightDirection);
+	const glm::mat4 invLightRotation = glm::transpose(lightRotation);
+
+	for (unsigned int level = 0; level < params.levels; level++)
+	{
+		Cascade & cascade = cascades[level];
+		cascade.nearDistance = splits[level];
+		cascade.farDistance = splits[level + 1];
+
+		float centerDistance;
+		computeSliceSphere(tanHalfX, tanHalfY, cascade.nearDistance, cascade.farDistance, centerDistance, cascade.radius);
+
+		// Move the center in whole texels, so the light space texel grid stays put on the scene.
+		// The radius only depends on the splits and the projection, so the texel size does not change.
+		// The map covers the margin texels around the sphere
+		const float extent = cascade.radius * float(params.resolution) / float(params.resolution - 2 * params.marginTexels);
+		const float texelSize = 2.0f * extent / float(params.resolution);
+		const float slack = cascade.radius * params.depthSlack;
+		glm::vec3 center = glm::vec3(lightRotation * glm::vec4(eye + forward * centerDistance, 1.0f));
+		center.x = floorf(center.x / texelSize) * texelSize;
+		center.y = floorf(center.y / texelSize) * texelSize;
+
+		// The light looks along -z, so depths grow towards -z
+		cascade.view = lightRotation;
+		cascade.projection = glm::ortho(center.x - extent, center.x + extent, center.y - extent, center.y + extent,
+			-center.z - cascade.radius - params.casterDistance - slack, -center.z + cascade.radius + slack);
+		cascade.center = glm::vec3(invLightRotation * glm::vec4(center, 1.0f));
+		cascade.texelDensity = 1.0f / texelSize;
+	}
+}
+
+const Engine::ShadowCascadeFit::Parameters & Engine::ShadowCascadeFit::getParameters() const
+{
+	return params;
+}
+
+const std::vector<float> & Engine::ShadowCascadeFit::getSplits() const
+{
+	return splits;
+}
+
+const std::vector<Engine::ShadowCascadeFit::Cascade> & Engine::ShadowCascadeFit::getCascades() const
+{
+	return cascades;
+}
+
+void Engine::ShadowCascadeFit::computeSplits(Engine::ShadowCascadeFit::SplitScheme scheme, float lambda, unsigned int levels, float nearDistance, float farDistance, std::vector<float> & result)
+{
+	result.resize(levels + 1);
+	result[0] = nearDistance;
+	result[levels] = farDistance;
+
+	const float ratio = farDistance / nearDistance;
+	for (unsigned int i = 1; i < levels; i++)
+	{
+		const float fraction = float(i) / float(levels);
+		const float logarithmic = nearDistance * powf(ratio, fraction);
+		const float linear = nearDistance + (farDistance - nearDistance) * fraction;
+
+		switch (scheme)
+		{
+		case SPLIT_LOGARITHMIC:
+			result[i] = logarithmic;
+			break;
+		case SPLIT_LINEAR:
+			result[i] = linear;
+			break;
+		default:
+			result[i] = lambda * logarithmic + (1.0f - lambda) * linear;
+			break;
+		}
+	}
+}
+
+void Engine::ShadowCascadeFit::computeSliceSphere(float tanHalfX, float tanHalfY, float nearDistance, float farDistance, float & centerDistance, float & radius)
+{
+	// The slice corners lie at nearDistance * k and farDistance * k from the view axis. The
+	// center which is as far from the near corners as from the far ones is at
+	// (near + far) * (1 + k^2) / 2. Wide slices have it beyond the far plane, and the far
+	// plane corners alone bound them
+	const float k2 = tanHalfX * tanHalfX + tanHalfY * tanHalfY;
+	centerDistance = 0.5f * (nearDistance + farDistance) * (1.0f + k2);
+
+	if (centerDistance >= farDistance)
+	{
+		centerDistance = farDistance;
+		radius = farDistance * sqrtf(k2);
+	}
+	else
+	{
+		const float along = farDistance - centerDistance;
+		radius = sqrtf(along * along + farDistance * farDistance * k2);
+	}
+}
+
+glm::mat4 Engine::ShadowCascadeFit::getLightRotation(const glm::vec3 & lightDirection)
+{
+	const glm::vec3 direction = glm::normalize(lightDirection);
+	const glm::vec3 up = fabsf(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+	return glm::lookAt(glm::vec3(0.0f), -direction, up);
+}
\ No newline at end of file
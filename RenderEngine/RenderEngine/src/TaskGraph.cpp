@@ -0,0 +1,275 @@
+#include "TaskGraph.h"
+
+#include <iomanip>
+#include <algorithm>
+
+#include "Threadpool.h"
+
+Engine::Concurrent::TaskGraph::TaskGraph()
+	:completedStages(0), frameTime(0)
+{
+}
+
+Engine::Concurrent::TaskGraph::~TaskGraph()
+{
+}
+
+unsigned int Engine::Concurrent::TaskGraph::getResourceId(const std::string & name)
+{
+	auto it = resourceIds.find(name);
+	if (it != resourceIds.end())
+	{
+		return it->second;
+	}
+
+	unsigned int id = (unsigned int)resourceNames.size();
+	resourceIds[name] = id;
+	resourceNames.push_back(name);
+	return id;
+}
+
+unsigned int Engine::Concurrent::TaskGraph::addStage(const std::string & name,
+	const std::vector<std::string> & reads,
+	const std::vector<std::string> & writes,
+	Engine::Concurrent::TaskAffinity affinity,
+	std::function<void()> job)
+{
+	unsigned int index = (unsigned int)stages.size();
+
+	std::unique_ptr<Stage> stage(new Stage());
+	stage->name = name;
+	stage->affinity = affinity;
+	stage->job = job;
+	stage->pendingDependencies = 0;
+	stage->startTime = stage->endTime = 0;
+	stage->thread = -1;
+
+	for (auto & r : reads)
+	{
+		stage->reads.push_back(getResourceId(r));
+	}
+	for (auto & w : writes)
+	{
+		stage->writes.push_back(getResourceId(w));
+	}
+
+	// Walk the previous stages backwards looking for hazards on our resources
+	std::vector<bool> dependsOn(index, false);
+	for (unsigned int res : stage->reads)
+	{
+		// Read after write: last writer
+		for (unsigned int i = index; i-- > 0;)
+		{
+			const std::vector<unsigned int> & w = stages[i]->writes;
+			if (std::find(w.begin(), w.end(), res) != w.end())
+			{
+				dependsOn[i] = true;
+				break;
+			}
+		}
+	}
+	for (unsigned int res : stage->writes)
+	{
+		// Write after read: every reader since the last writer. Write after write: last writer
+		for (unsigned int i = index; i-- > 0;)
+		{
+			const std::vector<unsigned int> & w = stages[i]->writes;
+			const std::vector<unsigned int> & r = stages[i]->reads;
+			if (std::find(w.begin(), w.end(), res) != w.end())
+			{
+				dependsOn[i] = true;
+				break;
+			}
+			if (std::find(r.begin(), r.end(), res) != r.end())
+			{
+				dependsOn[i] = true;
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < index; i++)
+	{
+		if (dependsOn[i])
+		{
+			stage->dependencies.push_back(i);
+			stages[i]->successors.push_back(index);
+		}
+	}
+
+	stages.push_back(std::move(stage));
+	return index;
+}
+
+void Engine::Concurrent::TaskGraph::execute()
+{
+	const unsigned int numStages = (unsigned int)stages.size();
+	if (numStages == 0)
+	{
+		return;
+	}
+
+	frameStart = std::chrono::high_resolution_clock::now();
+	completedStages = 0;
+	for (auto & stage : stages)
+	{
+		stage->pendingDependencies = (unsigned int)stage->dependencies.size();
+	}
+
+	for (unsigned int i = 0; i < numStages; i++)
+	{
+		if (stages[i]->dependencies.empty())
+		{
+			dispatch(i);
+		}
+	}
+
+	// The main thread only runs its own stages (instead of helping the pool) so GL work
+	// is never delayed by a long worker job
+	std::unique_lock<std::mutex> lock(readyLock);
+	while (completedStages.load() < numStages)
+	{
+		if (mainThreadReady.empty())
+		{
+			readyMonitor.wait(lock);
+			continue;
+		}
+
+		// Among the ready main thread stages, keep the declaration order
+		auto nextIt = std::min_element(mainThreadReady.begin(), mainThreadReady.end());
+		unsigned int next = *nextIt;
+		mainThreadReady.erase(nextIt);
+		lock.unlock();
+		runStage(next);
+		lock.lock();
+	}
+	lock.unlock();
+
+	frameTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - frameStart).count();
+}
+
+void Engine::Concurrent::TaskGraph::dispatch(unsigned int stageIndex)
+{
+	if (stages[stageIndex]->affinity == AFFINITY_MAIN_THREAD)
+	{
+		std::unique_lock<std::mutex> lock(readyLock);
+		mainThreadReady.push_back(stageIndex);
+		lock.unlock();
+		readyMonitor.notify_one();
+	}
+	else
+	{
+		TaskGraph * graph = this;
+		ThreadPool::getInstance().execute([graph, stageIndex]()
+		{
+			graph->runStage(stageIndex);
+		});
+	}
+}
+
+void Engine::Concurrent::TaskGraph::runStage(unsigned int stageIndex)
+{
+	Stage & stage = *stages[stageIndex];
+
+	stage.thread = ThreadPool::getInstance().getCurrentWorkerIndex();
+	stage.startTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - frameStart).count();
+	stage.job();
+	stage.endTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - frameStart).count();
+
+	for (unsigned int successor : stage.successors)
+	{
+		if (stages[successor]->pendingDependencies.fetch_sub(1) == 1)
+		{
+			dispatch(successor);
+		}
+	}
+
+	// Notified while holding the lock, execute() may return (and the graph be destroyed)
+	// as soon as the lock is released after the last stage
+	std::unique_lock<std::mutex> lock(readyLock);
+	completedStages++;
+	readyMonitor.notify_one();
+}
+
+std::vector<unsigned int> Engine::Concurrent::TaskGraph::computeCriticalPath() const
+{
+	std::vector<unsigned int> path;
+	if (stages.empty())
+	{
+		return path;
+	}
+
+	// Dependencies always point to previous stages, so declaration order is a topological order
+	std::vector<long long> longest(stages.size(), 0);
+	std::vector<int> previous(stages.size(), -1);
+	unsigned int last = 0;
+	for (unsigned int i = 0; i < stages.size(); i++)
+	{
+		long long best = 0;
+		for (unsigned int dep : stages[i]->dependencies)
+		{
+			if (longest[dep] > best || previous[i] < 0)
+			{
+				best = longest[dep];
+				previous[i] = int(dep);
+			}
+		}
+		longest[i] = best + (stages[i]->endTime - stages[i]->startTime);
+		if (longest[i] > longest[last])
+		{
+			last = i;
+		}
+	}
+
+	for (int i = int(last); i >= 0; i = previous[i])
+	{
+		path.push_back(unsigned(i));
+	}
+	std::reverse(path.begin(), path.end());
+	return path;
+}
+
+void Engine::Concurrent::TaskGraph::dump(std::ostream & os) const
+{
+	std::vector<unsigned int> criticalPath = computeCriticalPath();
+	std::vector<bool> critical(stages.size(), false);
+	long long criticalTime = 0;
+	for (unsigned int i : criticalPath)
+	{
+		critical[i] = true;
+		criticalTime += stages[i]->endTime - stages[i]->startTime;
+	}
+
+	os << "TaskGraph: " << stages.size() << " stage(s), frame " << frameTime << " us, critical path " << criticalTime << " us" << std::endl;
+	for (unsigned int i = 0; i < stages.size(); i++)
+	{
+		const Stage & stage = *stages[i];
+
+		os << (critical[i] ? " * " : "   ") << std::setw(2) << i << " " << std::left << std::setw(20) << stage.name << std::right
+			<< (stage.thread < 0 ? " main    " : " worker ") << (stage.thread < 0 ? std::string() : std::to_string(stage.thread))
+			<< " start " << std::setw(7) << stage.startTime
+			<< " end " << std::setw(7) << stage.endTime
+			<< " (" << std::setw(6) << (stage.endTime - stage.startTime) << " us)";
+
+		os << " deps:";
+		if (stage.dependencies.empty())
+		{
+			os << " -";
+		}
+		for (unsigned int dep : stage.dependencies)
+		{
+			os << " " << stages[dep]->name;
+		}
+
+		os << " | reads:";
+		for (unsigned int r : stage.reads)
+		{
+			os << " " << resourceNames[r];
+		}
+		os << " | writes:";
+		for (unsigned int w : stage.writes)
+		{
+			os << " " << resourceNames[w];
+		}
+		os << std::endl;
+	}
+}
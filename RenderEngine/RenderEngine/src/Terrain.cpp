@@ -10,13 +10,22 @@
 #include "terraincomponents/FlowerComponent.h"
 
 #include <iostream>
+#include <string>
+
+#include <glm/gtc/matrix_transform.hpp>
 
 #include "CascadeShadowMaps.h"
+#include "FrameStatistics.h"
+
+// Tile height ranges computed per frame (each takes a few tens of microseconds), so
+// changing the terrain settings does not stall the frame
+static const unsigned int MAX_NEW_HEIGHT_RANGES = 64;
 
 Engine::Terrain::Terrain()
 {
 	tileWidth = 1.0f;
 	renderRadius = 7;
+	heightRangeBudget = 0;
 	initialize();
 }
 
@@ -24,6 +33,7 @@ Engine::Terrain::Terrain(float tileWidth, unsigned int renderRadius)
 {
 	this->tileWidth = tileWidth;
 	this->renderRadius = renderRadius;
+	heightRangeBudget = 0;
 	initialize();
 }
 
@@ -39,6 +49,7 @@ void Engine::Terrain::registerComponent(Engine::TerrainComponent * comp)
 		if (comp->castShadows())
 		{
 			shadowableComponents.push_back(comp);
+			shadowTileWindows.push_back(glm::ivec4(0));
 		}
 	}
 }
@@ -47,101 +58,387 @@ void Engine::Terrain::registerComponent(Engine::TerrainComponent * comp)
 
 void Engine::Terrain::render(Engine::Camera * camera)
 {
+	updateHeightField();
+	heightRangeBudget = MAX_NEW_HEIGHT_RANGES;
+
 	for (auto & tc : renderableComponents)
 	{
-		renderTiledComponent(tc, camera);
+		const unsigned long long drawCalls = Engine::FrameStatistics::getDrawCallCount();
+		const unsigned long long uniformCalls = Engine::FrameStatistics::getUniformCallCount();
+
+		if (Engine::Settings::terrainQuadTree && tc->supportsQuadTree())
+		{
+			renderQuadTreeComponent(tc, camera);
+		}
+		else
+		{
+			renderTiledComponent(tc, camera);
+		}
+
+		tc->callStatistics.drawCalls = (unsigned int)(Engine::FrameStatistics::getDrawCallCount() - drawCalls);
+		tc->callStatistics.uniformCalls = (unsigned int)(Engine::FrameStatistics::getUniformCallCount() - uniformCalls);
+	}
+
+	for (unsigned int i = 0; i < shadowableComponents.size(); i++)
+	{
+		updateShadowTileWindow(i, camera);
 	}
 }
 
-void Engine::Terrain::renderShadow(Camera * cam, const glm::mat4 & projectionMatrix)
+void Engine::Terrain::renderShadow(Camera * cam, const glm::mat4 * projectionMatrices, unsigned int regions)
 {
+	updateHeightField();
+
+	// Light space culling: only the tiles within the volume of a region, or between it and the light, cast
+	// shadows on it. The volumes are open towards the light, as the caster depth is clamped
+	const glm::mat4 tileToWorld = glm::scale(glm::mat4(1.0f), glm::vec3(tileWidth));
+	shadowVolumes.resize(regions);
+	shadowTileVolumes.resize(regions);
+	shadowVolumeLevels.resize(regions);
+	for (unsigned int i = 0; i < regions; i++)
+	{
+		shadowVolumes[i].update(projectionMatrices[i]);
+		shadowVolumes[i].extrude(Engine::Frustum::PLANE_NEAR);
+		shadowTileVolumes[i].update(projectionMatrices[i] * tileToWorld);
+		shadowTileVolumes[i].extrude(Engine::Frustum::PLANE_NEAR);
+		shadowVolumeLevels[i] = Engine::CascadeShadowMaps::getInstance().getRegionLevel(i);
+	}
+
 	for (auto & sc : shadowableComponents)
 	{
-		renderTiledComponentShadow(sc, cam, projectionMatrix);
+		const unsigned long long drawCalls = Engine::FrameStatistics::getDrawCallCount();
+		const unsigned long long uniformCalls = Engine::FrameStatistics::getUniformCallCount();
+
+		if (Engine::Settings::terrainQuadTree && sc->supportsQuadTree())
+		{
+			renderQuadTreeComponentShadow(sc, cam, projectionMatrices, regions);
+		}
+		else
+		{
+			renderTiledComponentShadow(sc, cam, projectionMatrices, regions);
+		}
+
+		sc->callStatistics.shadowDrawCalls = (unsigned int)(Engine::FrameStatistics::getDrawCallCount() - drawCalls);
+		sc->callStatistics.shadowUniformCalls = (unsigned int)(Engine::FrameStatistics::getUniformCallCount() - uniformCalls);
 	}
 }
 
 // ====================================================================================================================
 
-void Engine::Terrain::renderTiledComponent(Engine::TerrainComponent * component, Engine::Camera * cam)
+void Engine::Terrain::updateHeightField()
+{
+	TerrainHeightField::Parameters params = TerrainHeightField::getSettingsParameters();
+	params.tileWidth = tileWidth;
+	const TerrainHeightField::Parameters & current = heightField.getParameters();
+	if (current.amplitude != params.amplitude || current.frecuency != params.frecuency || current.scale != params.scale
+		|| current.octaves != params.octaves || current.tileWidth != params.tileWidth)
+	{
+		heightField.setParameters(params);
+		tileHeightRanges.clear();
+	}
+}
+
+bool Engine::Terrain::getTileHeightRange(int i, int j, glm::vec2 & range)
+{
+	const long long key = (long long)(((unsigned long long)(unsigned int)i << 32) | (unsigned long long)(unsigned int)j);
+	auto it = tileHeightRanges.find(key);
+	if (it != tileHeightRanges.end())
+	{
+		range = it->second;
+		return true;
+	}
+
+	if (heightRangeBudget == 0)
+	{
+		return false;
+	}
+	heightRangeBudget--;
+
+	// Keep the cache around the areas visited lately
+	if (tileHeightRanges.size() >= 16384)
+	{
+		tileHeightRanges.clear();
+	}
+
+	heightField.getTileRange(i, j, range.x, range.y);
+	tileHeightRanges[key] = range;
+	return true;
+}
+
+glm::ivec4 Engine::Terrain::getTileWindow(Engine::TerrainComponent * component, Engine::Camera * cam)
 {
 	glm::vec3 cameraPosition = cam->getPosition();
 
 	int x = -int((floor(cameraPosition.x)) / tileWidth);
 	int y = -int((floor(cameraPosition.z)) / tileWidth);
 
-	unsigned int rr = component->getRenderRadius();
-	int xStart = x - rr;
-	int xEnd = x + rr;
-	int yStart = y - rr;
-	int yEnd = y + rr;
+	int rr = int(component->getRenderRadius());
+	return glm::ivec4(x - rr, x + rr, y - rr, y + rr);
+}
+
+void Engine::Terrain::updateShadowTileWindow(unsigned int index, Engine::Camera * cam)
+{
+	Engine::TerrainComponent * component = shadowableComponents[index];
+	const glm::ivec4 window = getTileWindow(component, cam);
+	const glm::ivec4 previous = shadowTileWindows[index];
+	if (window == previous)
+	{
+		return;
+	}
+	shadowTileWindows[index] = window;
+
+	// The cached shadow map levels still hold the tiles which left, and miss the ones which entered
+	auto inside = [](const glm::ivec4 & area, int i, int j)
+	{
+		return i >= area.x && i < area.y && j >= area.z && j < area.w;
+	};
+	const glm::ivec4 * areas[2] = { &previous, &window };
+	for (unsigned int a = 0; a < 2; a++)
+	{
+		const glm::ivec4 & area = *areas[a];
+		const glm::ivec4 & other = *areas[1 - a];
+		for (int i = area.x; i < area.y; i++)
+		{
+			for (int j = area.z; j < area.w; j++)
+			{
+				if (!inside(other, i, j))
+				{
+					glm::vec3 boundsMin, boundsMax;
+					component->getTileBounds(i, j, boundsMin, boundsMax);
+					Engine::CascadeShadowMaps::getInstance().notifyCasterUpdate(boundsMin, boundsMax);
+				}
+			}
+		}
+	}
+}
+
+void Engine::Terrain::selectTiles(Engine::TerrainComponent * component, Engine::Camera * cam, const Engine::Frustum * volumes, const unsigned int * volumeGroups, unsigned int numVolumes,
+	Engine::TileCullingStatistics * groupStatistics, unsigned int numGroups)
+{
+	const glm::ivec4 window = getTileWindow(component, cam);
+	const int xStart = window.x;
+	const int xEnd = window.y;
+	const int yStart = window.z;
+	const int yEnd = window.w;
+
+	// Frustum culling, testing the bounds of all the tiles at once against each volume
+	tileBounds.clear();
+	for (int i = xStart; i < xEnd; i++)
+	{
+		for (int j = yStart; j < yEnd; j++)
+		{
+			glm::vec3 boundsMin, boundsMax;
+			component->getTileBounds(i, j, boundsMin, boundsMax);
+			tileBounds.add(boundsMin, boundsMax);
+		}
+	}
+
+	tileVisibility.assign(tileBounds.size(), 0);
+	volumeVisibility.resize(tileBounds.size());
+	for (unsigned int v = 0; v < numVolumes; v++)
+	{
+		volumes[v].intersects(tileBounds, volumeVisibility.data());
+		const unsigned char groupBit = (unsigned char)(1u << volumeGroups[v]);
+		for (size_t t = 0; t < tileBounds.size(); t++)
+		{
+			tileVisibility[t] |= volumeVisibility[t] != 0 ? groupBit : 0;
+		}
+	}
+
+	// Tiles start culled on every group, and are moved to drawn or hidden on the groups they intersect
+	for (unsigned int g = 0; g < numGroups; g++)
+	{
+		groupStatistics[g] = { (unsigned int)tileBounds.size(), (unsigned int)tileBounds.size(), 0, 0 };
+	}
+
+	// Tiles covered by other components (such as water under the land)
+	size_t tile = 0;
+	visibleTiles.clear();
+	for (int i = xStart; i < xEnd; i++)
+	{
+		for (int j = yStart; j < yEnd; j++, tile++)
+		{
+			const unsigned char groups = tileVisibility[tile];
+			if (groups == 0)
+			{
+				continue;
+			}
+
+			glm::vec2 range;
+			const bool hidden = getTileHeightRange(i, j, range) && component->isTileHidden(i, j, range.x, range.y, cam);
+
+			for (unsigned int g = 0; g < numGroups; g++)
+			{
+				if (groups & (1u << g))
+				{
+					groupStatistics[g].culled--;
+					if (hidden)
+					{
+						groupStatistics[g].hidden++;
+					}
+					else
+					{
+						groupStatistics[g].drawn++;
+					}
+				}
+			}
+
+			if (!hidden)
+			{
+				visibleTiles.push_back(glm::ivec2(i, j));
+			}
+		}
+	}
+}
 
+void Engine::Terrain::renderTiledComponent(Engine::TerrainComponent * component, Engine::Camera * cam)
+{
+	Engine::Frustum frustum(cam->getProjectionMatrix() * cam->getViewMatrix());
+	const unsigned int group = 0;
+	selectTiles(component, cam, &frustum, &group, 1, &component->cullingStatistics, 1);
+
+	component->updateComponent(cam);
 	component->preRenderComponent();
 
 	Program * prog = component->getActiveShader();
 	prog->use();
 	prog->applyGlobalUniforms();
 
-	// Culling parameters
-	glm::vec3 fwd = cam->getForwardVector();
-	fwd.y = 0;
-	fwd = -glm::normalize(fwd);
-	int px = -int(renderRadius), py = px;
-
-	for (int i = xStart; i < xEnd; i++, px++)
+	if (Engine::Settings::terrainInstancing && component->supportsInstancing())
+	{
+		component->renderInstances(visibleTiles, cam);
+	}
+	else
 	{
-		for (int j = yStart; j < yEnd; j++, py++)
+		for (auto & t : visibleTiles)
 		{
-			// Culling (skips almost half)
-			glm::vec3 test(i - x, 0, j - y);
-			if (abs(px) > 2 && abs(py) > 2 && glm::dot(glm::normalize(test), fwd) < 0.1f)
-				continue;
+			component->renderComponent(t.x, t.y, cam);
+		}
+	}
+
+	component->postRenderComponent();
+}
+
+void Engine::Terrain::renderTiledComponentShadow(Engine::TerrainComponent * component, Engine::Camera * cam, const glm::mat4 * projections, unsigned int regions)
+{
+	// Tiles within any of the region volumes (see renderShadow()), counted on the level of the region. The
+	// tiles are drawn once, on every region
+	selectTiles(component, cam, shadowVolumes.data(), shadowVolumeLevels.data(), regions,
+		component->shadowCullingStatistics, Engine::CascadeShadowMaps::getInstance().getCascadeLevels());
+
+	component->updateComponent(cam);
+	component->preRenderComponent();
+
+	Program * prog = component->getShadowMapShader();
+	prog->use();
+	prog->applyGlobalUniforms();
 
-			component->renderComponent(i, j, cam);
+	if (Engine::Settings::terrainInstancing && component->supportsInstancing())
+	{
+		component->renderShadowInstances(projections, regions, visibleTiles, cam);
+	}
+	else
+	{
+		for (auto & t : visibleTiles)
+		{
+			component->renderShadow(projections, regions, t.x, t.y, cam);
 		}
 	}
 
 	component->postRenderComponent();
 }
 
-void Engine::Terrain::renderTiledComponentShadow(Engine::TerrainComponent * component, Engine::Camera * cam, const glm::mat4 & proj)
+size_t Engine::Terrain::selectQuadTreeNodes(Engine::TerrainComponent * component, Engine::Camera * cam, const Engine::Frustum * frustums, unsigned int numFrustums)
 {
-	glm::vec3 cameraPosition = cam->getPosition();
+	TerrainQuadTree::Parameters params = quadTree.getParameters();
+	params.pixelError = Engine::Settings::terrainPixelError;
+	params.viewportHeight = cam->getViewportHeight();
+	params.projectionScale = cam->getProjectionMatrix()[1][1];
+	params.viewDistance = float(component->getRenderRadius());
+	params.minHeight = 0.0f;
+	params.maxHeight = component->getMaxTerrainHeight() / tileWidth;
+	quadTree.configure(params);
+
+	// The quadtree works in tiles
+	const glm::vec3 cameraPosition = -cam->getPosition() / tileWidth;
+	quadTreeNodes.clear();
+	return quadTree.select(cameraPosition, frustums, numFrustums, quadTreeNodes);
+}
 
-	int x = -int((floor(cameraPosition.x)) / tileWidth);
-	int y = -int((floor(cameraPosition.z)) / tileWidth);
+void Engine::Terrain::renderQuadTreeComponent(Engine::TerrainComponent * component, Engine::Camera * cam)
+{
+	const glm::mat4 tileToWorld = glm::scale(glm::mat4(1.0f), glm::vec3(tileWidth));
+	Engine::Frustum frustum(cam->getProjectionMatrix() * cam->getViewMatrix() * tileToWorld);
+
+	const size_t culledNodes = selectQuadTreeNodes(component, cam, &frustum, 1);
 
-	unsigned int rr = component->getRenderRadius();
-	int xStart = x - rr;
-	int xEnd = x + rr;
-	int yStart = y - rr;
-	int yEnd = y + rr;
+	component->cullingStatistics.tested = (unsigned int)(quadTreeNodes.size() + culledNodes);
+	component->cullingStatistics.drawn = (unsigned int)quadTreeNodes.size();
+	component->cullingStatistics.culled = (unsigned int)culledNodes;
+	component->cullingStatistics.hidden = 0;
 
 	component->preRenderComponent();
 
-	Program * prog = component->getShadowMapShader();
+	Program * prog = component->getActiveShader();
 	prog->use();
 	prog->applyGlobalUniforms();
 
-	// Culling parameters
-	glm::vec3 fwd = cam->getForwardVector();
-	fwd.y = 0;
-	fwd = -glm::normalize(fwd);
-	int px = -int(renderRadius), py = px;
+	for (auto & node : quadTreeNodes)
+	{
+		component->renderQuadTreeNode(node, cam);
+	}
+
+	component->postRenderComponent();
+}
+
+void Engine::Terrain::renderQuadTreeComponentShadow(Engine::TerrainComponent * component, Engine::Camera * cam, const glm::mat4 * projections, unsigned int regions)
+{
+	// Nodes within any of the region volumes (see renderShadow()), in tiles
+	const size_t culledNodes = selectQuadTreeNodes(component, cam, shadowTileVolumes.data(), regions);
+	const unsigned int tested = (unsigned int)(quadTreeNodes.size() + culledNodes);
+
+	// Nodes drawn on each level are the ones within the volume of any of its regions
+	const unsigned int levels = Engine::CascadeShadowMaps::getInstance().getCascadeLevels();
+	for (unsigned int l = 0; l < levels; l++)
+	{
+		component->shadowCullingStatistics[l] = { tested, tested, 0, 0 };
+	}
 
-	for (int i = xStart; i < xEnd; i++, px++)
+	const TerrainQuadTree::Parameters & params = quadTree.getParameters();
+	for (auto & node : quadTreeNodes)
 	{
-		for (int j = yStart; j < yEnd; j++, py++)
+		const glm::vec3 boundsMin(node.x, params.minHeight, node.z);
+		const glm::vec3 boundsMax(node.x + node.size, params.maxHeight, node.z + node.size);
+		unsigned int nodeLevels = 0;
+		for (unsigned int i = 0; i < regions; i++)
 		{
-			// Culling (skips almost half)
-			glm::vec3 test(i - x, 0, j - y);
-			if (abs(px) > 2 && abs(py) > 2 && glm::dot(glm::normalize(test), fwd) < 0.1f)
-				continue;
+			if (shadowTileVolumes[i].intersects(boundsMin, boundsMax))
+			{
+				nodeLevels |= 1u << shadowVolumeLevels[i];
+			}
+		}
 
-			component->renderShadow(proj, i, j, cam);
+		for (unsigned int l = 0; l < levels; l++)
+		{
+			if (nodeLevels & (1u << l))
+			{
+				component->shadowCullingStatistics[l].culled--;
+				component->shadowCullingStatistics[l].drawn++;
+			}
 		}
 	}
 
+	component->preRenderComponent();
+
+	Program * prog = component->getShadowMapShader();
+	prog->use();
+	prog->applyGlobalUniforms();
+
+	for (auto & node : quadTreeNodes)
+	{
+		component->renderQuadTreeNodeShadow(projections, regions, node, cam);
+	}
+
 	component->postRenderComponent();
 }
 
@@ -196,8 +493,58 @@ void Engine::Terrain::createTileMesh()
 	uv[4] = 0.0f; uv[5] = 1.0f;
 	uv[6] = 1.0f; uv[7] = 1.0f;
 
-	Engine::Mesh plane(2, 4, faces, vertices, 0, normals, uv, 0);
+	Engine::Mesh plane(2, 4, faces, vertices, 0, normals, uv, 0, 0, false);
+	plane.setVertexFormat(Engine::VertexFormat::quantized());
+	plane.syncGPU();
 	Engine::MeshTable::getInstance().addMeshToCache("terrain_tile", plane);
+
+	// Quadtree nodes, and nodes partially covered by their children
+	createGridMesh(Engine::TerrainQuadTree::GRID_RESOLUTION);
+	createGridMesh(Engine::TerrainQuadTree::GRID_RESOLUTION / 2);
+}
+
+void Engine::Terrain::createGridMesh(unsigned int resolution)
+{
+	const unsigned int side = resolution + 1;
+	std::vector<float> vertices(side * side * 3);
+	std::vector<float> normals(side * side * 3);
+	std::vector<float> uv(side * side * 2);
+	for (unsigned int z = 0; z < side; z++)
+	{
+		for (unsigned int x = 0; x < side; x++)
+		{
+			const unsigned int v = z * side + x;
+			vertices[v * 3] = float(x) / float(resolution);
+			vertices[v * 3 + 1] = 0.0f;
+			vertices[v * 3 + 2] = float(z) / float(resolution);
+
+			normals[v * 3] = 0.0f;
+			normals[v * 3 + 1] = 1.0f;
+			normals[v * 3 + 2] = 0.0f;
+
+			uv[v * 2] = vertices[v * 3];
+			uv[v * 2 + 1] = vertices[v * 3 + 2];
+		}
+	}
+
+	// Same winding as the tile
+	std::vector<unsigned int> faces;
+	faces.reserve(resolution * resolution * 6);
+	for (unsigned int z = 0; z < resolution; z++)
+	{
+		for (unsigned int x = 0; x < resolution; x++)
+		{
+			const unsigned int v = z * side + x;
+			faces.push_back(v); faces.push_back(v + side); faces.push_back(v + 1);
+			faces.push_back(v + 1); faces.push_back(v + side); faces.push_back(v + side + 1);
+		}
+	}
+
+	Engine::Mesh grid(resolution * resolution * 2, side * side, faces.data(), vertices.data(), 0, normals.data(), uv.data(), 0, 0, false);
+	grid.optimize();
+	grid.setVertexFormat(Engine::VertexFormat::quantized());
+	grid.syncGPU();
+	Engine::MeshTable::getInstance().addMeshToCache("terrain_grid_" + std::to_string(resolution), grid);
 }
 
 // ====================================================================================================================
@@ -216,4 +563,9 @@ float Engine::Terrain::getTileScale()
 unsigned int Engine::Terrain::getRenderRadius()
 {
 	return renderRadius;
+}
+
+const std::vector<Engine::TerrainComponent*> & Engine::Terrain::getComponents() const
+{
+	return renderableComponents;
 }
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include "TerrainHeightField.h"
+
+#include <cmath>
+#include <vector>
+
+#include "WorldConfig.h"
+#include "util/Simd.h"
+
+namespace
+{
+	// Octaves crossed by more lattice lines than this per side are bounded by [0, amplitude]
+	// instead of evaluating their lattice (their amplitude is negligible by then)
+	const unsigned int MAX_RANGE_LATTICE_LINES = 32;
+	// Covers the rounding differences between the octave ranges and their sum
+	const float RANGE_MARGIN = 1e-5f;
+
+	// Integer hash of a noise lattice point into [0, 1). Same as LatticeValue() in the terrain shaders
+	const unsigned int HASH_X = 0x8DA6B343u;
+	const unsigned int HASH_Y = 0xD8163841u;
+	const unsigned int HASH_MIX0 = 0x7FEB352Du;
+	const unsigned int HASH_MIX1 = 0x846CA68Bu;
+
+	inline float latticeValue(float x, float y)
+	{
+		unsigned int h = ((unsigned int)(int)x * HASH_X) ^ ((unsigned int)(int)y * HASH_Y);
+		h = (h ^ (h >> 16)) * HASH_MIX0;
+		h = (h ^ (h >> 15)) * HASH_MIX1;
+		h ^= h >> 16;
+		return float(h >> 8) * (1.0f / 16777216.0f);
+	}
+
+	inline float noiseInterpolation(float u, float v, float size)
+	{
+		const float gridX = u * size;
+		const float gridY = v * size;
+
+		const float inputX = floorf(gridX);
+		const float inputY = floorf(gridY);
+		float weightX = gridX - inputX;
+		float weightY = gridY - inputY;
+
+		const float p0 = latticeValue(inputX, inputY);
+		const float p1 = latticeValue(inputX + 1.0f, inputY);
+		const float p2 = latticeValue(inputX, inputY + 1.0f);
+		const float p3 = latticeValue(inputX + 1.0f, inputY + 1.0f);
+
+		// smoothstep(0, 1, x), the weights are already within [0, 1]
+		weightX = weightX * weightX * (3.0f - 2.0f * weightX);
+		weightY = weightY * weightY * (3.0f - 2.0f * weightY);
+
+		return p0 +
+			(p1 - p0) * weightX +
+			(p2 - p0) * weightY * (1.0f - weightX) +
+			(p3 - p1) * (weightY * weightX);
+	}
+
+	inline Engine::Simd::Float4 latticeValue(Engine::Simd::Float4 x, Engine::Simd::Float4 y)
+	{
+		using namespace Engine::Simd;
+		Int4 h = bitXor(mul(toInt(x), set1(HASH_X)), mul(toInt(y), set1(HASH_Y)));
+		h = mul(bitXor(h, shiftRight(h, 16)), set1(HASH_MIX0));
+		h = mul(bitXor(h, shiftRight(h, 15)), set1(HASH_MIX1));
+		h = bitXor(h, shiftRight(h, 16));
+		return mul(toFloat(shiftRight(h, 8)), set1(1.0f / 16777216.0f));
+	}
+
+	inline Engine::Simd::Float4 noiseInterpolation(Engine::Simd::Float4 u, Engine::Simd::Float4 v, Engine::Simd::Float4 size)
+	{
+		using namespace Engine::Simd;
+		const Float4 one = set1(1.0f);
+
+		const Float4 gridX = mul(u, size);
+		const Float4 gridY = mul(v, size);
+
+		const Float4 inputX = floor(gridX);
+		const Float4 inputY = floor(gridY);
+		Float4 weightX = sub(gridX, inputX);
+		Float4 weightY = sub(gridY, inputY);
+
+		const Float4 p0 = latticeValue(inputX, inputY);
+		const Float4 p1 = latticeValue(add(inputX, one), inputY);
+		const Float4 p2 = latticeValue(inputX, add(inputY, one));
+		const Float4 p3 = latticeValue(add(inputX, one), add(inputY, one));
+
+		weightX = mul(mul(weightX, weightX), sub(set1(3.0f), mul(set1(2.0f), weightX)));
+		weightY = mul(mul(weightY, weightY), sub(set1(3.0f), mul(set1(2.0f), weightY)));
+
+		Float4 result = add(p0, mul(sub(p1, p0), weightX));
+		result = add(result, mul(mul(sub(p2, p0), weightY), sub(one, weightX)));
+		return add(result, mul(sub(p3, p1), mul(weightY, weightX)));
+	}
+}
+
+Engine::TerrainHeightField::TerrainHeightField()
+	:params(getSettingsParameters())
+{
+}
+
+Engine::TerrainHeightField::TerrainHeightField(const Engine::TerrainHeightField::Parameters & parameters)
+	:params(parameters)
+{
+}
+
+Engine::TerrainHeightField::Parameters Engine::TerrainHeightField::getSettingsParameters()
+{
+	Parameters parameters;
+	parameters.amplitude = Engine::Settings::terrainAmplitude;
+	parameters.frecuency = Engine::Settings::terrainFrecuency;
+	parameters.scale = Engine::Settings::terrainScale;
+	parameters.octaves = Engine::Settings::terrainOctaves;
+	parameters.tileWidth = Engine::Settings::worldTileScale;
+	return parameters;
+}
+
+void Engine::TerrainHeightField::update()
+{
+	params = getSettingsParameters();
+}
+
+void Engine::TerrainHeightField::setParameters(const Engine::TerrainHeightField::Parameters & parameters)
+{
+	params = parameters;
+}
+
+const Engine::TerrainHeightField::Parameters & Engine::TerrainHeightField::getParameters() const
+{
+	return params;
+}
+
+float Engine::TerrainHeightField::getNoiseHeight(float u, float v) const
+{
+	float noiseValue = 0.0f;
+
+	float localAmplitude = params.amplitude;
+	float localFrecuency = params.frecuency;
+
+	for (unsigned int index = 0; index < params.octaves; index++)
+	{
+		noiseValue += noiseInterpolation(u, v, params.scale * localFrecuency) * localAmplitude;
+
+		localAmplitude /= 2.0f;
+		localFrecuency *= 2.0f;
+	}
+
+	return noiseValue * noiseValue * noiseValue;
+}
+
+void Engine::TerrainHeightField::getNoiseHeights(const float * u, const float * v, float * heights, size_t count) const
+{
+	size_t i = 0;
+	for (; i + BATCH_SIZE <= count; i += BATCH_SIZE)
+	{
+		computeNoiseHeights(u + i, v + i, heights + i);
+	}
+
+	// Pad the last batch with the last sample
+	if (i < count)
+	{
+		float padU[BATCH_SIZE], padV[BATCH_SIZE], padHeights[BATCH_SIZE];
+		for (size_t j = 0; j < BATCH_SIZE; j++)
+		{
+			const size_t src = i + j < count ? i + j : count - 1;
+			padU[j] = u[src];
+			padV[j] = v[src];
+		}
+		computeNoiseHeights(padU, padV, padHeights);
+		for (size_t j = 0; i + j < count; j++)
+		{
+			heights[i + j] = padHeights[j];
+		}
+	}
+}
+
+float Engine::TerrainHeightField::getHeight(float x, float z) const
+{
+	// The terrain shaders sample the noise at the absolute tile coordinates
+	return getNoiseHeight(fabsf(x / params.tileWidth), fabsf(z / params.tileWidth)) * 1.5f * params.tileWidth;
+}
+
+void Engine::TerrainHeightField::getHeights(const float * x, const float * z, float * heights, size_t count) const
+{
+	float u[BATCH_SIZE], v[BATCH_SIZE];
+	for (size_t i = 0; i < count; i += BATCH_SIZE)
+	{
+		const size_t batch = count - i < BATCH_SIZE ? count - i : BATCH_SIZE;
+		for (size_t j = 0; j < batch; j++)
+		{
+			u[j] = fabsf(x[i + j] / params.tileWidth);
+			v[j] = fabsf(z[i + j] / params.tileWidth);
+		}
+
+		getNoiseHeights(u, v, heights + i, batch);
+		for (size_t j = 0; j < batch; j++)
+		{
+			heights[i + j] = heights[i + j] * 1.5f * params.tileWidth;
+		}
+	}
+}
+
+void Engine::TerrainHeightField::getHeightGrid(float x, float z, float spacing, unsigned int columns, unsigned int rows, float * heights) const
+{
+	std::vector<float> rowX(columns), rowZ(columns);
+	for (unsigned int c = 0; c < columns; c++)
+	{
+		rowX[c] = x + float(c) * spacing;
+	}
+
+	for (unsigned int r = 0; r < rows; r++)
+	{
+		const float rowPosition = z + float(r) * spacing;
+		for (unsigned int c = 0; c < columns; c++)
+		{
+			rowZ[c] = rowPosition;
+		}
+		getHeights(rowX.data(), rowZ.data(), heights + size_t(r) * columns, columns);
+	}
+}
+
+void Engine::TerrainHeightField::getNoiseRange(float u0, float v0, float u1, float v1, float & minHeight, float & maxHeight) const
+{
+	float minNoise = 0.0f;
+	float maxNoise = 0.0f;
+
+	float localAmplitude = params.amplitude;
+	float localFrecuency = params.frecuency;
+
+	std::vector<float> pointsU, pointsV;
+	for (unsigned int index = 0; index < params.octaves; index++)
+	{
+		const float size = params.scale * localFrecuency;
+		const float firstU = floorf(u0 * size) + 1.0f, lastU = ceilf(u1 * size) - 1.0f;
+		const float firstV = floorf(v0 * size) + 1.0f, lastV = ceilf(v1 * size) - 1.0f;
+
+		if (size <= 0.0f || lastU - firstU >= float(MAX_RANGE_LATTICE_LINES) || lastV - firstV >= float(MAX_RANGE_LATTICE_LINES))
+		{
+			// Lattice values lie within [0, 1)
+			maxNoise += localAmplitude;
+		}
+		else
+		{
+			// Rectangle corners and the lattice lines crossing it
+			pointsU.clear();
+			pointsV.clear();
+			pointsU.push_back(u0);
+			pointsV.push_back(v0);
+			for (float line = firstU; line <= lastU; line += 1.0f)
+			{
+				pointsU.push_back(line / size);
+			}
+			for (float line = firstV; line <= lastV; line += 1.0f)
+			{
+				pointsV.push_back(line / size);
+			}
+			pointsU.push_back(u1);
+			pointsV.push_back(v1);
+
+			float octaveMin = 1.0f;
+			float octaveMax = 0.0f;
+			for (float v : pointsV)
+			{
+				for (float u : pointsU)
+				{
+					const float value = noiseInterpolation(u, v, size);
+					octaveMin = value < octaveMin ? value : octaveMin;
+					octaveMax = value > octaveMax ? value : octaveMax;
+				}
+			}
+
+			minNoise += octaveMin * localAmplitude;
+			maxNoise += octaveMax * localAmplitude;
+		}
+
+		localAmplitude /= 2.0f;
+		localFrecuency *= 2.0f;
+	}
+
+	// The noise sum is positive, so its cube keeps the order
+	minNoise = minNoise - RANGE_MARGIN > 0.0f ? minNoise - RANGE_MARGIN : 0.0f;
+	maxNoise += RANGE_MARGIN;
+	minHeight = minNoise * minNoise * minNoise;
+	maxHeight = maxNoise * maxNoise * maxNoise;
+}
+
+void Engine::TerrainHeightField::getTileRange(int i, int j, float & minHeight, float & maxHeight) const
+{
+	// The terrain shaders sample the noise at the absolute tile coordinates
+	const float u0 = i >= 0 ? float(i) : -float(i + 1);
+	const float v0 = j >= 0 ? float(j) : -float(j + 1);
+	getNoiseRange(u0, v0, u0 + 1.0f, v0 + 1.0f, minHeight, maxHeight);
+
+	minHeight *= 1.5f * params.tileWidth;
+	maxHeight *= 1.5f * params.tileWidth;
+}
+
+void Engine::TerrainHeightField::computeNoiseHeights(const float * u, const float * v, float * heights) const
+{
+	using namespace Engine::Simd;
+
+	// Two independent 4 wide halves, so their latencies overlap
+	const Float4 u0 = load(u), u1 = load(u + 4);
+	const Float4 v0 = load(v), v1 = load(v + 4);
+	Float4 noise0 = set1(0.0f), noise1 = set1(0.0f);
+
+	float localAmplitude = params.amplitude;
+	float localFrecuency = params.frecuency;
+
+	for (unsigned int index = 0; index < params.octaves; index++)
+	{
+		const Float4 size = set1(params.scale * localFrecuency);
+		const Float4 amplitude = set1(localAmplitude);
+		noise0 = add(noise0, mul(noiseInterpolation(u0, v0, size), amplitude));
+		noise1 = add(noise1, mul(noiseInterpolation(u1, v1, size), amplitude));
+
+		localAmplitude /= 2.0f;
+		localFrecuency *= 2.0f;
+	}
+
+	store(heights, mul(mul(noise0, noise0), noise0));
+	store(heights + 4, mul(mul(noise1, noise1), noise1));
+}
\ No newline at end of file
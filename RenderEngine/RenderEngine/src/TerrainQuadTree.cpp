@@ -0,0 +1,158 @@
+#include "TerrainQuadTree.h"
+
+#include <cmath>
+
+Engine::TerrainQuadTree::TerrainQuadTree()
+{
+	Parameters defaults = { 1.0f, GRID_RESOLUTION, 4.0f, 1080.0f, 1.0f, 12.0f, 0.0f, 1.0f, 0.3f, 12 };
+	configure(defaults);
+}
+
+void Engine::TerrainQuadTree::configure(const Engine::TerrainQuadTree::Parameters & parameters)
+{
+	params = parameters;
+	params.gridResolution = params.gridResolution < 2 ? 2 : params.gridResolution & ~1u;
+	params.maxLevels = params.maxLevels < 1 ? 1 : params.maxLevels;
+	params.morphRatio = params.morphRatio < 0.01f ? 0.01f : params.morphRatio > 0.99f ? 0.99f : params.morphRatio;
+
+	const float height = params.maxHeight - params.minHeight;
+	const float pixelsPerUnit = params.viewportHeight * params.projectionScale / (2.0f * params.pixelError);
+
+	// A node of size s drawn with the grid has a spacing of s / gridResolution, which projects
+	// to pixelError pixels at spacing * pixelsPerUnit. Besides that, each range must exceed the
+	// previous one by the diagonal of the previous level nodes (over the morph area), so the
+	// levels of neighbour nodes differ by one at most and their vertices are not morphing to
+	// different grids where they meet
+	ranges.clear();
+	float size = params.leafSize;
+	float previousRange = 0.0f;
+	float previousDiagonal = 0.0f;
+	for (unsigned int level = 0; level < params.maxLevels; level++)
+	{
+		float range = size / float(params.gridResolution) * pixelsPerUnit;
+		const float minRange = previousRange + previousDiagonal / (1.0f - params.morphRatio);
+		range = range < minRange ? minRange : range;
+		ranges.push_back(range);
+
+		if (range >= params.viewDistance)
+		{
+			break;
+		}
+
+		previousRange = range;
+		previousDiagonal = sqrtf(2.0f * size * size + height * height);
+		size *= 2.0f;
+	}
+
+	// The top level covers everything up to the view distance
+	ranges.back() = ranges.back() < params.viewDistance ? params.viewDistance : ranges.back();
+}
+
+const Engine::TerrainQuadTree::Parameters & Engine::TerrainQuadTree::getParameters() const
+{
+	return params;
+}
+
+const std::vector<float> & Engine::TerrainQuadTree::getRanges() const
+{
+	return ranges;
+}
+
+unsigned int Engine::TerrainQuadTree::getNumLevels() const
+{
+	return (unsigned int)ranges.size();
+}
+
+size_t Engine::TerrainQuadTree::select(const glm::vec3 & cameraPosition, const Engine::Frustum * frustums, unsigned int numFrustums, std::vector<Engine::TerrainQuadTree::Node> & selection) const
+{
+	// Root nodes covering the view distance around the camera, aligned to their size
+	const unsigned int topLevel = getNumLevels() - 1;
+	const float rootSize = params.leafSize * float(1u << topLevel);
+	const int xStart = (int)floorf((cameraPosition.x - params.viewDistance) / rootSize);
+	const int xEnd = (int)floorf((cameraPosition.x + params.viewDistance) / rootSize);
+	const int zStart = (int)floorf((cameraPosition.z - params.viewDistance) / rootSize);
+	const int zEnd = (int)floorf((cameraPosition.z + params.viewDistance) / rootSize);
+
+	size_t culled = 0;
+	for (int i = xStart; i <= xEnd; i++)
+	{
+		for (int j = zStart; j <= zEnd; j++)
+		{
+			selectNode(float(i) * rootSize, float(j) * rootSize, topLevel, cameraPosition, frustums, numFrustums, selection, culled);
+		}
+	}
+
+	return culled;
+}
+
+bool Engine::TerrainQuadTree::selectNode(float x, float z, unsigned int level, const glm::vec3 & cameraPosition, const Engine::Frustum * frustums, unsigned int numFrustums, std::vector<Engine::TerrainQuadTree::Node> & selection, size_t & culled) const
+{
+	const float size = params.leafSize * float(1u << level);
+	if (!intersectsRange(x, z, size, ranges[level], cameraPosition))
+	{
+		return false;
+	}
+
+	// Culled nodes count as handled, so their parent does not draw them either
+	if (frustums != 0)
+	{
+		const glm::vec3 boundsMin(x, params.minHeight, z);
+		const glm::vec3 boundsMax(x + size, params.maxHeight, z + size);
+		bool inside = false;
+		for (unsigned int i = 0; i < numFrustums && !inside; i++)
+		{
+			inside = frustums[i].intersects(boundsMin, boundsMax);
+		}
+
+		if (!inside)
+		{
+			culled++;
+			return true;
+		}
+	}
+
+	if (level == 0 || !intersectsRange(x, z, size, ranges[level - 1], cameraPosition))
+	{
+		addNode(x, z, size, level, params.gridResolution, selection);
+		return true;
+	}
+
+	// Children areas out of their range are drawn by this node, at this level detail
+	const float childSize = size * 0.5f;
+	for (unsigned int c = 0; c < 4; c++)
+	{
+		const float childX = x + float(c & 1) * childSize;
+		const float childZ = z + float(c >> 1) * childSize;
+		if (!selectNode(childX, childZ, level - 1, cameraPosition, frustums, numFrustums, selection, culled))
+		{
+			addNode(childX, childZ, childSize, level, params.gridResolution / 2, selection);
+		}
+	}
+
+	return true;
+}
+
+bool Engine::TerrainQuadTree::intersectsRange(float x, float z, float size, float range, const glm::vec3 & cameraPosition) const
+{
+	// Distance from the camera to the node bounds
+	const float dx = cameraPosition.x < x ? x - cameraPosition.x : cameraPosition.x > x + size ? cameraPosition.x - x - size : 0.0f;
+	const float dy = cameraPosition.y < params.minHeight ? params.minHeight - cameraPosition.y : cameraPosition.y > params.maxHeight ? cameraPosition.y - params.maxHeight : 0.0f;
+	const float dz = cameraPosition.z < z ? z - cameraPosition.z : cameraPosition.z > z + size ? cameraPosition.z - z - size : 0.0f;
+
+	return dx * dx + dy * dy + dz * dz <= range * range;
+}
+
+void Engine::TerrainQuadTree::addNode(float x, float z, float size, unsigned int level, unsigned int gridResolution, std::vector<Engine::TerrainQuadTree::Node> & selection) const
+{
+	const float previousRange = level > 0 ? ranges[level - 1] : 0.0f;
+
+	Node node;
+	node.x = x;
+	node.z = z;
+	node.size = size;
+	node.level = level;
+	node.gridResolution = gridResolution;
+	node.morphEnd = ranges[level];
+	node.morphStart = ranges[level] - (ranges[level] - previousRange) * params.morphRatio;
+	selection.push_back(node);
+}
\ No newline at end of file
@@ -0,0 +1,365 @@
+#include "TerrainTileCache.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Threadpool.h"
+
+// Finite differences step and height scale of computeNormal() in terrain.frag
+static const float NORMAL_STEP = 0.01f;
+static const float NORMAL_HEIGHT_SCALE = 0.01f;
+
+Engine::TerrainTileCache::TerrainTileCache(const Engine::TerrainTileCache::Parameters & parameters, const Engine::TerrainHeightField::Parameters & heightParameters)
+	:params(parameters), generation(0), pendingTasks(0), frame(~0ull)
+{
+	params.resolution = params.resolution < 2 ? 2 : params.resolution;
+	params.maxPendingTiles = params.maxPendingTiles < 1 ? 1 : params.maxPendingTiles;
+
+	texelsPerTile = size_t(params.resolution) * size_t(params.resolution);
+	numSlots = (unsigned int)(params.memoryBudget / getTileBytes(params.resolution));
+
+	heights.resize(texelsPerTile * numSlots);
+	normals.resize(texelsPerTile * numSlots * 4);
+	slotTiles.resize(numSlots);
+
+	// Popped from the back, so the first slots are used first
+	freeSlots.reserve(numSlots);
+	for (unsigned int slot = numSlots; slot > 0; slot--)
+	{
+		freeSlots.push_back(slot - 1);
+	}
+
+	heightField = std::make_shared<const TerrainHeightField>(heightParameters);
+
+	stats = {};
+	stats.slots = numSlots;
+	stats.memoryBudget = params.memoryBudget;
+}
+
+Engine::TerrainTileCache::~TerrainTileCache()
+{
+	flush();
+}
+
+void Engine::TerrainTileCache::update(unsigned long long frameNumber, const glm::vec2 & cameraTile, const glm::vec2 & velocity, unsigned int radius)
+{
+	newTiles.clear();
+	collectCompleted();
+
+	if (frameNumber == frame)
+	{
+		return;
+	}
+
+	frame = frameNumber;
+	stats.hits = stats.misses = 0;
+
+	// Visible area first, nearest tiles first. Then the area around the predicted position
+	requests.clear();
+	addRequests(cameraTile, radius, cameraTile, false);
+
+	glm::vec2 ahead = velocity * params.prefetchTime;
+	const float aheadLength = glm::length(ahead);
+	if (aheadLength > params.maxPrefetchDistance)
+	{
+		ahead *= params.maxPrefetchDistance / aheadLength;
+	}
+	if (glm::length(ahead) >= 1.0f)
+	{
+		addRequests(cameraTile + ahead, radius, cameraTile + ahead, true);
+	}
+
+	std::stable_sort(requests.begin(), requests.end(), [](const Request & a, const Request & b)
+	{
+		return a.prefetch != b.prefetch ? !a.prefetch : a.distance < b.distance;
+	});
+
+	for (const Request & request : requests)
+	{
+		if (pendingTasks.load() >= params.maxPendingTiles || !requestTile(request))
+		{
+			break;
+		}
+	}
+
+	stats.pendingTiles = pendingTasks.load();
+}
+
+void Engine::TerrainTileCache::setHeightParameters(const Engine::TerrainHeightField::Parameters & heightParameters)
+{
+	const TerrainHeightField::Parameters & current = heightField->getParameters();
+	if (current.amplitude == heightParameters.amplitude && current.frecuency == heightParameters.frecuency
+		&& current.scale == heightParameters.scale && current.octaves == heightParameters.octaves
+		&& current.tileWidth == heightParameters.tileWidth)
+	{
+		return;
+	}
+
+	clear();
+	heightField = std::make_shared<const TerrainHeightField>(heightParameters);
+}
+
+void Engine::TerrainTileCache::flush()
+{
+	Engine::Concurrent::ThreadPool::getInstance().helpUntil([this]()
+	{
+		return pendingTasks.load() == 0;
+	});
+	collectCompleted();
+	stats.pendingTiles = 0;
+}
+
+int Engine::TerrainTileCache::acquire(int i, int j)
+{
+	auto it = tiles.find(getKey(i, j));
+	if (it == tiles.end() || it->second.state != TILE_RESIDENT)
+	{
+		stats.misses++;
+		return -1;
+	}
+
+	Tile & tile = it->second;
+	tile.lastUse = frame;
+	lru.splice(lru.end(), lru, tile.lruPosition);
+	stats.hits++;
+	return int(tile.slot);
+}
+
+const std::vector<unsigned int> & Engine::TerrainTileCache::getNewTiles() const
+{
+	return newTiles;
+}
+
+const float * Engine::TerrainTileCache::getSlotHeights(unsigned int slot) const
+{
+	return heights.data() + texelsPerTile * slot;
+}
+
+const signed char * Engine::TerrainTileCache::getSlotNormals(unsigned int slot) const
+{
+	return normals.data() + texelsPerTile * slot * 4;
+}
+
+const Engine::TerrainTileCache::Parameters & Engine::TerrainTileCache::getParameters() const
+{
+	return params;
+}
+
+unsigned int Engine::TerrainTileCache::getNumSlots() const
+{
+	return numSlots;
+}
+
+const Engine::TerrainTileCache::Statistics & Engine::TerrainTileCache::getStatistics() const
+{
+	return stats;
+}
+
+size_t Engine::TerrainTileCache::getTileBytes(unsigned int resolution)
+{
+	// 32 bit height and 4 byte normal per texel
+	return size_t(resolution) * size_t(resolution) * (sizeof(float) + 4);
+}
+
+long long Engine::TerrainTileCache::getKey(int i, int j)
+{
+	return (long long)(((unsigned long long)(unsigned int)i << 32) | (unsigned long long)(unsigned int)j);
+}
+
+void Engine::TerrainTileCache::collectCompleted()
+{
+	std::vector<CompletedTile> done;
+	{
+		std::unique_lock<std::mutex> guard(completedLock);
+		done.swap(completed);
+	}
+
+	for (const CompletedTile & result : done)
+	{
+		// Tiles requested before the last clear() are dropped, their slot was kept until now
+		auto it = tiles.find(slotTiles[result.slot]);
+		if (result.generation != generation || it == tiles.end() || it->second.slot != result.slot)
+		{
+			freeSlots.push_back(result.slot);
+			continue;
+		}
+
+		Tile & tile = it->second;
+		tile.state = TILE_RESIDENT;
+		tile.lastUse = frame;
+		tile.lruPosition = lru.insert(lru.end(), it->first);
+		newTiles.push_back(result.slot);
+		stats.generatedTiles++;
+	}
+
+	stats.residentTiles = (unsigned int)lru.size();
+	stats.memoryUsed = size_t(numSlots - freeSlots.size()) * getTileBytes(params.resolution);
+}
+
+void Engine::TerrainTileCache::addRequests(const glm::vec2 & center, unsigned int radius, const glm::vec2 & distanceOrigin, bool prefetch)
+{
+	// Same tile range the terrain draws around the camera
+	const int x = (int)floorf(center.x);
+	const int y = (int)floorf(center.y);
+	const int r = int(radius);
+
+	for (int i = x - r; i < x + r; i++)
+	{
+		for (int j = y - r; j < y + r; j++)
+		{
+			auto it = tiles.find(getKey(i, j));
+			if (it != tiles.end())
+			{
+				// Keep the tiles about to be visible away from the eviction
+				if (prefetch && it->second.state == TILE_RESIDENT)
+				{
+					lru.splice(lru.end(), lru, it->second.lruPosition);
+				}
+				continue;
+			}
+
+			const glm::vec2 tileCenter(float(i) + 0.5f, float(j) + 0.5f);
+			Request request = { i, j, glm::length(tileCenter - distanceOrigin), prefetch };
+			requests.push_back(request);
+		}
+	}
+}
+
+bool Engine::TerrainTileCache::requestTile(const Engine::TerrainTileCache::Request & request)
+{
+	const long long key = getKey(request.i, request.j);
+	if (tiles.find(key) != tiles.end())
+	{
+		// Requested by both areas
+		return true;
+	}
+
+	if (freeSlots.empty())
+	{
+		// Evict the least recently used tile, unless it was drawn on this frame or the previous one
+		// (the budget does not hold the visible tiles, evicting them would only trash the cache)
+		if (lru.empty() || tiles[lru.front()].lastUse + 1 >= frame)
+		{
+			stats.budgetStalls++;
+			return false;
+		}
+		evict(lru.front());
+	}
+
+	const unsigned int slot = freeSlots.back();
+	freeSlots.pop_back();
+
+	Tile tile;
+	tile.i = request.i;
+	tile.j = request.j;
+	tile.slot = slot;
+	tile.state = TILE_PENDING;
+	tile.lastUse = frame;
+	tiles[key] = tile;
+	slotTiles[slot] = key;
+
+	if (request.prefetch)
+	{
+		stats.prefetchedTiles++;
+	}
+
+	pendingTasks++;
+	std::shared_ptr<const TerrainHeightField> field = heightField;
+	const unsigned int tileGeneration = generation;
+	const int i = request.i;
+	const int j = request.j;
+	Engine::Concurrent::ThreadPool::getInstance().execute([this, field, slot, tileGeneration, i, j]()
+	{
+		generateTile(*field, slot, i, j);
+
+		std::unique_lock<std::mutex> guard(completedLock);
+		CompletedTile result = { slot, tileGeneration };
+		completed.push_back(result);
+		pendingTasks--;
+	});
+
+	return true;
+}
+
+void Engine::TerrainTileCache::evict(long long key)
+{
+	auto it = tiles.find(key);
+	lru.erase(it->second.lruPosition);
+	freeSlots.push_back(it->second.slot);
+	tiles.erase(it);
+	stats.evictedTiles++;
+}
+
+void Engine::TerrainTileCache::clear()
+{
+	// Resident tiles release their slots now, the ones being generated when they finish
+	for (auto & entry : tiles)
+	{
+		if (entry.second.state == TILE_RESIDENT)
+		{
+			freeSlots.push_back(entry.second.slot);
+		}
+	}
+
+	tiles.clear();
+	lru.clear();
+	generation++;
+
+	stats.residentTiles = 0;
+	stats.memoryUsed = size_t(numSlots - freeSlots.size()) * getTileBytes(params.resolution);
+}
+
+void Engine::TerrainTileCache::generateTile(const Engine::TerrainHeightField & field, unsigned int slot, int i, int j)
+{
+	const unsigned int res = params.resolution;
+	float * tileHeights = heights.data() + texelsPerTile * slot;
+	signed char * tileNormals = normals.data() + texelsPerTile * slot * 4;
+
+	// Noise coordinates of a row of texels and of their finite differences neighbours
+	std::vector<float> u(res), v(res), du(res), dv(res);
+	std::vector<float> right(res), left(res), top(res), bottom(res);
+
+	for (unsigned int b = 0; b < res; b++)
+	{
+		const float rowV = fabsf(float(j) + float(b) / float(res - 1));
+		for (unsigned int a = 0; a < res; a++)
+		{
+			// Same coordinates as the terrain shaders (absolute tile position)
+			u[a] = fabsf(float(i) + float(a) / float(res - 1));
+			v[a] = rowV;
+		}
+
+		field.getNoiseHeights(u.data(), v.data(), tileHeights + size_t(b) * res, res);
+
+		for (unsigned int a = 0; a < res; a++)
+		{
+			du[a] = u[a] + NORMAL_STEP;
+			dv[a] = v[a] + NORMAL_STEP;
+		}
+		field.getNoiseHeights(du.data(), v.data(), right.data(), res);
+		field.getNoiseHeights(u.data(), dv.data(), top.data(), res);
+
+		for (unsigned int a = 0; a < res; a++)
+		{
+			du[a] = u[a] - NORMAL_STEP;
+			dv[a] = v[a] - NORMAL_STEP;
+		}
+		field.getNoiseHeights(du.data(), v.data(), left.data(), res);
+		field.getNoiseHeights(u.data(), dv.data(), bottom.data(), res);
+
+		for (unsigned int a = 0; a < res; a++)
+		{
+			const glm::vec3 normal = glm::normalize(glm::vec3(
+				left[a] * NORMAL_HEIGHT_SCALE - right[a] * NORMAL_HEIGHT_SCALE,
+				NORMAL_STEP * NORMAL_STEP,
+				bottom[a] * NORMAL_HEIGHT_SCALE - top[a] * NORMAL_HEIGHT_SCALE));
+
+			signed char * texel = tileNormals + (size_t(b) * res + a) * 4;
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				texel[c] = (signed char)lroundf(glm::clamp(normal[c], -1.0f, 1.0f) * 127.0f);
+			}
+			texel[3] = 0;
+		}
+	}
+}
\ No newline at end of file
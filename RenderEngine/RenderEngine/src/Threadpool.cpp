@@ -2,6 +2,74 @@
 
 #include <iostream>
 
+// Index of the pool worker running on this thread (-1 for threads outside the pool)
+static thread_local int currentWorkerIndex = -1;
+
+// ===================================================================
+
+Engine::Concurrent::WorkQueue::WorkQueue()
+	:head(0), tail(0)
+{
+	ring.resize(64);
+}
+
+void Engine::Concurrent::WorkQueue::push(Engine::Concurrent::Task && task)
+{
+	std::unique_lock<std::mutex> guard(lock);
+
+	size_t capacity = ring.size();
+	if (tail - head == capacity)
+	{
+		// Full, double the ring keeping the tasks order
+		std::vector<Task> newRing(capacity * 2);
+		for (size_t i = head; i < tail; i++)
+		{
+			newRing[i - head] = std::move(ring[i & (capacity - 1)]);
+		}
+		ring.swap(newRing);
+		tail = tail - head;
+		head = 0;
+		capacity = ring.size();
+	}
+
+	ring[tail & (capacity - 1)] = std::move(task);
+	tail++;
+}
+
+bool Engine::Concurrent::WorkQueue::pop(Engine::Concurrent::Task & task)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	if (head == tail)
+	{
+		return false;
+	}
+
+	tail--;
+	task = std::move(ring[tail & (ring.size() - 1)]);
+	return true;
+}
+
+bool Engine::Concurrent::WorkQueue::steal(Engine::Concurrent::Task & task)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	if (head == tail)
+	{
+		return false;
+	}
+
+	task = std::move(ring[head & (ring.size() - 1)]);
+	head++;
+	return true;
+}
+
+bool Engine::Concurrent::WorkQueue::empty()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	return head == tail;
+}
+
+// ===================================================================
+
 Engine::Concurrent::ThreadPool * Engine::Concurrent::ThreadPool::INSTANCE = new Engine::Concurrent::ThreadPool();
 
 Engine::Concurrent::ThreadPool & Engine::Concurrent::ThreadPool::getInstance()
@@ -10,20 +78,32 @@ Engine::Concurrent::ThreadPool & Engine::Concurrent::ThreadPool::getInstance()
 }
 
 Engine::Concurrent::ThreadPool::ThreadPool()
+	:sleepingWorkers(0), queuedTasks(0), nextExternalQueue(0), active(false), poolSize(0)
 {
 	init();
 	std::cout << "ThreadPool: Using " << poolSize << " thread(s)" << std::endl;
 }
 
-void Engine::Concurrent::ThreadPool::init()
+void Engine::Concurrent::ThreadPool::init(unsigned int numThreads)
 {
-	active = true;
-	poolSize = std::thread::hardware_concurrency();
-	poolSize = poolSize < 1 ? 1 : poolSize;
+	// The thread waiting for results also executes tasks, so leave a core for it
+	poolSize = numThreads;
+	if (poolSize == 0)
+	{
+		poolSize = std::thread::hardware_concurrency();
+		poolSize = poolSize > 1 ? poolSize - 1 : 1;
+	}
+
+	queues.clear();
+	for (unsigned i = 0; i < poolSize; i++)
+	{
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+	}
 
+	active = true;
 	for (unsigned i = 0; i < poolSize; i++)
 	{
-		std::thread t(&Engine::Concurrent::ThreadPool::pollTask, this);
+		std::thread t(&Engine::Concurrent::ThreadPool::workerLoop, this, i);
 		pool.push_back(std::move(t));
 	}
 }
@@ -35,45 +115,181 @@ Engine::Concurrent::ThreadPool::~ThreadPool()
 
 void Engine::Concurrent::ThreadPool::shutDown()
 {
+	if (!active)
+	{
+		return;
+	}
+
 	active = false;
-	std::unique_lock<std::mutex> lock(globalLock);
+	std::unique_lock<std::mutex> lock(sleepLock);
 	monitor.notify_all();
 	lock.unlock();
 	for (auto & thread : pool)
 	{
 		thread.join();
 	}
+	pool.clear();
 }
 
-void Engine::Concurrent::ThreadPool::addTask(std::unique_ptr<Engine::Concurrent::Runnable> task)
+int Engine::Concurrent::ThreadPool::getCurrentWorkerIndex() const
 {
-	std::unique_lock<std::mutex> lock(globalLock);
-	tasks.push(std::move(task));
-	lock.unlock();
-	monitor.notify_one();
+	return currentWorkerIndex;
 }
 
-void Engine::Concurrent::ThreadPool::pollTask()
+void Engine::Concurrent::ThreadPool::schedule(Engine::Concurrent::Task && task)
 {
-	while (active)
+	// Workers push to their own queue, everyone else spreads the tasks round robin
+	int index = currentWorkerIndex;
+	if (index < 0)
+	{
+		index = int(nextExternalQueue.fetch_add(1, std::memory_order_relaxed) % poolSize);
+	}
+
+	queues[index]->push(std::move(task));
+	queuedTasks.fetch_add(1);
+
+	// Only pay for the wake up when someone is asleep. Paired with the check done by
+	// the workers under sleepLock, so a wake up can not be lost
+	if (sleepingWorkers.load() > 0)
 	{
-		std::unique_lock<std::mutex> lock(globalLock);
-		while (tasks.empty() && active)
+		std::unique_lock<std::mutex> lock(sleepLock);
+		lock.unlock();
+		monitor.notify_one();
+	}
+}
+
+bool Engine::Concurrent::ThreadPool::findTask(int index, Engine::Concurrent::Task & task)
+{
+	if (queuedTasks.load(std::memory_order_relaxed) == 0)
+	{
+		return false;
+	}
+
+	// Own queue first (newest task), then steal the oldest task of the other queues
+	if (index >= 0 && queues[index]->pop(task))
+	{
+		queuedTasks.fetch_sub(1);
+		return true;
+	}
+
+	const unsigned int start = index >= 0 ? unsigned(index) + 1 : nextExternalQueue.load(std::memory_order_relaxed);
+	for (unsigned int i = 0; i < poolSize; i++)
+	{
+		unsigned int victim = (start + i) % poolSize;
+		if (int(victim) != index && queues[victim]->steal(task))
 		{
-			monitor.wait(lock);
+			queuedTasks.fetch_sub(1);
+			return true;
 		}
+	}
+
+	return false;
+}
 
-		if (!tasks.empty())
+bool Engine::Concurrent::ThreadPool::runPendingTask()
+{
+	Task task;
+	if (findTask(currentWorkerIndex, task))
+	{
+		task();
+		return true;
+	}
+
+	return false;
+}
+
+void Engine::Concurrent::ThreadPool::workerLoop(unsigned int index)
+{
+	currentWorkerIndex = int(index);
+
+	Task task;
+	while (true)
+	{
+		if (findTask(int(index), task))
 		{
-			std::unique_ptr<Runnable> task = std::move(tasks.front());
-			tasks.pop();
-			lock.unlock();
+			task();
+			task.reset();
+			continue;
+		}
 
-			task->run();
+		std::unique_lock<std::mutex> lock(sleepLock);
+		sleepingWorkers.fetch_add(1);
+		while (queuedTasks.load() == 0 && active)
+		{
+			monitor.wait(lock);
 		}
-		else
+		sleepingWorkers.fetch_sub(1);
+
+		// Pending tasks are drained before exiting
+		if (!active && queuedTasks.load() == 0)
 		{
-			lock.unlock();
+			break;
 		}
 	}
-}
\ No newline at end of file
+
+	currentWorkerIndex = -1;
+}
+
+// ===================================================================
+
+void Engine::Concurrent::ParallelLoopContext::process()
+{
+	size_t chunk;
+	while ((chunk = nextChunk.fetch_add(1)) < numChunks)
+	{
+		if (!failed.load(std::memory_order_relaxed))
+		{
+			try
+			{
+				body(func, chunk);
+			}
+			catch (...)
+			{
+				std::unique_lock<std::mutex> guard(errorLock);
+				if (!failed)
+				{
+					error = std::current_exception();
+					failed = true;
+				}
+			}
+		}
+		completedChunks.fetch_add(1, std::memory_order_release);
+	}
+}
+
+void Engine::Concurrent::runParallelChunks(Engine::Concurrent::ParallelLoopContext & context)
+{
+	context.nextChunk = 0;
+	context.completedChunks = 0;
+	context.failed = false;
+
+	ThreadPool & tp = ThreadPool::getInstance();
+
+	// One helper per worker at most, each one grabs chunks until the loop is exhausted
+	unsigned int helpers = unsigned(context.numChunks - 1 < tp.getPoolSize() ? context.numChunks - 1 : tp.getPoolSize());
+	context.runningHelpers = helpers;
+
+	ParallelLoopContext * ctx = &context;
+	for (unsigned int i = 0; i < helpers; i++)
+	{
+		tp.execute([ctx]()
+		{
+			ctx->process();
+			ctx->runningHelpers.fetch_sub(1, std::memory_order_release);
+		});
+	}
+
+	context.process();
+
+	// The context lives on this stack, so every helper must have left it before returning
+	tp.helpUntil([ctx]()
+	{
+		return ctx->runningHelpers.load(std::memory_order_acquire) == 0
+			&& ctx->completedChunks.load(std::memory_order_acquire) == ctx->numChunks;
+	});
+
+	if (context.failed)
+	{
+		std::rethrow_exception(context.error);
+	}
+}
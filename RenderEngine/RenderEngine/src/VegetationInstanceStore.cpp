@@ -0,0 +1,231 @@
+#include "VegetationInstanceStore.h"
+
+#include <algorithm>
+
+#include "Threadpool.h"
+
+Engine::VegetationInstanceStore::VegetationInstanceStore(const Engine::VegetationInstanceStore::Generator & generator, const Engine::VegetationPlacement::Parameters & placementParameters, unsigned int maxPendingTiles)
+	:generator(generator), maxPendingTiles(maxPendingTiles < 1 ? 1 : maxPendingTiles), generation(0), pendingTasks(0),
+	xStart(0), xEnd(0), yStart(0), yEnd(0), missingTiles(0), version(0)
+{
+	placement = std::make_shared<const VegetationPlacement>(placementParameters);
+	stats = {};
+}
+
+Engine::VegetationInstanceStore::~VegetationInstanceStore()
+{
+	flush();
+}
+
+void Engine::VegetationInstanceStore::update(int xStart, int xEnd, int yStart, int yEnd)
+{
+	// Tiles released by clear() since the last update are listed on this one
+	stats.generatedTiles = 0;
+	stats.releasedTiles = (unsigned int)clearedTiles.size();
+	changedTiles.swap(clearedTiles);
+	clearedTiles.clear();
+
+	collectCompleted();
+
+	if (xStart != this->xStart || xEnd != this->xEnd || yStart != this->yStart || yEnd != this->yEnd)
+	{
+		this->xStart = xStart;
+		this->xEnd = xEnd;
+		this->yStart = yStart;
+		this->yEnd = yEnd;
+
+		// Tiles which left the area. The ones being generated are dropped when they finish
+		for (auto it = tiles.begin(); it != tiles.end();)
+		{
+			const int i = int((unsigned long long)it->first >> 32);
+			const int j = int((unsigned long long)it->first & 0xFFFFFFFFull);
+			if (i < xStart || i >= xEnd || j < yStart || j >= yEnd)
+			{
+				if (it->second.state == TILE_RESIDENT)
+				{
+					stats.memoryUsed -= it->second.instances.capacity() * sizeof(Instance);
+					stats.residentTiles--;
+					stats.releasedTiles++;
+					changedTiles.push_back(glm::ivec2(i, j));
+					version++;
+				}
+				it = tiles.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		missingTiles = (unsigned int)((xEnd - xStart) * (yEnd - yStart));
+	}
+
+	// Tiles which entered it
+	if (missingTiles > 0 && pendingTasks.load() < maxPendingTiles)
+	{
+		requestTiles();
+	}
+
+	stats.pendingTiles = pendingTasks.load();
+}
+
+void Engine::VegetationInstanceStore::setPlacementParameters(const Engine::VegetationPlacement::Parameters & placementParameters)
+{
+	if (Engine::VegetationPlacement::equals(placement->getParameters(), placementParameters))
+	{
+		return;
+	}
+
+	clear();
+	placement = std::make_shared<const VegetationPlacement>(placementParameters);
+}
+
+void Engine::VegetationInstanceStore::flush()
+{
+	Engine::Concurrent::ThreadPool::getInstance().helpUntil([this]()
+	{
+		return pendingTasks.load() == 0;
+	});
+	collectCompleted();
+	stats.pendingTiles = 0;
+}
+
+void Engine::VegetationInstanceStore::clear()
+{
+	for (const auto & tile : tiles)
+	{
+		if (tile.second.state == TILE_RESIDENT)
+		{
+			clearedTiles.push_back(glm::ivec2(int((unsigned long long)tile.first >> 32), int((unsigned long long)tile.first & 0xFFFFFFFFull)));
+		}
+	}
+
+	tiles.clear();
+	generation++;
+	version++;
+
+	// Requests the whole area again on the next update
+	xStart = xEnd = yStart = yEnd = 0;
+	missingTiles = 0;
+
+	stats.residentTiles = 0;
+	stats.memoryUsed = 0;
+}
+
+const std::vector<Engine::VegetationInstanceStore::Instance> & Engine::VegetationInstanceStore::getTile(int i, int j) const
+{
+	static const std::vector<Instance> empty;
+
+	auto it = tiles.find(getKey(i, j));
+	return it != tiles.end() ? it->second.instances : empty;
+}
+
+unsigned long long Engine::VegetationInstanceStore::getVersion() const
+{
+	return version;
+}
+
+const std::vector<glm::ivec2> & Engine::VegetationInstanceStore::getChangedTiles() const
+{
+	return changedTiles;
+}
+
+const Engine::VegetationInstanceStore::Statistics & Engine::VegetationInstanceStore::getStatistics() const
+{
+	return stats;
+}
+
+long long Engine::VegetationInstanceStore::getKey(int i, int j)
+{
+	return (long long)(((unsigned long long)(unsigned int)i << 32) | (unsigned long long)(unsigned int)j);
+}
+
+void Engine::VegetationInstanceStore::collectCompleted()
+{
+	std::vector<CompletedTile> done;
+	{
+		std::unique_lock<std::mutex> guard(completedLock);
+		done.swap(completed);
+	}
+
+	for (CompletedTile & result : done)
+	{
+		// Tiles released, or requested before the last clear(), are dropped
+		auto it = tiles.find(getKey(result.i, result.j));
+		if (result.generation != generation || it == tiles.end() || it->second.state != TILE_PENDING)
+		{
+			continue;
+		}
+
+		Tile & tile = it->second;
+		tile.state = TILE_RESIDENT;
+		tile.instances.swap(result.instances);
+		tile.instances.shrink_to_fit();
+
+		stats.memoryUsed += tile.instances.capacity() * sizeof(Instance);
+		stats.residentTiles++;
+		stats.generatedTiles++;
+		stats.totalGeneratedTiles++;
+		changedTiles.push_back(glm::ivec2(result.i, result.j));
+		version++;
+	}
+}
+
+void Engine::VegetationInstanceStore::requestTiles()
+{
+	// Nearest tiles to the area center first
+	const float centerX = float(xStart + xEnd) * 0.5f;
+	const float centerY = float(yStart + yEnd) * 0.5f;
+
+	requests.clear();
+	for (int i = xStart; i < xEnd; i++)
+	{
+		for (int j = yStart; j < yEnd; j++)
+		{
+			if (tiles.find(getKey(i, j)) == tiles.end())
+			{
+				const float dx = float(i) + 0.5f - centerX;
+				const float dy = float(j) + 0.5f - centerY;
+				Request request = { i, j, dx * dx + dy * dy };
+				requests.push_back(request);
+			}
+		}
+	}
+
+	std::sort(requests.begin(), requests.end(), [](const Request & a, const Request & b)
+	{
+		return a.distance < b.distance;
+	});
+
+	missingTiles = (unsigned int)requests.size();
+	for (const Request & request : requests)
+	{
+		if (pendingTasks.load() >= maxPendingTiles)
+		{
+			break;
+		}
+
+		Tile tile;
+		tile.state = TILE_PENDING;
+		tiles[getKey(request.i, request.j)] = tile;
+		missingTiles--;
+
+		pendingTasks++;
+		std::shared_ptr<const VegetationPlacement> tilePlacement = placement;
+		const unsigned int tileGeneration = generation;
+		const int i = request.i;
+		const int j = request.j;
+		Engine::Concurrent::ThreadPool::getInstance().execute([this, tilePlacement, tileGeneration, i, j]()
+		{
+			CompletedTile result;
+			result.i = i;
+			result.j = j;
+			result.generation = tileGeneration;
+			generator(*tilePlacement, i, j, result.instances);
+
+			std::unique_lock<std::mutex> guard(completedLock);
+			completed.push_back(std::move(result));
+			pendingTasks--;
+		});
+	}
+}
\ No newline at end of file
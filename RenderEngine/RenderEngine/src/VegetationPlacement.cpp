@@ -0,0 +1,109 @@
+#include "VegetationPlacement.h"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <vector>
+
+#include "WorldConfig.h"
+
+namespace
+{
+	// Finite differences step and height scale of computeNormal() in terrain.frag
+	const float NORMAL_STEP = 0.01f;
+	const float NORMAL_HEIGHT_SCALE = 0.01f;
+
+	inline unsigned int hash(unsigned int h)
+	{
+		h = (h ^ (h >> 16)) * 0x7FEB352Du;
+		h = (h ^ (h >> 15)) * 0x846CA68Bu;
+		return h ^ (h >> 16);
+	}
+}
+
+Engine::VegetationPlacement::VegetationPlacement(const Engine::VegetationPlacement::Parameters & parameters)
+	:params(parameters), heightField(parameters.terrain)
+{
+}
+
+Engine::VegetationPlacement::Parameters Engine::VegetationPlacement::getSettingsParameters()
+{
+	Parameters parameters;
+	parameters.terrain = Engine::TerrainHeightField::getSettingsParameters();
+	parameters.minHeight = Engine::Settings::waterHeight;
+	parameters.maxHeight = Engine::Settings::waterHeight + Engine::Settings::vegetationMaxHeight;
+	parameters.minSlopeCos = Engine::Settings::grassCoverage;
+	parameters.seed = Engine::Settings::worldSeed;
+	return parameters;
+}
+
+bool Engine::VegetationPlacement::equals(const Engine::VegetationPlacement::Parameters & a, const Engine::VegetationPlacement::Parameters & b)
+{
+	return a.terrain.amplitude == b.terrain.amplitude && a.terrain.frecuency == b.terrain.frecuency
+		&& a.terrain.scale == b.terrain.scale && a.terrain.octaves == b.terrain.octaves
+		&& a.terrain.tileWidth == b.terrain.tileWidth
+		&& a.minHeight == b.minHeight && a.maxHeight == b.maxHeight
+		&& a.minSlopeCos == b.minSlopeCos && a.seed == b.seed;
+}
+
+const Engine::VegetationPlacement::Parameters & Engine::VegetationPlacement::getParameters() const
+{
+	return params;
+}
+
+void Engine::VegetationPlacement::evaluate(const float * x, const float * z, float * heights, unsigned char * accepted, size_t count) const
+{
+	// Noise coordinates of the positions and of their finite differences neighbours, evaluated
+	// together: center, right, left, top and bottom
+	std::vector<float> u(count * 5), v(count * 5), noise(count * 5);
+	const float tileWidth = params.terrain.tileWidth;
+	for (size_t k = 0; k < count; k++)
+	{
+		// Same coordinates as the terrain shaders (absolute tile position)
+		const float cu = fabsf(x[k] / tileWidth);
+		const float cv = fabsf(z[k] / tileWidth);
+
+		u[k] = cu;
+		v[k] = cv;
+		u[count + k] = cu + NORMAL_STEP;
+		v[count + k] = cv;
+		u[count * 2 + k] = cu - NORMAL_STEP;
+		v[count * 2 + k] = cv;
+		u[count * 3 + k] = cu;
+		v[count * 3 + k] = cv + NORMAL_STEP;
+		u[count * 4 + k] = cu;
+		v[count * 4 + k] = cv - NORMAL_STEP;
+	}
+
+	heightField.getNoiseHeights(u.data(), v.data(), noise.data(), count * 5);
+
+	for (size_t k = 0; k < count; k++)
+	{
+		const float height = noise[k];
+		heights[k] = height * 1.5f * tileWidth;
+
+		// Water and vegetation height masks, as tested by tree.geom before
+		if (!(height > params.minHeight && height < params.maxHeight))
+		{
+			accepted[k] = 0;
+			continue;
+		}
+
+		// Slope mask, as the grass coverage test of terrain.frag
+		const glm::vec3 normal = glm::normalize(glm::vec3(
+			noise[count * 2 + k] * NORMAL_HEIGHT_SCALE - noise[count + k] * NORMAL_HEIGHT_SCALE,
+			NORMAL_STEP * NORMAL_STEP,
+			noise[count * 4 + k] * NORMAL_HEIGHT_SCALE - noise[count * 3 + k] * NORMAL_HEIGHT_SCALE));
+		accepted[k] = normal.y > params.minSlopeCos ? 1 : 0;
+	}
+}
+
+float Engine::VegetationPlacement::random(int i, int j, unsigned int kind, unsigned int index) const
+{
+	unsigned int h = hash(params.seed ^ 0x9E3779B9u);
+	h = hash(h ^ (unsigned int)i);
+	h = hash(h ^ (unsigned int)j);
+	h = hash(h ^ kind);
+	h = hash(h ^ index);
+	return float(h >> 8) * (1.0f / 16777216.0f);
+}
\ No newline at end of file
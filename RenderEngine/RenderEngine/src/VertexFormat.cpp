@@ -0,0 +1,352 @@
+#include "VertexFormat.h"
+
+#include <GL/glew.h>
+
+#include <cstring>
+#include <cmath>
+#include <iostream>
+
+// Number of float components of each attribute on the CPU side
+static const unsigned int ATTRIBUTE_COMPONENTS[Engine::VERTEX_ATTRIB_COUNT] =
+{
+	3,	// Position
+	3,	// Normal
+	3,	// Color
+	3,	// Emission
+	2,	// UV
+	3	// Tangent
+};
+
+Engine::VertexFormat::VertexFormat(bool interleaved)
+	:interleaved(interleaved), vertexSize(0)
+{
+	for (unsigned int i = 0; i < VERTEX_ATTRIB_COUNT; i++)
+	{
+		attributes[i].present = false;
+		attributes[i].components = ATTRIBUTE_COMPONENTS[i];
+		attributes[i].gpuComponents = ATTRIBUTE_COMPONENTS[i];
+		attributes[i].type = VERTEX_TYPE_FLOAT32;
+		attributes[i].offset = 0;
+		attributes[i].stride = 0;
+	}
+}
+
+Engine::VertexFormat Engine::VertexFormat::quantized(bool interleaved)
+{
+	VertexFormat format(interleaved);
+	format.setAttributeType(VERTEX_ATTRIB_NORMAL, VERTEX_TYPE_OCT16);
+	format.setAttributeType(VERTEX_ATTRIB_TANGENT, VERTEX_TYPE_OCT16);
+	format.setAttributeType(VERTEX_ATTRIB_COLOR, VERTEX_TYPE_UNORM8);
+	format.setAttributeType(VERTEX_ATTRIB_EMISSION, VERTEX_TYPE_UNORM8);
+	format.setAttributeType(VERTEX_ATTRIB_UV, VERTEX_TYPE_HALF16);
+	return format;
+}
+
+void Engine::VertexFormat::setAttributeType(Engine::VertexAttribute attribute, Engine::VertexAttributeType type)
+{
+	VertexAttributeFormat & format = attributes[attribute];
+
+	if (type == VERTEX_TYPE_OCT16 && format.components != 3)
+	{
+		std::cerr << "VertexFormat: Octahedral encoding requires a 3 component attribute" << std::endl;
+		exit(-1);
+	}
+
+	format.type = type;
+	format.gpuComponents = type == VERTEX_TYPE_OCT16 ? 2 : format.components;
+}
+
+unsigned int Engine::VertexFormat::getAttributeSize(Engine::VertexAttribute attribute) const
+{
+	const VertexAttributeFormat & format = attributes[attribute];
+	unsigned int size;
+	switch (format.type)
+	{
+	case VERTEX_TYPE_OCT16:
+	case VERTEX_TYPE_HALF16:
+		size = format.gpuComponents * sizeof(unsigned short);
+		break;
+	case VERTEX_TYPE_UNORM8:
+		size = format.gpuComponents;
+		break;
+	case VERTEX_TYPE_FLOAT32:
+	default:
+		size = format.gpuComponents * sizeof(float);
+		break;
+	}
+
+	// Keep every attribute 4 byte aligned
+	return (size + 3) & ~3u;
+}
+
+void Engine::VertexFormat::computeLayout(const float * const data[VERTEX_ATTRIB_COUNT])
+{
+	vertexSize = 0;
+	for (unsigned int i = 0; i < VERTEX_ATTRIB_COUNT; i++)
+	{
+		VertexAttributeFormat & format = attributes[i];
+		format.present = data[i] != 0;
+		if (!format.present)
+		{
+			continue;
+		}
+
+		unsigned int size = getAttributeSize(VertexAttribute(i));
+		if (interleaved)
+		{
+			format.offset = vertexSize;
+			vertexSize += size;
+		}
+		else
+		{
+			format.offset = 0;
+			format.stride = size;
+		}
+	}
+
+	if (interleaved)
+	{
+		for (unsigned int i = 0; i < VERTEX_ATTRIB_COUNT; i++)
+		{
+			attributes[i].stride = vertexSize;
+		}
+	}
+}
+
+void Engine::VertexFormat::packAttribute(Engine::VertexAttribute attribute, const float * src, unsigned int numVertices, unsigned char * dst) const
+{
+	const VertexAttributeFormat & format = attributes[attribute];
+	const unsigned int components = format.components;
+	unsigned char * out = dst + format.offset;
+
+	switch (format.type)
+	{
+	case VERTEX_TYPE_OCT16:
+		for (unsigned int i = 0; i < numVertices; i++)
+		{
+			short encoded[2];
+			encodeOctahedral(src, encoded);
+			memcpy(out, encoded, sizeof(encoded));
+			out += format.stride;
+			src += components;
+		}
+		break;
+	case VERTEX_TYPE_UNORM8:
+		for (unsigned int i = 0; i < numVertices; i++)
+		{
+			for (unsigned int c = 0; c < components; c++)
+			{
+				out[c] = floatToUnorm8(src[c]);
+			}
+			out += format.stride;
+			src += components;
+		}
+		break;
+	case VERTEX_TYPE_HALF16:
+		for (unsigned int i = 0; i < numVertices; i++)
+		{
+			for (unsigned int c = 0; c < components; c++)
+			{
+				unsigned short half = floatToHalf(src[c]);
+				memcpy(out + c * sizeof(unsigned short), &half, sizeof(unsigned short));
+			}
+			out += format.stride;
+			src += components;
+		}
+		break;
+	case VERTEX_TYPE_FLOAT32:
+	default:
+		{
+			const size_t valueSize = components * sizeof(float);
+			if (format.stride == valueSize)
+			{
+				memcpy(out, src, valueSize * numVertices);
+				return;
+			}
+
+			for (unsigned int i = 0; i < numVertices; i++)
+			{
+				memcpy(out, src, valueSize);
+				out += format.stride;
+				src += components;
+			}
+		}
+		break;
+	}
+}
+
+void Engine::VertexFormat::packInterleaved(const float * const data[VERTEX_ATTRIB_COUNT], unsigned int numVertices, unsigned char * dst) const
+{
+	for (unsigned int i = 0; i < VERTEX_ATTRIB_COUNT; i++)
+	{
+		if (attributes[i].present)
+		{
+			packAttribute(VertexAttribute(i), data[i], numVertices, dst);
+		}
+	}
+}
+
+unsigned int Engine::VertexFormat::getGLType(Engine::VertexAttribute attribute) const
+{
+	switch (attributes[attribute].type)
+	{
+	case VERTEX_TYPE_OCT16:
+		return GL_SHORT;
+	case VERTEX_TYPE_UNORM8:
+		return GL_UNSIGNED_BYTE;
+	case VERTEX_TYPE_HALF16:
+		return GL_HALF_FLOAT;
+	case VERTEX_TYPE_FLOAT32:
+	default:
+		return GL_FLOAT;
+	}
+}
+
+bool Engine::VertexFormat::isNormalized(Engine::VertexAttribute attribute) const
+{
+	const VertexAttributeType type = attributes[attribute].type;
+	return type == VERTEX_TYPE_OCT16 || type == VERTEX_TYPE_UNORM8;
+}
+
+// ====================================================================================================================
+
+static short floatToSnorm16(float value)
+{
+	value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+	return short(floorf(value * 32767.0f + 0.5f));
+}
+
+static float snorm16ToFloat(short value)
+{
+	// GL 4.2+ signed normalized conversion
+	float f = float(value) / 32767.0f;
+	return f < -1.0f ? -1.0f : f;
+}
+
+void Engine::encodeOctahedral(const float * v, short * out)
+{
+	// Project on the octahedron |x| + |y| + |z| = 1 and unfold the lower hemisphere
+	const float l1 = fabsf(v[0]) + fabsf(v[1]) + fabsf(v[2]);
+	float x = v[0] / l1;
+	float y = v[1] / l1;
+	if (v[2] < 0.0f)
+	{
+		const float ox = x;
+		x = (1.0f - fabsf(y)) * (ox >= 0.0f ? 1.0f : -1.0f);
+		y = (1.0f - fabsf(ox)) * (y >= 0.0f ? 1.0f : -1.0f);
+	}
+
+	// Plain rounding is not optimal on the folded octahedron, pick the closest
+	// of the 4 surrounding quantized points
+	const float fx = floorf(x * 32767.0f);
+	const float fy = floorf(y * 32767.0f);
+	float bestDot = -2.0f;
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		float cx = (fx + float(i & 1)) / 32767.0f;
+		float cy = (fy + float(i >> 1)) / 32767.0f;
+		short candidate[2] = { floatToSnorm16(cx), floatToSnorm16(cy) };
+
+		float decoded[3];
+		decodeOctahedral(candidate, decoded);
+		const float dot = decoded[0] * v[0] + decoded[1] * v[1] + decoded[2] * v[2];
+		if (dot > bestDot)
+		{
+			bestDot = dot;
+			out[0] = candidate[0];
+			out[1] = candidate[1];
+		}
+	}
+}
+
+void Engine::decodeOctahedral(const short * in, float * v)
+{
+	// Must match the GLSL decoding on the shaders
+	float x = snorm16ToFloat(in[0]);
+	float y = snorm16ToFloat(in[1]);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	const float t = z < 0.0f ? -z : 0.0f;
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	const float invLength = 1.0f / sqrtf(x * x + y * y + z * z);
+	v[0] = x * invLength;
+	v[1] = y * invLength;
+	v[2] = z * invLength;
+}
+
+unsigned short Engine::floatToHalf(float value)
+{
+	unsigned int bits;
+	memcpy(&bits, &value, sizeof(float));
+
+	const unsigned int sign = (bits >> 16) & 0x8000u;
+	bits &= 0x7fffffffu;
+
+	unsigned short result;
+	if (bits >= 0x47800000u)
+	{
+		// Overflow (>= 65536) to infinity, keep NaN
+		result = bits > 0x7f800000u ? 0x7e00u : 0x7c00u;
+	}
+	else if (bits < 0x38800000u)
+	{
+		// Subnormal half: let the FPU round by adding a magic number which aligns
+		// the mantissa to the half precision ulp (2^-24)
+		const unsigned int magicBits = 0x3f000000u;
+		float magic, f;
+		memcpy(&magic, &magicBits, sizeof(float));
+		memcpy(&f, &bits, sizeof(float));
+		f += magic;
+		unsigned int fBits;
+		memcpy(&fBits, &f, sizeof(float));
+		result = (unsigned short)(fBits - magicBits);
+	}
+	else
+	{
+		// Rebias the exponent and round the mantissa to nearest even
+		const unsigned int mantissaOdd = (bits >> 13) & 1u;
+		bits += 0xc8000fffu + mantissaOdd;
+		result = (unsigned short)(bits >> 13);
+	}
+
+	return (unsigned short)(result | sign);
+}
+
+float Engine::halfToFloat(unsigned short value)
+{
+	const unsigned int sign = (value & 0x8000u) << 16;
+	const unsigned int exponent = (value >> 10) & 0x1fu;
+	const unsigned int mantissa = value & 0x3ffu;
+
+	unsigned int bits;
+	if (exponent == 0)
+	{
+		const float f = ldexpf(float(mantissa), -24);
+		memcpy(&bits, &f, sizeof(float));
+		bits |= sign;
+	}
+	else if (exponent == 31)
+	{
+		bits = sign | 0x7f800000u | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(float));
+	return result;
+}
+
+unsigned char Engine::floatToUnorm8(float value)
+{
+	value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+	return (unsigned char)(value * 255.0f + 0.5f);
+}
+
+float Engine::unorm8ToFloat(unsigned char value)
+{
+	return float(value) / 255.0f;
+}
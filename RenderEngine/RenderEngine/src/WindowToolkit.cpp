@@ -4,6 +4,7 @@
 
 #include "WorldConfig.h"
 #include "TimeAccesor.h"
+#include "FrameStatistics.h"
 
 // ===================================================================
 
@@ -42,6 +43,12 @@ void Engine::Window::WindowToolkit::initGlew()
 		exit(-1);
 	}
 
+	// Uniform uploads are only counted for the frame statistics on request
+	if (Engine::Settings::countUniformCalls)
+	{
+		Engine::FrameStatistics::installUniformCounter();
+	}
+
 	const GLubyte *oglVersion = glGetString(GL_VERSION);
 	std::cout << "This system supports OpenGL Version: " << oglVersion << std::endl;
 }
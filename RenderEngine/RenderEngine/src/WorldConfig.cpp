@@ -9,6 +9,15 @@ glm::vec3 Engine::Settings::lightColor = glm::vec3(1, 1, 1);
 float Engine::Settings::lightFactor = 1.0f;
 glm::vec3 Engine::Settings::realLightColor = glm::vec3(1, 1, 1);
 glm::vec3 Engine::Settings::lightDirection = glm::vec3(1, 1, 0);
+unsigned int Engine::Settings::shadowCascades = 3;
+unsigned int Engine::Settings::shadowSplitScheme = 2;
+float Engine::Settings::shadowSplitLambda = 0.75f;
+float Engine::Settings::shadowDistance = 100.0f;
+unsigned int Engine::Settings::shadowMapResolution = 1024;
+bool Engine::Settings::shadowCache = true;
+unsigned int Engine::Settings::shadowCacheFirstLevel = 1;
+unsigned int Engine::Settings::shadowCacheThreshold = 8;
+unsigned int Engine::Settings::shadowCacheInterval = 30;
 
 float Engine::Settings::worldTileScale = 7.0f;
 unsigned int Engine::Settings::worldRenderRadius = 12;
@@ -21,6 +30,11 @@ float Engine::Settings::terrainFrecuency = 0.244f;
 float Engine::Settings::terrainScale = 0.9f;
 unsigned int Engine::Settings::terrainOctaves = 10;
 float Engine::Settings::vegetationMaxHeight = 0.1f;
+bool Engine::Settings::treeLods = true;
+bool Engine::Settings::terrainQuadTree = false;
+float Engine::Settings::terrainPixelError = 4.0f;
+bool Engine::Settings::terrainTileCache = false;
+bool Engine::Settings::terrainInstancing = true;
 float Engine::Settings::grassCoverage = 0.5f;
 glm::vec3 Engine::Settings::grassColor = glm::vec3(0.1f, 0.3f, 0.0f);
 glm::vec3 Engine::Settings::sandColor = glm::vec3(0.94f, 0.89f, 0.5f);
@@ -59,7 +73,11 @@ float Engine::Settings::godRaysDensity = 0.318f;
 float Engine::Settings::godRaysExposure = 0.515f;
 float Engine::Settings::godRaysWeight = 0.2f;
 
+bool Engine::Settings::compactGBuffer = false;
+
 bool Engine::Settings::showUI = false;
+bool Engine::Settings::countUniformCalls = false;
+bool Engine::Settings::dumpFrameGraph = false;
 
 void Engine::Settings::update()
 {
@@ -121,5 +139,10 @@ void Engine::RenderableNotifier::checkUpdatedConfig()
 			light->translate(previousLightDir);
 			light->setColor(previousLightColor);
 		}
+
+		for (auto render : renderables)
+		{
+			render->notifyLightUpdate();
+		}
 	}
 }
\ No newline at end of file
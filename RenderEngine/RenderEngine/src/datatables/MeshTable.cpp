@@ -5,9 +5,12 @@
 
 #include "datatables/MeshTable.h"
 
+#include "util/IOUtils.h"
+
 #include <assimp\cimport.h>
 #include <assimp\postprocess.h>
 #include <iostream>
+#include <cstdio>
 
 Engine::MeshTable * Engine::MeshTable::INSTANCE = new Engine::MeshTable();
 
@@ -17,6 +20,7 @@ Engine::MeshTable & Engine::MeshTable::getInstance()
 }
 
 Engine::MeshTable::MeshTable()
+	:cacheDirectory("meshcache")
 {
 }
 
@@ -34,6 +38,25 @@ Engine::Mesh * Engine::MeshTable::getMesh(std::string filename)
 	else
 	{
 		unsigned int flags = aiPostProcessSteps::aiProcess_GenUVCoords | aiPostProcessSteps::aiProcess_JoinIdenticalVertices;
+
+		// Cache entries are keyed by the size and modification time of the file, so edited files are imported again
+		unsigned long long paramHash = 0;
+		unsigned long long fileSize = 0;
+		long long modificationTime = 0;
+		if (!cacheDirectory.empty() && Engine::IO::getFileStatus(filename.c_str(), fileSize, modificationTime))
+		{
+			paramHash = Engine::MeshCache::hash(&fileSize, sizeof(fileSize));
+			paramHash = Engine::MeshCache::hash(&modificationTime, sizeof(modificationTime), paramHash);
+			paramHash = Engine::MeshCache::hash(&flags, sizeof(flags), paramHash);
+
+			Mesh * cached = loadCachedMesh(filename, paramHash);
+			if (cached != 0)
+			{
+				meshCache[filename] = cached;
+				return cached;
+			}
+		}
+
 		const aiScene * scene = aiImportFile(filename.c_str(), flags);
 
 		if (!scene)
@@ -44,7 +67,14 @@ Engine::Mesh * Engine::MeshTable::getMesh(std::string filename)
 		if (scene->HasMeshes())
 		{
 			aiMesh * rawMesh = scene->mMeshes[0];
-			Mesh * m = new Mesh(rawMesh);
+			Mesh * m = new Mesh(rawMesh, false);
+			m->optimize(true);
+			m->syncGPU();
+
+			if (paramHash != 0)
+			{
+				storeCachedMesh(filename, paramHash, *m);
+			}
 
 			meshCache[filename] = m;
 			aiReleaseImport(scene);
@@ -66,6 +96,70 @@ void Engine::MeshTable::addMeshToCache(std::string name, const Engine::Mesh & me
 	}
 }
 
+bool Engine::MeshTable::addMeshToCache(std::string name, Engine::Mesh * mesh)
+{
+	std::map<std::string, Engine::Mesh* >::iterator it = meshCache.find(name);
+	if (it == meshCache.end())
+	{
+		meshCache[name] = mesh;
+		return true;
+	}
+
+	return false;
+}
+
+void Engine::MeshTable::setCacheDirectory(const std::string & directory)
+{
+	cacheDirectory = directory;
+}
+
+Engine::Mesh * Engine::MeshTable::loadCachedMesh(const std::string & name, unsigned long long paramHash) const
+{
+	if (cacheDirectory.empty())
+	{
+		return 0;
+	}
+
+	return Engine::MeshCache::loadMesh(getCacheFileName(name), paramHash);
+}
+
+bool Engine::MeshTable::readCachedMesh(const std::string & name, unsigned long long paramHash, Engine::MeshCache::Entry & entry) const
+{
+	if (cacheDirectory.empty())
+	{
+		return false;
+	}
+
+	return Engine::MeshCache::readMesh(getCacheFileName(name), paramHash, entry);
+}
+
+bool Engine::MeshTable::storeCachedMesh(const std::string & name, unsigned long long paramHash, const Engine::Mesh & mesh) const
+{
+	if (cacheDirectory.empty() || !Engine::IO::createDirectory(cacheDirectory.c_str()))
+	{
+		return false;
+	}
+
+	return Engine::MeshCache::writeMesh(getCacheFileName(name), mesh, paramHash);
+}
+
+std::string Engine::MeshTable::getCacheFileName(const std::string & name) const
+{
+	// Flatten the name into a single file name within the cache directory
+	std::string fileName = name;
+	for (auto & c : fileName)
+	{
+		const bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+		c = valid ? c : '_';
+	}
+
+	// Flattening may map different names to the same string, the hash of the original name tells them apart
+	char nameHash[17];
+	snprintf(nameHash, sizeof(nameHash), "%016llx", Engine::MeshCache::hash(name.data(), name.size()));
+
+	return cacheDirectory + "/" + fileName + "_" + nameHash + ".mesh";
+}
+
 void Engine::MeshTable::clean()
 {
 	std::map<std::string, Engine::Mesh* >::iterator it = meshCache.begin();
@@ -2,6 +2,59 @@
 #include "datatables/MeshTable.h"
 
 #include "vegetation/FractalTree.h"
+#include "MeshCache.h"
+#include "Threadpool.h"
+
+#include <memory>
+#include <iostream>
+
+namespace
+{
+	// Hash of the generator version and of the base shapes every fractal tree is built from. Must be
+	// computed on the GL thread, as the shapes may be loaded through the MeshTable
+	unsigned long long hashTreeShapes()
+	{
+		const char generator[] = "FractalTree";
+		const unsigned int version = Engine::FractalTree::VERSION;
+		unsigned long long h = Engine::MeshCache::hash(generator, sizeof(generator));
+		h = Engine::MeshCache::hash(&version, sizeof(version), h);
+		h = Engine::MeshCache::hashMesh(*Engine::MeshTable::getInstance().getMesh("trunk"), h);
+		return Engine::MeshCache::hashMesh(*Engine::MeshTable::getInstance().getMesh("leaf"), h);
+	}
+
+	// Hash of everything the geometry of a fractal tree depends on (the name is not included)
+	unsigned long long hashFractalTreeData(const Engine::TreeGenerationData & data, unsigned long long shapesHash)
+	{
+		unsigned long long h = shapesHash;
+
+		const unsigned long long seed = data.seed;
+		const unsigned int values[] = { data.maxDepth, data.startBranchingDepth, data.maxBranchesSplit, data.rotateMainTrunk ? 1u : 0u,
+			data.emissiveLeaf ? 1u : 0u, data.depthStartingLeaf, data.parallelSplitDepth };
+		const glm::vec3 vectors[] = { data.minBranchRotation, data.maxBranchRotation, data.scalingFactor, data.startTrunkColor,
+			data.endTrunkColor, data.leafStartColor, data.leafEndColor };
+
+		h = Engine::MeshCache::hash(&seed, sizeof(seed), h);
+		h = Engine::MeshCache::hash(values, sizeof(values), h);
+		for (auto & v : vectors)
+		{
+			const float components[3] = { v.x, v.y, v.z };
+			h = Engine::MeshCache::hash(components, sizeof(components), h);
+		}
+
+		return h;
+	}
+
+	std::string getTreeCacheName(const Engine::TreeGenerationData & data)
+	{
+		return std::string("tree_") + data.treeName;
+	}
+
+	unsigned long long hashLodSettings(unsigned long long treeHash, const Engine::MeshSimplifier::LodSettings & lod)
+	{
+		const float values[] = { lod.triangleRatio, lod.maxError };
+		return Engine::MeshCache::hash(values, sizeof(values), treeHash);
+	}
+}
 
 Engine::VegetationTable * Engine::VegetationTable::INSTANCE = new Engine::VegetationTable();
 
@@ -17,14 +70,142 @@ Engine::VegetationTable::VegetationTable()
 
 Engine::Mesh * Engine::VegetationTable::generateFractalTree(const Engine::TreeGenerationData & data, bool addToMeshTable)
 {
-	Engine::FractalTree ft(data);
-	Engine::Mesh * tree = ft.generate();
+	const unsigned long long paramHash = hashFractalTreeData(data, hashTreeShapes());
+	Engine::Mesh * tree = Engine::MeshTable::getInstance().loadCachedMesh(getTreeCacheName(data), paramHash);
+
+	if (tree == 0)
+	{
+		Engine::FractalTree ft(data);
+		tree = ft.generate();
+		Engine::MeshTable::getInstance().storeCachedMesh(getTreeCacheName(data), paramHash, *tree);
+	}
 
 	if (addToMeshTable)
 	{
-		Engine::MeshTable::getInstance().addMeshToCache(data.treeName, *tree);
+		Engine::MeshTable::getInstance().addMeshToCache(data.treeName, tree);
 	}
 
 	return tree;
 }
 
+std::vector<Engine::Mesh *> Engine::VegetationTable::generateFractalTrees(const std::vector<Engine::TreeGenerationData> & data, bool addToMeshTable)
+{
+	// Trees built on previous runs are taken from the mesh cache
+	const unsigned long long shapesHash = hashTreeShapes();
+	std::vector<Engine::MeshCache::Entry> cached(data.size());
+	std::vector<unsigned long long> paramHashes(data.size());
+	Engine::Concurrent::parallelFor(0, data.size(), 1, [&](size_t i)
+	{
+		paramHashes[i] = hashFractalTreeData(data[i], shapesHash);
+		if (!Engine::MeshTable::getInstance().readCachedMesh(getTreeCacheName(data[i]), paramHashes[i], cached[i]))
+		{
+			cached[i].mesh = nullptr;
+		}
+	});
+
+	std::vector<Engine::Mesh *> trees(data.size(), nullptr);
+	std::vector<size_t> missing;
+	std::vector<Engine::TreeGenerationData> missingData;
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		trees[i] = cached[i].mesh;
+		if (trees[i] == nullptr)
+		{
+			missing.push_back(i);
+			missingData.push_back(data[i]);
+		}
+	}
+
+	std::vector<Engine::Mesh *> generated = generateFractalTreesCPU(missingData);
+	Engine::Concurrent::parallelFor(0, missing.size(), 1, [&](size_t m)
+	{
+		const size_t i = missing[m];
+		trees[i] = generated[m];
+		Engine::MeshTable::getInstance().storeCachedMesh(getTreeCacheName(data[i]), paramHashes[i], *trees[i]);
+	});
+
+	for (size_t i = 0; i < trees.size(); i++)
+	{
+		trees[i]->syncGPU(cached[i].packedVertices.empty() ? 0 : cached[i].packedVertices.data());
+
+		if (addToMeshTable)
+		{
+			Engine::MeshTable::getInstance().addMeshToCache(data[i].treeName, trees[i]);
+		}
+	}
+
+	return trees;
+}
+
+std::vector<Engine::Mesh *> Engine::VegetationTable::generateFractalTreesCPU(const std::vector<Engine::TreeGenerationData> & data)
+{
+	// Generators fetch their base shapes from the MeshTable (which may load and upload them),
+	// so they are created here, on the GL thread
+	std::vector<std::unique_ptr<Engine::FractalTree>> generators;
+	for (const auto & treeData : data)
+	{
+		generators.push_back(std::unique_ptr<Engine::FractalTree>(new Engine::FractalTree(treeData)));
+	}
+
+	// Every tree owns its random engine, so the output does not depend on the execution order
+	std::vector<Engine::Mesh *> trees(data.size(), nullptr);
+	Engine::Concurrent::parallelFor(0, data.size(), 1, [&](size_t i)
+	{
+		trees[i] = generators[i]->generateCPU();
+	});
+
+	return trees;
+}
+
+std::vector<std::vector<Engine::Mesh *>> Engine::VegetationTable::generateFractalTreeLods(const std::vector<Engine::TreeGenerationData> & data, const std::vector<Engine::Mesh *> & trees,
+	const std::vector<Engine::MeshSimplifier::LodSettings> & lods, bool addToMeshTable)
+{
+	const size_t numLods = lods.size();
+	const unsigned long long shapesHash = hashTreeShapes();
+	std::vector<Engine::MeshCache::Entry> levels(trees.size() * numLods);
+	std::vector<std::string> names(levels.size());
+
+	// Every level is simplified from the full detail tree, so all of them are built concurrently
+	Engine::Concurrent::parallelFor(0, levels.size(), 1, [&](size_t k)
+	{
+		const size_t i = k / numLods;
+		const size_t l = k % numLods;
+		names[k] = data[i].treeName + "_lod" + std::to_string(l + 1);
+
+		const std::string cacheName = getTreeCacheName(data[i]) + "_lod" + std::to_string(l + 1);
+		const unsigned long long paramHash = hashLodSettings(hashFractalTreeData(data[i], shapesHash), lods[l]);
+		if (Engine::MeshTable::getInstance().readCachedMesh(cacheName, paramHash, levels[k]))
+		{
+			return;
+		}
+
+		const unsigned int targetFaces = (unsigned int)(float(trees[i]->getNumFaces()) * lods[l].triangleRatio);
+		levels[k].mesh = trees[i]->simplify(targetFaces, lods[l].maxError);
+		if (levels[k].mesh != nullptr)
+		{
+			Engine::MeshTable::getInstance().storeCachedMesh(cacheName, paramHash, *levels[k].mesh);
+		}
+	});
+
+	std::vector<std::vector<Engine::Mesh *>> result(trees.size());
+	for (size_t k = 0; k < levels.size(); k++)
+	{
+		if (levels[k].mesh == nullptr)
+		{
+			// The level falls back to the full detail tree, which is already uploaded and owned by the caller
+			std::cerr << "VegetationTable: Could not simplify " << data[k / numLods].treeName << ", using the full detail mesh for " << names[k] << std::endl;
+			result[k / numLods].push_back(trees[k / numLods]);
+			continue;
+		}
+
+		levels[k].mesh->syncGPU(levels[k].packedVertices.empty() ? 0 : levels[k].packedVertices.data());
+		result[k / numLods].push_back(levels[k].mesh);
+
+		if (addToMeshTable)
+		{
+			Engine::MeshTable::getInstance().addMeshToCache(names[k], levels[k].mesh);
+		}
+	}
+
+	return result;
+}
\ No newline at end of file
@@ -257,10 +257,9 @@ Engine::PostProcessChainNode * createSSAANode()
 	// Shader
 	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::SSAAProgram>();
 
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(2, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
+	// Render targets (allocated by the renderer)
+	node->outputs.push_back({ GL_RGBA8, GL_RGBA, GL_FLOAT, GL_LINEAR });
+	node->renderBuffer = 0;
 	node->callBack = 0;
 
 	// Render plane
@@ -282,11 +281,10 @@ Engine::PostProcessChainNode * createBloomNode()
 	// Shader
 	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::BloomProgram>();
 
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(2, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addColorBuffer(1, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
+	// Render targets (allocated by the renderer)
+	node->outputs.push_back({ GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_LINEAR });
+	node->outputs.push_back({ GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_LINEAR });
+	node->renderBuffer = 0;
 	node->callBack = 0;
 
 	// Render plane
@@ -308,10 +306,9 @@ Engine::PostProcessChainNode * createSSReflectionNode()
 	// Shader
 	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::SSReflectionProgram>();
 
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(1, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
+	// Render targets (allocated by the renderer)
+	node->outputs.push_back({ GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_LINEAR });
+	node->renderBuffer = 0;
 	node->callBack = 0;
 
 	// Render plane
@@ -333,11 +330,9 @@ Engine::PostProcessChainNode * createSSGrassNode()
 	// Shader
 	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::SSGrassProgram>();
 
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(2, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addColorBuffer(1, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
+	// Render targets (allocated by the renderer). The shader only outputs color
+	node->outputs.push_back({ GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_LINEAR });
+	node->renderBuffer = 0;
 	node->callBack = 0;
 
 	// Render plane
@@ -359,10 +354,9 @@ Engine::PostProcessChainNode * createHDRNode()
 	// Shader
 	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::HDRToneMappingProgram>();
 
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(1, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
+	// Render targets (allocated by the renderer)
+	node->outputs.push_back({ GL_RGBA8, GL_RGBA, GL_FLOAT, GL_LINEAR });
+	node->renderBuffer = 0;
 	node->callBack = 0;
 
 	// Render plane
@@ -384,10 +378,10 @@ Engine::PostProcessChainNode * createSSGodRayNode()
 	// Shader
 	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::SSGodRayProgram>();
 
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(1, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
+	// Render targets (allocated by the renderer). Color, and the emission passed on to bloom
+	node->outputs.push_back({ GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_LINEAR });
+	node->outputs.push_back({ GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_LINEAR });
+	node->renderBuffer = 0;
 	node->callBack = 0;
 
 	// Render plane
@@ -409,10 +403,9 @@ Engine::PostProcessChainNode * createDOFNode()
 	// Shader
 	node->postProcessProgram = Engine::ProgramTable::getInstance().getProgram<Engine::DepthOfFieldProgram>();
 
-	// RTT
-	node->renderBuffer = new Engine::DeferredRenderObject(1, false);
-	node->renderBuffer->addColorBuffer(0, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	node->renderBuffer->addDepthBuffer24(500, 500);
+	// Render targets (allocated by the renderer)
+	node->outputs.push_back({ GL_RGBA8, GL_RGBA, GL_FLOAT, GL_LINEAR });
+	node->renderBuffer = 0;
 	node->callBack = 0;
 
 	// Render plane
@@ -7,16 +7,15 @@ Engine::BloomProgram::BloomProgram(std::string name, unsigned long long paramete
 {
 	fShaderFile = "shaders/postprocess/Bloom.frag";
 
+	// The blur passes do not depth test, so they get no depth buffer
 	buf[0].pass = new Engine::DeferredRenderObject(2, false);
 	buf[0].color = buf[0].pass->addColorBuffer(0, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
 	buf[0].emissive = buf[0].pass->addColorBuffer(1, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	buf[0].pass->addDepthBuffer24(500, 500);
 	buf[0].pass->initialize();
 
 	buf[1].pass = new Engine::DeferredRenderObject(2, false);
 	buf[1].color = buf[1].pass->addColorBuffer(0, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
 	buf[1].emissive = buf[1].pass->addColorBuffer(1, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);
-	buf[1].pass->addDepthBuffer24(500, 500);
 	buf[1].pass->initialize();
 
 	passes = 8;
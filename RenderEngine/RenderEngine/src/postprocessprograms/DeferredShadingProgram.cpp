@@ -23,6 +23,13 @@ Engine::DeferredShadingProgram::DeferredShadingProgram(const Engine::DeferredSha
 	uSkyZenitColor = other.uSkyZenitColor;
 
 	uColorFactor = other.uColorFactor;
+
+	uInvProjMat = other.uInvProjMat;
+}
+
+std::string Engine::DeferredShadingProgram::getConfigString()
+{
+	return Engine::Settings::compactGBuffer ? "#define COMPACT_GBUFFER\n" : "";
 }
 
 void Engine::DeferredShadingProgram::processDirectionalLights(Engine::DirectionalLight * dl, const glm::mat4 & view)
@@ -54,6 +61,9 @@ void Engine::DeferredShadingProgram::onRenderObject(const Engine::Object * obj,
 	glUniform3fv(uSkyHorizonColor, 1, &Engine::Settings::skyHorizonColor[0]);
 
 	glUniform1f(uColorFactor, Engine::Settings::lightFactor);
+
+	glm::mat4 invProj = glm::inverse(camera->getProjectionMatrix());
+	glUniformMatrix4fv(uInvProjMat, 1, GL_FALSE, &invProj[0][0]);
 }
 
 void Engine::DeferredShadingProgram::configureProgram()
@@ -68,6 +78,8 @@ void Engine::DeferredShadingProgram::configureProgram()
 	uSLBuffer = glGetUniformBlockIndex(glProgram, "SLBuffer");
 
 	uColorFactor = glGetUniformLocation(glProgram, "colorFactor");
+
+	uInvProjMat = glGetUniformLocation(glProgram, "invProjMat");
 }
 
 // =====================================================
@@ -1,6 +1,7 @@
 #include "postprocessprograms/SSGrassProgram.h"
 
 #include "renderers/DeferredRenderer.h"
+#include "WorldConfig.h"
 
 const std::string Engine::SSGrassProgram::PROGRAM_NAME = "SSGrassProgram";
 
@@ -16,6 +17,13 @@ Engine::SSGrassProgram::SSGrassProgram(const Engine::SSGrassProgram & other)
 	uScreenSize = other.uScreenSize;
 	uGrassInfoBuffer = other.uGrassInfoBuffer;
 	uPosBuffer = other.uPosBuffer;
+	uDepthBuffer = other.uDepthBuffer;
+	uInvProjMat = other.uInvProjMat;
+}
+
+std::string Engine::SSGrassProgram::getConfigString()
+{
+	return Engine::Settings::compactGBuffer ? "#define COMPACT_GBUFFER\n" : "";
 }
 
 void Engine::SSGrassProgram::configureProgram()
@@ -25,6 +33,8 @@ void Engine::SSGrassProgram::configureProgram()
 	uScreenSize = glGetUniformLocation(glProgram, "screenSize");
 	uGrassInfoBuffer = glGetUniformLocation(glProgram, "grassBuffer");
 	uPosBuffer = glGetUniformLocation(glProgram, "posBuffer");
+	uDepthBuffer = glGetUniformLocation(glProgram, "depthBuffer");
+	uInvProjMat = glGetUniformLocation(glProgram, "invProjMat");
 }
 
 void Engine::SSGrassProgram::onRenderObject(const Engine::Object * obj, Engine::Camera * camera)
@@ -40,9 +50,22 @@ void Engine::SSGrassProgram::onRenderObject(const Engine::Object * obj, Engine::
 	glActiveTexture(GL_TEXTURE1);
 	glBindTexture(GL_TEXTURE_2D, dr->getGBufferInfo()->getTexture()->getTextureId());
 
-	glUniform1i(uPosBuffer, 2);
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, dr->getGBufferPos()->getTexture()->getTextureId());
+	// The compact G-buffer position is rebuilt from the depth
+	if (dr->getGBufferPos() != NULL)
+	{
+		glUniform1i(uPosBuffer, 2);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, dr->getGBufferPos()->getTexture()->getTextureId());
+	}
+	else
+	{
+		glUniform1i(uDepthBuffer, 2);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, dr->getGBufferDepth()->getTexture()->getTextureId());
+
+		glm::mat4 invProj = glm::inverse(camera->getProjectionMatrix());
+		glUniformMatrix4fv(uInvProjMat, 1, GL_FALSE, &invProj[0][0]);
+	}
 }
 
 // ======================================================================================
@@ -16,6 +16,7 @@ Engine::SSReflectionProgram::SSReflectionProgram(const Engine::SSReflectionProgr
 	: Engine::PostProcessProgram(other)
 {
 	uProjMat = other.uProjMat;
+	uInvProjMat = other.uInvProjMat;
 	uPosBuffer = other.uPosBuffer;
 	uNormalBuffer = other.uNormalBuffer;
 	uDepthBuffer = other.uDepthBuffer;
@@ -23,11 +24,17 @@ Engine::SSReflectionProgram::SSReflectionProgram(const Engine::SSReflectionProgr
 	uLightDir = other.uLightDir;
 }
 
+std::string Engine::SSReflectionProgram::getConfigString()
+{
+	return Engine::Settings::compactGBuffer ? "#define COMPACT_GBUFFER\n" : "";
+}
+
 void Engine::SSReflectionProgram::configureProgram()
 {
 	Engine::PostProcessProgram::configureProgram();
 
 	uProjMat = glGetUniformLocation(glProgram, "projMat");
+	uInvProjMat = glGetUniformLocation(glProgram, "invProjMat");
 	uPosBuffer = glGetUniformLocation(glProgram, "posBuffer");
 	uNormalBuffer = glGetUniformLocation(glProgram, "normalBuffer");
 	uDepthBuffer = glGetUniformLocation(glProgram, "depthBuffer");
@@ -42,9 +49,18 @@ void Engine::SSReflectionProgram::onRenderObject(const Engine::Object * obj, Eng
 	Engine::DeferredRenderer * deferred = static_cast<Engine::DeferredRenderer*>(Engine::RenderManager::getInstance().getRenderer());
 
 	glUniformMatrix4fv(uProjMat, 1, GL_FALSE, &(camera->getProjectionMatrix()[0][0]));
-	glUniform1i(uPosBuffer, 1);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, deferred->getGBufferPos()->getTexture()->getTextureId());
+	// The compact G-buffer position is rebuilt from the depth
+	if (deferred->getGBufferPos() != NULL)
+	{
+		glUniform1i(uPosBuffer, 1);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, deferred->getGBufferPos()->getTexture()->getTextureId());
+	}
+	else
+	{
+		glm::mat4 invProj = glm::inverse(camera->getProjectionMatrix());
+		glUniformMatrix4fv(uInvProjMat, 1, GL_FALSE, &invProj[0][0]);
+	}
 	glUniform1i(uNormalBuffer, 2);
 	glActiveTexture(GL_TEXTURE2);
 	glBindTexture(GL_TEXTURE_2D, deferred->getGBufferNormal()->getTexture()->getTextureId());
@@ -35,9 +35,7 @@ void Engine::CloudShadowProgram::configureMeshBuffers(Engine::Mesh * mesh)
 
 	if (uInPos != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, mesh->vboVertices);
-		glVertexAttribPointer(uInPos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInPos);
+		mesh->bindAttribute(Engine::VERTEX_ATTRIB_POSITION, uInPos);
 	}
 
 	if (uInUV != -1)
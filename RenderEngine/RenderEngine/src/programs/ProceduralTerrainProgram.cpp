@@ -11,6 +11,8 @@ const std::string Engine::ProceduralTerrainProgram::PROGRAM_NAME = "ProceduralTe
 const unsigned long long Engine::ProceduralTerrainProgram::WIRE_DRAW_MODE = 0x01;
 const unsigned long long Engine::ProceduralTerrainProgram::POINT_DRAW_MODE = 0x02;
 const unsigned long long Engine::ProceduralTerrainProgram::SHADOW_MAP = 0x04;
+const unsigned long long Engine::ProceduralTerrainProgram::QUADTREE_MODE = 0x08;
+const unsigned long long Engine::ProceduralTerrainProgram::INSTANCED = 0x10;
 
 // ==================================================================================
 
@@ -22,6 +24,13 @@ Engine::ProceduralTerrainProgram::ProceduralTerrainProgram(std::string name, uns
 	tevalShaderFile =	"shaders/terrain/terrain.teseval";
 	gShaderFile =		"shaders/terrain/terrain.geom";
 	fShaderFile =		"shaders/terrain/terrain.frag";
+
+	if (params & Engine::ProceduralTerrainProgram::QUADTREE_MODE)
+	{
+		vShaderFile = "shaders/terrain/terrain_quadtree.vert";
+	}
+
+	tcsShader = tevalShader = gShader = 0;
 }
 
 Engine::ProceduralTerrainProgram::ProceduralTerrainProgram(const ProceduralTerrainProgram & other)
@@ -31,6 +40,10 @@ Engine::ProceduralTerrainProgram::ProceduralTerrainProgram(const ProceduralTerra
 	tevalShaderFile = other.tevalShaderFile;
 	gShaderFile = other.gShaderFile;
 
+	tcsShader = other.tcsShader;
+	tevalShader = other.tevalShader;
+	gShader = other.gShader;
+
 	uModelView = other.uModelView;
 	uModelViewProj = other.uModelViewProj;
 	uNormal = other.uNormal;
@@ -39,10 +52,12 @@ Engine::ProceduralTerrainProgram::ProceduralTerrainProgram(const ProceduralTerra
 	uWorldScale = other.uWorldScale;
 	uRenderRadius = other.uRenderRadius;
 
-	uLightDepthMatrix = other.uLightDepthMatrix;
-	uLightDepthMatrix1 = other.uLightDepthMatrix1;
-	uDepthTexture = other.uDepthTexture;
-	uDepthTexture1 = other.uDepthTexture1;
+	uRegionDepthMatrices = other.uRegionDepthMatrices;
+	uRegionLayers = other.uRegionLayers;
+	uShadowRegions = other.uShadowRegions;
+	uLightDepthMatrices = other.uLightDepthMatrices;
+	uDepthTextures = other.uDepthTextures;
+	uCascadeLevels = other.uCascadeLevels;
 	uLightDirection = other.uLightDirection;
 
 	uAmplitude = other.uAmplitude;
@@ -52,9 +67,20 @@ Engine::ProceduralTerrainProgram::ProceduralTerrainProgram(const ProceduralTerra
 
 	uInPos = other.uInPos;
 	uInUV = other.uInUV;
+	uInInstance = other.uInInstance;
 
 	uGridPos = other.uGridPos;
 
+	uNodeOffset = other.uNodeOffset;
+	uNodeSize = other.uNodeSize;
+	uGridResolution = other.uGridResolution;
+	uMorphRange = other.uMorphRange;
+	uCameraPosition = other.uCameraPosition;
+
+	uTileHeights = other.uTileHeights;
+	uTileNormals = other.uTileNormals;
+	uTileLayer = other.uTileLayer;
+
 	uTime = other.uTime;
 
 	uGrassCoverage = other.uGrassCoverage;
@@ -69,40 +95,55 @@ void Engine::ProceduralTerrainProgram::initialize()
 
 	if (parameters & Engine::ProceduralTerrainProgram::WIRE_DRAW_MODE)
 	{
-		configStr += "#define WIRE_MODE";
+		configStr += "#define WIRE_MODE\n";
 	}
 	else if (parameters & Engine::ProceduralTerrainProgram::POINT_DRAW_MODE)
 	{
-		configStr += "#define POINT_MODE";
+		configStr += "#define POINT_MODE\n";
 	}
 
 	if (parameters & Engine::ProceduralTerrainProgram::SHADOW_MAP)
 	{
-		configStr += "#define SHADOW_MAP";
+		configStr += "#define SHADOW_MAP\n";
 	}
 
-	vShader = loadShader(vShaderFile, GL_VERTEX_SHADER, configStr);
-	tcsShader = loadShader(tcsShaderFile, GL_TESS_CONTROL_SHADER, configStr);
-	tevalShader = loadShader(tevalShaderFile, GL_TESS_EVALUATION_SHADER, configStr);
+	if (parameters & Engine::ProceduralTerrainProgram::INSTANCED)
+	{
+		configStr += "#define INSTANCED\n";
+	}
 
-	if (!(parameters & Engine::ProceduralTerrainProgram::SHADOW_MAP))
+	// G-buffer layout the fragment shader writes
+	if (Engine::Settings::compactGBuffer)
 	{
-		gShader = loadShader(gShaderFile, GL_GEOMETRY_SHADER, configStr);
+		configStr += "#define COMPACT_GBUFFER\n";
 	}
 
+	// The quadtree vertex shader displaces the terrain itself
+	const bool tessellated = !(parameters & Engine::ProceduralTerrainProgram::QUADTREE_MODE);
+
+	vShader = loadShader(vShaderFile, GL_VERTEX_SHADER, configStr);
+	if (tessellated)
+	{
+		tcsShader = loadShader(tcsShaderFile, GL_TESS_CONTROL_SHADER, configStr);
+		tevalShader = loadShader(tevalShaderFile, GL_TESS_EVALUATION_SHADER, configStr);
+	}
+
+	// On the shadow map pass, the geometry shader emits the triangles on every shadow map region
+	gShader = loadShader(gShaderFile, GL_GEOMETRY_SHADER, configStr);
+
 	fShader = loadShader(fShaderFile, GL_FRAGMENT_SHADER, configStr);
 
 	glProgram = glCreateProgram();
 
 	glAttachShader(glProgram, vShader);
-	glAttachShader(glProgram, tcsShader);
-	glAttachShader(glProgram, tevalShader);
-
-	if (!(parameters & Engine::ProceduralTerrainProgram::SHADOW_MAP))
+	if (tessellated)
 	{
-		glAttachShader(glProgram, gShader);
+		glAttachShader(glProgram, tcsShader);
+		glAttachShader(glProgram, tevalShader);
 	}
 
+	glAttachShader(glProgram, gShader);
+
 	glAttachShader(glProgram, fShader);
 
 	glLinkProgram(glProgram);
@@ -130,11 +171,23 @@ void Engine::ProceduralTerrainProgram::configureProgram()
 	uNormal = glGetUniformLocation(glProgram, "normal");
 	uGridPos = glGetUniformLocation(glProgram, "gridPos");
 
-	uLightDepthMatrix = glGetUniformLocation(glProgram, "lightDepthMat");
-	uLightDepthMatrix1 = glGetUniformLocation(glProgram, "lightDepthMat1");
+	uNodeOffset = glGetUniformLocation(glProgram, "nodeOffset");
+	uNodeSize = glGetUniformLocation(glProgram, "nodeSize");
+	uGridResolution = glGetUniformLocation(glProgram, "gridResolution");
+	uMorphRange = glGetUniformLocation(glProgram, "morphRange");
+	uCameraPosition = glGetUniformLocation(glProgram, "cameraPosition");
+
+	uTileHeights = glGetUniformLocation(glProgram, "tileHeights");
+	uTileNormals = glGetUniformLocation(glProgram, "tileNormals");
+	uTileLayer = glGetUniformLocation(glProgram, "tileLayer");
+
+	uRegionDepthMatrices = glGetUniformLocation(glProgram, "regionDepthMats");
+	uRegionLayers = glGetUniformLocation(glProgram, "regionLayers");
+	uShadowRegions = glGetUniformLocation(glProgram, "shadowRegions");
+	uLightDepthMatrices = glGetUniformLocation(glProgram, "lightDepthMats");
 	uLightDirection = glGetUniformLocation(glProgram, "lightDir");
-	uDepthTexture = glGetUniformLocation(glProgram, "depthTexture");
-	uDepthTexture1 = glGetUniformLocation(glProgram, "depthTexture1");
+	uDepthTextures = glGetUniformLocation(glProgram, "depthTextures");
+	uCascadeLevels = glGetUniformLocation(glProgram, "cascadeLevels");
 
 	uWaterLevel = glGetUniformLocation(glProgram, "waterHeight");
 	uWorldScale = glGetUniformLocation(glProgram, "worldScale");
@@ -153,6 +206,7 @@ void Engine::ProceduralTerrainProgram::configureProgram()
 
 	uInPos = glGetAttribLocation(glProgram, "inPos");
 	uInUV = glGetAttribLocation(glProgram, "inUV");
+	uInInstance = glGetAttribLocation(glProgram, "inInstance");
 }
 
 void Engine::ProceduralTerrainProgram::configureMeshBuffers(Engine::Mesh * data)
@@ -161,16 +215,12 @@ void Engine::ProceduralTerrainProgram::configureMeshBuffers(Engine::Mesh * data)
 
 	if (uInPos != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, data->vboVertices);
-		glVertexAttribPointer(uInPos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInPos);
+		data->bindAttribute(Engine::VERTEX_ATTRIB_POSITION, uInPos);
 	}
 
 	if (uInUV != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, data->vboUVs);
-		glVertexAttribPointer(uInUV, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInUV);
+		data->bindAttribute(Engine::VERTEX_ATTRIB_UV, uInUV);
 	}
 }
 
@@ -178,13 +228,7 @@ void Engine::ProceduralTerrainProgram::applyGlobalUniforms()
 {
 	if (!(parameters & Engine::ProceduralTerrainProgram::SHADOW_MAP))
 	{
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, Engine::CascadeShadowMaps::getInstance().getDepthTexture0()->getTexture()->getTextureId());
-		glUniform1i(uDepthTexture, 0);
-
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, Engine::CascadeShadowMaps::getInstance().getDepthTexture1()->getTexture()->getTextureId());
-		glUniform1i(uDepthTexture1, 1);
+		Engine::CascadeShadowMaps::getInstance().bindDepthTextures(uDepthTextures);
 
 		glm::vec3 ld = glm::normalize(Engine::Settings::lightDirection);
 		glUniform3fv(uLightDirection, 1, &ld[0]);
@@ -199,6 +243,10 @@ void Engine::ProceduralTerrainProgram::applyGlobalUniforms()
 		glUniform1f(uWorldScale, Engine::Settings::worldTileScale);
 		glUniform1f(uRenderRadius, (float)Engine::Settings::worldRenderRadius);
 	}
+	else
+	{
+		Engine::CascadeShadowMaps::getInstance().setRegionUniforms(uRegionLayers, uShadowRegions);
+	}
 
 	glUniform1f(uWorldScale, Engine::Settings::worldTileScale);
 	glUniform1f(uAmplitude, Engine::Settings::terrainAmplitude);
@@ -206,6 +254,11 @@ void Engine::ProceduralTerrainProgram::applyGlobalUniforms()
 	glUniform1f(uScale, Engine::Settings::terrainScale);
 	glUniform1i(uOctaves, Engine::Settings::terrainOctaves);
 	glUniform1f(uWaterLevel, Engine::Settings::waterHeight);
+
+	// Tile cache maps are bound by the landscape component (see LandscapeComponent::preRenderComponent)
+	glUniform1i(uTileHeights, Engine::CascadeShadowMaps::MAX_LEVELS);
+	glUniform1i(uTileNormals, Engine::CascadeShadowMaps::MAX_LEVELS + 1);
+	glUniform1i(uTileLayer, -1);
 }
 
 void Engine::ProceduralTerrainProgram::onRenderObject(const Engine::Object * obj, Engine::Camera * camera)
@@ -227,14 +280,49 @@ void Engine::ProceduralTerrainProgram::setUniformGridPosition(unsigned int i, un
 	glUniform2i(uGridPos, i, j);
 }
 
-void Engine::ProceduralTerrainProgram::setUniformLightDepthMatrix(const glm::mat4 & ldm)
+void Engine::ProceduralTerrainProgram::setUniformRegionDepthMatrices(const glm::mat4 * rdm, unsigned int regions)
+{
+	glUniformMatrix4fv(uRegionDepthMatrices, regions, GL_FALSE, &(rdm[0][0][0]));
+}
+
+void Engine::ProceduralTerrainProgram::setUniformLightDepthMatrices(const glm::mat4 * ldm, unsigned int levels)
+{
+	glUniformMatrix4fv(uLightDepthMatrices, levels, GL_FALSE, &(ldm[0][0][0]));
+	glUniform1i(uCascadeLevels, levels);
+}
+
+void Engine::ProceduralTerrainProgram::setUniformQuadTreeNode(const Engine::TerrainQuadTree::Node & node)
+{
+	glUniform2f(uNodeOffset, node.x, node.z);
+	glUniform1f(uNodeSize, node.size);
+	glUniform1f(uGridResolution, float(node.gridResolution));
+	glUniform2f(uMorphRange, node.morphStart, node.morphEnd);
+}
+
+void Engine::ProceduralTerrainProgram::setUniformCameraPosition(const glm::vec3 & position)
+{
+	glUniform3fv(uCameraPosition, 1, &position[0]);
+}
+
+void Engine::ProceduralTerrainProgram::setUniformTileLayer(int layer)
+{
+	glUniform1i(uTileLayer, layer);
+}
+
+void Engine::ProceduralTerrainProgram::bindInstances(Engine::InstanceBuffer & instances, size_t firstInstance)
 {
-	glUniformMatrix4fv(uLightDepthMatrix, 1, GL_FALSE, &(ldm[0][0]));
+	if (uInInstance != -1)
+	{
+		instances.bind(uInInstance, firstInstance);
+	}
 }
 
-void Engine::ProceduralTerrainProgram::setUniformLightDepthMatrix1(const glm::mat4 & ldm)
+void Engine::ProceduralTerrainProgram::unbindInstances(Engine::InstanceBuffer & instances)
 {
-	glUniformMatrix4fv(uLightDepthMatrix1, 1, GL_FALSE, &(ldm[0][0]));
+	if (uInInstance != -1)
+	{
+		instances.unbind(uInInstance);
+	}
 }
 
 void Engine::ProceduralTerrainProgram::destroy()
@@ -242,14 +330,20 @@ void Engine::ProceduralTerrainProgram::destroy()
 	glDetachShader(glProgram, vShader);
 	glDeleteShader(vShader);
 
-	glDetachShader(glProgram, tcsShader);
-	glDeleteShader(tcsShader);
+	if (tcsShader != 0)
+	{
+		glDetachShader(glProgram, tcsShader);
+		glDeleteShader(tcsShader);
 
-	glDetachShader(glProgram, tevalShader);
-	glDeleteShader(tevalShader);
+		glDetachShader(glProgram, tevalShader);
+		glDeleteShader(tevalShader);
+	}
 
-	glDetachShader(glProgram, gShader);
-	glDeleteShader(gShader);
+	if (gShader != 0)
+	{
+		glDetachShader(glProgram, gShader);
+		glDeleteShader(gShader);
+	}
 
 	glDetachShader(glProgram, fShader);
 	glDeleteShader(fShader);
@@ -12,6 +12,7 @@ std::string Engine::ProceduralWaterProgram::PROGRAM_NAME = "ProceduralWaterProgr
 const unsigned long long Engine::ProceduralWaterProgram::WIRE_DRAW_MODE = 0x01;
 const unsigned long long Engine::ProceduralWaterProgram::POINT_DRAW_MODE = 0x02;
 const unsigned long long Engine::ProceduralWaterProgram::SHADOW_MAP = 0x04;
+const unsigned long long Engine::ProceduralWaterProgram::INSTANCED = 0x08;
 
 Engine::ProceduralWaterProgram::ProceduralWaterProgram(std::string name, unsigned long long params)
 	:Engine::Program(name, params)
@@ -31,9 +32,9 @@ Engine::ProceduralWaterProgram::ProceduralWaterProgram(const Engine::ProceduralW
 	uNormal = other.uNormal;
 
 	uLightDepthMatrix = other.uLightDepthMatrix;
-	uLightDepthMatrix1 = other.uLightDepthMatrix1;
-	uDepthTexture = other.uDepthTexture;
-	uDepthTexture1 = other.uDepthTexture1;
+	uLightDepthMatrices = other.uLightDepthMatrices;
+	uDepthTextures = other.uDepthTextures;
+	uCascadeLevels = other.uCascadeLevels;
 	uLightDirection = other.uLightDirection;
 
 	uInInfo = other.uInInfo;
@@ -45,6 +46,7 @@ Engine::ProceduralWaterProgram::ProceduralWaterProgram(const Engine::ProceduralW
 
 	uInPos = other.uInPos;
 	uInUV = other.uInUV;
+	uInInstance = other.uInInstance;
 
 	uGridPos = other.uGridPos;
 }
@@ -55,16 +57,27 @@ void Engine::ProceduralWaterProgram::initialize()
 
 	if (parameters & Engine::ProceduralWaterProgram::WIRE_DRAW_MODE)
 	{
-		configStr += "#define WIRE_MODE";
+		configStr += "#define WIRE_MODE\n";
 	}
 	else if (parameters & Engine::ProceduralWaterProgram::POINT_DRAW_MODE)
 	{
-		configStr += "#define POINT_MODE";
+		configStr += "#define POINT_MODE\n";
 	}
 
 	if (parameters & Engine::ProceduralWaterProgram::SHADOW_MAP)
 	{
-		configStr += "#define SHADOW_MAP";
+		configStr += "#define SHADOW_MAP\n";
+	}
+
+	if (parameters & Engine::ProceduralWaterProgram::INSTANCED)
+	{
+		configStr += "#define INSTANCED\n";
+	}
+
+	// G-buffer layout the fragment shader writes
+	if (Engine::Settings::compactGBuffer)
+	{
+		configStr += "#define COMPACT_GBUFFER\n";
 	}
 
 	vShader = loadShader(vShaderFile, GL_VERTEX_SHADER, configStr);
@@ -112,9 +125,9 @@ void Engine::ProceduralWaterProgram::configureProgram()
 	uGridPos = glGetUniformLocation(glProgram, "gridPos");
 
 	uLightDepthMatrix = glGetUniformLocation(glProgram, "lightDepthMat");
-	uLightDepthMatrix1 = glGetUniformLocation(glProgram, "lightDepthMat1");
-	uDepthTexture = glGetUniformLocation(glProgram, "depthTexture");
-	uDepthTexture1 = glGetUniformLocation(glProgram, "depthTexture1");
+	uLightDepthMatrices = glGetUniformLocation(glProgram, "lightDepthMats");
+	uDepthTextures = glGetUniformLocation(glProgram, "depthTextures");
+	uCascadeLevels = glGetUniformLocation(glProgram, "cascadeLevels");
 	uLightDirection = glGetUniformLocation(glProgram, "lightDir");
 
 	uInInfo = glGetUniformLocation(glProgram, "inInfo");
@@ -126,6 +139,7 @@ void Engine::ProceduralWaterProgram::configureProgram()
 
 	uInPos = glGetAttribLocation(glProgram, "inPos");
 	uInUV = glGetAttribLocation(glProgram, "inUV");
+	uInInstance = glGetAttribLocation(glProgram, "inInstance");
 }
 
 void Engine::ProceduralWaterProgram::setUniformGridPosition(unsigned int i, unsigned int j)
@@ -138,22 +152,33 @@ void Engine::ProceduralWaterProgram::setUniformLightDepthMatrix(const glm::mat4
 	glUniformMatrix4fv(uLightDepthMatrix, 1, GL_FALSE, &(ldm[0][0]));
 }
 
-void Engine::ProceduralWaterProgram::setUniformLightDepthMatrix1(const glm::mat4 & ldm)
+void Engine::ProceduralWaterProgram::setUniformLightDepthMatrices(const glm::mat4 * ldm, unsigned int levels)
 {
-	glUniformMatrix4fv(uLightDepthMatrix1, 1, GL_FALSE, &(ldm[0][0]));
+	glUniformMatrix4fv(uLightDepthMatrices, levels, GL_FALSE, &(ldm[0][0][0]));
+	glUniform1i(uCascadeLevels, levels);
+}
+
+void Engine::ProceduralWaterProgram::bindInstances(Engine::InstanceBuffer & instances)
+{
+	if (uInInstance != -1)
+	{
+		instances.bind(uInInstance);
+	}
+}
+
+void Engine::ProceduralWaterProgram::unbindInstances(Engine::InstanceBuffer & instances)
+{
+	if (uInInstance != -1)
+	{
+		instances.unbind(uInInstance);
+	}
 }
 
 void Engine::ProceduralWaterProgram::applyGlobalUniforms()
 {
 	//if (!(parameters & Engine::ProceduralWaterProgram::SHADOW_MAP))
 	{
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, Engine::CascadeShadowMaps::getInstance().getDepthTexture0()->getTexture()->getTextureId());
-		glUniform1i(uDepthTexture, 0);
-
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, Engine::CascadeShadowMaps::getInstance().getDepthTexture1()->getTexture()->getTextureId());
-		glUniform1i(uDepthTexture1, 1);
+		Engine::CascadeShadowMaps::getInstance().bindDepthTextures(uDepthTextures);
 
 		glm::vec3 ld = glm::normalize(Engine::Settings::lightDirection);
 		glUniform3fv(uLightDirection, 1, &ld[0]);
@@ -161,9 +186,9 @@ void Engine::ProceduralWaterProgram::applyGlobalUniforms()
 		glUniform1f(uTime, Engine::Time::timeSinceBegining);
 
 		Engine::DeferredRenderer * dr = static_cast<Engine::DeferredRenderer*>(Engine::RenderManager::getInstance().getRenderer());
-		glActiveTexture(GL_TEXTURE2);
+		glActiveTexture(GL_TEXTURE0 + Engine::CascadeShadowMaps::MAX_LEVELS);
 		glBindTexture(GL_TEXTURE_2D, dr->getGBufferInfo()->getTexture()->getTextureId());
-		glUniform1i(uInInfo, 2);
+		glUniform1i(uInInfo, Engine::CascadeShadowMaps::MAX_LEVELS);
 		glUniform2f(uScreenSize, float(Engine::ScreenManager::SCREEN_WIDTH), float(Engine::ScreenManager::SCREEN_HEIGHT));
 
 		glUniform1f(uWaterSpeed, Engine::Settings::waterSpeed);
@@ -188,16 +213,12 @@ void Engine::ProceduralWaterProgram::configureMeshBuffers(Engine::Mesh * data)
 
 	if (uInPos != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, data->vboVertices);
-		glVertexAttribPointer(uInPos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInPos);
+		data->bindAttribute(Engine::VERTEX_ATTRIB_POSITION, uInPos);
 	}
 
 	if (uInUV != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, data->vboUVs);
-		glVertexAttribPointer(uInUV, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInUV);
+		data->bindAttribute(Engine::VERTEX_ATTRIB_UV, uInUV);
 	}
 }
 
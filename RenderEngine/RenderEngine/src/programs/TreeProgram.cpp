@@ -11,6 +11,7 @@ const std::string Engine::TreeProgram::PROGRAM_NAME = "TreeProgram";
 const unsigned long long Engine::TreeProgram::SHADOW_MAP = 0x01;
 const unsigned long long Engine::TreeProgram::WIRE_MODE = 0x02;
 const unsigned long long Engine::TreeProgram::POINT_MODE = 0x04;
+const unsigned long long Engine::TreeProgram::INSTANCED = 0x08;
 
 Engine::TreeProgram::TreeProgram(std::string name, unsigned long long params)
 	:Program(name, params)
@@ -26,19 +27,14 @@ Engine::TreeProgram::TreeProgram(const TreeProgram & other)
 	uModelViewProj = other.uModelViewProj;
 	uModelView = other.uModelView;
 	uNormal = other.uNormal;
-	uLightDepthMat0 = other.uLightDepthMat0;
-	uLightDepthMat1 = other.uLightDepthMat1;
-	uGridUV = other.uGridUV;
-	uAmplitude = other.uAmplitude;
-	uFrecuency = other.uFrecuency;
-	uScale = other.uScale;
-	uOctaves = other.uOctaves;
-	uWorldScale = other.uWorldScale;
+	uRegionDepthMats = other.uRegionDepthMats;
+	uRegionLayers = other.uRegionLayers;
+	uShadowRegions = other.uShadowRegions;
+	uLightDepthMats = other.uLightDepthMats;
+	uCascadeLevels = other.uCascadeLevels;
+	uWindSign = other.uWindSign;
 	uLightDir = other.uLightDir;
-	uWaterLevel = other.uWaterLevel;
-	uMaxHeight = other.uMaxHeight;
-	uDepthMap0 = other.uDepthMap0;
-	uDepthMap1 = other.uDepthMap1;
+	uDepthMaps = other.uDepthMaps;
 	uSinTime = other.uSinTime;
 	uWindDir = other.uWindDir;
 	uWindStrength = other.uWindStrength;
@@ -48,6 +44,7 @@ Engine::TreeProgram::TreeProgram(const TreeProgram & other)
 	uInNormal = other.uInNormal;
 	uInEmissive = other.uInEmissive;
 	uInUV = other.uInUV;
+	uInInstance = other.uInInstance;
 }
 
 void Engine::TreeProgram::initialize()
@@ -56,16 +53,27 @@ void Engine::TreeProgram::initialize()
 
 	if (parameters & Engine::TreeProgram::SHADOW_MAP)
 	{
-		config += "#define SHADOW_MAP";
+		config += "#define SHADOW_MAP\n";
 	}
 
 	if (parameters & Engine::TreeProgram::WIRE_MODE)
 	{
-		config += "#define WIRE_MODE";
+		config += "#define WIRE_MODE\n";
 	}
 	else if (parameters & Engine::TreeProgram::POINT_MODE)
 	{
-		config += "#define POINT_MODE";
+		config += "#define POINT_MODE\n";
+	}
+
+	if (parameters & Engine::TreeProgram::INSTANCED)
+	{
+		config += "#define INSTANCED\n";
+	}
+
+	// G-buffer layout the fragment shader writes
+	if (Engine::Settings::compactGBuffer)
+	{
+		config += "#define COMPACT_GBUFFER\n";
 	}
 
 	vShader = loadShader(vShaderFile, GL_VERTEX_SHADER, config);
@@ -101,19 +109,14 @@ void Engine::TreeProgram::configureProgram()
 	uModelViewProj = glGetUniformLocation(glProgram, "modelViewProj");
 	uModelView = glGetUniformLocation(glProgram, "modelView");
 	uNormal = glGetUniformLocation(glProgram, "normal");
-	uGridUV = glGetUniformLocation(glProgram, "tileUV");
-	uAmplitude = glGetUniformLocation(glProgram, "amplitude");
-	uFrecuency = glGetUniformLocation(glProgram, "frecuency");
-	uScale = glGetUniformLocation(glProgram, "scale");
-	uOctaves = glGetUniformLocation(glProgram, "octaves");
-	uLightDepthMat0 = glGetUniformLocation(glProgram, "lightDepthMat");
-	uLightDepthMat1 = glGetUniformLocation(glProgram, "lightDepthMat1");
+	uWindSign = glGetUniformLocation(glProgram, "windSign");
+	uRegionDepthMats = glGetUniformLocation(glProgram, "regionDepthMats");
+	uRegionLayers = glGetUniformLocation(glProgram, "regionLayers");
+	uShadowRegions = glGetUniformLocation(glProgram, "shadowRegions");
+	uLightDepthMats = glGetUniformLocation(glProgram, "lightDepthMats");
+	uCascadeLevels = glGetUniformLocation(glProgram, "cascadeLevels");
 	uLightDir = glGetUniformLocation(glProgram, "lightDir");
-	uWaterLevel = glGetUniformLocation(glProgram, "waterHeight");
-	uMaxHeight = glGetUniformLocation(glProgram, "maxHeight");
-	uDepthMap0 = glGetUniformLocation(glProgram, "depthTexture");
-	uDepthMap1 = glGetUniformLocation(glProgram, "depthTexture1");
-	uWorldScale = glGetUniformLocation(glProgram, "worldScale");
+	uDepthMaps = glGetUniformLocation(glProgram, "depthTextures");
 
 	uSinTime = glGetUniformLocation(glProgram, "sinTime");
 	uWindDir = glGetUniformLocation(glProgram, "windDirection");
@@ -124,6 +127,7 @@ void Engine::TreeProgram::configureProgram()
 	uInNormal = glGetAttribLocation(glProgram, "inNormal");
 	uInEmissive = glGetAttribLocation(glProgram, "inEmission");
 	uInUV = glGetAttribLocation(glProgram, "inTexCoord");
+	uInInstance = glGetAttribLocation(glProgram, "inInstance");
 }
 
 void Engine::TreeProgram::configureMeshBuffers(Mesh * mesh)
@@ -132,37 +136,27 @@ void Engine::TreeProgram::configureMeshBuffers(Mesh * mesh)
 
 	if (uInPos != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, mesh->vboVertices);
-		glVertexAttribPointer(uInPos, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInPos);
+		mesh->bindAttribute(Engine::VERTEX_ATTRIB_POSITION, uInPos);
 	}
 
 	if (uInColor != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, mesh->vboColors);
-		glVertexAttribPointer(uInColor, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInColor);
+		mesh->bindAttribute(Engine::VERTEX_ATTRIB_COLOR, uInColor);
 	}
 
 	if (uInNormal != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, mesh->vboNormals);
-		glVertexAttribPointer(uInNormal, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInNormal);
+		mesh->bindAttribute(Engine::VERTEX_ATTRIB_NORMAL, uInNormal);
 	}
 
 	if (uInEmissive != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, mesh->vboEmission);
-		glVertexAttribPointer(uInEmissive, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInEmissive);
+		mesh->bindAttribute(Engine::VERTEX_ATTRIB_EMISSION, uInEmissive);
 	}
 
 	if (uInUV != -1)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, mesh->vboUVs);
-		glVertexAttribPointer(uInUV, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		glEnableVertexAttribArray(uInUV);
+		mesh->bindAttribute(Engine::VERTEX_ATTRIB_UV, uInUV);
 	}
 }
 
@@ -170,26 +164,21 @@ void Engine::TreeProgram::applyGlobalUniforms()
 {
 	if (!(parameters & Engine::TreeProgram::SHADOW_MAP))
 	{
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, Engine::CascadeShadowMaps::getInstance().getDepthTexture0()->getTexture()->getTextureId());
-		glUniform1i(uDepthMap0, 0);
-
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, Engine::CascadeShadowMaps::getInstance().getDepthTexture1()->getTexture()->getTextureId());
-		glUniform1i(uDepthMap1, 1);
+		Engine::CascadeShadowMaps::getInstance().bindDepthTextures(uDepthMaps);
 
 		glm::vec3 ld = glm::normalize(Engine::Settings::lightDirection);
 		glUniform3fv(uLightDir, 1, &ld[0]);
 	}
+	else
+	{
+		Engine::CascadeShadowMaps::getInstance().setRegionUniforms(uRegionLayers, uShadowRegions);
+	}
 
 	float sinTime = glm::sin(Engine::Time::timeSinceBegining);
 	sinTime *= sinTime;
 	glUniform1f(uSinTime, sinTime);
 	glUniform3fv(uWindDir, 1, &Engine::Settings::windDirection[0]);
 	glUniform1f(uWindStrength, Engine::Settings::windStrength);
-
-	glUniform1f(uMaxHeight, Engine::Settings::waterHeight + Engine::Settings::vegetationMaxHeight);
-	glUniform1f(uWorldScale, Engine::Settings::worldTileScale);
 }
 
 void Engine::TreeProgram::onRenderObject(const Engine::Object * obj, Engine::Camera * camera)
@@ -201,27 +190,38 @@ void Engine::TreeProgram::onRenderObject(const Engine::Object * obj, Engine::Cam
 	glUniformMatrix4fv(uModelViewProj, 1, GL_FALSE, &(modelViewProj[0][0]));
 	glUniformMatrix4fv(uModelView, 1, GL_FALSE, &(modelView[0][0]));
 	glUniformMatrix4fv(uNormal, 1, GL_FALSE, &(normal[0][0]));
+}
 
-	glUniform1f(uAmplitude, Engine::Settings::terrainAmplitude);
-	glUniform1f(uFrecuency, Engine::Settings::terrainFrecuency);
-	glUniform1f(uScale, Engine::Settings::terrainScale);
-	glUniform1i(uOctaves, Engine::Settings::terrainOctaves);
-	glUniform1f(uWaterLevel, Engine::Settings::waterHeight);
+void Engine::TreeProgram::setUniformWindSign(float sign)
+{
+	glUniform1f(uWindSign, sign);
 }
 
-void Engine::TreeProgram::setUniformTileUV(float u, float v)
+void Engine::TreeProgram::setUniformRegionDepthMats(const glm::mat4 * rdp, unsigned int regions)
 {
-	glUniform2f(uGridUV, u, v);
+	glUniformMatrix4fv(uRegionDepthMats, regions, GL_FALSE, &(rdp[0][0][0]));
 }
 
-void Engine::TreeProgram::setUniformLightDepthMat(const glm::mat4 & ldm)
+void Engine::TreeProgram::setUniformLightDepthMats(const glm::mat4 * ldp, unsigned int levels)
 {
-	glUniformMatrix4fv(uLightDepthMat0, 1, GL_FALSE, &(ldm[0][0]));
+	glUniformMatrix4fv(uLightDepthMats, levels, GL_FALSE, &(ldp[0][0][0]));
+	glUniform1i(uCascadeLevels, levels);
 }
 
-void Engine::TreeProgram::setUniformLightDepthMat1(const glm::mat4 & ldp)
+void Engine::TreeProgram::bindInstances(Engine::InstanceBuffer & instances, size_t firstInstance)
 {
-	glUniformMatrix4fv(uLightDepthMat1, 1, GL_FALSE, &(ldp[0][0]));
+	if (uInInstance != -1)
+	{
+		instances.bind(uInInstance, firstInstance);
+	}
+}
+
+void Engine::TreeProgram::unbindInstances(Engine::InstanceBuffer & instances)
+{
+	if (uInInstance != -1)
+	{
+		instances.unbind(uInInstance);
+	}
 }
 
 void Engine::TreeProgram::destroy()
@@ -1,5 +1,7 @@
 #include "renderers/DeferredRenderer.h"
 
+#include <iostream>
+
 #include "Scene.h"
 #include "datatables/DeferredObjectsTable.h"
 #include "datatables/MeshTable.h"
@@ -7,6 +9,7 @@
 
 #include "volumetricclouds/NoiseInitializer.h"
 #include "CascadeShadowMaps.h"
+#include "WorldConfig.h"
 
 Engine::DeferredRenderer::DeferredRenderer()
 	:Engine::Renderer()
@@ -18,6 +21,11 @@ Engine::DeferredRenderer::DeferredRenderer()
 
 Engine::DeferredRenderer::~DeferredRenderer()
 {
+	for (auto texture : graphTextures)
+	{
+		delete texture->getTexture();
+		delete texture;
+	}
 }
 
 void Engine::DeferredRenderer::addPostProcess(Engine::PostProcessChainNode * object)
@@ -60,6 +68,16 @@ const Engine::TextureInstance * Engine::DeferredRenderer::getGBufferInfo()
 	return gBufferInfo;
 }
 
+unsigned int Engine::DeferredRenderer::getGBufferBytesPerPixel() const
+{
+	return gBufferBytesPerPixel;
+}
+
+const Engine::RenderGraph & Engine::DeferredRenderer::getRenderGraph() const
+{
+	return renderGraph;
+}
+
 void Engine::DeferredRenderer::initialize()
 {
 	Engine::Renderer::initialize();
@@ -69,17 +87,42 @@ void Engine::DeferredRenderer::initialize()
 
 	initialized = true;
 
-	// Create G Buffers
-	forwardPassBuffer = new Engine::DeferredRenderObject(6, true);
-	gBufferColor = forwardPassBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, Engine::DeferredRenderObject::G_BUFFER_COLOR, GL_NEAREST);
-	gBufferNormal = forwardPassBuffer->addColorBuffer(1, GL_RGB32F, GL_RGBA, GL_UNSIGNED_BYTE, 500, 500, Engine::DeferredRenderObject::G_BUFFER_NORMAL, GL_NEAREST);
-	gBufferSpecular = forwardPassBuffer->addColorBuffer(2, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, Engine::DeferredRenderObject::G_BUFFER_SPECULAR, GL_NEAREST);
-	gBufferEmissive = forwardPassBuffer->addColorBuffer(3, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, Engine::DeferredRenderObject::G_BUFFER_EMISSIVE, GL_NEAREST);
-	gBufferPos = forwardPassBuffer->addColorBuffer(4, GL_RGB32F, GL_RGBA, GL_UNSIGNED_BYTE, 500, 500, Engine::DeferredRenderObject::G_BUFFER_POS, GL_NEAREST);
-	gBufferInfo = forwardPassBuffer->addColorBuffer(5, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "InfoBuffer", GL_LINEAR);
+	// Create G Buffers. The compact layout drops the view space position, which the deferred passes rebuild
+	// from the depth and the inverse projection, stores the normal octahedral encoded on two 16 bit channels
+	// and the specular (a single value for every surface) on the emissive alpha
+	std::vector<GLenum> gBufferFormats;
+	if (Engine::Settings::compactGBuffer)
+	{
+		forwardPassBuffer = new Engine::DeferredRenderObject(4, true);
+		gBufferColor = forwardPassBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, Engine::DeferredRenderObject::G_BUFFER_COLOR, GL_NEAREST);
+		gBufferNormal = forwardPassBuffer->addColorBuffer(1, GL_RG16, GL_RG, GL_UNSIGNED_SHORT, 500, 500, Engine::DeferredRenderObject::G_BUFFER_NORMAL, GL_NEAREST);
+		gBufferEmissive = forwardPassBuffer->addColorBuffer(2, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, Engine::DeferredRenderObject::G_BUFFER_EMISSIVE, GL_NEAREST);
+		gBufferInfo = forwardPassBuffer->addColorBuffer(3, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "InfoBuffer", GL_LINEAR);
+		gBufferSpecular = gBufferEmissive;
+		gBufferPos = NULL;
+		gBufferFormats = { GL_RGBA16F, GL_RG16, GL_RGBA16F, GL_RGBA8 };
+	}
+	else
+	{
+		forwardPassBuffer = new Engine::DeferredRenderObject(6, true);
+		gBufferColor = forwardPassBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, Engine::DeferredRenderObject::G_BUFFER_COLOR, GL_NEAREST);
+		gBufferNormal = forwardPassBuffer->addColorBuffer(1, GL_RGB32F, GL_RGBA, GL_UNSIGNED_BYTE, 500, 500, Engine::DeferredRenderObject::G_BUFFER_NORMAL, GL_NEAREST);
+		gBufferSpecular = forwardPassBuffer->addColorBuffer(2, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, Engine::DeferredRenderObject::G_BUFFER_SPECULAR, GL_NEAREST);
+		gBufferEmissive = forwardPassBuffer->addColorBuffer(3, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, Engine::DeferredRenderObject::G_BUFFER_EMISSIVE, GL_NEAREST);
+		gBufferPos = forwardPassBuffer->addColorBuffer(4, GL_RGB32F, GL_RGBA, GL_UNSIGNED_BYTE, 500, 500, Engine::DeferredRenderObject::G_BUFFER_POS, GL_NEAREST);
+		gBufferInfo = forwardPassBuffer->addColorBuffer(5, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "InfoBuffer", GL_LINEAR);
+		gBufferFormats = { GL_RGBA16F, GL_RGB32F, GL_RGBA8, GL_RGBA16F, GL_RGB32F, GL_RGBA8 };
+	}
 	gBufferDepth = forwardPassBuffer->addDepthBuffer24(500, 500);
+	gBufferFormats.push_back(GL_DEPTH_COMPONENT24);
 	forwardPassBuffer->initialize();
 
+	gBufferBytesPerPixel = 0;
+	for (GLenum format : gBufferFormats)
+	{
+		gBufferBytesPerPixel += Engine::RenderGraph::getBytesPerTexel(format);
+	}
+
 	// Instantiate deferred shading program
 	deferredShading = Engine::ProgramTable::getInstance().getProgram<Engine::DeferredShadingProgram>();
 	Engine::Mesh * mi = Engine::MeshTable::getInstance().getMesh("plane");
@@ -88,22 +131,61 @@ void Engine::DeferredRenderer::initialize()
 	// Link G-Buffers to deferred shading surface input
 	forwardPassBuffer->populateDeferredObject(deferredDrawSurface);
 
+	// Deferred shading pass targets. The skybox is depth tested when rendered on them. The god rays pass
+	// samples them at texel centers, so they are filtered like the post process targets to share textures
+	const Engine::RenderGraph::TargetDesc shadedTarget = { GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_LINEAR };
+	const Engine::RenderGraph::TargetDesc godRaysTarget = { GL_RGBA8, GL_RGBA, GL_FLOAT, GL_LINEAR };
+	const Engine::RenderGraph::TargetDesc depthTarget = { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT, GL_NEAREST };
+	std::vector<unsigned int> previousOutputs;
+	previousOutputs.push_back(renderGraph.addTarget("Shaded color", shadedTarget));	// Color info
+	previousOutputs.push_back(renderGraph.addTarget("Shaded emission", shadedTarget));	// Emission info
+	previousOutputs.push_back(renderGraph.addTarget("God rays info", godRaysTarget));	// God rays info
+	std::vector<unsigned int> shadingWrites = previousOutputs;
+	shadingWrites.push_back(renderGraph.addTarget("Shading depth", depthTarget));
+	renderGraph.addPass("Deferred shading", {}, shadingWrites);
+
+	// Each post process reads the targets of the previous one, and the screen output the last ones
+	for (auto node : postProcessChain)
+	{
+		const std::string name = node->postProcessProgram->getName();
+		std::vector<unsigned int> outputs;
+		for (unsigned int i = 0; i < node->outputs.size(); i++)
+		{
+			outputs.push_back(renderGraph.addTarget(name + " " + std::to_string(i), node->outputs[i]));
+		}
+		renderGraph.addPass(name, previousOutputs, outputs);
+		previousOutputs = outputs;
+	}
+	renderGraph.addPass("Screen output", previousOutputs, {});
+
+	// Targets alive on different passes share the textures. Their size is set on resize
+	if (!renderGraph.compile())
+	{
+		std::cerr << "DeferredRenderer: the post process chain reads a target no previous pass writes" << std::endl;
+		exit(-1);
+	}
+	for (unsigned int i = 0; i < renderGraph.getNumTextures(); i++)
+	{
+		const Engine::RenderGraph::TargetDesc & desc = renderGraph.getTextureDesc(i);
+		Engine::TextureInstance * texture = Engine::DeferredRenderObject::createRenderTexture(desc.gpuTextureFormat, desc.inputTextureFormat,
+			desc.pixelFormat, 500, 500, "", desc.filterMethod);
+		texture->generateTexture();
+		texture->configureTexture();
+		graphTextures.push_back(texture);
+	}
+
 	// Creage deferred shading buffer
-	deferredPassBuffer = new Engine::DeferredRenderObject(3, false);
-	deferredPassBuffer->addColorBuffer(0, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_NEAREST);	// Color info
-	deferredPassBuffer->addColorBuffer(1, GL_RGBA16F, GL_RGBA, GL_FLOAT, 500, 500, "", GL_NEAREST);	// Emission info
-	deferredPassBuffer->addColorBuffer(2, GL_RGBA8, GL_RGBA, GL_FLOAT, 500, 500, "", GL_LINEAR);		// God rays info
-	deferredPassBuffer->addDepthBuffer24(500, 500);
-	deferredPassBuffer->initialize();
+	deferredPassBuffer = createPassBuffer(0);
 
 	// Linke post processes as a chain
 	std::list<Engine::PostProcessChainNode *>::iterator it = postProcessChain.begin();
 	Engine::DeferredRenderObject * previousLink = deferredPassBuffer;
+	unsigned int pass = 1;
 	while (it != postProcessChain.end())
 	{
 		Engine::PostProcessChainNode * node = (*it);
-		// Initialize FBO and textures
-		node->renderBuffer->initialize();
+		// Initialize FBO
+		node->renderBuffer = createPassBuffer(pass++);
 		// Set the output of the previous pass as the input of the next
 		previousLink->populateDeferredObject(node->obj);
 		previousLink = node->renderBuffer;
@@ -209,7 +291,42 @@ void Engine::DeferredRenderer::runPostProcesses()
 	glEnable(GL_DEPTH_TEST);
 }
 
+Engine::DeferredRenderObject * Engine::DeferredRenderer::createPassBuffer(unsigned int pass)
+{
+	const Engine::RenderGraph::Pass & graphPass = renderGraph.getPasses()[pass];
+
+	unsigned int colorBuffers = 0;
+	for (unsigned int target : graphPass.writes)
+	{
+		colorBuffers += Engine::RenderGraph::isDepthFormat(renderGraph.getTargets()[target].desc.gpuTextureFormat) ? 0 : 1;
+	}
+
+	Engine::DeferredRenderObject * buffer = new Engine::DeferredRenderObject(colorBuffers, false);
+	unsigned int index = 0;
+	for (unsigned int target : graphPass.writes)
+	{
+		Engine::TextureInstance * texture = graphTextures[renderGraph.getTexture(target)];
+		if (Engine::RenderGraph::isDepthFormat(renderGraph.getTargets()[target].desc.gpuTextureFormat))
+		{
+			buffer->attachDepthBuffer(texture);
+		}
+		else
+		{
+			buffer->attachColorBuffer(index++, texture);
+		}
+	}
+	buffer->initialize();
+
+	return buffer;
+}
+
 void Engine::DeferredRenderer::onResize(unsigned int w, unsigned int h)
 {
+	// The shared textures are resized first, the FBOs attach them again once resized
+	for (auto texture : graphTextures)
+	{
+		texture->resize(w, h);
+	}
+
 	Engine::DeferredObjectsTable::getInstance().onResize(int(w), int(h));
 }
\ No newline at end of file
@@ -58,7 +58,7 @@ void Engine::ForwardRenderer::renderProgram(Engine::Camera * camera, Engine::Pro
 			program->onRenderObject(objToRender, camera);
 
 			unsigned int vertexPerFace = objToRender->getMesh()->getNumVerticesPerFace();
-			glDrawElements(objToRender->getRenderMode(), objToRender->getMesh()->getNumFaces() * vertexPerFace, GL_UNSIGNED_INT, (void*)0);
+			glDrawElements(objToRender->getRenderMode(), objToRender->getMesh()->getNumFaces() * vertexPerFace, objToRender->getMesh()->getIndexType(), (void*)0);
 		}
 	}
 }
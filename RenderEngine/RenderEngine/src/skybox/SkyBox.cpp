@@ -47,7 +47,7 @@ void Engine::SkyBox::render(Engine::Camera * camera)
 	cubeMesh->setTranslation(cubePos);
 	shader->onRenderObject(cubeMesh, camera);
 
-	glDrawElements(renderMode, data->getNumFaces() * data->getNumVerticesPerFace(), GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(renderMode, data->getNumFaces() * data->getNumVerticesPerFace(), data->getIndexType(), (void*)0);
 
 	glDepthFunc(GL_LESS);
 
@@ -5,10 +5,19 @@
 #include "datatables/VegetationTable.h"
 
 #include "CascadeShadowMaps.h"
+#include "FrameStatistics.h"
 #include "ProceduralVegetation.h"
 
+#include <glm/gtc/matrix_transform.hpp>
+
 #include <random>
 
+namespace
+{
+	// Kind of vegetation given to VegetationPlacement::random()
+	const unsigned int FLOWER_PLACEMENT = 2;
+}
+
 Engine::FlowerComponent::FlowerComponent()
 	:Engine::TerrainComponent()
 {
@@ -20,6 +29,16 @@ unsigned int Engine::FlowerComponent::getRenderRadius()
 	return 3;
 }
 
+const char * Engine::FlowerComponent::getName()
+{
+	return "Flowers";
+}
+
+void Engine::FlowerComponent::getTileBounds(int i, int j, glm::vec3 & boundsMin, glm::vec3 & boundsMax)
+{
+	getVegetationTileBounds(i, j, shapeMin, shapeMax, boundsMin, boundsMax);
+}
+
 void Engine::FlowerComponent::initialize()
 {
 	// SHADERS
@@ -29,7 +48,14 @@ void Engine::FlowerComponent::initialize()
 
 	pointShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::POINT_MODE);
 
+	instancedFillShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::INSTANCED);
+
+	instancedWireShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::WIRE_MODE | Engine::TreeProgram::INSTANCED);
+
+	instancedPointShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::POINT_MODE | Engine::TreeProgram::INSTANCED);
+
 	activeShader = fillShader;
+	activeInstancedShader = instancedFillShader;
 
 	flowersToSpawn = 35;
 
@@ -57,8 +83,62 @@ void Engine::FlowerComponent::initialize()
 
 	fillShader->configureMeshBuffers(m);
 	wireShader->configureMeshBuffers(m);
+	instancedFillShader->configureMeshBuffers(m);
+	instancedWireShader->configureMeshBuffers(m);
 
 	flower = new Engine::Object(m);
+	worldFlower = new Engine::Object(m);
+
+	m->computeBounds(&shapeMin[0], &shapeMax[0]);
+
+	flowerStore = new Engine::VegetationInstanceStore([this](const Engine::VegetationPlacement & placement, int i, int j, std::vector<Engine::VegetationInstanceStore::Instance> & flowers)
+	{
+		generateFlowers(placement, i, j, flowers);
+	}, Engine::VegetationPlacement::getSettingsParameters(), 32);
+
+	uploadedVersion = ~0ull;
+}
+
+void Engine::FlowerComponent::generateFlowers(const Engine::VegetationPlacement & placement, int i, int j, std::vector<Engine::VegetationInstanceStore::Instance> & flowers)
+{
+	// Candidates spread randomly over the tile, each with three random values: position and wind direction
+	std::vector<float> x(flowersToSpawn), z(flowersToSpawn), heights(flowersToSpawn);
+	std::vector<unsigned char> accepted(flowersToSpawn);
+	for (unsigned int k = 0; k < flowersToSpawn; k++)
+	{
+		x[k] = (float(i) + placement.random(i, j, FLOWER_PLACEMENT, k * 3)) * scale;
+		z[k] = (float(j) + placement.random(i, j, FLOWER_PLACEMENT, k * 3 + 1)) * scale;
+	}
+
+	placement.evaluate(x.data(), z.data(), heights.data(), accepted.data(), flowersToSpawn);
+
+	for (unsigned int k = 0; k < flowersToSpawn; k++)
+	{
+		if (!accepted[k])
+		{
+			continue;
+		}
+
+		const float windSign = placement.random(i, j, FLOWER_PLACEMENT, k * 3 + 2) < 0.5f ? -1.0f : 1.0f;
+
+		Engine::VegetationInstanceStore::Instance flower;
+		flower.modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(x[k], heights[k], z[k]));
+		flower.placement = glm::vec4(x[k], heights[k], z[k], windSign);
+		flower.type = 0;
+		flowers.push_back(flower);
+	}
+}
+
+void Engine::FlowerComponent::updateComponent(Engine::Camera * camera)
+{
+	// Same tiles as Terrain::renderTiledComponent()
+	glm::vec3 cameraPosition = camera->getPosition();
+	int x = -int((floor(cameraPosition.x)) / scale);
+	int y = -int((floor(cameraPosition.z)) / scale);
+	int rr = int(getRenderRadius());
+
+	flowerStore->setPlacementParameters(Engine::VegetationPlacement::getSettingsParameters());
+	flowerStore->update(x - rr, x + rr, y - rr, y + rr);
 }
 
 void Engine::FlowerComponent::preRenderComponent()
@@ -68,43 +148,71 @@ void Engine::FlowerComponent::preRenderComponent()
 
 void Engine::FlowerComponent::renderComponent(int i, int j, Engine::Camera * cam)
 {
-	// We have to travel way to much to make this seed system not to work...
-	unsigned int seed = (j << 16) | i;
-	float posX = i * scale;
-	float posZ = j * scale;
-
-	std::uniform_real_distribution<float> dTerrain(0.0f, 1.0f);
-	std::default_random_engine eTerrain(seed);
-
 	Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
 
 	const unsigned int numElements = flower->getMesh()->getNumFaces() * 3;
+	glm::mat4 lightDepth[Engine::CascadeShadowMaps::MAX_LEVELS];
 
-	unsigned int z = 0;
-	while (z < flowersToSpawn)
+	for (auto & instance : flowerStore->getTile(i, j))
 	{
-		z++;
-		float uOffset = dTerrain(eTerrain);
-		float vOffset = dTerrain(eTerrain);
+		flower->setModelMatrix(instance.modelMatrix);
 
-		float treePosX = posX + uOffset * scale;
-		float treePosZ = posZ + vOffset * scale;
+		activeShader->setUniformWindSign(instance.placement.w);
+		unsigned int levels = csm.getDepthMatrices(instance.modelMatrix, lightDepth);
+		activeShader->setUniformLightDepthMats(lightDepth, levels);
+		activeShader->onRenderObject(flower, cam);
 
-		flower->setTranslation(glm::vec3(treePosX, 0.0f, treePosZ));
+		glDrawElements(GL_TRIANGLES, numElements, flower->getMesh()->getIndexType(), (void*)0);
+		Engine::FrameStatistics::countDrawCall();
+	}
+}
 
-		float u = abs(i + uOffset);
-		float v = abs(j + vOffset);
+bool Engine::FlowerComponent::supportsInstancing()
+{
+	return true;
+}
 
-		activeShader->setUniformTileUV(u, v);
-		activeShader->setUniformLightDepthMat(csm.getDepthMatrix0() * flower->getModelMatrix());
-		activeShader->setUniformLightDepthMat1(csm.getDepthMatrix1() * flower->getModelMatrix());
-		activeShader->onRenderObject(flower, cam);
+void Engine::FlowerComponent::renderInstances(const std::vector<glm::ivec2> & tiles, Engine::Camera * cam)
+{
+	if (tiles.empty())
+	{
+		return;
+	}
+
+	// The flowers of a tile do not change once generated, so the last upload is still valid for the same tiles
+	if (tiles != uploadedTiles || flowerStore->getVersion() != uploadedVersion)
+	{
+		instanceData.clear();
+		for (auto & t : tiles)
+		{
+			for (auto & instance : flowerStore->getTile(t.x, t.y))
+			{
+				instanceData.push_back(instance.placement);
+			}
+		}
+		instances.upload(instanceData);
+		uploadedTiles = tiles;
+		uploadedVersion = flowerStore->getVersion();
+	}
 
-		glDrawElements(GL_TRIANGLES, numElements, GL_UNSIGNED_INT, (void*)0);
+	// Every flower may be rejected by the placement masks, or not generated yet
+	if (instanceData.empty())
+	{
+		return;
 	}
+
+	// Flowers are in world space already
+	Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
+	activeInstancedShader->setUniformLightDepthMats(csm.getDepthMatrices(), csm.getCascadeLevels());
+	activeInstancedShader->onRenderObject(worldFlower, cam);
+
+	activeInstancedShader->bindInstances(instances);
+	glDrawElementsInstanced(GL_TRIANGLES, worldFlower->getMesh()->getNumFaces() * 3, worldFlower->getMesh()->getIndexType(), (void*)0, (GLsizei)instanceData.size());
+	activeInstancedShader->unbindInstances(instances);
+	Engine::FrameStatistics::countDrawCall();
 }
 
-void Engine::FlowerComponent::renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam)
+void Engine::FlowerComponent::renderShadow(const glm::mat4 * projections, unsigned int regions, int i, int j, Engine::Camera * cam)
 {
 	
 }
@@ -115,22 +223,30 @@ void Engine::FlowerComponent::notifyRenderModeChange(Engine::RenderMode mode)
 	{
 	case Engine::RenderMode::RENDER_MODE_SHADED:
 		activeShader = fillShader;
+		activeInstancedShader = instancedFillShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_WIRE:
 		activeShader = wireShader;
+		activeInstancedShader = instancedWireShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_POINT:
 		activeShader = pointShader;
+		activeInstancedShader = instancedPointShader;
 		break;
 	}
 }
 
 Engine::Program * Engine::FlowerComponent::getActiveShader()
 {
-	return activeShader;
+	return Engine::Settings::terrainInstancing ? activeInstancedShader : activeShader;
 }
 
 Engine::Program * Engine::FlowerComponent::getShadowMapShader()
 {
 	return NULL;
+}
+
+const Engine::VegetationInstanceStore * Engine::FlowerComponent::getInstanceStore() const
+{
+	return flowerStore;
 }
\ No newline at end of file
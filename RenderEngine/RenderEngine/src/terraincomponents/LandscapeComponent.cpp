@@ -4,6 +4,9 @@
 #include "datatables/MeshTable.h"
 
 #include "CascadeShadowMaps.h"
+#include "FrameStatistics.h"
+#include "Threadpool.h"
+#include "TimeAccesor.h"
 
 Engine::LandscapeComponent::LandscapeComponent()
 	:Engine::TerrainComponent()
@@ -16,6 +19,20 @@ unsigned int Engine::LandscapeComponent::getRenderRadius()
 	return 12;
 }
 
+const char * Engine::LandscapeComponent::getName()
+{
+	return "Landscape";
+}
+
+bool Engine::LandscapeComponent::isTileHidden(int i, int j, float minHeight, float maxHeight, Engine::Camera * camera)
+{
+	// Land deeper than 40% of the water level turns the water above it opaque (see the alpha in
+	// terrain.frag and water.frag), which is also what the water shows over the cleared G-buffer.
+	// Only from above the water, and while the water is shaded
+	const float waterLevel = Engine::Settings::waterHeight * 1.5f * scale;
+	return activeShader == fillShader && -camera->getPosition().y > waterLevel && maxHeight <= waterLevel * 0.4f;
+}
+
 void Engine::LandscapeComponent::initialize()
 {
 	fillShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>();
@@ -29,6 +46,30 @@ void Engine::LandscapeComponent::initialize()
 	shadowShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
 		Engine::ProceduralTerrainProgram::SHADOW_MAP);
 
+	quadTreeFillShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
+		Engine::ProceduralTerrainProgram::QUADTREE_MODE);
+
+	quadTreeWireShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
+		Engine::ProceduralTerrainProgram::WIRE_DRAW_MODE | Engine::ProceduralTerrainProgram::QUADTREE_MODE);
+
+	quadTreePointShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
+		Engine::ProceduralTerrainProgram::POINT_DRAW_MODE | Engine::ProceduralTerrainProgram::QUADTREE_MODE);
+
+	quadTreeShadowShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
+		Engine::ProceduralTerrainProgram::SHADOW_MAP | Engine::ProceduralTerrainProgram::QUADTREE_MODE);
+
+	instancedFillShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
+		Engine::ProceduralTerrainProgram::INSTANCED);
+
+	instancedWireShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
+		Engine::ProceduralTerrainProgram::WIRE_DRAW_MODE | Engine::ProceduralTerrainProgram::INSTANCED);
+
+	instancedPointShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
+		Engine::ProceduralTerrainProgram::POINT_DRAW_MODE | Engine::ProceduralTerrainProgram::INSTANCED);
+
+	instancedShadowShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
+		Engine::ProceduralTerrainProgram::SHADOW_MAP | Engine::ProceduralTerrainProgram::INSTANCED);
+
 	Engine::Mesh * tile = Engine::MeshTable::getInstance().getMesh("terrain_tile");
 	landscapeTile = new Engine::Object(tile);
 	landscapeTile->setScale(glm::vec3(scale));
@@ -37,12 +78,115 @@ void Engine::LandscapeComponent::initialize()
 	wireShader->configureMeshBuffers(tile);
 	shadowShader->configureMeshBuffers(tile);
 
+	worldTile = new Engine::Object(tile);
+	instancedFillShader->configureMeshBuffers(tile);
+	instancedWireShader->configureMeshBuffers(tile);
+	instancedPointShader->configureMeshBuffers(tile);
+	instancedShadowShader->configureMeshBuffers(tile);
+
+	ProceduralTerrainProgram * quadTreeShaders[4] = { quadTreeFillShader, quadTreeWireShader, quadTreePointShader, quadTreeShadowShader };
+	nodeGrid = createNodeGrid(quadTreeShaders, Engine::TerrainQuadTree::GRID_RESOLUTION);
+	halfNodeGrid = createNodeGrid(quadTreeShaders, Engine::TerrainQuadTree::GRID_RESOLUTION / 2);
+
 	activeShader = fillShader;
+	activeQuadTreeShader = quadTreeFillShader;
+	activeInstancedShader = instancedFillShader;
+
+	createTileCache();
+}
+
+void Engine::LandscapeComponent::createTileCache()
+{
+	// 65x65 texels match the maximum tessellation of a tile. 32 MB hold the visible tiles
+	// (24x24) plus the prefetched ones
+	Engine::TerrainTileCache::Parameters params;
+	params.resolution = 65;
+	params.memoryBudget = 32 * 1024 * 1024;
+	params.prefetchTime = 1.5f;
+	params.maxPrefetchDistance = 6.0f;
+	params.maxPendingTiles = 2 * Engine::Concurrent::ThreadPool::getInstance().getPoolSize();
+	tileCache = new Engine::TerrainTileCache(params, Engine::TerrainHeightField::getSettingsParameters());
+	lastCameraTile = glm::vec2(0.0f);
+
+	const unsigned int res = params.resolution;
+	const unsigned int layers = tileCache->getNumSlots() > 0 ? tileCache->getNumSlots() : 1;
+
+	glGenTextures(1, &tileHeightsTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, tileHeightsTexture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, res, res, layers, 0, GL_RED, GL_FLOAT, 0);
+
+	glGenTextures(1, &tileNormalsTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, tileNormalsTexture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8_SNORM, res, res, layers, 0, GL_RGBA, GL_BYTE, 0);
+
+	unsigned int textures[2] = { tileHeightsTexture, tileNormalsTexture };
+	for (unsigned int t = 0; t < 2; t++)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textures[t]);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+Engine::Object * Engine::LandscapeComponent::createNodeGrid(Engine::ProceduralTerrainProgram * programs[4], unsigned int resolution)
+{
+	Engine::Mesh * grid = Engine::MeshTable::getInstance().getMesh("terrain_grid_" + std::to_string(resolution));
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		programs[i]->configureMeshBuffers(grid);
+	}
+
+	// Nodes are placed by the vertex shader, in tiles
+	Engine::Object * object = new Engine::Object(grid);
+	object->setScale(glm::vec3(scale));
+	return object;
+}
+
+void Engine::LandscapeComponent::updateComponent(Engine::Camera * camera)
+{
+	if (!Engine::Settings::terrainTileCache)
+	{
+		return;
+	}
+
+	const glm::vec3 cameraPosition = -camera->getPosition() / scale;
+	const glm::vec2 cameraTile(cameraPosition.x, cameraPosition.z);
+	const glm::vec2 velocity = Engine::Time::deltaTime > 0.0f ? (cameraTile - lastCameraTile) / Engine::Time::deltaTime : glm::vec2(0.0f);
+	lastCameraTile = cameraTile;
+
+	tileCache->setHeightParameters(Engine::TerrainHeightField::getSettingsParameters());
+	tileCache->update(Engine::Time::frame, cameraTile, velocity, getRenderRadius());
+
+	// Upload the tiles generated since the last update
+	const unsigned int res = tileCache->getParameters().resolution;
+	for (unsigned int slot : tileCache->getNewTiles())
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, tileHeightsTexture);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, slot, res, res, 1, GL_RED, GL_FLOAT, tileCache->getSlotHeights(slot));
+		glBindTexture(GL_TEXTURE_2D_ARRAY, tileNormalsTexture);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, slot, res, res, 1, GL_RGBA, GL_BYTE, tileCache->getSlotNormals(slot));
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 }
 
 void Engine::LandscapeComponent::preRenderComponent()
 {
 	glBindVertexArray(landscapeTile->getMesh()->vao);
+
+	// Texture units set by ProceduralTerrainProgram::applyGlobalUniforms
+	glActiveTexture(GL_TEXTURE0 + Engine::CascadeShadowMaps::MAX_LEVELS);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, tileHeightsTexture);
+	glActiveTexture(GL_TEXTURE0 + Engine::CascadeShadowMaps::MAX_LEVELS + 1);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, tileNormalsTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+int Engine::LandscapeComponent::getTileLayer(int i, int j)
+{
+	return Engine::Settings::terrainTileCache ? tileCache->acquire(i, j) : -1;
 }
 
 void Engine::LandscapeComponent::renderComponent(int i, int j, Engine::Camera * cam)
@@ -52,26 +196,33 @@ void Engine::LandscapeComponent::renderComponent(int i, int j, Engine::Camera *
 	landscapeTile->setTranslation(glm::vec3(poxX, 0.0f, posZ));
 
 	activeShader->setUniformGridPosition(i, j);
-	activeShader->setUniformLightDepthMatrix(Engine::CascadeShadowMaps::getInstance().getDepthMatrix0() * landscapeTile->getModelMatrix());
-	activeShader->setUniformLightDepthMatrix1(Engine::CascadeShadowMaps::getInstance().getDepthMatrix1() * landscapeTile->getModelMatrix());
+	activeShader->setUniformTileLayer(getTileLayer(i, j));
+	glm::mat4 lightDepth[Engine::CascadeShadowMaps::MAX_LEVELS];
+	unsigned int levels = Engine::CascadeShadowMaps::getInstance().getDepthMatrices(landscapeTile->getModelMatrix(), lightDepth);
+	activeShader->setUniformLightDepthMatrices(lightDepth, levels);
 
 	activeShader->onRenderObject(landscapeTile, cam);
 
-	glDrawElements(GL_PATCHES, 6, GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(GL_PATCHES, 6, landscapeTile->getMesh()->getIndexType(), (void*)0);
+	Engine::FrameStatistics::countDrawCall();
 }
 
-void Engine::LandscapeComponent::renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam)
+void Engine::LandscapeComponent::renderShadow(const glm::mat4 * projections, unsigned int regions, int i, int j, Engine::Camera * cam)
 {
 	float poxX = i * scale;
 	float posZ = j * scale;
 	landscapeTile->setTranslation(glm::vec3(poxX, 0.0f, posZ));
 
 	shadowShader->setUniformGridPosition(i, j);
-	shadowShader->setUniformLightDepthMatrix(projection * landscapeTile->getModelMatrix());
+	shadowShader->setUniformTileLayer(getTileLayer(i, j));
+	glm::mat4 regionDepth[Engine::CascadeShadowMaps::MAX_REGIONS];
+	getShadowRegionMatrices(projections, regions, landscapeTile->getModelMatrix(), regionDepth);
+	shadowShader->setUniformRegionDepthMatrices(regionDepth, regions);
 
 	shadowShader->onRenderObject(landscapeTile, cam);
 
-	glDrawElements(GL_PATCHES, 6, GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(GL_PATCHES, 6, landscapeTile->getMesh()->getIndexType(), (void*)0);
+	Engine::FrameStatistics::countDrawCall();
 }
 
 void Engine::LandscapeComponent::notifyRenderModeChange(Engine::RenderMode mode)
@@ -80,22 +231,131 @@ void Engine::LandscapeComponent::notifyRenderModeChange(Engine::RenderMode mode)
 	{
 	case Engine::RenderMode::RENDER_MODE_SHADED:
 		activeShader = fillShader;
+		activeQuadTreeShader = quadTreeFillShader;
+		activeInstancedShader = instancedFillShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_WIRE:
 		activeShader = wireShader;
+		activeQuadTreeShader = quadTreeWireShader;
+		activeInstancedShader = instancedWireShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_POINT:
 		activeShader = pointShader;
+		activeQuadTreeShader = quadTreePointShader;
+		activeInstancedShader = instancedPointShader;
 		break;
 	}
 }
 
+bool Engine::LandscapeComponent::supportsQuadTree()
+{
+	return true;
+}
+
+void Engine::LandscapeComponent::renderQuadTreeNode(const Engine::TerrainQuadTree::Node & node, Engine::Camera * cam)
+{
+	Engine::Object * grid = node.gridResolution == Engine::TerrainQuadTree::GRID_RESOLUTION ? nodeGrid : halfNodeGrid;
+	grid->getMesh()->use();
+
+	// The sign of the node position flips the normals like on the tiles (see terrain.frag)
+	activeQuadTreeShader->setUniformGridPosition((int)floorf(node.x), (int)floorf(node.z));
+	activeQuadTreeShader->setUniformQuadTreeNode(node);
+	activeQuadTreeShader->setUniformCameraPosition(-cam->getPosition() / scale);
+	glm::mat4 lightDepth[Engine::CascadeShadowMaps::MAX_LEVELS];
+	unsigned int levels = Engine::CascadeShadowMaps::getInstance().getDepthMatrices(grid->getModelMatrix(), lightDepth);
+	activeQuadTreeShader->setUniformLightDepthMatrices(lightDepth, levels);
+
+	activeQuadTreeShader->onRenderObject(grid, cam);
+
+	glDrawElements(GL_TRIANGLES, grid->getMesh()->getNumFaces() * 3, grid->getMesh()->getIndexType(), (void*)0);
+	Engine::FrameStatistics::countDrawCall();
+}
+
+void Engine::LandscapeComponent::renderQuadTreeNodeShadow(const glm::mat4 * projections, unsigned int regions, const Engine::TerrainQuadTree::Node & node, Engine::Camera * cam)
+{
+	Engine::Object * grid = node.gridResolution == Engine::TerrainQuadTree::GRID_RESOLUTION ? nodeGrid : halfNodeGrid;
+	grid->getMesh()->use();
+
+	quadTreeShadowShader->setUniformQuadTreeNode(node);
+	quadTreeShadowShader->setUniformCameraPosition(-cam->getPosition() / scale);
+	glm::mat4 regionDepth[Engine::CascadeShadowMaps::MAX_REGIONS];
+	getShadowRegionMatrices(projections, regions, grid->getModelMatrix(), regionDepth);
+	quadTreeShadowShader->setUniformRegionDepthMatrices(regionDepth, regions);
+
+	quadTreeShadowShader->onRenderObject(grid, cam);
+
+	glDrawElements(GL_TRIANGLES, grid->getMesh()->getNumFaces() * 3, grid->getMesh()->getIndexType(), (void*)0);
+	Engine::FrameStatistics::countDrawCall();
+}
+
+bool Engine::LandscapeComponent::supportsInstancing()
+{
+	return true;
+}
+
+void Engine::LandscapeComponent::uploadInstances(const std::vector<glm::ivec2> & tiles)
+{
+	instanceData.clear();
+	for (auto & t : tiles)
+	{
+		instanceData.push_back(glm::vec4(float(t.x), float(t.y), float(getTileLayer(t.x, t.y)), 0.0f));
+	}
+
+	instances.upload(instanceData);
+}
+
+void Engine::LandscapeComponent::renderInstances(const std::vector<glm::ivec2> & tiles, Engine::Camera * cam)
+{
+	if (tiles.empty())
+	{
+		return;
+	}
+
+	uploadInstances(tiles);
+
+	// Tiles are in world space already
+	Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
+	activeInstancedShader->setUniformLightDepthMatrices(csm.getDepthMatrices(), csm.getCascadeLevels());
+
+	activeInstancedShader->onRenderObject(worldTile, cam);
+
+	activeInstancedShader->bindInstances(instances);
+	glDrawElementsInstanced(GL_PATCHES, 6, worldTile->getMesh()->getIndexType(), (void*)0, (GLsizei)tiles.size());
+	activeInstancedShader->unbindInstances(instances);
+	Engine::FrameStatistics::countDrawCall();
+}
+
+void Engine::LandscapeComponent::renderShadowInstances(const glm::mat4 * projections, unsigned int regions, const std::vector<glm::ivec2> & tiles, Engine::Camera * cam)
+{
+	if (tiles.empty())
+	{
+		return;
+	}
+
+	uploadInstances(tiles);
+
+	// Tiles are in world space already
+	instancedShadowShader->setUniformRegionDepthMatrices(projections, regions);
+
+	instancedShadowShader->onRenderObject(worldTile, cam);
+
+	instancedShadowShader->bindInstances(instances);
+	glDrawElementsInstanced(GL_PATCHES, 6, worldTile->getMesh()->getIndexType(), (void*)0, (GLsizei)tiles.size());
+	instancedShadowShader->unbindInstances(instances);
+	Engine::FrameStatistics::countDrawCall();
+}
+
 Engine::Program * Engine::LandscapeComponent::getActiveShader()
 {
-	return activeShader;
+	return Engine::Settings::terrainQuadTree ? activeQuadTreeShader : Engine::Settings::terrainInstancing ? activeInstancedShader : activeShader;
 }
 
 Engine::Program * Engine::LandscapeComponent::getShadowMapShader()
 {
-	return shadowShader;
+	return Engine::Settings::terrainQuadTree ? quadTreeShadowShader : Engine::Settings::terrainInstancing ? instancedShadowShader : shadowShader;
+}
+
+const Engine::TerrainTileCache * Engine::LandscapeComponent::getTileCache() const
+{
+	return tileCache;
 }
\ No newline at end of file
@@ -5,13 +5,23 @@
 #include "datatables/VegetationTable.h"
 
 #include "CascadeShadowMaps.h"
+#include "FrameStatistics.h"
 #include "ProceduralVegetation.h"
+#include "WorldConfig.h"
+
+#include <glm/gtc/matrix_transform.hpp>
 
 #include <algorithm>
 #include <random>
 
 #include <iostream>
 
+namespace
+{
+	// Kind of vegetation given to VegetationPlacement::random()
+	const unsigned int TREE_PLACEMENT = 1;
+}
+
 Engine::TreeComponent::TreeComponent()
 	:Engine::TerrainComponent()
 {
@@ -23,6 +33,16 @@ unsigned int Engine::TreeComponent::getRenderRadius()
 	return 6;
 }
 
+const char * Engine::TreeComponent::getName()
+{
+	return "Trees";
+}
+
+void Engine::TreeComponent::getTileBounds(int i, int j, glm::vec3 & boundsMin, glm::vec3 & boundsMax)
+{
+	getVegetationTileBounds(i, j, shapeMin, shapeMax, boundsMin, boundsMax);
+}
+
 void Engine::TreeComponent::initialize()
 {
 	// SHADERS
@@ -34,37 +54,19 @@ void Engine::TreeComponent::initialize()
 
 	shadowShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::SHADOW_MAP);
 
-	activeShader = fillShader;
-
-	// JITTERED TREE POSITIONS
-	treesToSpawn = 12;
-	size_t jitterSize = treesToSpawn % 2 != 0 ? treesToSpawn + 1 : treesToSpawn;
-	int rows = (int)glm::ceil(sqrtf((float)jitterSize));
-	int columns = rows;
-	jitterPattern = new glm::vec2[rows * columns];
+	instancedFillShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::INSTANCED);
 
-	std::uniform_real_distribution<float> d(0.0f, 1.0f);
-	std::default_random_engine e(0);
+	instancedWireShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::WIRE_MODE | Engine::TreeProgram::INSTANCED);
 
-	float jitterCellX = 1.0f / columns;
-	float jitterCellY = 1.0f / rows;
+	instancedPointShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::POINT_MODE | Engine::TreeProgram::INSTANCED);
 
-	std::vector<glm::vec2> rawJitter;
-	rawJitter.reserve(columns * rows);
+	instancedShadowShader = Engine::ProgramTable::getInstance().getProgram<Engine::TreeProgram>(Engine::TreeProgram::SHADOW_MAP | Engine::TreeProgram::INSTANCED);
 
-	for (int i = 0; i < rows; i++)
-	{
-		for (int j = 0; j < columns; j++)
-		{
-			float x = d(e) * jitterCellX + jitterCellX * float(j);
-			float y = d(e) * jitterCellY + jitterCellY * float(i);
-			rawJitter.push_back(glm::vec2(x, y));
-		}
-	}
+	activeShader = fillShader;
+	activeInstancedShader = instancedFillShader;
 
-	std::shuffle(rawJitter.begin(), rawJitter.end(), std::default_random_engine(0));
-	std::shuffle(rawJitter.begin(), rawJitter.end(), std::default_random_engine(5000));
-	memcpy(jitterPattern, &rawJitter[0], sizeof(glm::vec2) * columns * rows);
+	// TREE POSITIONS
+	treesToSpawn = 12;
 
 	// TREE MESHES
 	initTrees();
@@ -82,6 +84,9 @@ void Engine::TreeComponent::initTrees()
 	std::uniform_real_distribution<float> trunkColor(0.0f, 1.0f);
 	std::default_random_engine eTrunk(d(e) * d(e));
 
+	std::vector<Engine::TreeGenerationData> speciesData;
+	speciesData.reserve(8);
+
 	for (int i = 0; i < 8; i++)
 	{
 		Engine::TreeGenerationData treeData;
@@ -101,129 +106,348 @@ void Engine::TreeComponent::initTrees()
 		treeData.scalingFactor = (glm::vec3(0.75, 1.0, 0.75) + glm::vec3(0.0f, (1.0f - rotFactor) * 0.25f, 0.0f));
 		treeData.seed = d(e);
 		treeData.startBranchingDepth = 2;
+		// The subtrees starting two levels below the first split are generated in parallel
+		treeData.parallelSplitDepth = std::min(treeData.startBranchingDepth + 2, treeData.maxDepth);
+
+		speciesData.push_back(treeData);
+	}
 
-		Engine::Mesh * m = Engine::VegetationTable::getInstance().generateFractalTree(treeData, true);
+	// All species are generated at once so they are built concurrently
+	std::vector<Engine::Mesh *> meshes = Engine::VegetationTable::getInstance().generateFractalTrees(speciesData, true);
 
-		fillShader->configureMeshBuffers(m);
-		wireShader->configureMeshBuffers(m);
-		shadowShader->configureMeshBuffers(m);
+	// Levels of detail, from the closest to the farthest
+	std::vector<Engine::MeshSimplifier::LodSettings> lodSettings;
+	lodSettings.push_back({ 0.5f, 0.01f });
+	lodSettings.push_back({ 0.25f, 0.03f });
+	lodSettings.push_back({ 0.1f, 0.08f });
+	lodDistances = { 1.5f, 3.0f, 4.5f };
 
-		Engine::Object * tree = new Engine::Object(m);
+	std::vector<std::vector<Engine::Mesh *>> lodMeshes = Engine::VegetationTable::getInstance().generateFractalTreeLods(speciesData, meshes, lodSettings, true);
 
-		treeTypes.push_back(tree);
+	treeLods.resize(meshes.size());
+	for (size_t t = 0; t < meshes.size(); t++)
+	{
+		// The simplified trees only keep a subset of the vertices, so they are within the same bounds
+		glm::vec3 treeMin, treeMax;
+		meshes[t]->computeBounds(&treeMin[0], &treeMax[0]);
+		shapeMin = t == 0 ? treeMin : glm::min(shapeMin, treeMin);
+		shapeMax = t == 0 ? treeMax : glm::max(shapeMax, treeMax);
+
+		lodMeshes[t].insert(lodMeshes[t].begin(), meshes[t]);
+		for (auto m : lodMeshes[t])
+		{
+			fillShader->configureMeshBuffers(m);
+			wireShader->configureMeshBuffers(m);
+			shadowShader->configureMeshBuffers(m);
+			instancedFillShader->configureMeshBuffers(m);
+			instancedWireShader->configureMeshBuffers(m);
+			instancedShadowShader->configureMeshBuffers(m);
+
+			treeLods[t].push_back(new Engine::Object(m));
+		}
+
+		treeTypes.push_back(treeLods[t][0]);
 	}
 
-	// Amount of each tree type to evenly spawn trees up to treesToSpawn
-	size_t numTypeOfTrees = treeTypes.size();
-	equalAmountOfTrees = treesToSpawn / numTypeOfTrees;
-	equalAmountOfTrees = equalAmountOfTrees < 1 ? 1 : equalAmountOfTrees;
+	worldTree = new Engine::Object(treeTypes[0]->getManipMesh());
+
+	treeStore = new Engine::VegetationInstanceStore([this](const Engine::VegetationPlacement & placement, int i, int j, std::vector<Engine::VegetationInstanceStore::Instance> & trees)
+	{
+		generateTrees(placement, i, j, trees);
+	}, Engine::VegetationPlacement::getSettingsParameters(), 32);
+
+	mainInstances.version = shadowInstances.version = ~0ull;
 }
 
-void Engine::TreeComponent::renderComponent(int i, int j, Engine::Camera * cam)
+void Engine::TreeComponent::generateTrees(const Engine::VegetationPlacement & placement, int i, int j, std::vector<Engine::VegetationInstanceStore::Instance> & trees)
 {
-	float posX = i * scale;
-	float posZ = j * scale;
+	const unsigned int numTypeOfTrees = (unsigned int)treeTypes.size();
+	const unsigned int columns = (unsigned int)ceilf(sqrtf(float(treesToSpawn)));
+	const unsigned int rows = (treesToSpawn + columns - 1) / columns;
 
-	size_t numTypeOfTrees = treeTypes.size();
-	Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
+	// Jittered grid of candidates, each with three random values: offset within its cell and wind direction.
+	// Tree types are spawned evenly, starting from a different one on each tile
+	const unsigned int firstType = (unsigned int)(placement.random(i, j, TREE_PLACEMENT, treesToSpawn * 3) * float(numTypeOfTrees));
+
+	std::vector<float> x(treesToSpawn), z(treesToSpawn), heights(treesToSpawn);
+	std::vector<unsigned char> accepted(treesToSpawn);
+	for (unsigned int k = 0; k < treesToSpawn; k++)
+	{
+		const float uOffset = (float(k % columns) + placement.random(i, j, TREE_PLACEMENT, k * 3)) / float(columns);
+		const float vOffset = (float(k / columns) + placement.random(i, j, TREE_PLACEMENT, k * 3 + 1)) / float(rows);
+		x[k] = (float(i) + uOffset) * scale;
+		z[k] = (float(j) + vOffset) * scale;
+	}
 
-	size_t treeToSpawn = 0;
-	unsigned int z = 0;
-	while (z < treesToSpawn)
+	placement.evaluate(x.data(), z.data(), heights.data(), accepted.data(), treesToSpawn);
+
+	for (unsigned int k = 0; k < treesToSpawn; k++)
 	{
-		Engine::Object * randomTree = treeTypes[treeToSpawn % numTypeOfTrees];
-		treeToSpawn++;
-		randomTree->getMesh()->use();
-		unsigned int k = 0;
-		while (k < equalAmountOfTrees)
+		if (!accepted[k])
 		{
-			k++;
-			z++;
+			continue;
+		}
+
+		const float windSign = placement.random(i, j, TREE_PLACEMENT, k * 3 + 2) < 0.5f ? -1.0f : 1.0f;
+
+		Engine::VegetationInstanceStore::Instance tree;
+		tree.modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(x[k], heights[k], z[k]));
+		tree.placement = glm::vec4(x[k], heights[k], z[k], windSign);
+		tree.type = (firstType + k) % numTypeOfTrees;
+		trees.push_back(tree);
+	}
+
+	// Grouped by type, so each type mesh is bound once per tile
+	std::stable_sort(trees.begin(), trees.end(), [](const Engine::VegetationInstanceStore::Instance & a, const Engine::VegetationInstanceStore::Instance & b)
+	{
+		return a.type < b.type;
+	});
+}
+
+void Engine::TreeComponent::updateComponent(Engine::Camera * camera)
+{
+	// Same tiles as Terrain::renderTiledComponent()
+	glm::vec3 cameraPosition = camera->getPosition();
+	int x = -int((floor(cameraPosition.x)) / scale);
+	int y = -int((floor(cameraPosition.z)) / scale);
+	int rr = int(getRenderRadius());
+
+	treeStore->setPlacementParameters(Engine::VegetationPlacement::getSettingsParameters());
+	treeStore->update(x - rr, x + rr, y - rr, y + rr);
+
+	// Trees placed or released change the shadows of the cached levels holding them
+	for (const glm::ivec2 & tile : treeStore->getChangedTiles())
+	{
+		glm::vec3 boundsMin, boundsMax;
+		getTileBounds(tile.x, tile.y, boundsMin, boundsMax);
+		Engine::CascadeShadowMaps::getInstance().notifyCasterUpdate(boundsMin, boundsMax);
+	}
+}
+
+unsigned int Engine::TreeComponent::selectLod(int i, int j, Engine::Camera * cam)
+{
+	if (!Engine::Settings::treeLods)
+	{
+		return 0;
+	}
+
+	// Camera position and tile center in tile units
+	const glm::vec3 cameraPosition = -cam->getPosition() / scale;
+	const float dx = float(i) + 0.5f - cameraPosition.x;
+	const float dz = float(j) + 0.5f - cameraPosition.z;
+	const float distance = sqrtf(dx * dx + dz * dz);
+
+	unsigned int lod = 0;
+	while (lod < lodDistances.size() && distance >= lodDistances[lod])
+	{
+		lod++;
+	}
+
+	return lod;
+}
 
-			glm::vec2 & jitter = jitterPattern[z];
-			float & uOffset = jitter.x;
-			float & vOffset = jitter.y;
+void Engine::TreeComponent::renderComponent(int i, int j, Engine::Camera * cam)
+{
+	Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
+
+	unsigned int lod = selectLod(i, j, cam);
+	glm::mat4 lightDepth[Engine::CascadeShadowMaps::MAX_LEVELS];
+
+	// Trees come grouped by type
+	unsigned int lastType = (unsigned int)-1;
+	for (auto & tree : treeStore->getTile(i, j))
+	{
+		Engine::Object * randomTree = treeLods[tree.type][lod];
+		if (tree.type != lastType)
+		{
+			randomTree->getMesh()->use();
+			lastType = tree.type;
+		}
+		unsigned int fullDetailFaces = treeTypes[tree.type]->getMesh()->getNumFaces();
 
-			float treePosX = posX + uOffset * scale;
-			float treePosZ = posZ + vOffset * scale;
+		randomTree->setModelMatrix(tree.modelMatrix);
 
-			randomTree->setTranslation(glm::vec3(treePosX, 0.0f, treePosZ));
+		activeShader->setUniformWindSign(tree.placement.w);
+		unsigned int levels = csm.getDepthMatrices(tree.modelMatrix, lightDepth);
+		activeShader->setUniformLightDepthMats(lightDepth, levels);
+		activeShader->onRenderObject(randomTree, cam);
 
-			float u = abs(i + uOffset);
-			float v = abs(j + vOffset);
+		glDrawElements(GL_TRIANGLES, randomTree->getMesh()->getNumFaces() * 3, randomTree->getMesh()->getIndexType(), (void*)0);
+		Engine::FrameStatistics::recordDraw(randomTree->getMesh()->getNumFaces(), fullDetailFaces);
+	}
+}
 
-			activeShader->setUniformTileUV(u, v);
-			activeShader->setUniformLightDepthMat(csm.getDepthMatrix0() * randomTree->getModelMatrix());
-			activeShader->setUniformLightDepthMat1(csm.getDepthMatrix1() * randomTree->getModelMatrix());
-			activeShader->onRenderObject(randomTree, cam);
+void Engine::TreeComponent::renderShadow(const glm::mat4 * projections, unsigned int regions, int i, int j, Engine::Camera * cam)
+{
+	unsigned int lod = selectLod(i, j, cam);
+	glm::mat4 regionDepth[Engine::CascadeShadowMaps::MAX_REGIONS];
 
-			glDrawElements(GL_TRIANGLES, randomTree->getMesh()->getNumFaces() * 3, GL_UNSIGNED_INT, (void*)0);
+	unsigned int lastType = (unsigned int)-1;
+	for (auto & tree : treeStore->getTile(i, j))
+	{
+		Engine::Object * randomTree = treeLods[tree.type][lod];
+		if (tree.type != lastType)
+		{
+			randomTree->getMesh()->use();
+			lastType = tree.type;
 		}
+
+		randomTree->setModelMatrix(tree.modelMatrix);
+
+		shadowShader->setUniformWindSign(tree.placement.w);
+		getShadowRegionMatrices(projections, regions, tree.modelMatrix, regionDepth);
+		shadowShader->setUniformRegionDepthMats(regionDepth, regions);
+		shadowShader->onRenderObject(randomTree, cam);
+
+		glDrawElements(GL_TRIANGLES, randomTree->getMesh()->getNumFaces() * 3, randomTree->getMesh()->getIndexType(), (void*)0);
+		Engine::FrameStatistics::countDrawCall();
 	}
 }
 
-void Engine::TreeComponent::renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam)
+bool Engine::TreeComponent::supportsInstancing()
 {
-	float posX = i * scale;
-	float posZ = j * scale;
+	return true;
+}
+
+void Engine::TreeComponent::uploadInstances(Engine::TreeComponent::TreeInstanceGroups & groups, const std::vector<glm::ivec2> & tiles, Engine::Camera * cam)
+{
+	tileLods.clear();
+	for (auto & t : tiles)
+	{
+		tileLods.push_back(glm::ivec3(t.x, t.y, selectLod(t.x, t.y, cam)));
+	}
+
+	// The trees of a tile do not change once generated, so the groups are still valid
+	if (tileLods == groups.tiles && treeStore->getVersion() == groups.version)
+	{
+		return;
+	}
 
 	size_t numTypeOfTrees = treeTypes.size();
-	
-	size_t treeToSpawn = 0;
-	unsigned int z = 0;
-	while (z < treesToSpawn)
-	{
-		Engine::Object * randomTree = treeTypes[treeToSpawn % numTypeOfTrees];
-		treeToSpawn++;
-		randomTree->getMesh()->use();
-		unsigned int k = 0;
-		while (k < equalAmountOfTrees)
+	const size_t numLods = lodDistances.size() + 1;
+
+	groupInstances.resize(numTypeOfTrees * numLods);
+	for (auto & group : groupInstances)
+	{
+		group.clear();
+	}
+
+	for (auto & t : tileLods)
+	{
+		for (auto & tree : treeStore->getTile(t.x, t.y))
 		{
-			k++;
-			z++;
-			glm::vec2 & jitter = jitterPattern[z];
-			float & uOffset = jitter.x;
-			float & vOffset = jitter.y;
+			groupInstances[tree.type * numLods + t.z].push_back(tree.placement);
+		}
+	}
 
-			float treePosX = posX + uOffset * scale;
-			float treePosZ = posZ + vOffset * scale;
+	instanceData.clear();
+	groups.groupStart.clear();
+	groups.groupCount.clear();
+	for (auto & group : groupInstances)
+	{
+		groups.groupStart.push_back(instanceData.size());
+		groups.groupCount.push_back(group.size());
+		instanceData.insert(instanceData.end(), group.begin(), group.end());
+	}
+
+	groups.instances.upload(instanceData);
+	groups.tiles = tileLods;
+	groups.version = treeStore->getVersion();
+}
 
-			randomTree->setTranslation(glm::vec3(treePosX, 0.0f, treePosZ));
+void Engine::TreeComponent::drawInstances(Engine::TreeProgram * program, Engine::TreeComponent::TreeInstanceGroups & groups, bool recordStatistics)
+{
+	const size_t numLods = lodDistances.size() + 1;
+	for (size_t g = 0; g < groups.groupCount.size(); g++)
+	{
+		const size_t count = groups.groupCount[g];
+		if (count == 0)
+		{
+			continue;
+		}
 
-			float u = abs(i + uOffset);
-			float v = abs(j + vOffset);
+		const Engine::Mesh * tree = treeLods[g / numLods][g % numLods]->getMesh();
+		tree->use();
 
-			shadowShader->setUniformTileUV(u, v);
-			shadowShader->setUniformLightDepthMat(projection *  randomTree->getModelMatrix());
-			shadowShader->onRenderObject(randomTree, cam);
+		program->bindInstances(groups.instances, groups.groupStart[g]);
+		glDrawElementsInstanced(GL_TRIANGLES, tree->getNumFaces() * 3, tree->getIndexType(), (void*)0, (GLsizei)count);
+		program->unbindInstances(groups.instances);
 
-			glDrawElements(GL_TRIANGLES, randomTree->getMesh()->getNumFaces() * 3, GL_UNSIGNED_INT, (void*)0);
+		if (recordStatistics)
+		{
+			const unsigned long long fullDetailFaces = treeTypes[g / numLods]->getMesh()->getNumFaces();
+			Engine::FrameStatistics::recordDraw(tree->getNumFaces() * count, fullDetailFaces * count);
+		}
+		else
+		{
+			Engine::FrameStatistics::countDrawCall();
 		}
 	}
 }
 
+void Engine::TreeComponent::renderInstances(const std::vector<glm::ivec2> & tiles, Engine::Camera * cam)
+{
+	if (tiles.empty())
+	{
+		return;
+	}
+
+	uploadInstances(mainInstances, tiles, cam);
+
+	// Trees are in world space already, so every group shares the same matrices
+	Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
+	activeInstancedShader->setUniformLightDepthMats(csm.getDepthMatrices(), csm.getCascadeLevels());
+	activeInstancedShader->onRenderObject(worldTree, cam);
+
+	drawInstances(activeInstancedShader, mainInstances, true);
+}
+
+void Engine::TreeComponent::renderShadowInstances(const glm::mat4 * projections, unsigned int regions, const std::vector<glm::ivec2> & tiles, Engine::Camera * cam)
+{
+	if (tiles.empty())
+	{
+		return;
+	}
+
+	uploadInstances(shadowInstances, tiles, cam);
+
+	// Trees are in world space already
+	instancedShadowShader->setUniformRegionDepthMats(projections, regions);
+	instancedShadowShader->onRenderObject(worldTree, cam);
+
+	drawInstances(instancedShadowShader, shadowInstances, false);
+}
+
 void Engine::TreeComponent::notifyRenderModeChange(Engine::RenderMode mode)
 {
 	switch (mode)
 	{
 	case Engine::RenderMode::RENDER_MODE_SHADED:
 		activeShader = fillShader;
+		activeInstancedShader = instancedFillShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_WIRE:
 		activeShader = wireShader;
+		activeInstancedShader = instancedWireShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_POINT:
 		activeShader = pointShader;
+		activeInstancedShader = instancedPointShader;
 		break;
 	}
 }
 
 Engine::Program * Engine::TreeComponent::getActiveShader()
 {
-	return activeShader;
+	return Engine::Settings::terrainInstancing ? activeInstancedShader : activeShader;
 }
 
 Engine::Program * Engine::TreeComponent::getShadowMapShader()
 {
-	return shadowShader;
+	return Engine::Settings::terrainInstancing ? instancedShadowShader : shadowShader;
+}
+
+const Engine::VegetationInstanceStore * Engine::TreeComponent::getInstanceStore() const
+{
+	return treeStore;
 }
\ No newline at end of file
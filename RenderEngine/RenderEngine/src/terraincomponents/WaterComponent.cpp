@@ -4,6 +4,11 @@
 #include "datatables/MeshTable.h"
 
 #include "CascadeShadowMaps.h"
+#include "FrameStatistics.h"
+
+// Highest wave above the water level, in tiles. Waves are noiseHeight() * 0.01, and noiseHeight() sums
+// 4 octaves of amplitude 0.5 twice and scales them by 0.01 (see water.teseval): 2 * 0.9375 * 0.01 * 0.01
+static const float MAX_WAVE_HEIGHT = 1.875e-4f;
 
 Engine::WaterComponent::WaterComponent()
 	:Engine::TerrainComponent()
@@ -16,6 +21,26 @@ unsigned int Engine::WaterComponent::getRenderRadius()
 	return 12;
 }
 
+const char * Engine::WaterComponent::getName()
+{
+	return "Water";
+}
+
+void Engine::WaterComponent::getTileBounds(int i, int j, glm::vec3 & boundsMin, glm::vec3 & boundsMax)
+{
+	// Flat tile at the water level
+	const float height = Engine::Settings::waterHeight * scale * 1.5f;
+	boundsMin = glm::vec3(float(i) * scale, height, float(j) * scale);
+	boundsMax = glm::vec3(float(i + 1) * scale, height, float(j + 1) * scale);
+}
+
+bool Engine::WaterComponent::isTileHidden(int i, int j, float minHeight, float maxHeight, Engine::Camera * camera)
+{
+	// Water entirely below the land fails the depth test. Wireframe and point modes show it through the land
+	const float waterTop = (Engine::Settings::waterHeight * 1.5f + MAX_WAVE_HEIGHT) * scale;
+	return activeShader == fillShader && minHeight >= waterTop;
+}
+
 void Engine::WaterComponent::initialize()
 {
 	fillShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralWaterProgram>();
@@ -24,6 +49,14 @@ void Engine::WaterComponent::initialize()
 
 	pointShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralWaterProgram>(Engine::ProceduralWaterProgram::POINT_DRAW_MODE);
 
+	instancedFillShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralWaterProgram>(Engine::ProceduralWaterProgram::INSTANCED);
+
+	instancedWireShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralWaterProgram>(
+		Engine::ProceduralWaterProgram::WIRE_DRAW_MODE | Engine::ProceduralWaterProgram::INSTANCED);
+
+	instancedPointShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralWaterProgram>(
+		Engine::ProceduralWaterProgram::POINT_DRAW_MODE | Engine::ProceduralWaterProgram::INSTANCED);
+
 	/*shadowShader = Engine::ProgramTable::getInstance().getProgram<Engine::ProceduralTerrainProgram>(
 		Engine::ProceduralTerrainProgram::PROGRAM_NAME,
 		Engine::ProceduralTerrainProgram::SHADOW_MAP);*/
@@ -36,7 +69,13 @@ void Engine::WaterComponent::initialize()
 	wireShader->configureMeshBuffers(tile);
 	//shadowShader->configureMeshBuffers(tile);
 
+	worldTile = new Engine::Object(tile);
+	instancedFillShader->configureMeshBuffers(tile);
+	instancedWireShader->configureMeshBuffers(tile);
+	instancedPointShader->configureMeshBuffers(tile);
+
 	activeShader = fillShader;
+	activeInstancedShader = instancedFillShader;
 }
 
 void Engine::WaterComponent::preRenderComponent()
@@ -44,6 +83,12 @@ void Engine::WaterComponent::preRenderComponent()
 	glBindVertexArray(waterTile->getMesh()->vao);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// The compact G-buffer stores the specular on the emissive alpha (buffer 2): the water replaces it,
+	// but keeps the emissive color below
+	if (Engine::Settings::compactGBuffer)
+	{
+		glBlendFuncSeparatei(2, GL_ZERO, GL_ONE, GL_ONE, GL_ZERO);
+	}
 }
 
 void Engine::WaterComponent::renderComponent(int i, int j, Engine::Camera * cam)
@@ -53,11 +98,44 @@ void Engine::WaterComponent::renderComponent(int i, int j, Engine::Camera * cam)
 	waterTile->setTranslation(glm::vec3(poxX, Engine::Settings::waterHeight * scale * 1.5f, posZ));
 
 	activeShader->setUniformGridPosition(i, j);
-	activeShader->setUniformLightDepthMatrix(Engine::CascadeShadowMaps::getInstance().getDepthMatrix0() * waterTile->getModelMatrix());
-	activeShader->setUniformLightDepthMatrix1(Engine::CascadeShadowMaps::getInstance().getDepthMatrix1() * waterTile->getModelMatrix());
+	glm::mat4 lightDepth[Engine::CascadeShadowMaps::MAX_LEVELS];
+	unsigned int levels = Engine::CascadeShadowMaps::getInstance().getDepthMatrices(waterTile->getModelMatrix(), lightDepth);
+	activeShader->setUniformLightDepthMatrices(lightDepth, levels);
 	activeShader->onRenderObject(waterTile, cam);
 
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(GL_TRIANGLES, 6, waterTile->getMesh()->getIndexType(), (void*)0);
+	Engine::FrameStatistics::countDrawCall();
+}
+
+bool Engine::WaterComponent::supportsInstancing()
+{
+	return true;
+}
+
+void Engine::WaterComponent::renderInstances(const std::vector<glm::ivec2> & tiles, Engine::Camera * cam)
+{
+	if (tiles.empty())
+	{
+		return;
+	}
+
+	const float height = Engine::Settings::waterHeight * scale * 1.5f;
+	instanceData.clear();
+	for (auto & t : tiles)
+	{
+		instanceData.push_back(glm::vec4(float(t.x), float(t.y), height, scale));
+	}
+	instances.upload(instanceData);
+
+	// Tiles are in world space already
+	Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
+	activeInstancedShader->setUniformLightDepthMatrices(csm.getDepthMatrices(), csm.getCascadeLevels());
+	activeInstancedShader->onRenderObject(worldTile, cam);
+
+	activeInstancedShader->bindInstances(instances);
+	glDrawElementsInstanced(GL_TRIANGLES, 6, worldTile->getMesh()->getIndexType(), (void*)0, (GLsizei)tiles.size());
+	activeInstancedShader->unbindInstances(instances);
+	Engine::FrameStatistics::countDrawCall();
 }
 
 void Engine::WaterComponent::postRenderComponent()
@@ -65,7 +143,7 @@ void Engine::WaterComponent::postRenderComponent()
 	glDisable(GL_BLEND);
 }
 
-void Engine::WaterComponent::renderShadow(const glm::mat4 & projection, int i, int j, Engine::Camera * cam)
+void Engine::WaterComponent::renderShadow(const glm::mat4 * projections, unsigned int regions, int i, int j, Engine::Camera * cam)
 {
 	/*
 	float poxX = i * scale;
@@ -87,18 +165,21 @@ void Engine::WaterComponent::notifyRenderModeChange(Engine::RenderMode mode)
 	{
 	case Engine::RenderMode::RENDER_MODE_SHADED:
 		activeShader = fillShader;
+		activeInstancedShader = instancedFillShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_POINT:
 		activeShader = pointShader;
+		activeInstancedShader = instancedPointShader;
 		break;
 	case Engine::RenderMode::RENDER_MODE_WIRE:
 		activeShader = wireShader;
+		activeInstancedShader = instancedWireShader;
 	}
 }
 
 Engine::Program * Engine::WaterComponent::getActiveShader()
 {
-	return activeShader;
+	return Engine::Settings::terrainInstancing ? activeInstancedShader : activeShader;
 }
 
 Engine::Program * Engine::WaterComponent::getShadowMapShader()
@@ -1,12 +1,19 @@
 #include "userinterfaces/WorldControllerUI.h"
 
 #include <iomanip>
+#include <iostream>
 #include <sstream>
 
 #include "imgui/imgui.h"
 #include "WorldConfig.h"
 #include "TimeAccesor.h"
+#include "FrameStatistics.h"
 #include "Scene.h"
+#include "CascadeShadowMaps.h"
+#include "renderers/DeferredRenderer.h"
+#include "terraincomponents/LandscapeComponent.h"
+#include "terraincomponents/TreeComponent.h"
+#include "terraincomponents/FlowerComponent.h"
 
 
 Engine::Window::WorldControllerUI::WorldControllerUI(GLFWwindow * surface)
@@ -29,6 +36,109 @@ void Engine::Window::WorldControllerUI::drawGraphics()
 		std::string fpsStr = "FPS: " + std::to_string(fps);
 		ImGui::Text(fpsStr.c_str());
 
+		std::string trianglesStr = "Vegetation triangles: " + std::to_string(Engine::FrameStatistics::triangles)
+			+ " (full detail: " + std::to_string(Engine::FrameStatistics::fullDetailTriangles) + ")";
+		ImGui::Text(trianglesStr.c_str());
+		std::string drawCallsStr = "Vegetation draw calls: " + std::to_string(Engine::FrameStatistics::drawCalls);
+		ImGui::Text(drawCallsStr.c_str());
+		if (ImGui::Checkbox("Count uniform calls##app", &Engine::Settings::countUniformCalls))
+		{
+			if (Engine::Settings::countUniformCalls)
+			{
+				Engine::FrameStatistics::installUniformCounter();
+			}
+			else
+			{
+				Engine::FrameStatistics::removeUniformCounter();
+			}
+		}
+
+		Engine::Terrain * terrain = Engine::SceneManager::getInstance().getActiveScene()->getTerrain();
+		if (terrain != NULL)
+		{
+			for (auto component : terrain->getComponents())
+			{
+				const Engine::TileCullingStatistics & stats = component->cullingStatistics;
+				std::string cullingStr = std::string(component->getName()) + " tiles: " + std::to_string(stats.drawn) + " drawn, "
+					+ std::to_string(stats.culled) + " culled, " + std::to_string(stats.hidden) + " hidden of " + std::to_string(stats.tested);
+				ImGui::Text(cullingStr.c_str());
+
+				const Engine::ComponentCallStatistics & calls = component->callStatistics;
+				std::string callsStr = "  " + std::to_string(calls.drawCalls) + " draws, " + std::to_string(calls.uniformCalls) + " uniforms (shadow map: "
+					+ std::to_string(calls.shadowDrawCalls) + " draws, " + std::to_string(calls.shadowUniformCalls) + " uniforms)";
+				ImGui::Text(callsStr.c_str());
+
+				if (component->castShadows())
+				{
+					std::string shadowCullingStr = "  Shadow map tiles drawn / culled:";
+					for (unsigned int i = 0; i < Engine::CascadeShadowMaps::getInstance().getCascadeLevels(); i++)
+					{
+						const Engine::TileCullingStatistics & shadowStats = component->shadowCullingStatistics[i];
+						shadowCullingStr += " " + std::to_string(shadowStats.drawn) + " / " + std::to_string(shadowStats.culled);
+					}
+					ImGui::Text(shadowCullingStr.c_str());
+				}
+
+				Engine::LandscapeComponent * landscape = dynamic_cast<Engine::LandscapeComponent*>(component);
+				if (landscape != NULL && Engine::Settings::terrainTileCache)
+				{
+					const Engine::TerrainTileCache::Statistics & cache = landscape->getTileCache()->getStatistics();
+					std::string cacheStr = "Tile cache: " + std::to_string(cache.residentTiles) + " / " + std::to_string(cache.slots)
+						+ " tiles (" + std::to_string(cache.memoryUsed >> 20) + " MB), " + std::to_string(cache.pendingTiles) + " pending, "
+						+ std::to_string(cache.hits) + " hits, " + std::to_string(cache.misses) + " misses";
+					ImGui::Text(cacheStr.c_str());
+				}
+
+				Engine::TreeComponent * trees = dynamic_cast<Engine::TreeComponent*>(component);
+				Engine::FlowerComponent * flowers = dynamic_cast<Engine::FlowerComponent*>(component);
+				const Engine::VegetationInstanceStore * vegetation = trees != NULL ? trees->getInstanceStore()
+					: flowers != NULL ? flowers->getInstanceStore() : NULL;
+				if (vegetation != NULL)
+				{
+					const Engine::VegetationInstanceStore::Statistics & placed = vegetation->getStatistics();
+					std::string placedStr = "  Placed on " + std::to_string(placed.residentTiles) + " tiles (" + std::to_string(placed.memoryUsed >> 10)
+						+ " KB), " + std::to_string(placed.pendingTiles) + " pending, " + std::to_string(placed.totalGeneratedTiles) + " generated";
+					ImGui::Text(placedStr.c_str());
+				}
+			}
+		}
+
+		Engine::CascadeShadowMaps & csm = Engine::CascadeShadowMaps::getInstance();
+		std::string shadowStr = "Shadow maps: " + std::to_string(csm.getCascadeLevels()) + " x " + std::to_string(csm.getCascadeFit().getParameters().resolution)
+			+ "^2 (" + std::to_string(csm.getMemoryUsage() >> 20) + " MB), " + std::to_string(csm.getShadowRegions()) + " regions in "
+			+ std::to_string(csm.getShadowDrawCalls()) + " draws";
+		ImGui::Text(shadowStr.c_str());
+		const std::vector<Engine::ShadowCascadeFit::Cascade> & cascades = csm.getCascadeFit().getCascades();
+		for (unsigned int i = 0; i < csm.getCascadeLevels(); i++)
+		{
+			std::ostringstream cascadeSs;
+			cascadeSs << std::fixed << std::setprecision(1) << "  Level " << i << ": " << cascades[i].nearDistance << " - " << cascades[i].farDistance
+				<< ", " << cascades[i].texelDensity << " texels per unit";
+			ImGui::Text(cascadeSs.str().c_str());
+
+			const Engine::ShadowCascadeCache::Level & cached = csm.getCascadeCache().getLevels()[i];
+			const double frames = cached.frames > 0 ? double(cached.frames) : 1.0;
+			std::ostringstream cacheSs;
+			cacheSs << std::fixed << std::setprecision(1) << "    " << cached.regions.size() << " regions, reused " << 100.0 * double(cached.reused) / frames
+				<< "%, scrolled " << 100.0 * double(cached.scrolled) / frames << "%, rendered " << 100.0 * double(cached.rendered) / frames << "% of the frames";
+			ImGui::Text(cacheSs.str().c_str());
+		}
+
+		Engine::DeferredRenderer * deferred = dynamic_cast<Engine::DeferredRenderer*>(Engine::RenderManager::getInstance().getRenderer());
+		if (deferred != NULL)
+		{
+			const Engine::RenderGraph & graph = deferred->getRenderGraph();
+			const unsigned int width = Engine::ScreenManager::SCREEN_WIDTH, height = Engine::ScreenManager::SCREEN_HEIGHT;
+			std::string targetsStr = "Post-process targets: " + std::to_string(graph.getTargets().size()) + " in " + std::to_string(graph.getNumTextures())
+				+ " textures (" + std::to_string(graph.getMemoryUsage(width, height) >> 20) + " MB, " + std::to_string(graph.getMemoryUsage(width, height, false) >> 20)
+				+ " MB without sharing)";
+			ImGui::Text(targetsStr.c_str());
+			const size_t gBufferBytes = size_t(width) * size_t(height) * deferred->getGBufferBytesPerPixel();
+			std::string gBufferStr = std::string("G-buffer: ") + (deferred->getGBufferPos() == NULL ? "compact, " : "") + std::to_string(deferred->getGBufferBytesPerPixel())
+				+ " bytes per pixel (" + std::to_string(gBufferBytes >> 20) + " MB)";
+			ImGui::Text(gBufferStr.c_str());
+		}
+
 		ImGui::Spacing(); ImGui::Spacing();
 		ImGui::Separator();
 		ImGui::Spacing(); ImGui::Spacing();
@@ -64,6 +174,30 @@ void Engine::Window::WorldControllerUI::drawGraphics()
 			ImGui::SliderFloat3("Light direction", &Engine::Settings::lightDirection[0], -1.f, 1.f);
 		}
 
+		if (ImGui::CollapsingHeader("Shadow settings"))
+		{
+			ImGui::SliderInt("Cascades##app", reinterpret_cast<int32_t*>(&Engine::Settings::shadowCascades), 1, Engine::CascadeShadowMaps::MAX_LEVELS);
+			ImGui::Combo("Split scheme##app", reinterpret_cast<int32_t*>(&Engine::Settings::shadowSplitScheme), "Logarithmic\0Linear\0Practical", 3);
+			ImGui::SliderFloat("Split lambda##app", &Engine::Settings::shadowSplitLambda, 0.0f, 1.0f);
+			ImGui::SliderFloat("Shadow distance##app", &Engine::Settings::shadowDistance, 10.0f, 500.0f);
+
+			const unsigned int resolutions[] = { 512, 1024, 2048, 4096 };
+			int resolution = 0;
+			while (resolution < 3 && resolutions[resolution] < Engine::Settings::shadowMapResolution)
+			{
+				resolution++;
+			}
+			if (ImGui::Combo("Shadow map resolution##app", &resolution, "512\0" "1024\0" "2048\0" "4096", 4))
+			{
+				Engine::Settings::shadowMapResolution = resolutions[resolution];
+			}
+
+			ImGui::Checkbox("Shadow cache##app", &Engine::Settings::shadowCache);
+			ImGui::SliderInt("Cache first level##app", reinterpret_cast<int32_t*>(&Engine::Settings::shadowCacheFirstLevel), 0, Engine::CascadeShadowMaps::MAX_LEVELS);
+			ImGui::SliderInt("Cache threshold (texels)##app", reinterpret_cast<int32_t*>(&Engine::Settings::shadowCacheThreshold), 0, 32);
+			ImGui::SliderInt("Cache interval (frames)##app", reinterpret_cast<int32_t*>(&Engine::Settings::shadowCacheInterval), 0, 240);
+		}
+
 		if (ImGui::CollapsingHeader("Sky settings"))
 		{
 			ImGui::ColorEdit3("Sky zenit color", &Engine::Settings::skyZenitColor[0]);
@@ -80,6 +214,11 @@ void Engine::Window::WorldControllerUI::drawGraphics()
 			ImGui::InputInt("Octaves##app", reinterpret_cast< int32_t*>(&Engine::Settings::terrainOctaves));
 			ImGui::SliderFloat("Grass coverage##app", &Engine::Settings::grassCoverage, 0.0f, 1.0f);
 			ImGui::SliderFloat("Vegetation max height##app", &Engine::Settings::vegetationMaxHeight, 0.0f, 1.0f);
+			ImGui::Checkbox("Tree levels of detail##app", &Engine::Settings::treeLods);
+			ImGui::Checkbox("Quadtree terrain##app", &Engine::Settings::terrainQuadTree);
+			ImGui::SliderFloat("Terrain pixel error##app", &Engine::Settings::terrainPixelError, 0.5f, 16.0f);
+			ImGui::Checkbox("Terrain tile cache##app", &Engine::Settings::terrainTileCache);
+			ImGui::Checkbox("Instanced terrain tiles##app", &Engine::Settings::terrainInstancing);
 			ImGui::ColorEdit3("Grass color##app", &Engine::Settings::grassColor[0]);
 			ImGui::ColorEdit3("Sand color##app", &Engine::Settings::sandColor[0]);
 			ImGui::ColorEdit3("Rock color##app", &Engine::Settings::rockColor[0]);
@@ -124,6 +263,18 @@ void Engine::Window::WorldControllerUI::drawGraphics()
 			ImGui::SliderFloat("Decay##app", &Engine::Settings::godRaysDecay, 0.0f, 1.0f);
 			ImGui::SliderFloat("Density##app", &Engine::Settings::godRaysDensity, 0.1f, 10.0f);
 		}
+
+		if (ImGui::CollapsingHeader("Frame graph"))
+		{
+			if (ImGui::Button("Dump frame graph##app"))
+			{
+				Engine::Settings::dumpFrameGraph = true;
+			}
+			if (deferred != NULL && ImGui::Button("Dump render graph##app"))
+			{
+				deferred->getRenderGraph().dump(std::cout);
+			}
+		}
 		ImGui::End();
 	}
 }
\ No newline at end of file
@@ -3,6 +3,20 @@
 #include <fstream>
 #include <iostream>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#endif
+
 char * Engine::IO::loadStringFromFile(const char * fileName, unsigned long long & fileLen)
 {
 	std::ifstream file;
@@ -30,4 +44,135 @@ char * Engine::IO::loadStringFromFile(const char * fileName, unsigned long long
 	file.close();
 
 	return content;
+}
+
+bool Engine::IO::createDirectory(const char * path)
+{
+#ifdef _WIN32
+	return CreateDirectoryA(path, NULL) != 0 || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+bool Engine::IO::getFileStatus(const char * fileName, unsigned long long & size, long long & modificationTime)
+{
+#ifdef _WIN32
+	struct _stat64 fileStat;
+	if (_stat64(fileName, &fileStat) != 0)
+#else
+	struct stat fileStat;
+	if (stat(fileName, &fileStat) != 0)
+#endif
+	{
+		return false;
+	}
+
+	size = (unsigned long long)fileStat.st_size;
+	modificationTime = (long long)fileStat.st_mtime;
+	return true;
+}
+
+Engine::IO::MappedFile::MappedFile()
+	:data(0), size(0)
+{
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#else
+	fileDescriptor = -1;
+#endif
+}
+
+Engine::IO::MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool Engine::IO::MappedFile::open(const char * fileName)
+{
+	close();
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle == NULL)
+	{
+		close();
+		return false;
+	}
+
+	data = (const unsigned char *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	size = size_t(fileSize.QuadPart);
+#else
+	fileDescriptor = ::open(fileName, O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close();
+		return false;
+	}
+
+	void * mapping = mmap(0, size_t(fileStat.st_size), PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	data = mapping == MAP_FAILED ? 0 : (const unsigned char *)mapping;
+	size = size_t(fileStat.st_size);
+#endif
+
+	if (data == 0)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void Engine::IO::MappedFile::close()
+{
+#ifdef _WIN32
+	if (data != 0)
+	{
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle != NULL)
+	{
+		CloseHandle(mappingHandle);
+		mappingHandle = NULL;
+	}
+	if (fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(fileHandle);
+		fileHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (data != 0)
+	{
+		munmap((void *)data, size);
+	}
+	if (fileDescriptor >= 0)
+	{
+		::close(fileDescriptor);
+		fileDescriptor = -1;
+	}
+#endif
+
+	data = 0;
+	size = 0;
 }
\ No newline at end of file
@@ -1,11 +1,29 @@
 #include "vegetation/FractalTree.h"
 
 #include "datatables/MeshTable.h"
+#include "Threadpool.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 
 #include <iostream>
+#include <atomic>
+
+// SplitMix64 step, used as counter based random stream on split seed mode
+static unsigned long long splitMix64(unsigned long long & state)
+{
+	unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+// Key of the child branch index of the branch with the given key
+static unsigned long long childKey(unsigned long long parentKey, unsigned int index)
+{
+	unsigned long long state = parentKey ^ (0xD1B54A32D192ED03ULL * (unsigned long long)(index + 1));
+	return splitMix64(state);
+}
 
 Engine::FractalTree::FractalTree(const TreeGenerationData & data) :Engine::ProceduralVegetation(data)
 {
@@ -27,78 +45,202 @@ Engine::FractalTree::FractalTree(const TreeGenerationData & data) :Engine::Proce
 }
 
 Engine::Mesh * Engine::FractalTree::generate()
+{
+	Engine::Mesh * tree = generateCPU();
+	tree->syncGPU();
+	return tree;
+}
+
+Engine::Mesh * Engine::FractalTree::generateCPU()
 {
 	// Initial data to start growin the tree
 	glm::vec3 scale = glm::vec3(0.04f, 0.2f, 0.04f) * treeData.scalingFactor;
 	glm::vec3 translation(0, 0, 0);
 	glm::vec3 rotation;
 
+	const unsigned long long rootKey = drawRoot(rotation);
+	const bool splitSeed = treeData.parallelSplitDepth > 0;
+
+	// Dry run to know the final size of the tree. Subtrees are placed after the geometry generated by
+	// the main task, in generation order
+	std::vector<GeometryCount> subtreeSizes;
+	const GeometryCount mainSize = countTree(rootKey, subtreeSizes);
+	GeometryCount total = mainSize;
+	for (auto & size : subtreeSizes)
+	{
+		total.numVertices += size.numVertices;
+		total.numFaces += size.numFaces;
+	}
+
+	GeometryBuffer out;
+	out.vertices = new float[total.numVertices * 3];
+	out.colors = new float[total.numVertices * 3];
+	out.emission = new float[total.numVertices * 3];
+	out.uvs = new float[total.numVertices * 2];
+	out.faces = new unsigned int[total.numFaces * 3];
+	out.numVertices = 0;
+	out.numFaces = 0;
+
+	if (splitSeed)
+	{
+		std::vector<SubtreeTask> subtrees;
+		subtrees.reserve(subtreeSizes.size());
+		processChunk(out, glm::mat4(1.0f), scale, translation, rotation, 0, 1, rootKey, &subtrees);
+
+		GeometryCount offset = mainSize;
+		for (size_t i = 0; i < subtrees.size(); i++)
+		{
+			subtrees[i].offset = offset;
+			subtrees[i].size = subtreeSizes[i];
+			offset.numVertices += subtreeSizes[i].numVertices;
+			offset.numFaces += subtreeSizes[i].numFaces;
+		}
+
+		processSubtrees(out, subtrees);
+	}
+	else
+	{
+		processChunk(out, glm::mat4(1.0f), scale, translation, rotation, 0, 1, rootKey, 0);
+	}
+
+	if (out.numVertices != mainSize.numVertices || out.numFaces != mainSize.numFaces)
+	{
+		std::cerr << "FractalTree: Generated geometry does not match the precomputed size" << std::endl;
+		exit(-1);
+	}
+
+	// Generate new mesh, which takes ownership of the arrays. Normals are automatically computed if not present in the constructor
+	Engine::Mesh * tree = new Engine::Mesh(Engine::ADOPT_BUFFERS, unsigned int(total.numFaces), unsigned int(total.numVertices), out.faces, out.vertices, out.colors, 0, out.uvs, 0, out.emission, false);
+	// Generation order follows the branch recursion, reorder it for the vertex cache and overdraw
+	tree->optimize(true);
+	// Trees carry 5 attributes, keep them quantized on a single buffer for better vertex fetch locality
+	// (the tree shaders expect octahedral encoded normals)
+	tree->setVertexFormat(Engine::VertexFormat::quantized(true));
+
+	return tree;
+}
+
+void Engine::FractalTree::countGeometry(size_t & numVertices, size_t & numFaces)
+{
+	// Same draws as generateCPU(), undone afterwards
+	std::default_random_engine savedEngine = randEngine;
+	glm::vec3 rotation;
+	std::vector<GeometryCount> subtreeSizes;
+	GeometryCount total = countTree(drawRoot(rotation), subtreeSizes);
+	for (auto & size : subtreeSizes)
+	{
+		total.numVertices += size.numVertices;
+		total.numFaces += size.numFaces;
+	}
+	randEngine = savedEngine;
+	randGen.reset();
+
+	numVertices = total.numVertices;
+	numFaces = total.numFaces;
+}
+
+unsigned long long Engine::FractalTree::drawRoot(glm::vec3 & rotation)
+{
+	unsigned long long rootKey = treeData.seed;
+	rootKey = splitMix64(rootKey);
+	// In split seed mode the main trunk rotation draws from its own stream, not from the one of the root chunk
+	unsigned long long stream = rootKey ^ 0x8CB92BA72F3D8DD7ULL;
+	stream = splitMix64(stream);
+
 	if (treeData.rotateMainTrunk)
 	{
 		glm::vec3 & min = treeData.minBranchRotation;
 		glm::vec3 & max = treeData.maxBranchRotation;
-		rotation.x = randInInterval(min.x, max.x);
-		rotation.y = randInInterval(min.y, max.y);
-		rotation.z = randInInterval(min.z, max.z);
+		rotation.x = randInInterval(min.x, max.x, stream);
+		rotation.y = randInInterval(min.y, max.y, stream);
+		rotation.z = randInInterval(min.z, max.z, stream);
 	}
 	else
 	{
 		rotation = glm::vec3(0, 0, 0);
 	}
-	
-	processChunk(glm::mat4(1.0f), scale, translation, rotation, 0, 1);
-
-	// Copy generated data to the Engine::Mesh class format
-	float * newVertices = new float[vertices.size() * 3];
-	float * newColors = new float[vertices.size() * 3];
-	float * newEmission = new float[vertices.size() * 3];
-	float * newUVs = new float[vertices.size() * 2];
-	for (size_t i = 0; i < vertices.size(); i++)
+
+	return rootKey;
+}
+
+Engine::FractalTree::GeometryCount Engine::FractalTree::countTree(unsigned long long rootKey, std::vector<GeometryCount> & subtreeSizes)
+{
+	// The random engine is restored afterwards, so the actual generation draws the same numbers
+	std::default_random_engine savedEngine = randEngine;
+	GeometryCount count = { 0, 0 };
+	countChunk(count, 1, rootKey, treeData.parallelSplitDepth > 0 ? &subtreeSizes : 0);
+	randEngine = savedEngine;
+	randGen.reset();
+	return count;
+}
+
+void Engine::FractalTree::countChunk(GeometryCount & count, unsigned int depth, unsigned long long key, std::vector<GeometryCount> * subtrees)
+{
+	if (subtrees != 0 && depth == treeData.parallelSplitDepth && depth > 1)
 	{
-		size_t index = i * 3;
-		// Copy vertex pos
-		glm::vec3 & v = vertices[i];
-		newVertices[index] = v.x;
-		newVertices[index + 1] = v.y;
-		newVertices[index + 2] = v.z;
-		// Copy vertex color
-		glm::vec3 & c = colors[i];
-		newColors[index] = c.x;
-		newColors[index + 1] = c.y;
-		newColors[index + 2] = c.z;
-		// Copy vertex emission
-		glm::vec3 & e = emission[i];
-		newEmission[index] = e.x;
-		newEmission[index + 1] = e.y;
-		newEmission[index + 2] = e.z;
-
-		size_t uvIndex = i * 2;
-		glm::vec2 & uv = uvs[i];
-		newUVs[uvIndex] = uv.x;
-		newUVs[uvIndex + 1] = uv.y;
+		GeometryCount subtree = { 0, 0 };
+		countChunk(subtree, depth, key, 0);
+		subtrees->push_back(subtree);
+		return;
 	}
 
-	unsigned int * newFaces = new unsigned int[faces.size() * 3];
-	for (size_t i = 0; i < faces.size(); i++)
+	// Leafs keep the whole base shape
+	if (depth >= treeData.depthStartingLeaf)
 	{
-		size_t index = i * 3;
-		glm::ivec3 & f = faces[i];
-		newFaces[index] = f.x;
-		newFaces[index + 1] = f.y;
-		newFaces[index + 2] = f.z;
+		count.numVertices += base->getNumVertices();
+		count.numFaces += base->getNumFaces();
+		if (depth >= treeData.maxDepth)
+		{
+			return;
+		}
 	}
 
-	// Generate new mesh. Normals are automatically computed if not present in the constructor
-	Engine::Mesh * tree = new Engine::Mesh(unsigned int(faces.size()), unsigned int(vertices.size()), newFaces, newVertices, newColors, 0, newUVs, 0, newEmission);
+	// Branches reuse the top ring of their parent, except the main trunk
+	count.numVertices += depth == 1 ? base->getNumVertices() : base->getNumVertices() / 2;
+	count.numFaces += base->getNumFaces();
 
-	return tree;
+	unsigned long long stream = key;
+
+	unsigned int intBranches = 1;
+	if (depth >= treeData.startBranchingDepth)
+	{
+		float branches = randNext(stream) * float(treeData.maxBranchesSplit);
+		intBranches = unsigned int(ceil(branches));
+	}
+
+	// Rotation and sign
+	randNext(stream);
+	randNext(stream);
+
+	for (unsigned int i = 0; i < intBranches; i++)
+	{
+		countChunk(count, depth + 1, childKey(key, i), subtrees);
+	}
 }
 
-void Engine::FractalTree::processChunk(glm::mat4 origin, glm::vec3 scale, glm::vec3 translate, glm::vec3 rotation, size_t vOffset, unsigned int depth)
+void Engine::FractalTree::processChunk(GeometryBuffer & out, glm::mat4 origin, glm::vec3 scale, glm::vec3 translate, glm::vec3 rotation, size_t vOffset, unsigned int depth, unsigned long long key, std::vector<SubtreeTask> * subtrees)
 {
+	// Defer the whole subtree to be generated as an independent task
+	if (subtrees != 0 && depth == treeData.parallelSplitDepth && depth > 1)
+	{
+		SubtreeTask task;
+		task.origin = origin;
+		task.scale = scale;
+		task.translate = translate;
+		task.rotation = rotation;
+		task.vOffset = vOffset;
+		task.depth = depth;
+		task.key = key;
+		// Filled in once the geometry of every subtree has been counted
+		task.offset = {};
+		task.size = {};
+		subtrees->push_back(task);
+		return;
+	}
+
 	if (depth >= treeData.depthStartingLeaf)
 	{
-		addLeaf(origin, scale / treeData.scalingFactor, vOffset, depth);
+		addLeaf(out, origin, scale / treeData.scalingFactor, vOffset, depth);
 		if(depth >= treeData.maxDepth)
 			return;
 	}
@@ -113,25 +255,28 @@ void Engine::FractalTree::processChunk(glm::mat4 origin, glm::vec3 scale, glm::v
 	glm::mat4 modelMat = origin * translateMat * rotateMat;
 
 	// Add vertices and faces applying the transformation
-	appendVerticesAndFaces(base, modelMat, scale, depth, vOffset, depth==1, false);
+	appendVerticesAndFaces(out, base, modelMat, scale, depth, vOffset, depth==1, false);
 
 	// Generate common translation to prevent branches from growing inside parent branches
 	translate.y = scale.y;
 
+	// Random stream of this chunk (only used in split seed mode)
+	unsigned long long stream = key;
+
 	// Check for branching
 	unsigned int intBranches = 1;
 	if (depth >= treeData.startBranchingDepth)
 	{
-		float branches = randGen(randEngine) * float(treeData.maxBranchesSplit);
+		float branches = randNext(stream) * float(treeData.maxBranchesSplit);
 		intBranches = unsigned int(ceil(branches)); // ceil ensures there will be at least 1 branch
 	}
 
-	size_t currentOffset = vertices.size();
+	size_t currentOffset = out.numVertices;
 
-	float xRotation = randInInterval(treeData.minBranchRotation.x, treeData.maxBranchRotation.x);;// *(depth + 1);
+	float xRotation = randInInterval(treeData.minBranchRotation.x, treeData.maxBranchRotation.x, stream);;// *(depth + 1);
 
 	float deltaAngle = (2.f * 3.1415f) / intBranches;
-	float sign = randSign();
+	float sign = randSign(stream);
 	// Apply branching
 	for (unsigned int i = 0; i < intBranches; i++)
 	{
@@ -146,11 +291,39 @@ void Engine::FractalTree::processChunk(glm::mat4 origin, glm::vec3 scale, glm::v
 		rotationCopy.z = 0.0f;
 
 		// Next branch
-		processChunk(modelMat, scaleCopy, translate, rotationCopy, currentOffset, depth + 1);
+		processChunk(out, modelMat, scaleCopy, translate, rotationCopy, currentOffset, depth + 1, childKey(key, i), subtrees);
 	}
 }
 
-void Engine::FractalTree::addLeaf(glm::mat4 origin, glm::vec3 lastScaling, size_t offset, unsigned int depth)
+void Engine::FractalTree::processSubtrees(GeometryBuffer & out, const std::vector<SubtreeTask> & subtrees)
+{
+	// Sizes are known in advance, so every subtree writes its final indices directly on its own region
+	std::atomic<bool> sizeMismatch(false);
+	Engine::Concurrent::parallelFor(0, subtrees.size(), 1, [&](size_t i)
+	{
+		const SubtreeTask & task = subtrees[i];
+
+		GeometryBuffer region = out;
+		region.numVertices = task.offset.numVertices;
+		region.numFaces = task.offset.numFaces;
+
+		processChunk(region, task.origin, task.scale, task.translate, task.rotation, task.vOffset, task.depth, task.key, 0);
+
+		if (region.numVertices != task.offset.numVertices + task.size.numVertices
+			|| region.numFaces != task.offset.numFaces + task.size.numFaces)
+		{
+			sizeMismatch = true;
+		}
+	});
+
+	if (sizeMismatch)
+	{
+		std::cerr << "FractalTree: Generated subtree does not match the precomputed size" << std::endl;
+		exit(-1);
+	}
+}
+
+void Engine::FractalTree::addLeaf(GeometryBuffer & out, glm::mat4 origin, glm::vec3 lastScaling, size_t offset, unsigned int depth)
 {
 	float maxScale = glm::max(glm::max(lastScaling.x, lastScaling.y), lastScaling.z);
 
@@ -158,14 +331,14 @@ void Engine::FractalTree::addLeaf(glm::mat4 origin, glm::vec3 lastScaling, size_
 	glm::mat4 model = origin * glm::translate(glm::mat4(1.0f), translation);
 
 	//0.4 0.3 0.4
-	appendVerticesAndFaces(base, model, glm::vec3(maxScale) * glm::vec3(0.4, 0.3, 0.4), 0, offset, true, true);
+	appendVerticesAndFaces(out, base, model, glm::vec3(maxScale) * glm::vec3(0.4, 0.3, 0.4), 0, offset, true, true);
 }
 
-void Engine::FractalTree::appendVerticesAndFaces(Engine::Mesh * source, glm::mat4 model, glm::vec3 scale, unsigned int depth, size_t vOffset, bool keepBase, bool isLeaf)
+void Engine::FractalTree::appendVerticesAndFaces(GeometryBuffer & out, Engine::Mesh * source, glm::mat4 model, glm::vec3 scale, unsigned int depth, size_t vOffset, bool keepBase, bool isLeaf)
 {
 	// Add faces adding the offset of vertices already added to the main tree
 	const unsigned int * fac = source->getFaces();
-	size_t realOffset = vertices.size();
+	size_t realOffset = out.numVertices;
 	for (unsigned int i = 0; i < source->getNumFaces(); i++)
 	{
 		unsigned int index = i * 3;
@@ -187,8 +360,11 @@ void Engine::FractalTree::appendVerticesAndFaces(Engine::Mesh * source, glm::mat
 			c += realOffset;
 		}
 
-		glm::ivec3 f(a, b, c);
-		faces.push_back(f);
+		unsigned int * f = out.faces + out.numFaces * 3;
+		f[0] = unsigned int(a);
+		f[1] = unsigned int(b);
+		f[2] = unsigned int(c);
+		out.numFaces++;
 	}
 
 	// Add new vertices applying the transformations
@@ -214,45 +390,68 @@ void Engine::FractalTree::appendVerticesAndFaces(Engine::Mesh * source, glm::mat
 		float z = verts[index + 2] * scale.z;
 		glm::vec4 v(x, y, z, 1.0);
 
+		const size_t outIndex = out.numVertices * 3;
+		const size_t outUVIndex = out.numVertices * 2;
+		out.numVertices++;
+
 		unsigned int uvIndex = i * 2;
 		float s = source->getUVs()[uvIndex] +  - 4;
 		float t = source->getUVs()[uvIndex + 1] + vOffset - 4;
-		glm::vec2 uv(s, t);
-		uvs.push_back(uv);
+		out.uvs[outUVIndex] = s;
+		out.uvs[outUVIndex + 1] = t;
 
 		glm::vec4 transformedV = model * v;
 
-		vertices.push_back(glm::vec3(transformedV.x, transformedV.y, transformedV.z));
+		out.vertices[outIndex] = transformedV.x;
+		out.vertices[outIndex + 1] = transformedV.y;
+		out.vertices[outIndex + 2] = transformedV.z;
 
+		glm::vec3 color, data;
 		if (!isLeaf)
 		{
 			// Add color gradient based on depth + vertex height
-			colors.push_back(glm::mix(treeData.startTrunkColor, treeData.endTrunkColor, depth * 2.0f + y));
-			emission.push_back(glm::vec3(0, 0, 0));
+			color = glm::mix(treeData.startTrunkColor, treeData.endTrunkColor, depth * 2.0f + y);
+			data = glm::vec3(0, 0, 0);
 		}
 		else
 		{
-			glm::vec3 color = glm::mix(treeData.leafStartColor, treeData.leafEndColor, verts[index + 1] / delta);
+			color = glm::mix(treeData.leafStartColor, treeData.leafEndColor, verts[index + 1] / delta);
 			// Add leaf color and possible emission
-			glm::vec3 data;
 			data.x = 1.0f;
 			data.y = treeData.emissiveLeaf ? 1.0f : 0.0f;
-			emission.push_back(data);
-			colors.push_back(color);
+			data.z = 0.0f;
 		}
+
+		out.colors[outIndex] = color.x;
+		out.colors[outIndex + 1] = color.y;
+		out.colors[outIndex + 2] = color.z;
+		out.emission[outIndex] = data.x;
+		out.emission[outIndex + 1] = data.y;
+		out.emission[outIndex + 2] = data.z;
+	}
+}
+
+float Engine::FractalTree::randNext(unsigned long long & stream)
+{
+	if (treeData.parallelSplitDepth > 0)
+	{
+		// 24 random bits mapped to [0, 1)
+		return float(splitMix64(stream) >> 40) * (1.0f / 16777216.0f);
 	}
+
+	return randGen(randEngine);
 }
 
-float Engine::FractalTree::randSign()
+float Engine::FractalTree::randSign(unsigned long long & stream)
 {
-	float v = randGen(randEngine);
+	float v = randNext(stream);
 	if (v < 0.5)
 		return -1.0f;
 	else
 		return 1.0f;
 }
 
-float Engine::FractalTree::randInInterval(float a, float b)
+float Engine::FractalTree::randInInterval(float a, float b, unsigned long long & stream)
 {
-	return a + (b - a) * randGen(randEngine);
+	return a + (b - a) * randNext(stream);
 }
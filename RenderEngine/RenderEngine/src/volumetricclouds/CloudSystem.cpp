@@ -83,8 +83,10 @@ void Engine::CloudSystem::VolumetricClouds::render(Engine::Camera * cam)
 	glEnable(GL_DEPTH_TEST);
 }
 
-void Engine::CloudSystem::VolumetricClouds::renderShadow(Camera * camera, const glm::mat4 & projectionMatrix)
+void Engine::CloudSystem::VolumetricClouds::renderShadow(Camera * camera, const glm::mat4 * projectionMatrices, unsigned int regions)
 {
+	// The cloud shadow program has no geometry shader to place the plane on every region, so it only
+	// covers the first one. The clouds are not registered as shadow casters
 	skyPlane->getMesh()->use();
 	const glm::vec3 & cameraPosition = camera->getPosition();
 	float x = 0.0f;// -cameraPosition.x;
@@ -93,9 +95,9 @@ void Engine::CloudSystem::VolumetricClouds::renderShadow(Camera * camera, const
 	skyPlane->setTranslation(glm::vec3(x, 0.0f, z));
 
 	shadowShader->use();
-	shadowShader->setUniformLightProjMatrix(projectionMatrix * skyPlane->getModelMatrix());
+	shadowShader->setUniformLightProjMatrix(projectionMatrices[0] * skyPlane->getModelMatrix());
 	shadowShader->onRenderObject(skyPlane, camera);
-	glDrawElements(GL_TRIANGLE_STRIP, 6, GL_UNSIGNED_INT, (void*)0);
+	glDrawElements(GL_TRIANGLE_STRIP, 6, skyPlane->getMesh()->getIndexType(), (void*)0);
 }
 
 void Engine::CloudSystem::VolumetricClouds::createTileMesh()
@@ -122,7 +124,9 @@ void Engine::CloudSystem::VolumetricClouds::createTileMesh()
 	uv[4] = 0.0f; uv[5] = 1.0f;
 	uv[6] = 1.0f; uv[7] = 1.0f;
 
-	Engine::Mesh plane(2, 4, faces, vertices, 0, normals, uv, 0);
+	Engine::Mesh plane(2, 4, faces, vertices, 0, normals, uv, 0, 0, false);
+	plane.setVertexFormat(Engine::VertexFormat::quantized());
+	plane.syncGPU();
 	Engine::MeshTable::getInstance().addMeshToCache("sky_tile", plane);
 	Engine::Mesh * planeInstance = Engine::MeshTable::getInstance().getMesh("sky_tile");
 
@@ -10,6 +10,8 @@
 #include "userinterfaces/WorldControllerUI.h"
 #include "WorldConfig.h"
 #include "TimeAccesor.h"
+#include "FrameStatistics.h"
+#include "TaskGraph.h"
 
 double lastMouseXPos = 0.0, lastMouseYPos = 0.0;
 
@@ -124,32 +126,76 @@ void Engine::Window::GLFWWindow::initializeContext()
 
 void Engine::Window::GLFWWindow::mainLoop()
 {
+	Engine::Concurrent::TaskGraph frameGraph;
+	buildFrameGraph(frameGraph);
+
 	while (!glfwWindowShouldClose(window))
 	{
-		// Update secondary settings based on main settings changes
+		frameGraph.execute();
+
+		if (Engine::Settings::dumpFrameGraph)
+		{
+			Engine::Settings::dumpFrameGraph = false;
+			frameGraph.dump(std::cout);
+		}
+	}
+
+	glfwDestroyWindow(window);
+
+	glfwTerminate();
+}
+
+void Engine::Window::GLFWWindow::buildFrameGraph(Engine::Concurrent::TaskGraph & graph)
+{
+	using namespace Engine::Concurrent;
+
+	GLFWwindow * surface = window;
+
+	// Update secondary settings based on main settings changes
+	graph.addStage("Settings update", {}, { "settings" }, AFFINITY_ANY_THREAD, []()
+	{
 		Engine::Settings::update();
+	});
 
-		// Render scene
+	// Render scene
+	graph.addStage("Render", { "settings", "camera", "time", "lights" }, { "framebuffer" }, AFFINITY_MAIN_THREAD, []()
+	{
 		Engine::RenderManager::getInstance().doRender();
+		Engine::FrameStatistics::endFrame();
+	});
 
-		// Update user interface
+	// Update user interface
+	graph.addStage("User interface", { "input", "time" }, { "settings", "framebuffer" }, AFFINITY_MAIN_THREAD, [this]()
+	{
 		updateUI();
+	});
 
+	graph.addStage("Config notify", { "settings" }, { "lights", "renderables" }, AFFINITY_MAIN_THREAD, []()
+	{
 		Engine::RenderableNotifier::getInstance().checkUpdatedConfig();
+	});
 
-		// Process inputs
+	// Process inputs (callbacks move the camera and may resize the viewport)
+	graph.addStage("Input", {}, { "input", "camera", "framebuffer" }, AFFINITY_MAIN_THREAD, []()
+	{
 		glfwPollEvents();
-		glfwSwapBuffers(window);
+	});
 
-		// Update animations
+	graph.addStage("Swap buffers", {}, { "framebuffer" }, AFFINITY_MAIN_THREAD, [surface]()
+	{
+		glfwSwapBuffers(surface);
+	});
+
+	// Update animations, CPU only, overlaps with the buffer swap
+	graph.addStage("Animations", { "time" }, { "camera" }, AFFINITY_ANY_THREAD, []()
+	{
 		Engine::SceneManager::getInstance().getActiveScene()->getAnimationHandler()->tick();
+	});
 
+	graph.addStage("Time update", {}, { "time" }, AFFINITY_ANY_THREAD, []()
+	{
 		Engine::Time::update(glfwGetTime());
-	}
-
-	glfwDestroyWindow(window);
-
-	glfwTerminate();
+	});
 }
 
 void Engine::Window::GLFWWindow::setKeyboardCallback(Engine::Window::glfwKeyboardCallback keyboardCb)
@@ -9,6 +9,7 @@
 #include "Scene.h"
 #include "windowmanagers/WindowManager.h"
 #include "TimeAccesor.h"
+#include "FrameStatistics.h"
 
 void Engine::Window::defaultResizeCallback(int width, int height)
 {
@@ -159,4 +160,5 @@ void Engine::Window::GLUTWindow::onRenderEnd()
 	//currentAbsTime -= renderStartTime;
 
 	Engine::Time::update(currentAbsTime);
+	Engine::FrameStatistics::endFrame();
 }
\ No newline at end of file
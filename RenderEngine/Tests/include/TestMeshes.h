@@ -0,0 +1,26 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <vector>
+
+#include "ProceduralVegetation.h"
+
+namespace Engine
+{
+	namespace Tests
+	{
+		// Adds the trunk and leaf base shapes used by the fractal trees to the MeshTable (as main.cpp
+		// does), without uploading them
+		void registerTreeShapes();
+
+		// Tree species configured as TreeComponent::initTrees does
+		std::vector<TreeGenerationData> createTreeSpecies(unsigned int count);
+
+		// Single mesh holding numTrees generated trees (one per species) placed side by side. Only positions
+		// and uvs are copied, the normals are computed by the Mesh and there are no tangents
+		Mesh * createForest(unsigned int numTrees);
+	}
+}
@@ -0,0 +1,78 @@
+/*
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace Engine
+{
+	namespace Tests
+	{
+		typedef void(*TestFunction)();
+
+		typedef struct TestCase
+		{
+			const char * name;
+			TestFunction function;
+			// Benchmarks only report timings, and only run when requested
+			bool benchmark;
+		} TestCase;
+
+		// Test cases and benchmarks of the project, registered by the TEST_CASE and BENCHMARK macros
+		class TestSuite
+		{
+		private:
+			static unsigned int failedChecks;
+		public:
+			static bool add(const char * name, TestFunction function, bool benchmark);
+
+			// Runs the test cases (and the benchmarks if requested) whose name contains filter.
+			// Returns the number of failed test cases
+			static int run(bool benchmarks, const std::string & filter);
+
+			// Records a failed check of the running case
+			static void fail(const char * file, int line, const std::string & message);
+			// Prints a measurement of the running case
+			static void report(const std::string & message);
+		private:
+			static std::vector<TestCase> & getCases();
+		};
+
+		// Wall clock time since its creation or the last reset
+		class Stopwatch
+		{
+		private:
+			std::chrono::high_resolution_clock::time_point start;
+		public:
+			Stopwatch() : start(std::chrono::high_resolution_clock::now()) {}
+
+			void reset() { start = std::chrono::high_resolution_clock::now(); }
+			double getSeconds() const { return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count(); }
+		};
+
+		// Restarts the engine thread pool with the given number of workers (0 for the default)
+		void restartPool(unsigned int numThreads);
+	}
+}
+
+#define TEST_CASE(NAME) \
+	static void NAME(); \
+	static const bool NAME##Registered = Engine::Tests::TestSuite::add(#NAME, &NAME, false); \
+	static void NAME()
+
+#define BENCHMARK(NAME) \
+	static void NAME(); \
+	static const bool NAME##Registered = Engine::Tests::TestSuite::add(#NAME, &NAME, true); \
+	static void NAME()
+
+#define CHECK(CONDITION) \
+	do { if (!(CONDITION)) Engine::Tests::TestSuite::fail(__FILE__, __LINE__, #CONDITION); } while (0)
+
+// Checks |a - b| <= tolerance
+#define CHECK_NEAR(A, B, TOLERANCE) \
+	do { double a_ = double(A), b_ = double(B); if (!(a_ - b_ <= double(TOLERANCE) && b_ - a_ <= double(TOLERANCE))) \
+		Engine::Tests::TestSuite::fail(__FILE__, __LINE__, std::string(#A " ~ " #B ": ") + std::to_string(a_) + " vs " + std::to_string(b_)); } while (0)
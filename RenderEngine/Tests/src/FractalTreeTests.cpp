@@ -0,0 +1,276 @@
+#include "TestSuite.h"
+#include "TestMeshes.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+
+#include "Threadpool.h"
+#include "datatables/VegetationTable.h"
+#include "vegetation/FractalTree.h"
+
+namespace
+{
+	typedef std::array<float, 9> Triangle;
+
+	std::unique_ptr<Engine::Mesh> generateTree(const Engine::TreeGenerationData & data)
+	{
+		Engine::FractalTree tree(data);
+		return std::unique_ptr<Engine::Mesh>(tree.generateCPU());
+	}
+
+	bool sameGeometry(const Engine::Mesh & a, const Engine::Mesh & b)
+	{
+		return a.getNumFaces() == b.getNumFaces() && a.getNumVertices() == b.getNumVertices()
+			&& memcmp(a.getFaces(), b.getFaces(), a.getNumFaces() * 3 * sizeof(unsigned int)) == 0
+			&& memcmp(a.getVertices(), b.getVertices(), a.getNumVertices() * 3 * sizeof(float)) == 0;
+	}
+
+	bool sameAttribute(const float * a, const float * b, size_t count)
+	{
+		return (a == nullptr && b == nullptr) || (a != nullptr && b != nullptr && memcmp(a, b, count * sizeof(float)) == 0);
+	}
+
+	// Geometry and every vertex attribute, byte for byte
+	bool sameMesh(const Engine::Mesh & a, const Engine::Mesh & b)
+	{
+		const size_t n = a.getNumVertices();
+		return sameGeometry(a, b) && sameAttribute(a.getNormals(), b.getNormals(), n * 3) && sameAttribute(a.getColor(), b.getColor(), n * 3)
+			&& sameAttribute(a.getUVs(), b.getUVs(), n * 2) && sameAttribute(a.getTangetns(), b.getTangetns(), n * 3)
+			&& sameAttribute(a.getEmissive(), b.getEmissive(), n * 3);
+	}
+
+	// Triangles of the mesh as vertex positions, each one starting on its smallest corner (keeping the winding), sorted
+	std::vector<Triangle> getTriangles(const Engine::Mesh & mesh)
+	{
+		std::vector<Triangle> triangles(mesh.getNumFaces());
+		for (unsigned int f = 0; f < mesh.getNumFaces(); f++)
+		{
+			std::array<std::array<float, 3>, 3> corners;
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				const float * v = mesh.getVertices() + mesh.getFaces()[f * 3 + c] * 3;
+				corners[c] = { v[0], v[1], v[2] };
+			}
+			const unsigned int first = unsigned(std::min_element(corners.begin(), corners.end()) - corners.begin());
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				std::copy(corners[(first + c) % 3].begin(), corners[(first + c) % 3].end(), triangles[f].begin() + c * 3);
+			}
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+}
+
+// Split seed trees must not depend on the number of threads which build them
+TEST_CASE(fractalTreeSplitSeedThreadIndependent)
+{
+	Engine::Tests::registerTreeShapes();
+	std::vector<Engine::TreeGenerationData> species = Engine::Tests::createTreeSpecies(3);
+	species[1].rotateMainTrunk = true;
+
+	for (const Engine::TreeGenerationData & data : species)
+	{
+		Engine::Tests::restartPool(1);
+		std::unique_ptr<Engine::Mesh> serial = generateTree(data);
+		Engine::Tests::restartPool(4);
+		std::unique_ptr<Engine::Mesh> parallel = generateTree(data);
+
+		CHECK(serial->getNumFaces() > 0);
+		CHECK(sameGeometry(*serial, *parallel));
+	}
+
+	Engine::Tests::restartPool(0);
+}
+
+// VegetationTable batches give the trees generated one after another, whatever the order the pool builds them in
+TEST_CASE(fractalTreeBatchMatchesSerial)
+{
+	Engine::Tests::registerTreeShapes();
+	std::vector<Engine::TreeGenerationData> species = Engine::Tests::createTreeSpecies(8);
+	species[1].rotateMainTrunk = true;
+	species[2].parallelSplitDepth = 0;
+	species[5].emissiveLeaf = true;
+
+	Engine::Tests::restartPool(1);
+	std::vector<std::unique_ptr<Engine::Mesh>> serial;
+	for (const Engine::TreeGenerationData & data : species)
+	{
+		serial.push_back(generateTree(data));
+	}
+
+	for (unsigned int threads : { 1u, 4u })
+	{
+		Engine::Tests::restartPool(threads);
+		std::vector<Engine::Mesh *> batch = Engine::VegetationTable::getInstance().generateFractalTreesCPU(species);
+		CHECK(batch.size() == species.size());
+		for (size_t i = 0; i < batch.size() && i < serial.size(); i++)
+		{
+			CHECK(sameMesh(*serial[i], *batch[i]));
+			delete batch[i];
+		}
+	}
+
+	Engine::Tests::restartPool(0);
+}
+
+// Split depth 1 generates every branch inline, with the same streams as the deferred subtrees. Only the
+// order of the geometry may change
+TEST_CASE(fractalTreeSplitDepthKeepsTriangles)
+{
+	Engine::Tests::registerTreeShapes();
+	std::vector<Engine::TreeGenerationData> species = Engine::Tests::createTreeSpecies(3);
+	species[2].rotateMainTrunk = true;
+
+	for (Engine::TreeGenerationData data : species)
+	{
+		data.parallelSplitDepth = 1;
+		std::unique_ptr<Engine::Mesh> inlineTree = generateTree(data);
+		const std::vector<Triangle> inlineTriangles = getTriangles(*inlineTree);
+
+		for (unsigned int splitDepth = 2; splitDepth <= data.maxDepth; splitDepth++)
+		{
+			data.parallelSplitDepth = splitDepth;
+			std::unique_ptr<Engine::Mesh> splitTree = generateTree(data);
+			CHECK(splitTree->getNumVertices() == inlineTree->getNumVertices());
+			CHECK(getTriangles(*splitTree) == inlineTriangles);
+		}
+	}
+}
+
+// The dry run counts exactly the geometry the tree is built with, over species, depths, seeds and split
+// depths, and counting does not change the tree generated afterwards
+TEST_CASE(fractalTreeCountedSize)
+{
+	Engine::Tests::registerTreeShapes();
+	std::vector<Engine::TreeGenerationData> species = Engine::Tests::createTreeSpecies(4);
+	species[1].rotateMainTrunk = true;
+	species[3].rotateMainTrunk = true;
+
+	size_t sizeErrors = 0, geometryErrors = 0, trees = 0;
+	for (Engine::TreeGenerationData data : species)
+	{
+		for (unsigned int maxDepth : { 3u, 5u, 7u })
+		{
+			data.maxDepth = maxDepth;
+			data.depthStartingLeaf = maxDepth - 1;
+			for (unsigned long seed : { 1ul, 977ul, 40503ul })
+			{
+				data.seed = seed;
+				for (unsigned int splitDepth : { 0u, 2u, 4u })
+				{
+					data.parallelSplitDepth = splitDepth;
+					Engine::FractalTree generator(data);
+					size_t numVertices = 0, numFaces = 0;
+					generator.countGeometry(numVertices, numFaces);
+					std::unique_ptr<Engine::Mesh> tree(generator.generateCPU());
+
+					sizeErrors += (tree->getNumVertices() != numVertices || tree->getNumFaces() != numFaces) ? 1 : 0;
+					geometryErrors += sameGeometry(*tree, *generateTree(data)) ? 0 : 1;
+					trees++;
+				}
+			}
+		}
+	}
+
+	CHECK(trees == 108);
+	CHECK(sizeErrors == 0);
+	CHECK(geometryErrors == 0);
+}
+
+// The trunk rotation draws from its own stream, so it does not change the branching of the tree
+TEST_CASE(fractalTreeTrunkRotationKeepsBranching)
+{
+	Engine::Tests::registerTreeShapes();
+	Engine::TreeGenerationData data = Engine::Tests::createTreeSpecies(1)[0];
+
+	std::unique_ptr<Engine::Mesh> straight = generateTree(data);
+	data.rotateMainTrunk = true;
+	std::unique_ptr<Engine::Mesh> rotated = generateTree(data);
+
+	CHECK(rotated->getNumFaces() == straight->getNumFaces());
+	CHECK(!sameGeometry(*straight, *rotated));
+}
+
+// Trees per second for the TreeComponent species: one after another on the default mode, one after
+// another splitting each tree, and all of them at once on the pool
+BENCHMARK(fractalTreeGeneration)
+{
+	Engine::Tests::registerTreeShapes();
+	std::vector<Engine::TreeGenerationData> species = Engine::Tests::createTreeSpecies(8);
+	const unsigned int rounds = 4;
+
+	auto report = [&](const char * name, double seconds)
+	{
+		Engine::Tests::TestSuite::report(std::string(name) + ": " + std::to_string(unsigned(rounds * species.size() / seconds)) + " trees/s");
+	};
+
+	for (unsigned int splitDepth : { 0u, 4u })
+	{
+		for (auto & data : species)
+		{
+			data.parallelSplitDepth = splitDepth;
+		}
+
+		Engine::Tests::Stopwatch watch;
+		size_t faces = 0;
+		for (unsigned int r = 0; r < rounds; r++)
+		{
+			for (const auto & data : species)
+			{
+				faces += generateTree(data)->getNumFaces();
+			}
+		}
+		report(splitDepth == 0 ? "default mode, one tree at a time" : "split depth 4, one tree at a time", watch.getSeconds());
+		Engine::Tests::TestSuite::report("  " + std::to_string(faces / (rounds * species.size())) + " faces per tree");
+
+		watch.reset();
+		for (unsigned int r = 0; r < rounds; r++)
+		{
+			std::vector<std::unique_ptr<Engine::Mesh>> trees(species.size());
+			Engine::Concurrent::parallelFor(0, species.size(), 1, [&](size_t i)
+			{
+				trees[i] = generateTree(species[i]);
+			});
+		}
+		report(splitDepth == 0 ? "default mode, all species at once" : "split depth 4, all species at once", watch.getSeconds());
+	}
+}
+
+// Cost of the dry run which sizes the output arrays, against the whole generation of the tree
+BENCHMARK(fractalTreeCountOverhead)
+{
+	Engine::Tests::registerTreeShapes();
+	std::vector<Engine::TreeGenerationData> species = Engine::Tests::createTreeSpecies(8);
+	const unsigned int rounds = 4;
+
+	Engine::Tests::Stopwatch watch;
+	size_t vertices = 0;
+	for (unsigned int r = 0; r < rounds; r++)
+	{
+		for (const auto & data : species)
+		{
+			Engine::FractalTree generator(data);
+			size_t numVertices = 0, numFaces = 0;
+			generator.countGeometry(numVertices, numFaces);
+			vertices += numVertices;
+		}
+	}
+	const double countSeconds = watch.getSeconds();
+
+	watch.reset();
+	for (unsigned int r = 0; r < rounds; r++)
+	{
+		for (const auto & data : species)
+		{
+			vertices -= generateTree(data)->getNumVertices();
+		}
+	}
+	const double generateSeconds = watch.getSeconds();
+
+	Engine::Tests::TestSuite::report("count: " + std::to_string(unsigned(rounds * species.size() / countSeconds)) + " trees/s, "
+		+ std::to_string(countSeconds / generateSeconds * 100.0) + "% of the generation time");
+	CHECK(vertices == 0);
+}
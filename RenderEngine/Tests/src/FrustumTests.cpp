@@ -0,0 +1,274 @@
+#include "TestSuite.h"
+
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "Frustum.h"
+#include "ShadowCascadeFit.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	// Random camera looking over the terrain window, with the engine projection settings
+	glm::mat4 randomViewProjection(std::default_random_engine & engine)
+	{
+		std::uniform_real_distribution<float> position(-12.0f, 12.0f);
+		std::uniform_real_distribution<float> height(0.0f, 3.0f);
+		std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+
+		const glm::vec3 eye(position(engine), height(engine), position(engine));
+		glm::vec3 forward(direction(engine), direction(engine) * 0.5f, direction(engine));
+		if (glm::length(forward) < 1e-3f)
+		{
+			forward = glm::vec3(0.0f, 0.0f, -1.0f);
+		}
+		return glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 40.0f) * glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+
+	// Brute force reference: a box is outside if its 8 corners are behind the same plane
+	bool referenceIntersects(const Engine::Frustum & frustum, const glm::vec3 & boundsMin, const glm::vec3 & boundsMax)
+	{
+		for (unsigned int p = 0; p < Engine::Frustum::PLANE_COUNT; p++)
+		{
+			const glm::vec4 & plane = frustum.getPlane(Engine::Frustum::FrustumPlane(p));
+			bool allOutside = true;
+			for (unsigned int c = 0; c < 8 && allOutside; c++)
+			{
+				const glm::vec3 corner((c & 1) ? boundsMax.x : boundsMin.x, (c & 2) ? boundsMax.y : boundsMin.y, (c & 4) ? boundsMax.z : boundsMin.z);
+				allOutside = glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f;
+			}
+			if (allOutside)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Random boxes over the terrain window, flatter than wide as the terrain tiles
+	void randomBoxes(std::default_random_engine & engine, size_t count, Engine::BoundingBoxList & boxes)
+	{
+		std::uniform_real_distribution<float> coordinate(-15.0f, 15.0f);
+		std::uniform_real_distribution<float> size(0.0f, 4.0f);
+		boxes.clear();
+		for (size_t i = 0; i < count; i++)
+		{
+			const glm::vec3 boundsMin(coordinate(engine), coordinate(engine) * 0.2f, coordinate(engine));
+			boxes.add(boundsMin, boundsMin + glm::vec3(size(engine), size(engine) * 0.5f, size(engine)));
+		}
+	}
+
+	// Tiles of the landscape render radius (24x24 tiles, 7 units wide) around the camera, with random height ranges
+	void landscapeTiles(std::default_random_engine & engine, const glm::vec3 & eye, Engine::BoundingBoxList & boxes)
+	{
+		std::uniform_real_distribution<float> height(0.0f, 6.0f);
+		const float tileWidth = 7.0f;
+		const int x = int(floorf(eye.x / tileWidth));
+		const int z = int(floorf(eye.z / tileWidth));
+		boxes.clear();
+		for (int i = x - 12; i < x + 12; i++)
+		{
+			for (int j = z - 12; j < z + 12; j++)
+			{
+				const float low = height(engine), high = low + height(engine) * 0.5f;
+				boxes.add(glm::vec3(float(i) * tileWidth, low, float(j) * tileWidth), glm::vec3(float(i + 1) * tileWidth, high, float(j + 1) * tileWidth));
+			}
+		}
+	}
+
+	// A box casts shadows on the level if a point of it lies inside the level box, or between it and the light
+	// (in front of the near plane, within the side planes). Tested on 8x8x8 points of the box
+	bool castsShadow(const glm::mat4 & lightViewProjection, const glm::vec3 & boundsMin, const glm::vec3 & boundsMax)
+	{
+		for (unsigned int s = 0; s < 512; s++)
+		{
+			const glm::vec3 t(float(s & 7) / 7.0f, float((s >> 3) & 7) / 7.0f, float(s >> 6) / 7.0f);
+			const glm::vec4 clip = lightViewProjection * glm::vec4(boundsMin + (boundsMax - boundsMin) * t, 1.0f);
+			if (fabsf(clip.x) <= clip.w && fabsf(clip.y) <= clip.w && clip.z <= clip.w)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+// The batch test, the single box test and the 8 corner reference agree on every box
+TEST_CASE(frustumMatchesBruteForce)
+{
+	std::default_random_engine engine(3);
+	Engine::BoundingBoxList boxes;
+	std::vector<unsigned char> visible;
+
+	size_t total = 0, culled = 0;
+	for (unsigned int camera = 0; camera < 500; camera++)
+	{
+		const Engine::Frustum frustum(randomViewProjection(engine));
+		// Sizes which are not multiples of 4 exercise the remainder of the batch
+		randomBoxes(engine, 573 + camera % 4, boxes);
+		visible.assign(boxes.size(), 2);
+
+		size_t count = frustum.intersects(boxes, visible.data());
+		size_t expectedCount = 0;
+		bool same = true;
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			const bool expected = referenceIntersects(frustum, boxes.getMin(i), boxes.getMax(i));
+			expectedCount += expected ? 1 : 0;
+			same = same && frustum.intersects(boxes.getMin(i), boxes.getMax(i)) == expected && visible[i] == (expected ? 1 : 0);
+		}
+		CHECK(same);
+		CHECK(count == expectedCount);
+
+		total += boxes.size();
+		culled += boxes.size() - expectedCount;
+	}
+
+	// Both outcomes must be well represented for the test to mean something
+	CHECK(culled > total / 10 && culled < total * 9 / 10);
+}
+
+// No point inside a culled box projects into the clip volume
+TEST_CASE(frustumConservative)
+{
+	std::default_random_engine engine(5);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	Engine::BoundingBoxList boxes;
+	std::vector<unsigned char> visible;
+
+	size_t insideCulled = 0;
+	for (unsigned int camera = 0; camera < 200; camera++)
+	{
+		const glm::mat4 viewProjection = randomViewProjection(engine);
+		const Engine::Frustum frustum(viewProjection);
+		randomBoxes(engine, 256, boxes);
+		visible.resize(boxes.size());
+		frustum.intersects(boxes, visible.data());
+
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			if (visible[i] != 0)
+			{
+				continue;
+			}
+
+			const glm::vec3 boundsMin = boxes.getMin(i);
+			const glm::vec3 size = boxes.getMax(i) - boundsMin;
+			for (unsigned int s = 0; s < 64; s++)
+			{
+				const glm::vec4 clip = viewProjection * glm::vec4(boundsMin + size * glm::vec3(unit(engine), unit(engine), unit(engine)), 1.0f);
+				if (clip.w > 0.0f && fabsf(clip.x) <= clip.w && fabsf(clip.y) <= clip.w && fabsf(clip.z) <= clip.w)
+				{
+					insideCulled++;
+				}
+			}
+		}
+	}
+	CHECK(insideCulled == 0);
+}
+
+// Shadow caster culling: the cascade volumes extruded towards the light keep every tile casting shadows on
+// their level, which the closed volumes miss
+TEST_CASE(frustumShadowCasters)
+{
+	std::default_random_engine engine(7);
+	std::uniform_real_distribution<float> position(-300.0f, 300.0f);
+	std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+	const glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.5f, 1000.0f);
+
+	Engine::ShadowCascadeFit fit;
+	Engine::ShadowCascadeFit::Parameters params = fit.getParameters();
+	params.levels = 3;
+	params.shadowDistance = 100.0f;
+	fit.configure(params);
+
+	Engine::BoundingBoxList boxes;
+	std::vector<unsigned char> visible;
+	size_t needed[3] = {}, drawn[3] = {}, missed[3] = {}, missedClosed[3] = {};
+	size_t total = 0;
+	for (unsigned int view = 0; view < 200; view++)
+	{
+		const glm::vec3 eye(position(engine), 3.0f + fabsf(direction(engine)) * 4.0f, position(engine));
+		const glm::vec3 forward(direction(engine), direction(engine) * 0.3f, direction(engine));
+		const glm::vec3 light = glm::normalize(glm::vec3(direction(engine), 0.2f + fabsf(direction(engine)), direction(engine)));
+		fit.fit(glm::inverse(glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f))), projection, light);
+		landscapeTiles(engine, eye, boxes);
+		visible.resize(boxes.size());
+		total += boxes.size();
+
+		for (unsigned int level = 0; level < 3; level++)
+		{
+			const Engine::ShadowCascadeFit::Cascade & cascade = fit.getCascades()[level];
+			const glm::mat4 lightViewProjection = cascade.projection * cascade.view;
+			const Engine::Frustum closed(lightViewProjection);
+			Engine::Frustum volume(lightViewProjection);
+			volume.extrude(Engine::Frustum::PLANE_NEAR);
+			drawn[level] += volume.intersects(boxes, visible.data());
+
+			for (size_t i = 0; i < boxes.size(); i++)
+			{
+				if (castsShadow(lightViewProjection, boxes.getMin(i), boxes.getMax(i)))
+				{
+					needed[level]++;
+					missed[level] += visible[i] == 0 ? 1 : 0;
+					missedClosed[level] += closed.intersects(boxes.getMin(i), boxes.getMax(i)) ? 0 : 1;
+				}
+			}
+		}
+	}
+
+	for (unsigned int level = 0; level < 3; level++)
+	{
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(1) << "level " << level << ": " << 100.0 * drawn[level] / total << "% of the tiles drawn, "
+			<< 100.0 * needed[level] / total << "% needed, " << missed[level] << " missed (" << missedClosed[level] << " without the extrusion)";
+		Engine::Tests::TestSuite::report(os.str());
+		CHECK(missed[level] == 0);
+		CHECK(needed[level] > 0);
+	}
+	CHECK(missedClosed[0] + missedClosed[1] + missedClosed[2] > 0);
+}
+
+// Time to test the 576 tiles of the 24x24 terrain window, one box at a time and as a batch
+BENCHMARK(frustumCulling)
+{
+	std::default_random_engine engine(9);
+	Engine::BoundingBoxList boxes;
+	randomBoxes(engine, 576, boxes);
+	std::vector<unsigned char> visible(boxes.size());
+
+	std::vector<Engine::Frustum> frustums;
+	for (unsigned int i = 0; i < 64; i++)
+	{
+		frustums.push_back(Engine::Frustum(randomViewProjection(engine)));
+	}
+	const unsigned int rounds = 2000;
+
+	size_t checksum = 0;
+	Engine::Tests::Stopwatch watch;
+	for (unsigned int r = 0; r < rounds; r++)
+	{
+		const Engine::Frustum & frustum = frustums[r % frustums.size()];
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			checksum += frustum.intersects(boxes.getMin(i), boxes.getMax(i)) ? 1 : 0;
+		}
+	}
+	const double single = watch.getSeconds();
+
+	watch.reset();
+	for (unsigned int r = 0; r < rounds; r++)
+	{
+		checksum += frustums[r % frustums.size()].intersects(boxes, visible.data());
+	}
+	const double batch = watch.getSeconds();
+
+	std::ostringstream os;
+	os << std::fixed << std::setprecision(2) << "576 boxes: one at a time " << single / rounds * 1e6 << " us, batch " << batch / rounds * 1e6
+		<< " us (checksum " << checksum << ")";
+	Engine::Tests::TestSuite::report(os.str());
+}
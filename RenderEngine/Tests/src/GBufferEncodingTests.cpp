@@ -0,0 +1,167 @@
+#include "TestSuite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace
+{
+	// Transcription of encodeNormal() of terrain.frag, water.frag and tree.frag with glm
+	glm::vec2 encodeNormal(glm::vec3 n)
+	{
+		n /= fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+		const glm::vec2 e = n.z >= 0.0f ? glm::vec2(n.x, n.y)
+			: (1.0f - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+		return e * 0.5f + 0.5f;
+	}
+
+	// Transcription of decodeNormal() of DeferredShading.frag and SSReflections.frag
+	glm::vec3 decodeNormal(glm::vec2 e)
+	{
+		e = e * 2.0f - 1.0f;
+		glm::vec3 n(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+		const float t = glm::clamp(-n.z, 0.0f, 1.0f);
+		n.x += n.x >= 0.0f ? -t : t;
+		n.y += n.y >= 0.0f ? -t : t;
+		return glm::normalize(n);
+	}
+
+	// Transcription of reconstructPosition() of DeferredShading.frag, SSReflections.frag and SSGrass.frag
+	glm::vec3 reconstructPosition(const glm::mat4 & invProjection, const glm::vec2 & uv, float z)
+	{
+		const glm::vec4 p = invProjection * glm::vec4(glm::vec3(uv, z) * 2.0f - 1.0f, 1.0f);
+		return glm::vec3(p) / p.w;
+	}
+
+	// Value the GPU stores on an unsigned normalized channel of the given bits, as read back by the shader
+	float quantizeUnorm(float value, unsigned int bits)
+	{
+		const double maxValue = double((1u << bits) - 1u);
+		return float(floor(double(glm::clamp(value, 0.0f, 1.0f)) * maxValue + 0.5) / maxValue);
+	}
+
+	// Same projection as Camera::onResize()
+	glm::mat4 cameraProjection(float nearPlane, float farPlane, float fovy, float width, float height)
+	{
+		glm::mat4 projMatrix(0.0f);
+		projMatrix[0].x = 1.0f / (tan(fovy*3.14159f / 180.0f) * (width / height));
+		projMatrix[1].y = 1.0f / tan(fovy*3.14159f / 180.0f);
+		projMatrix[2].z = (farPlane + nearPlane) / (nearPlane - farPlane);
+		projMatrix[3].z = 2.0f * nearPlane*farPlane / (nearPlane - farPlane);
+		projMatrix[2].w = -1.0f;
+		return projMatrix;
+	}
+
+	// In double precision, acos of a float dot product cannot resolve less than 0.02 degrees
+	float angleDegrees(const glm::vec3 & a, const glm::vec3 & b)
+	{
+		const glm::dvec3 da(a), db(b);
+		return float(glm::degrees(atan2(glm::length(glm::cross(da, db)), glm::dot(da, db))));
+	}
+}
+
+// Normals stored on RG16 decode within 0.01 degrees, on the octahedron folds and the axes too
+TEST_CASE(gBufferOctahedralNormals)
+{
+	std::default_random_engine engine(61);
+	std::normal_distribution<float> gaussian(0.0f, 1.0f);
+
+	std::vector<glm::vec3> normals = {
+		glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+		glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)), glm::normalize(glm::vec3(-1.0f, 1.0f, -1e-7f)),
+		glm::normalize(glm::vec3(0.3f, -0.7f, -1e-4f)), glm::normalize(glm::vec3(-1e-4f, 1e-4f, -1.0f)) };
+	for (unsigned int i = 0; i < 1000000; i++)
+	{
+		const glm::vec3 n(gaussian(engine), gaussian(engine), gaussian(engine));
+		if (glm::length(n) > 1e-3f)
+		{
+			normals.push_back(glm::normalize(n));
+		}
+	}
+
+	size_t outOfRange = 0;
+	double mean16 = 0.0, mean10 = 0.0;
+	float exactMax = 0.0f, max16 = 0.0f, max10 = 0.0f;
+	for (const glm::vec3 & n : normals)
+	{
+		const glm::vec2 e = encodeNormal(n);
+		outOfRange += (e.x < 0.0f || e.x > 1.0f || e.y < 0.0f || e.y > 1.0f) ? 1 : 0;
+
+		const float exactError = angleDegrees(n, decodeNormal(e));
+		const float error16 = angleDegrees(n, decodeNormal(glm::vec2(quantizeUnorm(e.x, 16), quantizeUnorm(e.y, 16))));
+		const float error10 = angleDegrees(n, decodeNormal(glm::vec2(quantizeUnorm(e.x, 10), quantizeUnorm(e.y, 10))));
+		exactMax = std::max(exactMax, exactError);
+		max16 = std::max(max16, error16);
+		max10 = std::max(max10, error10);
+		mean16 += error16;
+		mean10 += error10;
+	}
+
+	std::ostringstream os;
+	os << std::setprecision(2) << normals.size() << " normals, error in degrees: unquantized max " << exactMax
+		<< ", RG16 mean " << mean16 / double(normals.size()) << " max " << max16
+		<< ", 10 bits mean " << mean10 / double(normals.size()) << " max " << max10;
+	Engine::Tests::TestSuite::report(os.str());
+	CHECK(outOfRange == 0);
+	// Only float rounding without quantization
+	CHECK(exactMax < 1e-3f);
+	CHECK(max16 < 0.01f);
+	CHECK(mean16 / double(normals.size()) < 0.002);
+}
+
+// Positions rebuilt from a D24 depth buffer with the main.cpp camera stay within the error of one depth
+// step, at 1080p and 4K and from the near to the far plane
+TEST_CASE(gBufferDepthPositions)
+{
+	const float nearPlane = 0.5f, farPlane = 1000.0f;
+	const float distances[] = { 1.0f, 10.0f, 100.0f, 500.0f, 990.0f };
+	std::default_random_engine engine(67);
+
+	for (const glm::vec2 & screen : { glm::vec2(1920.0f, 1080.0f), glm::vec2(3840.0f, 2160.0f) })
+	{
+		const glm::mat4 projection = cameraProjection(nearPlane, farPlane, 35.0f, screen.x, screen.y);
+		const glm::mat4 invProjection = glm::inverse(projection);
+		std::uniform_int_distribution<int> pixelX(0, int(screen.x) - 1);
+		std::uniform_int_distribution<int> pixelY(0, int(screen.y) - 1);
+
+		std::ostringstream os;
+		os << std::setprecision(2) << unsigned(screen.x) << "x" << unsigned(screen.y) << " max error in % of the distance:";
+		size_t outsideBound = 0;
+		float maxSteps = 0.0f;
+		for (float distance : distances)
+		{
+			float maxRelative = 0.0f;
+			for (unsigned int s = 0; s < 20000; s++)
+			{
+				// Surface seen at the pixel center, at the distance along its ray
+				const glm::vec2 uv((float(pixelX(engine)) + 0.5f) / screen.x, (float(pixelY(engine)) + 0.5f) / screen.y);
+				const glm::vec3 ray = glm::normalize(reconstructPosition(invProjection, uv, 0.5f));
+				const glm::vec3 position = ray * distance;
+
+				const glm::vec4 clip = projection * glm::vec4(position, 1.0f);
+				const float depth = quantizeUnorm(clip.z / clip.w * 0.5f + 0.5f, 24);
+				const float error = glm::length(reconstructPosition(invProjection, uv, depth) - position);
+				maxRelative = std::max(maxRelative, error / distance);
+
+				// Half a depth step, 2^-25 of the window depth, moves the view depth z by 2^-25 z^2 (f - n) / (f n),
+				// and the position along the ray by distance / z times that. The float rounding of the window depth
+				// and of the inverse projection near the far plane are as large as the quantization
+				const float z = -position.z;
+				const float halfStepError = ldexpf(1.0f, -25) * z * (farPlane - nearPlane) / (farPlane * nearPlane) * distance + 1e-6f * distance;
+				outsideBound += error > 4.0f * halfStepError ? 1 : 0;
+				maxSteps = std::max(maxSteps, error / halfStepError);
+			}
+			os << " " << distance << ": " << maxRelative * 100.0f;
+		}
+		os << ", up to " << maxSteps << " times the half depth step error";
+		Engine::Tests::TestSuite::report(os.str());
+		CHECK(outsideBound == 0);
+	}
+}
@@ -0,0 +1,86 @@
+#include "TestSuite.h"
+#include "TestMeshes.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "MeshCache.h"
+#include "vegetation/FractalTree.h"
+
+namespace
+{
+	const char CACHE_FILE[] = "meshcache_test.bin";
+
+	std::unique_ptr<Engine::Mesh> generateTree()
+	{
+		Engine::Tests::registerTreeShapes();
+		Engine::FractalTree tree(Engine::Tests::createTreeSpecies(1)[0]);
+		return std::unique_ptr<Engine::Mesh>(tree.generateCPU());
+	}
+}
+
+// A written mesh reads back unchanged, and only with the hash it was written with
+TEST_CASE(meshCacheRoundTrip)
+{
+	std::unique_ptr<Engine::Mesh> tree = generateTree();
+	const unsigned long long paramHash = Engine::MeshCache::hashMesh(*tree);
+	CHECK(Engine::MeshCache::writeMesh(CACHE_FILE, *tree, paramHash));
+
+	Engine::MeshCache::Entry entry;
+	CHECK(!Engine::MeshCache::readMesh(CACHE_FILE, paramHash + 1, entry));
+	CHECK(Engine::MeshCache::readMesh(CACHE_FILE, paramHash, entry));
+	if (entry.mesh != nullptr)
+	{
+		CHECK(Engine::MeshCache::hashMesh(*entry.mesh) == paramHash);
+		CHECK(entry.mesh->getVertexFormat().isInterleaved() == tree->getVertexFormat().isInterleaved());
+		delete entry.mesh;
+	}
+
+	// Files written by another version of the cache are rejected
+	FILE * file = fopen(CACHE_FILE, "r+b");
+	CHECK(file != nullptr);
+	if (file != nullptr)
+	{
+		Engine::MeshCache::Header header;
+		CHECK(fread(&header, sizeof(header), 1, file) == 1);
+		header.version = Engine::MeshCache::VERSION - 1;
+		fseek(file, 0, SEEK_SET);
+		fwrite(&header, sizeof(header), 1, file);
+		fclose(file);
+		CHECK(!Engine::MeshCache::readMesh(CACHE_FILE, paramHash, entry));
+	}
+
+	remove(CACHE_FILE);
+}
+
+// Any change on the indices or vertex streams changes the hash of a mesh
+TEST_CASE(meshCacheHashMesh)
+{
+	std::unique_ptr<Engine::Mesh> tree = generateTree();
+	const unsigned long long h = Engine::MeshCache::hashMesh(*tree);
+	CHECK(Engine::MeshCache::hashMesh(Engine::Mesh(*tree)) == h);
+
+	const unsigned int numFaces = tree->getNumFaces();
+	const unsigned int numVertices = tree->getNumVertices();
+	std::vector<unsigned int> faces(tree->getFaces(), tree->getFaces() + numFaces * 3);
+	std::vector<float> vertices(tree->getVertices(), tree->getVertices() + numVertices * 3);
+	std::vector<float> uvs(tree->getUVs(), tree->getUVs() + numVertices * 2);
+
+	Engine::Mesh base(numFaces, numVertices, faces.data(), vertices.data(), 0, 0, uvs.data(), 0, 0, false);
+	const unsigned long long baseHash = Engine::MeshCache::hashMesh(base);
+
+	const float original = vertices[numVertices * 3 / 2];
+	vertices[numVertices * 3 / 2] += 0.001f;
+	CHECK(Engine::MeshCache::hashMesh(Engine::Mesh(numFaces, numVertices, faces.data(), vertices.data(), 0, 0, uvs.data(), 0, 0, false)) != baseHash);
+	vertices[numVertices * 3 / 2] = original;
+
+	std::swap(faces[0], faces[1]);
+	CHECK(Engine::MeshCache::hashMesh(Engine::Mesh(numFaces, numVertices, faces.data(), vertices.data(), 0, 0, uvs.data(), 0, 0, false)) != baseHash);
+	std::swap(faces[0], faces[1]);
+
+	// Dropping a stream
+	CHECK(Engine::MeshCache::hashMesh(Engine::Mesh(numFaces, numVertices, faces.data(), vertices.data(), 0, 0, 0, 0, 0, false)) != baseHash);
+	CHECK(Engine::MeshCache::hashMesh(Engine::Mesh(numFaces, numVertices, faces.data(), vertices.data(), 0, 0, uvs.data(), 0, 0, false)) == baseHash);
+}
@@ -0,0 +1,227 @@
+#include "TestSuite.h"
+#include "TestMeshes.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+
+namespace
+{
+	typedef std::array<unsigned int, 3> Face;
+
+	// Faces of the index buffer, each one starting on its smallest index (keeping the winding), sorted
+	std::vector<Face> getFaces(const std::vector<unsigned int> & indices)
+	{
+		std::vector<Face> faces;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			const unsigned int * f = indices.data() + i;
+			const unsigned int first = unsigned(std::min_element(f, f + 3) - f);
+			faces.push_back({ f[first], f[(first + 1) % 3], f[(first + 2) % 3] });
+		}
+		std::sort(faces.begin(), faces.end());
+		return faces;
+	}
+
+	typedef std::array<float, 9> Triangle;
+
+	// Triangles as vertex positions, each one starting on its smallest corner (keeping the winding), sorted
+	std::vector<Triangle> getTriangles(const std::vector<unsigned int> & indices, const float * positions)
+	{
+		std::vector<Triangle> triangles;
+		for (const Face & f : getFaces(indices))
+		{
+			std::array<std::array<float, 3>, 3> corners;
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				corners[c] = { positions[f[c] * 3], positions[f[c] * 3 + 1], positions[f[c] * 3 + 2] };
+			}
+			const unsigned int first = unsigned(std::min_element(corners.begin(), corners.end()) - corners.begin());
+			Triangle t;
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				std::copy(corners[(first + c) % 3].begin(), corners[(first + c) % 3].end(), t.begin() + c * 3);
+			}
+			triangles.push_back(t);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	float acmr(const std::vector<unsigned int> & indices, size_t numVertices)
+	{
+		return Engine::MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), numVertices).acmr;
+	}
+
+	bool near(float a, float b)
+	{
+		return fabsf(a - b) < 1e-6f;
+	}
+}
+
+// Statistics of hand-computed index sequences on the FIFO cache
+TEST_CASE(meshOptimizerCacheStatistics)
+{
+	using Engine::MeshOptimizer::analyzeVertexCache;
+
+	// A single triangle transforms its 3 vertices
+	const unsigned int single[] = { 0, 1, 2 };
+	Engine::MeshOptimizer::VertexCacheStatistics stats = analyzeVertexCache(single, 3, 3);
+	CHECK(stats.verticesTransformed == 3);
+	CHECK(near(stats.acmr, 3.0f));
+	CHECK(near(stats.atvr, 1.0f));
+
+	// Two triangles sharing an edge: 4 vertices for 2 triangles
+	const unsigned int quad[] = { 0, 1, 2, 2, 1, 3 };
+	stats = analyzeVertexCache(quad, 6, 4);
+	CHECK(stats.verticesTransformed == 4);
+	CHECK(near(stats.acmr, 2.0f));
+	CHECK(near(stats.atvr, 1.0f));
+
+	// With 3 entries, the second triangle pushes the first one out, which has to be transformed again
+	const unsigned int evicted[] = { 0, 1, 2, 3, 4, 5, 0, 1, 2 };
+	stats = analyzeVertexCache(evicted, 9, 6, 3);
+	CHECK(stats.verticesTransformed == 9);
+	CHECK(near(stats.acmr, 3.0f));
+	CHECK(near(stats.atvr, 1.5f));
+	// 6 entries keep all of them
+	stats = analyzeVertexCache(evicted, 9, 6, 6);
+	CHECK(stats.verticesTransformed == 6);
+	CHECK(near(stats.acmr, 2.0f));
+	CHECK(near(stats.atvr, 1.0f));
+
+	// FIFO, not LRU: hits do not refresh the entries. Vertex 3 evicts 0, which is transformed again
+	// evicting 1, while 2 and 3 are still cached
+	const unsigned int fan[] = { 0, 1, 2, 0, 1, 3, 0, 2, 3 };
+	stats = analyzeVertexCache(fan, 9, 4, 3);
+	CHECK(stats.verticesTransformed == 5);
+	CHECK(near(stats.acmr, 5.0f / 3.0f));
+	CHECK(near(stats.atvr, 5.0f / 4.0f));
+
+	// Unused vertices do not count on the ATVR, and an empty buffer has no ratios
+	stats = analyzeVertexCache(quad, 6, 100);
+	CHECK(near(stats.atvr, 1.0f));
+	stats = analyzeVertexCache(quad, 0, 4);
+	CHECK(stats.verticesTransformed == 0);
+	CHECK(stats.acmr == 0.0f);
+	CHECK(stats.atvr == 0.0f);
+}
+
+// The cache and overdraw passes keep the same triangles with their winding. The cache pass never raises the
+// ACMR, the overdraw pass stays within its threshold, and Mesh::optimize never ends worse than its input,
+// neither on the already optimized tree order nor on shuffled triangles
+TEST_CASE(meshOptimizerKeepsTriangles)
+{
+	std::unique_ptr<Engine::Mesh> forest(Engine::Tests::createForest(4));
+	const size_t numVertices = forest->getNumVertices();
+	std::vector<unsigned int> generated(forest->getFaces(), forest->getFaces() + size_t(forest->getNumFaces()) * 3);
+
+	// Same triangles in random order, each one starting on a random corner
+	std::default_random_engine engine(83);
+	std::vector<Face> faces;
+	for (size_t i = 0; i < generated.size(); i += 3)
+	{
+		const unsigned int first = engine() % 3;
+		faces.push_back({ generated[i + first], generated[i + (first + 1) % 3], generated[i + (first + 2) % 3] });
+	}
+	std::shuffle(faces.begin(), faces.end(), engine);
+	std::vector<unsigned int> shuffled;
+	for (const Face & f : faces)
+	{
+		shuffled.insert(shuffled.end(), f.begin(), f.end());
+	}
+
+	const std::vector<Face> reference = getFaces(generated);
+	const std::vector<Triangle> referenceTriangles = getTriangles(generated, forest->getVertices());
+	std::ostringstream os;
+	os << std::fixed << std::setprecision(3) << forest->getNumFaces() << " triangles, ACMR input -> cache -> overdraw (optimize)";
+	for (std::vector<unsigned int> * input : { &generated, &shuffled })
+	{
+		std::vector<unsigned int> indices = *input;
+		const float inputAcmr = acmr(indices, numVertices);
+
+		Engine::MeshOptimizer::optimizeVertexCache(indices.data(), indices.size(), numVertices);
+		const float cacheAcmr = acmr(indices, numVertices);
+		CHECK(getFaces(indices) == reference);
+		CHECK(cacheAcmr <= inputAcmr);
+
+		Engine::MeshOptimizer::optimizeOverdraw(indices.data(), indices.size(), forest->getVertices(), numVertices);
+		const float overdrawAcmr = acmr(indices, numVertices);
+		CHECK(getFaces(indices) == reference);
+		CHECK(overdrawAcmr <= cacheAcmr * 1.05f);
+
+		// Mesh::optimize also reorders the vertices, so triangles are compared by position
+		Engine::Mesh mesh(unsigned(input->size() / 3), unsigned(numVertices), input->data(), forest->getVertices(), 0, 0, forest->getUVs(), 0, 0, false);
+		mesh.optimize(true);
+		const std::vector<unsigned int> optimized(mesh.getFaces(), mesh.getFaces() + input->size());
+		const float optimizedAcmr = acmr(optimized, numVertices);
+		CHECK(getTriangles(optimized, mesh.getVertices()) == referenceTriangles);
+		CHECK(optimizedAcmr <= inputAcmr);
+
+		os << (input == &generated ? ", generated " : ", shuffled ") << inputAcmr << " -> " << cacheAcmr << " -> " << overdrawAcmr << " (" << optimizedAcmr << ")";
+		if (input == &shuffled)
+		{
+			CHECK(optimizedAcmr < inputAcmr * 0.5f);
+		}
+	}
+	Engine::Tests::TestSuite::report(os.str());
+}
+
+// The vertex fetch remap is a permutation which numbers the vertices by first use, unused ones last
+TEST_CASE(meshOptimizerVertexRemap)
+{
+	// Vertices 1 and 6 are not used
+	const std::vector<unsigned int> indices = { 4, 2, 0, 0, 2, 5, 7, 4, 5, 3, 7, 5 };
+	const size_t numVertices = 8;
+	std::vector<unsigned int> remap(numVertices);
+	Engine::MeshOptimizer::computeVertexFetchRemap(remap.data(), indices.data(), indices.size(), numVertices);
+
+	std::vector<unsigned int> sorted = remap;
+	std::sort(sorted.begin(), sorted.end());
+	for (unsigned int v = 0; v < numVertices; v++)
+	{
+		CHECK(sorted[v] == v);
+	}
+
+	CHECK(remap[4] == 0);
+	CHECK(remap[2] == 1);
+	CHECK(remap[0] == 2);
+	CHECK(remap[5] == 3);
+	CHECK(remap[7] == 4);
+	CHECK(remap[3] == 5);
+	CHECK(remap[1] >= 6 && remap[6] >= 6);
+
+	// On a forest, the remapped index buffer reads every used vertex in increasing order
+	std::unique_ptr<Engine::Mesh> forest(Engine::Tests::createForest(2));
+	const size_t forestIndices = size_t(forest->getNumFaces()) * 3;
+	std::vector<unsigned int> forestRemap(forest->getNumVertices());
+	Engine::MeshOptimizer::computeVertexFetchRemap(forestRemap.data(), forest->getFaces(), forestIndices, forest->getNumVertices());
+
+	std::vector<bool> seen(forest->getNumVertices(), false);
+	size_t duplicates = 0, outOfOrder = 0;
+	unsigned int next = 0;
+	for (unsigned int v : forestRemap)
+	{
+		duplicates += (v >= seen.size() || seen[v]) ? 1 : 0;
+		if (v < seen.size())
+		{
+			seen[v] = true;
+		}
+	}
+	for (size_t i = 0; i < forestIndices; i++)
+	{
+		const unsigned int v = forestRemap[forest->getFaces()[i]];
+		outOfOrder += v > next ? 1 : 0;
+		next = std::max(next, v + 1);
+	}
+	CHECK(duplicates == 0);
+	CHECK(outOfOrder == 0);
+}
@@ -0,0 +1,261 @@
+#include "TestSuite.h"
+#include "TestMeshes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "MeshSimplifier.h"
+#include "vegetation/FractalTree.h"
+
+namespace
+{
+	typedef struct TriangleMesh
+	{
+		std::vector<float> positions;
+		std::vector<unsigned int> indices;
+	} TriangleMesh;
+
+	// Closed UV sphere of radius 1
+	TriangleMesh createSphere(unsigned int rings, unsigned int segments)
+	{
+		TriangleMesh mesh;
+		mesh.positions.insert(mesh.positions.end(), { 0.0f, 1.0f, 0.0f });
+		for (unsigned int r = 1; r < rings; r++)
+		{
+			const float phi = 3.14159265f * float(r) / float(rings);
+			for (unsigned int s = 0; s < segments; s++)
+			{
+				const float theta = 2.0f * 3.14159265f * float(s) / float(segments);
+				mesh.positions.insert(mesh.positions.end(), { sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta) });
+			}
+		}
+		mesh.positions.insert(mesh.positions.end(), { 0.0f, -1.0f, 0.0f });
+
+		// Vertex s of ring r (1 to rings - 1), the poles are the first and the last vertex
+		auto vertex = [segments](unsigned int r, unsigned int s) { return 1 + (r - 1) * segments + s % segments; };
+		const unsigned int bottom = 1 + (rings - 1) * segments;
+		for (unsigned int s = 0; s < segments; s++)
+		{
+			mesh.indices.insert(mesh.indices.end(), { 0, vertex(1, s + 1), vertex(1, s) });
+			for (unsigned int r = 1; r < rings - 1; r++)
+			{
+				mesh.indices.insert(mesh.indices.end(), { vertex(r, s), vertex(r, s + 1), vertex(r + 1, s), vertex(r, s + 1), vertex(r + 1, s + 1), vertex(r + 1, s) });
+			}
+			mesh.indices.insert(mesh.indices.end(), { vertex(rings - 1, s), vertex(rings - 1, s + 1), bottom });
+		}
+		return mesh;
+	}
+
+	// Flat square grid on the XZ plane, with an open border
+	TriangleMesh createGrid(unsigned int size)
+	{
+		TriangleMesh mesh;
+		for (unsigned int z = 0; z <= size; z++)
+		{
+			for (unsigned int x = 0; x <= size; x++)
+			{
+				mesh.positions.insert(mesh.positions.end(), { float(x), 0.0f, float(z) });
+			}
+		}
+		for (unsigned int z = 0; z < size; z++)
+		{
+			for (unsigned int x = 0; x < size; x++)
+			{
+				const unsigned int a = z * (size + 1) + x;
+				mesh.indices.insert(mesh.indices.end(), { a, a + size + 1, a + 1, a + 1, a + size + 1, a + size + 2 });
+			}
+		}
+		return mesh;
+	}
+
+	glm::vec3 getPosition(const float * positions, unsigned int index)
+	{
+		return glm::vec3(positions[index * 3], positions[index * 3 + 1], positions[index * 3 + 2]);
+	}
+
+	// Distance from p to the triangle abc (closest point by Voronoi regions)
+	float pointTriangleDistance(const glm::vec3 & p, const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c)
+	{
+		const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+		const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f) return glm::length(p - a);
+
+		const glm::vec3 bp = p - b;
+		const float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3) return glm::length(p - b);
+
+		const glm::vec3 cp = p - c;
+		const float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6) return glm::length(p - c);
+
+		const float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+
+		const float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+
+		const float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+
+		const float denom = 1.0f / (va + vb + vc);
+		return glm::length(p - (a + ab * (vb * denom) + ac * (vc * denom)));
+	}
+
+	// One sided Hausdorff distance from the original surface (its vertices and face centroids) to the
+	// simplified one, brute force, relative to the largest side of the bounding box
+	float relativeHausdorff(const float * positions, size_t numVertices, const unsigned int * original, size_t numOriginal,
+		const unsigned int * simplified, size_t numSimplified)
+	{
+		glm::vec3 boundsMin = getPosition(positions, 0), boundsMax = boundsMin;
+		for (unsigned int v = 1; v < numVertices; v++)
+		{
+			boundsMin = glm::min(boundsMin, getPosition(positions, v));
+			boundsMax = glm::max(boundsMax, getPosition(positions, v));
+		}
+		const glm::vec3 size = boundsMax - boundsMin;
+
+		std::vector<glm::vec3> samples;
+		for (size_t i = 0; i < numOriginal; i += 3)
+		{
+			const glm::vec3 a = getPosition(positions, original[i]);
+			const glm::vec3 b = getPosition(positions, original[i + 1]);
+			const glm::vec3 c = getPosition(positions, original[i + 2]);
+			samples.insert(samples.end(), { a, b, c, (a + b + c) / 3.0f });
+		}
+
+		float maxDistance = 0.0f;
+		for (const glm::vec3 & p : samples)
+		{
+			float distance = 1e30f;
+			for (size_t i = 0; i < numSimplified && distance > maxDistance; i += 3)
+			{
+				distance = std::min(distance, pointTriangleDistance(p, getPosition(positions, simplified[i]), getPosition(positions, simplified[i + 1]),
+					getPosition(positions, simplified[i + 2])));
+			}
+			maxDistance = std::max(maxDistance, distance);
+		}
+		return maxDistance / std::max(std::max(size.x, size.y), size.z);
+	}
+
+	float surfaceArea(const float * positions, const unsigned int * indices, size_t numIndices)
+	{
+		float area = 0.0f;
+		for (size_t i = 0; i < numIndices; i += 3)
+		{
+			const glm::vec3 a = getPosition(positions, indices[i]);
+			area += 0.5f * glm::length(glm::cross(getPosition(positions, indices[i + 1]) - a, getPosition(positions, indices[i + 2]) - a));
+		}
+		return area;
+	}
+}
+
+// Without an error limit the target triangle count is reached, and the reported error grows with the reduction
+TEST_CASE(meshSimplifierReduction)
+{
+	const TriangleMesh sphere = createSphere(32, 64);
+	const size_t numVertices = sphere.positions.size() / 3;
+	std::vector<unsigned int> destination(sphere.indices.size());
+
+	float previousError = 0.0f;
+	for (float ratio : { 0.5f, 0.25f, 0.1f })
+	{
+		const size_t target = size_t(float(sphere.indices.size() / 3) * ratio) * 3;
+		float error = 0.0f;
+		const size_t result = Engine::MeshSimplifier::simplify(destination.data(), sphere.indices.data(), sphere.indices.size(), sphere.positions.data(),
+			numVertices, target, 1.0f, &error);
+
+		CHECK(result % 3 == 0);
+		CHECK(result <= target);
+		// Every pass stops as soon as the target is reached, so it is not undershot by much
+		CHECK(result >= target * 9 / 10);
+		CHECK(error >= previousError);
+		previousError = error;
+
+		for (size_t i = 0; i < result; i++)
+		{
+			CHECK(destination[i] < numVertices);
+		}
+	}
+
+	// Nothing to do
+	CHECK(Engine::MeshSimplifier::simplify(destination.data(), sphere.indices.data(), sphere.indices.size(), sphere.positions.data(), numVertices,
+		sphere.indices.size(), 1.0f) == sphere.indices.size());
+}
+
+// The reported error never exceeds the limit, and a zero limit only removes the vertices which do not change the surface
+TEST_CASE(meshSimplifierErrorLimit)
+{
+	const TriangleMesh sphere = createSphere(32, 64);
+	const size_t numVertices = sphere.positions.size() / 3;
+	std::vector<unsigned int> destination(sphere.indices.size());
+
+	for (float maxError : { 0.001f, 0.01f, 0.03f })
+	{
+		float error = 0.0f;
+		const size_t result = Engine::MeshSimplifier::simplify(destination.data(), sphere.indices.data(), sphere.indices.size(), sphere.positions.data(),
+			numVertices, 0, maxError, &error);
+		CHECK(error <= maxError);
+		CHECK(result < sphere.indices.size());
+
+		std::ostringstream os;
+		os << std::setprecision(3) << "sphere, max error " << maxError << ": " << result / 3 << " of " << sphere.indices.size() / 3 << " triangles, error "
+			<< error << ", hausdorff " << relativeHausdorff(sphere.positions.data(), numVertices, sphere.indices.data(), sphere.indices.size(), destination.data(), result);
+		Engine::Tests::TestSuite::report(os.str());
+	}
+
+	// The interior and the straight borders of a flat grid collapse for free, the covered area stays the same
+	const TriangleMesh grid = createGrid(16);
+	destination.resize(grid.indices.size());
+	float error = 1.0f;
+	const size_t result = Engine::MeshSimplifier::simplify(destination.data(), grid.indices.data(), grid.indices.size(), grid.positions.data(),
+		grid.positions.size() / 3, 0, 0.0f, &error);
+	CHECK(error == 0.0f);
+	CHECK(result < grid.indices.size() / 4);
+	CHECK_NEAR(surfaceArea(grid.positions.data(), destination.data(), result), 256.0f, 1e-3f);
+}
+
+// Tree levels of detail with the TreeComponent settings: reduction reached, reported error and measured distance
+TEST_CASE(meshSimplifierTreeLods)
+{
+	Engine::Tests::registerTreeShapes();
+	Engine::FractalTree generator(Engine::Tests::createTreeSpecies(1)[0]);
+	std::unique_ptr<Engine::Mesh> tree(generator.generateCPU());
+
+	const Engine::MeshSimplifier::LodSettings lods[] = { { 0.5f, 0.01f }, { 0.25f, 0.03f }, { 0.1f, 0.08f } };
+	for (const Engine::MeshSimplifier::LodSettings & lod : lods)
+	{
+		float error = 0.0f;
+		std::unique_ptr<Engine::Mesh> simplified(tree->simplify((unsigned int)(float(tree->getNumFaces()) * lod.triangleRatio), lod.maxError, &error));
+		CHECK(simplified != nullptr);
+		if (simplified == nullptr)
+		{
+			continue;
+		}
+
+		CHECK(error <= lod.maxError);
+		CHECK(simplified->getNumFaces() < tree->getNumFaces());
+		CHECK(simplified->getNumVertices() <= tree->getNumVertices());
+
+		// The simplified mesh keeps only the used vertices, so it is measured on its own positions
+		std::vector<float> positions(tree->getVertices(), tree->getVertices() + tree->getNumVertices() * 3);
+		positions.insert(positions.end(), simplified->getVertices(), simplified->getVertices() + simplified->getNumVertices() * 3);
+		std::vector<unsigned int> indices(simplified->getFaces(), simplified->getFaces() + simplified->getNumFaces() * 3);
+		for (unsigned int & index : indices)
+		{
+			index += tree->getNumVertices();
+		}
+
+		std::ostringstream os;
+		os << std::setprecision(3) << "tree lod " << lod.triangleRatio << " / " << lod.maxError << ": " << float(simplified->getNumFaces()) / float(tree->getNumFaces())
+			<< " of the triangles, error " << error << ", hausdorff " << relativeHausdorff(positions.data(), tree->getNumVertices(), tree->getFaces(),
+			size_t(tree->getNumFaces()) * 3, indices.data(), indices.size());
+		Engine::Tests::TestSuite::report(os.str());
+	}
+}
@@ -0,0 +1,190 @@
+#include "TestSuite.h"
+#include "TestMeshes.h"
+
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+
+#include "CustomMaths.h"
+#include "Mesh.h"
+
+namespace
+{
+	// The scalar Mesh::computeNormals before vectorizing it, kept as the reference
+	std::vector<float> referenceNormals(const Engine::Mesh & mesh)
+	{
+		const unsigned int * faces = mesh.getFaces();
+		const float * vertices = mesh.getVertices();
+		const unsigned int numVertices = mesh.getNumVertices();
+
+		std::vector<glm::vec3> perfaceNormals(numVertices, glm::vec3(0, 0, 0));
+		std::vector<float> voronoiArea(numVertices, 0.0f);
+
+		for (unsigned int i = 0; i < mesh.getNumFaces(); i++)
+		{
+			const unsigned int raw_a = faces[i * 3];
+			const unsigned int raw_b = faces[i * 3 + 1];
+			const unsigned int raw_c = faces[i * 3 + 2];
+
+			glm::vec3 A(vertices[raw_a * 3], vertices[raw_a * 3 + 1], vertices[raw_a * 3 + 2]);
+			glm::vec3 B(vertices[raw_b * 3], vertices[raw_b * 3 + 1], vertices[raw_b * 3 + 2]);
+			glm::vec3 C(vertices[raw_c * 3], vertices[raw_c * 3 + 1], vertices[raw_c * 3 + 2]);
+
+			glm::vec3 faceNormal = glm::normalize(glm::cross(B - A, C - A));
+			glm::vec3 faceAreas = Engine::voronoiTriangleAreas(A, B, C);
+
+			perfaceNormals[raw_a] += faceNormal * faceAreas.x;
+			perfaceNormals[raw_b] += faceNormal * faceAreas.y;
+			perfaceNormals[raw_c] += faceNormal * faceAreas.z;
+
+			voronoiArea[raw_a] += faceAreas.x;
+			voronoiArea[raw_b] += faceAreas.y;
+			voronoiArea[raw_c] += faceAreas.z;
+		}
+
+		std::vector<float> normals(numVertices * 3);
+		for (unsigned int i = 0; i < numVertices; i++)
+		{
+			perfaceNormals[i] /= voronoiArea[i];
+			glm::vec3 normal = glm::normalize(perfaceNormals[i]);
+			normals[i * 3] = normal.x;
+			normals[i * 3 + 1] = normal.y;
+			normals[i * 3 + 2] = normal.z;
+		}
+		return normals;
+	}
+
+	// The scalar Mesh::computeTangents before vectorizing it, kept as the reference
+	std::vector<float> referenceTangents(const Engine::Mesh & mesh)
+	{
+		const unsigned int * faces = mesh.getFaces();
+		const float * vertices = mesh.getVertices();
+		const float * uvs = mesh.getUVs();
+		const unsigned int numVertices = mesh.getNumVertices();
+
+		std::vector<glm::vec3> perFaceTangents(numVertices, glm::vec3(0, 0, 0));
+		std::vector<float> voronoiArea(numVertices, 0.0f);
+
+		for (unsigned int i = 0; i < mesh.getNumFaces(); i++)
+		{
+			const unsigned int raw_a = faces[i * 3];
+			const unsigned int raw_b = faces[i * 3 + 1];
+			const unsigned int raw_c = faces[i * 3 + 2];
+
+			glm::vec3 A(vertices[raw_a * 3], vertices[raw_a * 3 + 1], vertices[raw_a * 3 + 2]);
+			glm::vec3 B(vertices[raw_b * 3], vertices[raw_b * 3 + 1], vertices[raw_b * 3 + 2]);
+			glm::vec3 C(vertices[raw_c * 3], vertices[raw_c * 3 + 1], vertices[raw_c * 3 + 2]);
+
+			const unsigned int aStart = raw_a * 2;
+			const unsigned int bStart = raw_b * 2;
+			const unsigned int cStart = raw_c * 2;
+
+			glm::vec2 st1A(uvs[bStart] - uvs[aStart], uvs[bStart + 1] - uvs[aStart + 1]);
+			glm::vec2 st2A(uvs[cStart] - uvs[aStart], uvs[cStart + 1] - uvs[aStart + 1]);
+
+			glm::vec2 st1B(uvs[aStart] - uvs[bStart], uvs[aStart + 1] - uvs[bStart + 1]);
+			glm::vec2 st2B(uvs[cStart] - uvs[bStart], uvs[cStart + 1] - uvs[bStart + 1]);
+
+			glm::vec2 st1C(uvs[aStart] - uvs[cStart], uvs[aStart + 1] - uvs[cStart + 1]);
+			glm::vec2 st2C(uvs[bStart] - uvs[cStart], uvs[bStart + 1] - uvs[cStart + 1]);
+
+			glm::vec3 tangentA = glm::normalize(Engine::tangent(st1A, st2A, B - A, C - A));
+			glm::vec3 tangentB = glm::normalize(Engine::tangent(st1B, st2B, A - B, C - B));
+			glm::vec3 tangentC = glm::normalize(Engine::tangent(st1C, st2C, A - C, B - C));
+
+			glm::vec3 faceAreas = Engine::voronoiTriangleAreas(A, B, C);
+
+			perFaceTangents[raw_a] += tangentA * faceAreas.x;
+			perFaceTangents[raw_b] += tangentB * faceAreas.y;
+			perFaceTangents[raw_c] += tangentC * faceAreas.z;
+
+			voronoiArea[raw_a] += faceAreas.x;
+			voronoiArea[raw_b] += faceAreas.y;
+			voronoiArea[raw_c] += faceAreas.z;
+		}
+
+		std::vector<float> tangents(numVertices * 3);
+		for (unsigned int i = 0; i < numVertices; i++)
+		{
+			perFaceTangents[i] /= voronoiArea[i];
+			glm::vec3 tangent = glm::normalize(perFaceTangents[i]);
+			tangents[i * 3] = tangent.x;
+			tangents[i * 3 + 1] = tangent.y;
+			tangents[i * 3 + 2] = tangent.z;
+		}
+		return tangents;
+	}
+
+	bool sameValues(const float * values, const std::vector<float> & reference)
+	{
+		return memcmp(values, reference.data(), reference.size() * sizeof(float)) == 0;
+	}
+}
+
+// Normals and tangents match the scalar implementation bit for bit, on the serial path (one tree) and on
+// the parallel one (more than 64K faces), for any number of workers
+TEST_CASE(meshNormalsMatchReference)
+{
+	for (unsigned int numTrees : { 1u, 32u })
+	{
+		std::unique_ptr<Engine::Mesh> forest(Engine::Tests::createForest(numTrees));
+		const std::vector<float> normals = referenceNormals(*forest);
+		const std::vector<float> tangents = referenceTangents(*forest);
+		CHECK(numTrees == 1 || forest->getNumFaces() >= 65536);
+
+		for (unsigned int threads : { 1u, 3u, 8u })
+		{
+			Engine::Tests::restartPool(threads);
+			forest->computeNormals();
+			forest->computeTangents();
+			CHECK(sameValues(forest->getNormals(), normals));
+			CHECK(sameValues(forest->getTangetns(), tangents));
+		}
+	}
+
+	Engine::Tests::restartPool(0);
+}
+
+// Triangles per second of Mesh::computeNormals / computeTangents against the scalar implementation, on a
+// group of 8 trees and on a forest of more than a million triangles, which is also measured per number of workers
+BENCHMARK(meshNormalsThroughput)
+{
+	for (unsigned int numTrees : { 8u, 640u })
+	{
+		std::unique_ptr<Engine::Mesh> forest(Engine::Tests::createForest(numTrees));
+		const double numFaces = forest->getNumFaces();
+		const unsigned int rounds = numTrees > 8 ? 4 : 200;
+
+		auto measure = [&](const char * name, auto compute)
+		{
+			Engine::Tests::Stopwatch watch;
+			for (unsigned int r = 0; r < rounds; r++)
+			{
+				compute();
+			}
+			std::ostringstream os;
+			os << std::fixed << std::setprecision(1) << "  " << name << ": " << rounds * numFaces / watch.getSeconds() * 1e-6 << " Mtri/s";
+			Engine::Tests::TestSuite::report(os.str());
+		};
+
+		Engine::Tests::TestSuite::report(std::to_string(forest->getNumFaces()) + " triangles");
+		measure("scalar normals", [&]() { referenceNormals(*forest); });
+		measure("normals", [&]() { forest->computeNormals(); });
+		measure("scalar tangents", [&]() { referenceTangents(*forest); });
+		measure("tangents", [&]() { forest->computeTangents(); });
+
+		// Scaling of the parallel path with the number of workers (1 runs the serial path)
+		if (forest->getNumFaces() >= 65536)
+		{
+			for (unsigned int threads : { 1u, 2u, 4u, 8u })
+			{
+				Engine::Tests::restartPool(threads);
+				const std::string workers = std::to_string(threads) + (threads > 1 ? " workers" : " worker");
+				measure(("normals, " + workers).c_str(), [&]() { forest->computeNormals(); });
+				measure(("tangents, " + workers).c_str(), [&]() { forest->computeTangents(); });
+			}
+			Engine::Tests::restartPool(0);
+		}
+	}
+}
@@ -0,0 +1,272 @@
+#include "TestSuite.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "RenderGraph.h"
+
+namespace
+{
+	typedef Engine::RenderGraph::TargetDesc TargetDesc;
+
+	const TargetDesc HDR_TARGET = { GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_LINEAR };
+	const TargetDesc LDR_TARGET = { GL_RGBA8, GL_RGBA, GL_FLOAT, GL_LINEAR };
+	const TargetDesc DEPTH_TARGET = { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT, GL_NEAREST };
+
+	// Graph DeferredRenderer::initialize() builds for the post process chain of main.cpp
+	void buildMainChain(Engine::RenderGraph & graph)
+	{
+		std::vector<unsigned int> previousOutputs;
+		previousOutputs.push_back(graph.addTarget("Shaded color", HDR_TARGET));
+		previousOutputs.push_back(graph.addTarget("Shaded emission", HDR_TARGET));
+		previousOutputs.push_back(graph.addTarget("God rays info", LDR_TARGET));
+		std::vector<unsigned int> shadingWrites = previousOutputs;
+		shadingWrites.push_back(graph.addTarget("Shading depth", DEPTH_TARGET));
+		graph.addPass("Deferred shading", {}, shadingWrites);
+
+		const std::vector<std::pair<std::string, std::vector<TargetDesc>>> chain = {
+			{ "SSGodRayProgram", { HDR_TARGET, HDR_TARGET } },
+			{ "BloomProgram", { HDR_TARGET, HDR_TARGET } },
+			{ "SSReflectionProgram", { HDR_TARGET } },
+			{ "SSGrassProgram", { HDR_TARGET } },
+			{ "HDRToneMappingProgram", { LDR_TARGET } },
+			{ "DepthOfFieldProgram", { LDR_TARGET } } };
+		for (const auto & node : chain)
+		{
+			std::vector<unsigned int> outputs;
+			for (unsigned int i = 0; i < node.second.size(); i++)
+			{
+				outputs.push_back(graph.addTarget(node.first + " " + std::to_string(i), node.second[i]));
+			}
+			graph.addPass(node.first, previousOutputs, outputs);
+			previousOutputs = outputs;
+		}
+		graph.addPass("Screen output", previousOutputs, {});
+	}
+
+	bool sameDesc(const TargetDesc & a, const TargetDesc & b)
+	{
+		return a.gpuTextureFormat == b.gpuTextureFormat && a.inputTextureFormat == b.inputTextureFormat
+			&& a.pixelFormat == b.pixelFormat && a.filterMethod == b.filterMethod;
+	}
+
+	// Targets sharing a texture with overlapping lifetimes or a different description than the texture
+	size_t countAliasingErrors(const Engine::RenderGraph & graph)
+	{
+		const std::vector<Engine::RenderGraph::Target> & targets = graph.getTargets();
+		size_t errors = 0;
+		for (size_t a = 0; a < targets.size(); a++)
+		{
+			if (targets[a].texture < 0)
+			{
+				continue;
+			}
+			errors += sameDesc(targets[a].desc, graph.getTextureDesc(unsigned(targets[a].texture))) ? 0 : 1;
+			for (size_t b = a + 1; b < targets.size(); b++)
+			{
+				const bool overlap = targets[a].firstPass <= targets[b].lastPass && targets[b].firstPass <= targets[a].lastPass;
+				errors += (targets[a].texture == targets[b].texture && overlap) ? 1 : 0;
+			}
+		}
+		return errors;
+	}
+
+	// Most targets of one description alive on the same pass, the fewest textures they can use
+	unsigned int countPeakTargets(const Engine::RenderGraph & graph, const TargetDesc & desc)
+	{
+		unsigned int peak = 0;
+		for (unsigned int p = 0; p < graph.getPasses().size(); p++)
+		{
+			unsigned int alive = 0;
+			for (const Engine::RenderGraph::Target & target : graph.getTargets())
+			{
+				alive += (target.texture >= 0 && sameDesc(target.desc, desc) && target.firstPass <= int(p) && int(p) <= target.lastPass) ? 1 : 0;
+			}
+			peak = std::max(peak, alive);
+		}
+		return peak;
+	}
+
+	double toMegabytes(size_t bytes)
+	{
+		return double(bytes) / (1024.0 * 1024.0);
+	}
+}
+
+// The main.cpp chain gets the expected lifetimes and textures, and fits in 7 textures instead of 12
+TEST_CASE(renderGraphMainChain)
+{
+	Engine::RenderGraph graph;
+	buildMainChain(graph);
+	CHECK(graph.compile());
+
+	const std::vector<Engine::RenderGraph::Target> & targets = graph.getTargets();
+	CHECK(targets.size() == 12);
+	CHECK(graph.getPasses().size() == 8);
+	CHECK(graph.getNumTextures() == 7);
+
+	// Each target lives from the pass writing it to the next one, which reads it. The depth is only written
+	const int firstPass[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 4, 5, 6 };
+	const int lastPass[] = { 1, 1, 1, 0, 2, 2, 3, 3, 4, 5, 6, 7 };
+	// Bloom and SSGrass take the shading textures back, SSR a god rays one, HDR the god rays info one
+	const int texture[] = { 0, 1, 2, 3, 4, 5, 0, 1, 4, 0, 2, 6 };
+	size_t mismatches = 0;
+	for (unsigned int t = 0; t < targets.size() && t < 12; t++)
+	{
+		mismatches += targets[t].firstPass == firstPass[t] ? 0 : 1;
+		mismatches += targets[t].lastPass == lastPass[t] ? 0 : 1;
+		mismatches += targets[t].texture == texture[t] && graph.getTexture(t) == texture[t] ? 0 : 1;
+	}
+	CHECK(mismatches == 0);
+	CHECK(countAliasingErrors(graph) == 0);
+
+	// Only the deferred shading pass gets a depth buffer, the post process passes used to get one each
+	unsigned int shadingDepthWrites = 0, postProcessDepthWrites = 0;
+	for (unsigned int p = 0; p < graph.getPasses().size(); p++)
+	{
+		for (unsigned int t : graph.getPasses()[p].writes)
+		{
+			const unsigned int depth = Engine::RenderGraph::isDepthFormat(targets[t].desc.gpuTextureFormat) ? 1 : 0;
+			shadingDepthWrites += p == 0 ? depth : 0;
+			postProcessDepthWrites += p > 0 ? depth : 0;
+		}
+	}
+	CHECK(shadingDepthWrites == 1);
+	CHECK(postProcessDepthWrites == 0);
+
+	// Without aliasing every target gets its own texture
+	Engine::RenderGraph unaliased;
+	buildMainChain(unaliased);
+	CHECK(unaliased.compile(false));
+	CHECK(unaliased.getNumTextures() == 12);
+	CHECK(countAliasingErrors(unaliased) == 0);
+
+	// Memory reported before (one texture per target and a depth buffer per post process) and after
+	const unsigned int postProcessDepthBuffers = 6;
+	for (const std::pair<unsigned int, unsigned int> & size : { std::make_pair(1920u, 1080u), std::make_pair(3840u, 2160u) })
+	{
+		const size_t texels = size_t(size.first) * size.second;
+		const size_t aliasedBytes = graph.getMemoryUsage(size.first, size.second);
+		const size_t unaliasedBytes = graph.getMemoryUsage(size.first, size.second, false);
+		const size_t previousBytes = unaliasedBytes + postProcessDepthBuffers * texels * Engine::RenderGraph::getBytesPerTexel(GL_DEPTH_COMPONENT24);
+		CHECK(aliasedBytes == texels * 44);
+		CHECK(unaliasedBytes == texels * 80);
+		CHECK(unaliased.getMemoryUsage(size.first, size.second) == unaliasedBytes);
+
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(1) << size.first << "x" << size.second << ": " << toMegabytes(previousBytes) << " MB in "
+			<< unaliased.getNumTextures() + postProcessDepthBuffers << " textures before, " << toMegabytes(unaliasedBytes) << " MB without aliasing, "
+			<< toMegabytes(aliasedBytes) << " MB in " << graph.getNumTextures() << " textures";
+		Engine::Tests::TestSuite::report(os.str());
+	}
+}
+
+// Targets no pass uses get no texture and take no memory, the depth target included
+TEST_CASE(renderGraphUnusedTargets)
+{
+	Engine::RenderGraph graph;
+	const unsigned int color = graph.addTarget("Color", HDR_TARGET);
+	const unsigned int unusedDepth = graph.addTarget("Unused depth", DEPTH_TARGET);
+	const unsigned int unusedColor = graph.addTarget("Unused color", HDR_TARGET);
+	graph.addPass("Shading", {}, { color });
+	graph.addPass("Screen output", { color }, {});
+	CHECK(graph.compile());
+
+	CHECK(graph.getNumTextures() == 1);
+	CHECK(graph.getTexture(color) == 0);
+	CHECK(graph.getTexture(unusedDepth) < 0);
+	CHECK(graph.getTexture(unusedColor) < 0);
+	CHECK(graph.getMemoryUsage(1920, 1080) == size_t(1920 * 1080) * 8);
+	CHECK(graph.getMemoryUsage(1920, 1080, false) == size_t(1920 * 1080) * 8);
+
+	std::ostringstream os;
+	graph.dump(os);
+	CHECK(os.str().find("unused") != std::string::npos);
+}
+
+// Reading a target before it is written is reported to the caller, and no texture is assigned
+TEST_CASE(renderGraphReadBeforeWrite)
+{
+	Engine::RenderGraph graph;
+	const unsigned int first = graph.addTarget("First", HDR_TARGET);
+	const unsigned int second = graph.addTarget("Second", HDR_TARGET);
+	graph.addPass("Reads too early", { second }, { first });
+	graph.addPass("Writes", { first }, { second });
+	graph.addPass("Screen output", { second }, {});
+
+	// The error message is not part of the test output
+	std::ostringstream errors;
+	std::streambuf * previous = std::cerr.rdbuf(errors.rdbuf());
+	const bool compiled = graph.compile();
+	std::cerr.rdbuf(previous);
+
+	CHECK(!compiled);
+	CHECK(errors.str().find("Reads too early reads Second") != std::string::npos);
+	CHECK(graph.getNumTextures() == 0);
+	CHECK(graph.getTexture(first) < 0 && graph.getTexture(second) < 0);
+	CHECK(graph.getMemoryUsage(1920, 1080) == 0);
+}
+
+// Random chains: shared textures never hold targets alive on the same pass or of another description,
+// and each description uses as many textures as targets of it are alive at once
+TEST_CASE(renderGraphRandomChains)
+{
+	std::default_random_engine engine(59);
+	std::uniform_int_distribution<unsigned int> passCount(1, 12);
+	std::uniform_int_distribution<unsigned int> outputCount(1, 3);
+	std::uniform_int_distribution<unsigned int> descIndex(0, 2);
+	std::uniform_int_distribution<unsigned int> lookBack(1, 4);
+	const TargetDesc descs[] = { HDR_TARGET, LDR_TARGET, { GL_RGBA16F, GL_RGBA, GL_FLOAT, GL_NEAREST } };
+
+	size_t aliasingErrors = 0, extraTextures = 0;
+	unsigned int savedTextures = 0;
+	for (unsigned int graphIndex = 0; graphIndex < 500; graphIndex++)
+	{
+		Engine::RenderGraph graph;
+		std::vector<std::vector<unsigned int>> outputs;
+		const unsigned int passes = passCount(engine);
+		for (unsigned int p = 0; p < passes; p++)
+		{
+			// Reads outputs of a few passes back, not only the previous one
+			std::vector<unsigned int> reads;
+			for (unsigned int back = lookBack(engine); back > 0; back--)
+			{
+				if (back <= outputs.size())
+				{
+					const std::vector<unsigned int> & previous = outputs[outputs.size() - back];
+					reads.push_back(previous[engine() % previous.size()]);
+				}
+			}
+			std::sort(reads.begin(), reads.end());
+			reads.erase(std::unique(reads.begin(), reads.end()), reads.end());
+
+			std::vector<unsigned int> writes;
+			for (unsigned int o = outputCount(engine); o > 0; o--)
+			{
+				writes.push_back(graph.addTarget(std::to_string(p) + " " + std::to_string(o), descs[descIndex(engine)]));
+			}
+			graph.addPass(std::to_string(p), reads, writes);
+			outputs.push_back(writes);
+		}
+		graph.addPass("Screen output", outputs.back(), {});
+		CHECK(graph.compile());
+
+		aliasingErrors += countAliasingErrors(graph);
+		unsigned int peaks = 0;
+		for (const TargetDesc & desc : descs)
+		{
+			peaks += countPeakTargets(graph, desc);
+		}
+		extraTextures += graph.getNumTextures() - peaks;
+		savedTextures += unsigned(graph.getTargets().size()) - graph.getNumTextures();
+	}
+
+	Engine::Tests::TestSuite::report(std::to_string(savedTextures) + " textures saved over 500 graphs");
+	CHECK(aliasingErrors == 0);
+	CHECK(extraTextures == 0);
+	CHECK(savedTextures > 0);
+}
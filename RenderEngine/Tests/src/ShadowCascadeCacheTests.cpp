@@ -0,0 +1,213 @@
+#include "TestSuite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "ShadowCascadeCache.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	// CascadeShadowMaps settings with the shadow cache enabled on every level
+	void configureCache(Engine::ShadowCascadeFit & fit, Engine::ShadowCascadeCache & cache)
+	{
+		Engine::ShadowCascadeFit::Parameters params = fit.getParameters();
+		params.levels = 3;
+		params.nearDistance = 0.5f;
+		params.shadowDistance = 100.0f;
+		params.resolution = 1024;
+		params.marginTexels = 3;
+		params.depthSlack = 0.5f;
+		fit.configure(params);
+
+		Engine::ShadowCascadeCache::Parameters cacheParams;
+		cacheParams.firstLevel = 0;
+		cacheParams.interval = 0;
+		cache.configure(cacheParams);
+	}
+
+	void fitView(Engine::ShadowCascadeFit & fit, const glm::vec3 & eye)
+	{
+		const glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.5f, 1000.0f);
+		const glm::vec3 light = glm::normalize(glm::vec3(0.2f, 1.0f, 0.1f));
+		fit.fit(glm::inverse(glm::lookAt(eye, eye + glm::vec3(0.0f, -0.1f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f))), projection, light);
+	}
+
+	// Light view (x, y) of the center of a shadow map texel, rendered with the projection given through a viewport on the area
+	glm::vec2 texelCenter(const glm::mat4 & projection, const Engine::ShadowCascadeCache::Region & area, int x, int y)
+	{
+		const float ndcX = 2.0f * (float(x - area.x) + 0.5f) / float(area.width) - 1.0f;
+		const float ndcY = 2.0f * (float(y - area.y) + 0.5f) / float(area.height) - 1.0f;
+		return glm::vec2((ndcX - projection[3][0]) / projection[0][0], (ndcY - projection[3][1]) / projection[1][1]);
+	}
+
+	bool sameUpdates(const Engine::ShadowCascadeCache & cache, Engine::ShadowCascadeCache::Update a, Engine::ShadowCascadeCache::Update b, Engine::ShadowCascadeCache::Update c)
+	{
+		const std::vector<Engine::ShadowCascadeCache::Level> & levels = cache.getLevels();
+		return levels.size() == 3 && levels[0].update == a && levels[1].update == b && levels[2].update == c;
+	}
+}
+
+// Reused levels are rendered again when casters change within their volume, and only then
+TEST_CASE(shadowCacheCasterInvalidation)
+{
+	typedef Engine::ShadowCascadeCache Cache;
+	Engine::ShadowCascadeFit fit;
+	Cache cache;
+	configureCache(fit, cache);
+
+	const glm::vec3 eye(3.2f, 2.0f, -7.9f);
+	fitView(fit, eye);
+	cache.update(fit);
+	CHECK(sameUpdates(cache, Cache::UPDATE_FULL, Cache::UPDATE_FULL, Cache::UPDATE_FULL));
+	cache.update(fit);
+	CHECK(sameUpdates(cache, Cache::UPDATE_NONE, Cache::UPDATE_NONE, Cache::UPDATE_NONE));
+
+	// Casters far from every level, or below the last level (away from the light)
+	cache.invalidateBounds(glm::vec3(5000.0f, 0.0f, 5000.0f), glm::vec3(5007.0f, 3.0f, 5007.0f));
+	cache.invalidateBounds(eye + glm::vec3(-1.0f, -400.0f, -6.0f), eye + glm::vec3(1.0f, -399.0f, -4.0f));
+	cache.update(fit);
+	CHECK(sameUpdates(cache, Cache::UPDATE_NONE, Cache::UPDATE_NONE, Cache::UPDATE_NONE));
+
+	// A tile around the center of the last level, out of the first level volume
+	const glm::vec3 farCenter = fit.getCascades()[2].center;
+	cache.invalidateBounds(farCenter - glm::vec3(3.5f, 1.0f, 3.5f), farCenter + glm::vec3(3.5f, 1.0f, 3.5f));
+	cache.update(fit);
+	CHECK(cache.getLevels()[0].update == Cache::UPDATE_NONE);
+	CHECK(cache.getLevels()[2].update == Cache::UPDATE_FULL);
+
+	// Bounds are used once
+	cache.update(fit);
+	CHECK(sameUpdates(cache, Cache::UPDATE_NONE, Cache::UPDATE_NONE, Cache::UPDATE_NONE));
+
+	// A tree next to the camera, high up towards the light: inside the first level volume extruded towards the light
+	const glm::vec3 nearCenter = fit.getCascades()[0].center;
+	cache.invalidateBounds(nearCenter + glm::vec3(-0.5f, 40.0f, -0.5f), nearCenter + glm::vec3(0.5f, 45.0f, 0.5f));
+	cache.update(fit);
+	CHECK(cache.getLevels()[0].update == Cache::UPDATE_FULL);
+
+	// Scrolled levels are rendered entirely too
+	fitView(fit, eye + glm::vec3(0.3f, 0.0f, 0.2f));
+	cache.update(fit);
+	CHECK(cache.getLevels()[0].update == Cache::UPDATE_SCROLL);
+	fitView(fit, eye + glm::vec3(0.6f, 0.0f, 0.4f));
+	cache.invalidateBounds(nearCenter - glm::vec3(0.5f), nearCenter + glm::vec3(0.5f));
+	cache.update(fit);
+	CHECK(cache.getLevels()[0].update == Cache::UPDATE_FULL);
+
+	// Too many changes at once invalidate every level
+	for (size_t i = 0; i <= Cache::MAX_CHANGED_BOUNDS; i++)
+	{
+		cache.invalidateBounds(glm::vec3(5000.0f), glm::vec3(5001.0f));
+	}
+	cache.update(fit);
+	CHECK(sameUpdates(cache, Cache::UPDATE_FULL, Cache::UPDATE_FULL, Cache::UPDATE_FULL));
+}
+
+// Replays the cache updates on CPU shadow maps holding the light view position each texel was rendered at: scrolls
+// move the texels as CascadeShadowMaps::scrollShadowMap(), and regions render through their cropped projection and
+// viewport. Every texel must be rendered once, and hold the position of the fit the level is sampled with
+TEST_CASE(shadowCacheRegions)
+{
+	typedef Engine::ShadowCascadeCache Cache;
+	Engine::ShadowCascadeFit fit;
+	Cache cache;
+	configureCache(fit, cache);
+	Engine::ShadowCascadeFit::Parameters params = fit.getParameters();
+	params.resolution = 128;
+	fit.configure(params);
+	const int res = int(params.resolution);
+
+	const glm::vec2 unrendered(std::numeric_limits<float>::quiet_NaN());
+	std::vector<std::vector<glm::vec2>> maps(params.levels, std::vector<glm::vec2>(res * res, unrendered));
+	std::vector<glm::vec2> scrolled(res * res);
+	std::vector<unsigned char> renders(res * res);
+
+	std::default_random_engine engine(53);
+	std::uniform_real_distribution<float> step(-1.0f, 1.0f);
+	glm::vec3 eye(40.0f, 2.0f, -25.0f);
+	const glm::mat4 projection = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.5f, 1000.0f);
+	const glm::vec3 light = glm::normalize(glm::vec3(0.2f, 1.0f, 0.1f));
+
+	size_t badTexels = 0, overlaps = 0, scrolls = 0, reuses = 0;
+	for (unsigned int frame = 0; frame < 400; frame++)
+	{
+		// Walks and turns, faster on some frames
+		const float speed = frame % 50 < 10 ? 2.0f : 0.2f;
+		eye += glm::vec3(step(engine), 0.0f, step(engine)) * speed;
+		const float angle = float(frame) * 0.01f;
+		fit.fit(glm::inverse(glm::lookAt(eye, eye + glm::vec3(sinf(angle), -0.1f, -cosf(angle)), glm::vec3(0.0f, 1.0f, 0.0f))), projection, light);
+		cache.update(fit);
+
+		for (unsigned int l = 0; l < params.levels; l++)
+		{
+			const Cache::Level & level = cache.getLevels()[l];
+			std::vector<glm::vec2> & map = maps[l];
+			if (level.update == Cache::UPDATE_NONE)
+			{
+				reuses++;
+			}
+			else if (level.update == Cache::UPDATE_SCROLL)
+			{
+				scrolls++;
+				std::fill(scrolled.begin(), scrolled.end(), unrendered);
+				for (int y = 0; y < res; y++)
+				{
+					for (int x = 0; x < res; x++)
+					{
+						const int toX = x - level.shiftX, toY = y - level.shiftY;
+						if (toX >= 0 && toX < res && toY >= 0 && toY < res)
+						{
+							scrolled[toY * res + toX] = map[y * res + x];
+						}
+					}
+				}
+				map.swap(scrolled);
+			}
+
+			// Regions are cleared and rendered
+			std::fill(renders.begin(), renders.end(), 0);
+			const Cache::Region whole = { 0, 0, res, res };
+			// Every level uses the same light view, the crop only changes the projection
+			const glm::mat4 & levelProjection = level.cascade.projection;
+			for (const Cache::Region & region : level.regions)
+			{
+				const glm::mat4 regionProjection = Cache::getRegionCrop(region, params.resolution) * levelProjection;
+				for (int y = region.y; y < region.y + region.height; y++)
+				{
+					for (int x = region.x; x < region.x + region.width; x++)
+					{
+						renders[y * res + x]++;
+						map[y * res + x] = texelCenter(regionProjection, region, x, y);
+					}
+				}
+			}
+
+			// Light view positions are compared in texels, the centers are hundreds of texels away from the origin
+			const float texelSize = 1.0f / level.cascade.texelDensity;
+			for (int y = 0; y < res; y++)
+			{
+				for (int x = 0; x < res; x++)
+				{
+					overlaps += renders[y * res + x] > 1 ? 1 : 0;
+					const glm::vec2 offset = (map[y * res + x] - texelCenter(levelProjection, whole, x, y)) / texelSize;
+					badTexels += !(fabsf(offset.x) < 0.01f && fabsf(offset.y) < 0.01f) ? 1 : 0;
+				}
+			}
+		}
+	}
+
+	std::ostringstream os;
+	os << "400 frames, " << params.levels << " levels: " << reuses << " reused, " << scrolls << " scrolled";
+	Engine::Tests::TestSuite::report(os.str());
+	CHECK(badTexels == 0);
+	CHECK(overlaps == 0);
+	CHECK(scrolls > 100);
+	CHECK(reuses > 100);
+}
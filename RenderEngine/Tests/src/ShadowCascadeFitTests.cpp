@@ -0,0 +1,288 @@
+#include "TestSuite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "ShadowCascadeFit.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	// CascadeShadowMaps settings with the WorldConfig defaults and a 1920x1080 camera
+	Engine::ShadowCascadeFit::Parameters defaultParameters()
+	{
+		Engine::ShadowCascadeFit::Parameters params;
+		params.levels = 3;
+		params.scheme = Engine::ShadowCascadeFit::SPLIT_PRACTICAL;
+		params.lambda = 0.75f;
+		params.nearDistance = 0.5f;
+		params.shadowDistance = 100.0f;
+		params.resolution = 1024;
+		params.casterDistance = 50.0f;
+		params.marginTexels = 1;
+		params.depthSlack = 0.0f;
+		return params;
+	}
+
+	// Same projection as Camera::onWindowResize
+	glm::mat4 cameraProjection(float fovy, float aspect, float nearPlane, float farPlane)
+	{
+		glm::mat4 projection(0.0f);
+		projection[0].x = 1.0f / (tanf(glm::radians(fovy)) * aspect);
+		projection[1].y = 1.0f / tanf(glm::radians(fovy));
+		projection[2].z = -(farPlane + nearPlane) / (farPlane - nearPlane);
+		projection[2].w = -1.0f;
+		projection[3].z = -2.0f * farPlane * nearPlane / (farPlane - nearPlane);
+		return projection;
+	}
+
+	glm::mat4 randomInvView(std::default_random_engine & engine)
+	{
+		std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+		std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+		const glm::vec3 eye(position(engine), position(engine) * 0.01f, position(engine));
+		glm::vec3 forward(direction(engine), direction(engine) * 0.7f, direction(engine));
+		if (glm::length(forward) < 1e-2f)
+		{
+			forward = glm::vec3(0.0f, 0.0f, -1.0f);
+		}
+		return glm::inverse(glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+	}
+
+	glm::vec3 randomLight(std::default_random_engine & engine)
+	{
+		std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+		return glm::normalize(glm::vec3(direction(engine), 0.1f + fabsf(direction(engine)), direction(engine)));
+	}
+
+	// Corners of the view slice between nearDistance and farDistance (world space)
+	void sliceCorners(const glm::mat4 & invView, const glm::mat4 & projection, float nearDistance, float farDistance, glm::vec3 corners[8])
+	{
+		const float tanHalfX = 1.0f / projection[0][0];
+		const float tanHalfY = 1.0f / projection[1][1];
+		for (unsigned int c = 0; c < 8; c++)
+		{
+			const float distance = (c & 4) ? farDistance : nearDistance;
+			const glm::vec4 view((c & 1 ? 1.0f : -1.0f) * tanHalfX * distance, (c & 2 ? 1.0f : -1.0f) * tanHalfY * distance, -distance, 1.0f);
+			corners[c] = glm::vec3(invView * view);
+		}
+	}
+
+	// Light space center of the level (x, y) and its texel size, from its orthographic projection
+	glm::vec3 lightCenterInTexels(const Engine::ShadowCascadeFit::Cascade & cascade, unsigned int resolution)
+	{
+		const float texelSize = 2.0f / (cascade.projection[0][0] * float(resolution));
+		const float centerX = -cascade.projection[3][0] / cascade.projection[0][0];
+		const float centerY = -cascade.projection[3][1] / cascade.projection[1][1];
+		return glm::vec3(centerX / texelSize, centerY / texelSize, texelSize);
+	}
+}
+
+// Splits run from the near to the shadow distance, each scheme with its own spacing, and the practical one between both
+TEST_CASE(cascadeFitSplits)
+{
+	std::vector<float> logarithmic, linear, practical;
+	Engine::ShadowCascadeFit::computeSplits(Engine::ShadowCascadeFit::SPLIT_LOGARITHMIC, 0.75f, 4, 0.5f, 100.0f, logarithmic);
+	Engine::ShadowCascadeFit::computeSplits(Engine::ShadowCascadeFit::SPLIT_LINEAR, 0.75f, 4, 0.5f, 100.0f, linear);
+	Engine::ShadowCascadeFit::computeSplits(Engine::ShadowCascadeFit::SPLIT_PRACTICAL, 0.75f, 4, 0.5f, 100.0f, practical);
+
+	CHECK(logarithmic.size() == 5 && linear.size() == 5 && practical.size() == 5);
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		CHECK_NEAR(logarithmic[i + 1] / logarithmic[i], powf(200.0f, 0.25f), 1e-3f);
+		CHECK_NEAR(linear[i + 1] - linear[i], 99.5f / 4.0f, 1e-3f);
+		CHECK(practical[i + 1] > practical[i]);
+		CHECK(practical[i] >= logarithmic[i] - 1e-4f && practical[i] <= linear[i] + 1e-4f);
+	}
+	CHECK(practical.front() == 0.5f && practical.back() == 100.0f);
+
+	// Defaults of CascadeShadowMaps
+	Engine::ShadowCascadeFit fit;
+	fit.configure(defaultParameters());
+	const std::vector<float> & splits = fit.getSplits();
+	CHECK(splits.size() == 4);
+	CHECK_NEAR(splits[1], 10.6f, 0.05f);
+	CHECK_NEAR(splits[2], 29.5f, 0.05f);
+
+	// Level count clamped to the supported range
+	Engine::ShadowCascadeFit::Parameters params = defaultParameters();
+	params.levels = 9;
+	fit.configure(params);
+	CHECK(fit.getCascades().size() == Engine::ShadowCascadeFit::MAX_LEVELS);
+}
+
+// The closed form slice sphere holds the slice corners, and is as small as the best center found by search along the view axis
+TEST_CASE(cascadeFitSliceSphere)
+{
+	std::default_random_engine engine(41);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	float maxOutside = 0.0f, maxExcess = 0.0f;
+	for (unsigned int s = 0; s < 2000; s++)
+	{
+		const float tanHalfX = 0.2f + unit(engine) * 2.0f;
+		const float tanHalfY = 0.2f + unit(engine) * 1.5f;
+		const float nearDistance = 0.1f + unit(engine) * 50.0f;
+		const float farDistance = nearDistance * (1.01f + unit(engine) * 20.0f);
+
+		float centerDistance, radius;
+		Engine::ShadowCascadeFit::computeSliceSphere(tanHalfX, tanHalfY, nearDistance, farDistance, centerDistance, radius);
+
+		// Distance from a center on the axis to the farthest corner
+		auto farthest = [=](float center)
+		{
+			const float nearSide = nearDistance * nearDistance * (tanHalfX * tanHalfX + tanHalfY * tanHalfY);
+			const float farSide = farDistance * farDistance * (tanHalfX * tanHalfX + tanHalfY * tanHalfY);
+			return sqrtf(std::max((center - nearDistance) * (center - nearDistance) + nearSide, (center - farDistance) * (center - farDistance) + farSide));
+		};
+		maxOutside = std::max(maxOutside, (farthest(centerDistance) - radius) / radius);
+
+		// The farthest corner distance is convex along the axis
+		float low = 0.0f, high = farDistance * 2.0f;
+		for (unsigned int step = 0; step < 200; step++)
+		{
+			const float a = low + (high - low) / 3.0f, b = high - (high - low) / 3.0f;
+			if (farthest(a) < farthest(b))
+			{
+				high = b;
+			}
+			else
+			{
+				low = a;
+			}
+		}
+		maxExcess = std::max(maxExcess, (radius - farthest(0.5f * (low + high))) / radius);
+	}
+
+	std::ostringstream os;
+	os << std::setprecision(3) << "corners outside " << maxOutside << ", radius over the searched one " << maxExcess << " (relative)";
+	Engine::Tests::TestSuite::report(os.str());
+	CHECK(maxOutside < 1e-5f);
+	CHECK(maxExcess < 1e-4f);
+}
+
+// Every slice corner lies inside the clip box of its level, and the level edges stay on the light space texel grid
+TEST_CASE(cascadeFitCoverage)
+{
+	std::default_random_engine engine(43);
+	const glm::mat4 projection = cameraProjection(45.0f, 1920.0f / 1080.0f, 0.5f, 1000.0f);
+
+	float maxNdc = 0.0f, maxGridOffset = 0.0f;
+	for (unsigned int levels = 1; levels <= Engine::ShadowCascadeFit::MAX_LEVELS; levels++)
+	{
+		Engine::ShadowCascadeFit::Parameters params = defaultParameters();
+		params.levels = levels;
+		params.marginTexels = levels;
+		params.depthSlack = levels > 2 ? 0.2f : 0.0f;
+		Engine::ShadowCascadeFit fit;
+		fit.configure(params);
+
+		for (unsigned int view = 0; view < 500; view++)
+		{
+			const glm::mat4 invView = randomInvView(engine);
+			fit.fit(invView, projection, randomLight(engine));
+			for (const Engine::ShadowCascadeFit::Cascade & cascade : fit.getCascades())
+			{
+				glm::vec3 corners[8];
+				sliceCorners(invView, projection, cascade.nearDistance, cascade.farDistance, corners);
+				for (const glm::vec3 & corner : corners)
+				{
+					const glm::vec4 clip = cascade.projection * cascade.view * glm::vec4(corner, 1.0f);
+					maxNdc = std::max(maxNdc, std::max(std::max(fabsf(clip.x), fabsf(clip.y)), fabsf(clip.z)) / clip.w);
+				}
+
+				const glm::vec3 center = lightCenterInTexels(cascade, params.resolution);
+				maxGridOffset = std::max(maxGridOffset, std::max(fabsf(center.x - roundf(center.x)), fabsf(center.y - roundf(center.y))));
+				CHECK_NEAR(cascade.texelDensity * center.z, 1.0f, 1e-4f);
+			}
+		}
+	}
+
+	std::ostringstream os;
+	os << std::setprecision(4) << "max |ndc| " << maxNdc << ", max grid offset " << maxGridOffset << " texels";
+	Engine::Tests::TestSuite::report(os.str());
+	CHECK(maxNdc <= 1.0f);
+	// Float rounding of the projection terms, 500 units away from the origin. An unsnapped center is up to half a texel off
+	CHECK(maxGridOffset < 5e-2f);
+}
+
+// Turning the camera keeps the texel size of every level, and moving it shifts the maps by whole texels only
+TEST_CASE(cascadeFitStability)
+{
+	const glm::mat4 projection = cameraProjection(45.0f, 1920.0f / 1080.0f, 0.5f, 1000.0f);
+	const glm::vec3 light = glm::normalize(glm::vec3(0.3f, 0.8f, -0.5f));
+	Engine::ShadowCascadeFit fit;
+	fit.configure(defaultParameters());
+
+	const glm::vec3 eye(12.3f, 1.7f, -40.2f);
+	fit.fit(glm::inverse(glm::lookAt(eye, eye + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f))), projection, light);
+	const std::vector<Engine::ShadowCascadeFit::Cascade> reference = fit.getCascades();
+
+	float maxDensityChange = 0.0f, maxShiftOffset = 0.0f;
+	for (unsigned int step = 1; step < 360; step++)
+	{
+		const float angle = glm::radians(float(step));
+		const glm::vec3 moved = eye + glm::vec3(0.013f, 0.0f, 0.007f) * float(step);
+		fit.fit(glm::inverse(glm::lookAt(moved, moved + glm::vec3(sinf(angle), -0.2f, -cosf(angle)), glm::vec3(0.0f, 1.0f, 0.0f))), projection, light);
+
+		for (size_t level = 0; level < reference.size(); level++)
+		{
+			const Engine::ShadowCascadeFit::Cascade & cascade = fit.getCascades()[level];
+			maxDensityChange = std::max(maxDensityChange, fabsf(cascade.texelDensity - reference[level].texelDensity) / reference[level].texelDensity);
+
+			const glm::vec3 shift = lightCenterInTexels(cascade, 1024) - lightCenterInTexels(reference[level], 1024);
+			maxShiftOffset = std::max(maxShiftOffset, std::max(fabsf(shift.x - roundf(shift.x)), fabsf(shift.y - roundf(shift.y))));
+		}
+	}
+	CHECK(maxDensityChange < 1e-5f);
+	CHECK(maxShiftOffset < 5e-2f);
+}
+
+// Fit time, and texel density and memory per level for 3 and 4 levels of 1024^2
+BENCHMARK(cascadeFit)
+{
+	std::default_random_engine engine(47);
+	const glm::mat4 projection = cameraProjection(45.0f, 1920.0f / 1080.0f, 0.5f, 1000.0f);
+	std::vector<glm::mat4> views;
+	for (unsigned int v = 0; v < 256; v++)
+	{
+		views.push_back(randomInvView(engine));
+	}
+
+	for (unsigned int levels : { 3u, 4u })
+	{
+		Engine::ShadowCascadeFit::Parameters params = defaultParameters();
+		params.levels = levels;
+		Engine::ShadowCascadeFit fit;
+		fit.configure(params);
+
+		const unsigned int rounds = 200000;
+		float checksum = 0.0f;
+		Engine::Tests::Stopwatch watch;
+		for (unsigned int r = 0; r < rounds; r++)
+		{
+			fit.fit(views[r % views.size()], projection, glm::vec3(0.3f, 0.8f, -0.5f));
+			checksum += fit.getCascades()[0].center.x;
+		}
+		const double seconds = watch.getSeconds();
+
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(2) << levels << " levels: fit " << seconds / rounds * 1e6 << " us, splits";
+		for (float split : fit.getSplits())
+		{
+			os << " " << split;
+		}
+		os << ", texels per unit";
+		for (const Engine::ShadowCascadeFit::Cascade & cascade : fit.getCascades())
+		{
+			os << " " << cascade.texelDensity;
+		}
+		os << ", " << levels * params.resolution * params.resolution * 4 / (1024 * 1024) << " MB (checksum " << checksum << ")";
+		Engine::Tests::TestSuite::report(os.str());
+	}
+}
@@ -0,0 +1,203 @@
+#include "TestSuite.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TaskGraph.h"
+#include "Threadpool.h"
+
+namespace
+{
+	typedef Engine::Concurrent::TaskGraph TaskGraph;
+
+	// Order in which the stages of a graph started and finished, on a counter shared by all of them
+	struct StageLog
+	{
+		std::atomic<unsigned int> counter;
+		std::vector<unsigned int> starts;
+		std::vector<unsigned int> ends;
+		std::vector<std::thread::id> threads;
+
+		StageLog(size_t numStages) : counter(0), starts(numStages, 0), ends(numStages, 0), threads(numStages) {}
+	};
+
+	std::function<void()> loggedJob(StageLog & log, unsigned int stage)
+	{
+		return [&log, stage]()
+		{
+			log.starts[stage] = ++log.counter;
+			log.threads[stage] = std::this_thread::get_id();
+			// Long enough for the workers to overlap the stages which are allowed to
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+			log.ends[stage] = ++log.counter;
+		};
+	}
+
+	bool contains(const std::vector<std::string> & names, const std::string & name)
+	{
+		return std::find(names.begin(), names.end(), name) != names.end();
+	}
+}
+
+// Dependencies follow the declared reads and writes: read after write, write after read and write after write
+TEST_CASE(taskGraphDependencies)
+{
+	TaskGraph graph;
+	auto nothing = []() {};
+	const Engine::Concurrent::TaskAffinity any = Engine::Concurrent::AFFINITY_ANY_THREAD;
+	graph.addStage("A", {}, { "x" }, any, nothing);
+	graph.addStage("B", { "x" }, { "y" }, any, nothing);
+	graph.addStage("C", { "x" }, {}, any, nothing);
+	graph.addStage("D", {}, { "x" }, any, nothing);
+	graph.addStage("E", { "y" }, { "z" }, any, nothing);
+	graph.addStage("F", {}, { "y" }, any, nothing);
+	graph.addStage("G", { "w" }, {}, any, nothing);
+	graph.addStage("H", { "x", "z" }, { "z" }, any, nothing);
+
+	CHECK(graph.getNumStages() == 8);
+	// B and C read after A writes
+	CHECK(graph.getDependencies(0).empty());
+	CHECK(graph.getDependencies(1) == std::vector<unsigned int>({ 0 }));
+	CHECK(graph.getDependencies(2) == std::vector<unsigned int>({ 0 }));
+	// D writes after B and C read, and after A writes
+	CHECK(graph.getDependencies(3) == std::vector<unsigned int>({ 0, 1, 2 }));
+	CHECK(graph.getDependencies(4) == std::vector<unsigned int>({ 1 }));
+	// F writes after E reads and B writes, not after the readers before B
+	CHECK(graph.getDependencies(5) == std::vector<unsigned int>({ 1, 4 }));
+	// Nothing writes w
+	CHECK(graph.getDependencies(6).empty());
+	// H reads the last x (D) and reads and writes the last z (E)
+	CHECK(graph.getDependencies(7) == std::vector<unsigned int>({ 3, 4 }));
+}
+
+// Random graphs: each stage runs once per execution, after its dependencies, without overlapping any stage it
+// has a hazard with, and main thread stages run on the thread calling execute()
+TEST_CASE(taskGraphExecutionOrder)
+{
+	Engine::Tests::restartPool(4);
+	std::default_random_engine engine(71);
+	std::uniform_int_distribution<unsigned int> resource(0, 5);
+	std::uniform_int_distribution<unsigned int> count(0, 2);
+	std::uniform_int_distribution<unsigned int> stageCount(1, 24);
+	const std::thread::id mainThread = std::this_thread::get_id();
+
+	size_t runsMissing = 0, orderErrors = 0, overlaps = 0, affinityErrors = 0, concurrentStages = 0;
+	for (unsigned int g = 0; g < 60; g++)
+	{
+		const unsigned int numStages = stageCount(engine);
+		StageLog log(numStages);
+		std::vector<std::vector<std::string>> reads(numStages), writes(numStages);
+		std::vector<bool> onMainThread(numStages);
+
+		TaskGraph graph;
+		for (unsigned int s = 0; s < numStages; s++)
+		{
+			for (unsigned int r = count(engine); r > 0; r--)
+			{
+				reads[s].push_back("r" + std::to_string(resource(engine)));
+			}
+			for (unsigned int w = count(engine); w > 0; w--)
+			{
+				writes[s].push_back("r" + std::to_string(resource(engine)));
+			}
+			onMainThread[s] = engine() % 3 == 0;
+			graph.addStage("S" + std::to_string(s), reads[s], writes[s],
+				onMainThread[s] ? Engine::Concurrent::AFFINITY_MAIN_THREAD : Engine::Concurrent::AFFINITY_ANY_THREAD, loggedJob(log, s));
+		}
+
+		for (unsigned int frame = 0; frame < 3; frame++)
+		{
+			log.counter = 0;
+			std::fill(log.starts.begin(), log.starts.end(), 0);
+			std::fill(log.ends.begin(), log.ends.end(), 0);
+			graph.execute();
+
+			for (unsigned int s = 0; s < numStages; s++)
+			{
+				runsMissing += (log.starts[s] == 0 || log.ends[s] == 0) ? 1 : 0;
+				for (unsigned int dep : graph.getDependencies(s))
+				{
+					orderErrors += (dep >= s || log.ends[dep] > log.starts[s]) ? 1 : 0;
+				}
+				affinityErrors += ((log.threads[s] == mainThread) != onMainThread[s]) ? 1 : 0;
+
+				for (unsigned int t = s + 1; t < numStages; t++)
+				{
+					bool hazard = false;
+					for (const std::string & w : writes[s])
+					{
+						hazard = hazard || contains(reads[t], w) || contains(writes[t], w);
+					}
+					for (const std::string & w : writes[t])
+					{
+						hazard = hazard || contains(reads[s], w);
+					}
+					const bool overlap = log.starts[t] < log.ends[s] && log.starts[s] < log.ends[t];
+					overlaps += (hazard && overlap) ? 1 : 0;
+					concurrentStages += (!hazard && overlap) ? 1 : 0;
+				}
+			}
+		}
+	}
+
+	Engine::Tests::TestSuite::report(std::to_string(concurrentStages) + " pairs of independent stages ran concurrently");
+	CHECK(runsMissing == 0);
+	CHECK(orderErrors == 0);
+	CHECK(overlaps == 0);
+	CHECK(affinityErrors == 0);
+	CHECK(concurrentStages > 0);
+	Engine::Tests::restartPool(0);
+}
+
+// The dump marks the longest dependency chain by duration: input -> long simulation -> draw, not the short one
+TEST_CASE(taskGraphCriticalPath)
+{
+	Engine::Tests::restartPool(2);
+	auto sleepFor = [](int milliseconds)
+	{
+		return [milliseconds]() { std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds)); };
+	};
+
+	TaskGraph graph;
+	graph.addStage("Input", {}, { "camera" }, Engine::Concurrent::AFFINITY_MAIN_THREAD, sleepFor(2));
+	graph.addStage("Simulation", { "camera" }, { "instances" }, Engine::Concurrent::AFFINITY_ANY_THREAD, sleepFor(30));
+	graph.addStage("Culling", { "camera" }, { "tiles" }, Engine::Concurrent::AFFINITY_ANY_THREAD, sleepFor(2));
+	graph.addStage("Statistics", {}, { "counters" }, Engine::Concurrent::AFFINITY_ANY_THREAD, sleepFor(5));
+	graph.addStage("Draw", { "instances", "tiles" }, {}, Engine::Concurrent::AFFINITY_MAIN_THREAD, sleepFor(2));
+	graph.execute();
+
+	std::ostringstream os;
+	graph.dump(os);
+	std::vector<std::string> critical, others;
+	std::istringstream lines(os.str());
+	std::string line;
+	std::getline(lines, line);
+	const std::string header = line;
+	while (std::getline(lines, line))
+	{
+		std::istringstream fields(line.substr(3));
+		unsigned int index;
+		std::string name;
+		fields >> index >> name;
+		(line.compare(0, 3, " * ") == 0 ? critical : others).push_back(name);
+	}
+
+	CHECK(critical == std::vector<std::string>({ "Input", "Simulation", "Draw" }));
+	CHECK(others == std::vector<std::string>({ "Culling", "Statistics" }));
+	// The three stages take 34 ms, and the frame is not shorter than its critical path
+	const size_t at = header.find("critical path ");
+	CHECK(at != std::string::npos);
+	if (at != std::string::npos)
+	{
+		const long long criticalTime = std::stoll(header.substr(at + 14));
+		CHECK(criticalTime >= 34000);
+		CHECK(graph.getLastFrameTime() >= criticalTime);
+	}
+	Engine::Tests::restartPool(0);
+}
@@ -0,0 +1,234 @@
+#include "TestSuite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "TerrainHeightField.h"
+#include "WorldConfig.h"
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+namespace
+{
+	// Transcription of the terrain shader noise (terrain.teseval) with glm, kept independent from the engine code
+	float referenceLatticeValue(const glm::vec2 & lattice)
+	{
+		const glm::uvec2 q = glm::uvec2(glm::ivec2(lattice));
+		unsigned int h = (q.x * 0x8DA6B343u) ^ (q.y * 0xD8163841u);
+		h = (h ^ (h >> 16u)) * 0x7FEB352Du;
+		h = (h ^ (h >> 15u)) * 0x846CA68Bu;
+		h ^= h >> 16u;
+		return float(h >> 8u) * (1.0f / 16777216.0f);
+	}
+
+	float referenceNoiseInterpolation(const glm::vec2 & coord, float size)
+	{
+		const glm::vec2 grid = coord * size;
+		const glm::vec2 randomInput = glm::floor(grid);
+		glm::vec2 weights = glm::fract(grid);
+
+		const float p0 = referenceLatticeValue(randomInput);
+		const float p1 = referenceLatticeValue(randomInput + glm::vec2(1.0f, 0.0f));
+		const float p2 = referenceLatticeValue(randomInput + glm::vec2(0.0f, 1.0f));
+		const float p3 = referenceLatticeValue(randomInput + glm::vec2(1.0f, 1.0f));
+
+		weights = glm::smoothstep(glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 1.0f), weights);
+
+		return p0 +
+			(p1 - p0) * (weights.x) +
+			(p2 - p0) * (weights.y) * (1.0f - weights.x) +
+			(p3 - p1) * (weights.y * weights.x);
+	}
+
+	float referenceNoiseHeight(const glm::vec2 & pos, const Engine::TerrainHeightField::Parameters & params)
+	{
+		float noiseValue = 0.0f;
+		float localAplitude = params.amplitude;
+		float localFrecuency = params.frecuency;
+		for (unsigned int index = 0; index < params.octaves; index++)
+		{
+			noiseValue += referenceNoiseInterpolation(pos, params.scale * localFrecuency) * localAplitude;
+			localAplitude /= 2.0f;
+			localFrecuency *= 2.0f;
+		}
+		return noiseValue * noiseValue * noiseValue;
+	}
+
+	float referenceHeight(float x, float z, const Engine::TerrainHeightField::Parameters & params)
+	{
+		return referenceNoiseHeight(glm::abs(glm::vec2(x, z) / params.tileWidth), params) * 1.5f * params.tileWidth;
+	}
+
+	bool sameBits(float a, float b)
+	{
+		return memcmp(&a, &b, sizeof(float)) == 0;
+	}
+}
+
+// Scalar, batched (with a tail shorter than a batch) and grid evaluation match the shader transcription bit for bit
+TEST_CASE(terrainHeightFieldMatchesReference)
+{
+	const Engine::TerrainHeightField field;
+	const Engine::TerrainHeightField::Parameters & params = field.getParameters();
+
+	std::default_random_engine engine(23);
+	std::uniform_real_distribution<float> coordinate(-3000.0f, 3000.0f);
+	const size_t count = 100003;
+	std::vector<float> x(count), z(count), heights(count), noise(count), u(count), v(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		x[i] = coordinate(engine);
+		z[i] = coordinate(engine);
+		u[i] = fabsf(x[i] / params.tileWidth);
+		v[i] = fabsf(z[i] / params.tileWidth);
+	}
+	field.getHeights(x.data(), z.data(), heights.data(), count);
+	field.getNoiseHeights(u.data(), v.data(), noise.data(), count);
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const float expectedNoise = referenceNoiseHeight(glm::vec2(u[i], v[i]), params);
+		const float expected = referenceHeight(x[i], z[i], params);
+		mismatches += sameBits(field.getNoiseHeight(u[i], v[i]), expectedNoise) ? 0 : 1;
+		mismatches += sameBits(noise[i], expectedNoise) ? 0 : 1;
+		mismatches += sameBits(field.getHeight(x[i], z[i]), expected) ? 0 : 1;
+		mismatches += sameBits(heights[i], expected) ? 0 : 1;
+	}
+
+	const unsigned int columns = 257, rows = 131;
+	const float startX = -611.5f, startZ = 1033.25f, spacing = 0.37f;
+	std::vector<float> grid(columns * rows);
+	field.getHeightGrid(startX, startZ, spacing, columns, rows, grid.data());
+	for (unsigned int r = 0; r < rows; r++)
+	{
+		for (unsigned int c = 0; c < columns; c++)
+		{
+			mismatches += sameBits(grid[r * columns + c], referenceHeight(startX + float(c) * spacing, startZ + float(r) * spacing, params)) ? 0 : 1;
+		}
+	}
+	CHECK(mismatches == 0);
+}
+
+// Values pinned with the default Settings, so changes on the noise are noticed (the terrain layout and the
+// vegetation placement depend on it)
+TEST_CASE(terrainHeightFieldPinned)
+{
+	const Engine::TerrainHeightField field;
+	CHECK(field.getNoiseHeight(0.0f, 0.0f) == 0.0f);
+	CHECK_NEAR(field.getNoiseHeight(1.5f, 2.25f), 0.108007923f, 1e-8f);
+	CHECK_NEAR(field.getNoiseHeight(123.456f, 789.012f), 0.101063706f, 1e-8f);
+	CHECK_NEAR(field.getHeight(-35.0f, 70.0f), 6.23588848f, 1e-6f);
+}
+
+// Noise and tile ranges hold every height of a dense sampling of their area, and stay close to it
+TEST_CASE(terrainHeightFieldRanges)
+{
+	const Engine::TerrainHeightField field;
+	const float tileWidth = field.getParameters().tileWidth;
+	const unsigned int samples = 65;
+
+	std::default_random_engine engine(31);
+	std::uniform_real_distribution<float> coordinate(0.0f, 500.0f);
+	std::uniform_real_distribution<float> extent(0.01f, 4.0f);
+
+	size_t outside = 0;
+	double slack = 0.0;
+	for (unsigned int r = 0; r < 400; r++)
+	{
+		// Small rectangles use the lattice lines, large ones (and extent 40) the per octave fallback
+		const float u0 = coordinate(engine), v0 = coordinate(engine);
+		const float u1 = u0 + (r % 40 == 0 ? 40.0f : extent(engine)), v1 = v0 + extent(engine);
+		float minHeight, maxHeight;
+		field.getNoiseRange(u0, v0, u1, v1, minHeight, maxHeight);
+
+		float sampledMin = 1e30f, sampledMax = -1e30f;
+		for (unsigned int b = 0; b < samples; b++)
+		{
+			for (unsigned int a = 0; a < samples; a++)
+			{
+				const float height = field.getNoiseHeight(u0 + (u1 - u0) * float(a) / float(samples - 1), v0 + (v1 - v0) * float(b) / float(samples - 1));
+				sampledMin = std::min(sampledMin, height);
+				sampledMax = std::max(sampledMax, height);
+			}
+		}
+		outside += (sampledMin < minHeight || sampledMax > maxHeight) ? 1 : 0;
+		slack += double((maxHeight - minHeight) - (sampledMax - sampledMin)) / double(maxHeight - minHeight);
+	}
+
+	for (int i = -6; i < 6; i++)
+	{
+		for (int j = -6; j < 6; j++)
+		{
+			float minHeight, maxHeight;
+			field.getTileRange(i, j, minHeight, maxHeight);
+			for (unsigned int b = 0; b < samples; b++)
+			{
+				for (unsigned int a = 0; a < samples; a++)
+				{
+					const float height = field.getHeight((float(i) + float(a) / float(samples - 1)) * tileWidth, (float(j) + float(b) / float(samples - 1)) * tileWidth);
+					outside += (height < minHeight || height > maxHeight) ? 1 : 0;
+				}
+			}
+		}
+	}
+
+	std::ostringstream os;
+	os << std::setprecision(3) << "noise range " << slack / 400.0 * 100.0 << "% wider than the sampled one on average";
+	Engine::Tests::TestSuite::report(os.str());
+	CHECK(outside == 0);
+}
+
+// Samples per second of the transcription and of each entry point, with the default settings
+BENCHMARK(terrainHeightFieldSamples)
+{
+	const Engine::TerrainHeightField field;
+	const Engine::TerrainHeightField::Parameters & params = field.getParameters();
+
+	std::default_random_engine engine(29);
+	std::uniform_real_distribution<float> coordinate(-3000.0f, 3000.0f);
+	const size_t count = 1 << 20;
+	std::vector<float> x(count), z(count), heights(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		x[i] = coordinate(engine);
+		z[i] = coordinate(engine);
+	}
+
+	auto report = [count](const char * name, double seconds)
+	{
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(1) << name << ": " << count / seconds * 1e-6 << "M samples/s";
+		Engine::Tests::TestSuite::report(os.str());
+	};
+
+	Engine::Tests::TestSuite::report(std::to_string(params.octaves) + " octaves");
+
+	Engine::Tests::Stopwatch watch;
+	for (size_t i = 0; i < count; i++)
+	{
+		heights[i] = referenceHeight(x[i], z[i], params);
+	}
+	report("reference", watch.getSeconds());
+
+	watch.reset();
+	for (size_t i = 0; i < count; i++)
+	{
+		heights[i] = field.getHeight(x[i], z[i]);
+	}
+	report("scalar", watch.getSeconds());
+
+	watch.reset();
+	field.getHeights(x.data(), z.data(), heights.data(), count);
+	report("batched", watch.getSeconds());
+
+	watch.reset();
+	field.getHeightGrid(-512.0f, -512.0f, 1.0f, 1024, 1024, heights.data());
+	report("grid", watch.getSeconds());
+}
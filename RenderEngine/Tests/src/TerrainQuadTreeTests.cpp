@@ -0,0 +1,239 @@
+#include "TestSuite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "TerrainQuadTree.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	typedef Engine::TerrainQuadTree::Node Node;
+
+	// Random settings within the ones the engine uses (see Terrain::selectQuadTreeNodes)
+	Engine::TerrainQuadTree::Parameters randomParameters(std::default_random_engine & engine)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const float radii[] = { 6.0f, 12.0f, 24.0f, 48.0f, 96.0f, 192.0f };
+
+		Engine::TerrainQuadTree::Parameters params;
+		params.leafSize = 1.0f;
+		params.gridResolution = Engine::TerrainQuadTree::GRID_RESOLUTION;
+		params.pixelError = 1.0f + unit(engine) * 7.0f;
+		params.viewportHeight = 720.0f + unit(engine) * 1440.0f;
+		params.projectionScale = 1.0f / tanf(glm::radians(25.0f + unit(engine) * 20.0f));
+		params.viewDistance = radii[std::min(5u, unsigned(unit(engine) * 6.0f))];
+		params.minHeight = 0.0f;
+		params.maxHeight = unit(engine) * 2.0f;
+		params.morphRatio = 0.2f + unit(engine) * 0.2f;
+		params.maxLevels = 12;
+		return params;
+	}
+
+	glm::vec3 randomCamera(std::default_random_engine & engine, const Engine::TerrainQuadTree::Parameters & params)
+	{
+		std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+		std::uniform_real_distribution<float> height(0.0f, 1.0f);
+		return glm::vec3(position(engine), params.minHeight + height(engine) * (params.maxHeight - params.minHeight + 2.0f), position(engine));
+	}
+
+	// Distance from the camera to the point of the terrain at (x, z) closest to it over the height range
+	float minDistance(const glm::vec3 & camera, float x, float z, const Engine::TerrainQuadTree::Parameters & params)
+	{
+		const float y = std::min(std::max(camera.y, params.minHeight), params.maxHeight);
+		return glm::length(glm::vec3(x, y, z) - camera);
+	}
+
+	size_t countContaining(const std::vector<Node> & nodes, float x, float z)
+	{
+		size_t count = 0;
+		for (const Node & node : nodes)
+		{
+			count += (x >= node.x && x < node.x + node.size && z >= node.z && z < node.z + node.size) ? 1 : 0;
+		}
+		return count;
+	}
+}
+
+// Every point within the view distance is drawn by exactly one node
+TEST_CASE(quadTreeCoverage)
+{
+	std::default_random_engine engine(13);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	Engine::TerrainQuadTree quadTree;
+	std::vector<Node> nodes;
+
+	size_t uncovered = 0, overlapped = 0;
+	for (unsigned int config = 0; config < 300; config++)
+	{
+		const Engine::TerrainQuadTree::Parameters params = randomParameters(engine);
+		quadTree.configure(params);
+		const glm::vec3 camera = randomCamera(engine, params);
+		nodes.clear();
+		quadTree.select(camera, nullptr, 0, nodes);
+
+		// Horizontal radius within which the terrain is in view distance at any height
+		const float above = camera.y > params.maxHeight ? camera.y - params.maxHeight : 0.0f;
+		const float radius = sqrtf(params.viewDistance * params.viewDistance - above * above);
+		for (unsigned int s = 0; s < 500; s++)
+		{
+			const float angle = unit(engine) * 6.2831853f;
+			const float distance = sqrtf(unit(engine)) * radius * 0.999f;
+			const size_t count = countContaining(nodes, camera.x + cosf(angle) * distance, camera.z + sinf(angle) * distance);
+			uncovered += count == 0 ? 1 : 0;
+			overlapped += count > 1 ? 1 : 0;
+		}
+	}
+	CHECK(uncovered == 0);
+	CHECK(overlapped == 0);
+}
+
+// Nodes sharing an edge differ by one level at most, and on the finer side of a level change the edge
+// vertices have finished morphing into the coarser grid, so both sides meet on the same vertices
+TEST_CASE(quadTreeNeighbourLevels)
+{
+	std::default_random_engine engine(17);
+	Engine::TerrainQuadTree quadTree;
+	std::vector<Node> nodes;
+
+	size_t sharedEdges = 0, levelJumps = 0, unmorphed = 0;
+	for (unsigned int config = 0; config < 300; config++)
+	{
+		const Engine::TerrainQuadTree::Parameters params = randomParameters(engine);
+		quadTree.configure(params);
+		const glm::vec3 camera = randomCamera(engine, params);
+		nodes.clear();
+		quadTree.select(camera, nullptr, 0, nodes);
+
+		for (size_t a = 0; a < nodes.size(); a++)
+		{
+			for (size_t b = 0; b < nodes.size(); b++)
+			{
+				const Node & na = nodes[a];
+				const Node & nb = nodes[b];
+				const float spacingA = na.size / float(na.gridResolution);
+				const float spacingB = nb.size / float(nb.gridResolution);
+
+				// Shared vertical (x) or horizontal (z) edge of positive length, visited once from the finer side
+				const bool sharedX = na.x + na.size == nb.x;
+				const bool sharedZ = na.z + na.size == nb.z;
+				const float start = sharedX ? std::max(na.z, nb.z) : std::max(na.x, nb.x);
+				const float end = sharedX ? std::min(na.z + na.size, nb.z + nb.size) : std::min(na.x + na.size, nb.x + nb.size);
+				if (!(sharedX && start < end) && !(sharedZ && start < end))
+				{
+					continue;
+				}
+				sharedEdges++;
+
+				const float ratio = spacingA > spacingB ? spacingA / spacingB : spacingB / spacingA;
+				levelJumps += (ratio != 1.0f && ratio != 2.0f) ? 1 : 0;
+				if (ratio == 1.0f)
+				{
+					continue;
+				}
+
+				// Every vertex of the finer node on the edge must be fully morphed
+				const Node & fine = spacingA < spacingB ? na : nb;
+				const float spacing = std::min(spacingA, spacingB);
+				const float edge = sharedX ? nb.x : nb.z;
+				for (float t = start; t <= end; t += spacing)
+				{
+					const float distance = sharedX ? minDistance(camera, edge, t, params) : minDistance(camera, t, edge, params);
+					unmorphed += distance < fine.morphEnd - 1e-4f * fine.morphEnd ? 1 : 0;
+				}
+			}
+		}
+	}
+	Engine::Tests::TestSuite::report(std::to_string(sharedEdges) + " shared edges checked");
+	CHECK(sharedEdges > 1000);
+	CHECK(levelJumps == 0);
+	CHECK(unmorphed == 0);
+}
+
+// Frustum culling only drops nodes outside the frustum, and keeps the rest of the selection as it is
+TEST_CASE(quadTreeFrustumCulling)
+{
+	std::default_random_engine engine(19);
+	std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+	Engine::TerrainQuadTree quadTree;
+	std::vector<Node> all, visible;
+
+	size_t missing = 0, wronglyCulled = 0, totalCulled = 0;
+	for (unsigned int config = 0; config < 300; config++)
+	{
+		const Engine::TerrainQuadTree::Parameters params = randomParameters(engine);
+		quadTree.configure(params);
+		const glm::vec3 camera = randomCamera(engine, params);
+		const glm::vec3 forward(direction(engine), direction(engine) * 0.3f - 0.2f, direction(engine));
+		const Engine::Frustum frustum(glm::perspective(2.0f * atanf(1.0f / params.projectionScale), 16.0f / 9.0f, 0.01f, params.viewDistance)
+			* glm::lookAt(camera, camera + forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+		all.clear();
+		visible.clear();
+		quadTree.select(camera, nullptr, 0, all);
+		totalCulled += quadTree.select(camera, &frustum, 1, visible);
+
+		auto sameNode = [](const Node & a, const Node & b)
+		{
+			return a.x == b.x && a.z == b.z && a.size == b.size && a.level == b.level && a.gridResolution == b.gridResolution;
+		};
+		for (const Node & node : visible)
+		{
+			missing += std::none_of(all.begin(), all.end(), [&](const Node & n) { return sameNode(n, node); }) ? 1 : 0;
+		}
+		for (const Node & node : all)
+		{
+			const bool kept = std::any_of(visible.begin(), visible.end(), [&](const Node & n) { return sameNode(n, node); });
+			const bool inside = frustum.intersects(glm::vec3(node.x, params.minHeight, node.z), glm::vec3(node.x + node.size, params.maxHeight, node.z + node.size));
+			wronglyCulled += (!kept && inside) ? 1 : 0;
+		}
+	}
+	CHECK(missing == 0);
+	CHECK(wronglyCulled == 0);
+	CHECK(totalCulled > 0);
+}
+
+// Nodes drawn and selection time per view radius, against the (2r)^2 tiles of the grid path
+BENCHMARK(quadTreeSelection)
+{
+	Engine::TerrainQuadTree quadTree;
+	Engine::TerrainQuadTree::Parameters params = quadTree.getParameters();
+	params.pixelError = 4.0f;
+	params.viewportHeight = 1080.0f;
+	params.projectionScale = 1.0f / tanf(glm::radians(35.0f));
+	params.maxHeight = 1.0f;
+
+	std::vector<Node> nodes;
+	for (float radius : { 6.0f, 12.0f, 24.0f, 48.0f, 96.0f, 192.0f })
+	{
+		params.viewDistance = radius;
+		quadTree.configure(params);
+
+		const glm::vec3 camera(0.37f, 0.8f, -0.61f);
+		const Engine::Frustum frustum(glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.01f, radius)
+			* glm::lookAt(camera, camera + glm::vec3(1.0f, -0.1f, 0.3f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+		nodes.clear();
+		quadTree.select(camera, nullptr, 0, nodes);
+		const size_t allNodes = nodes.size();
+
+		const unsigned int rounds = 1000;
+		Engine::Tests::Stopwatch watch;
+		for (unsigned int r = 0; r < rounds; r++)
+		{
+			nodes.clear();
+			quadTree.select(camera, &frustum, 1, nodes);
+		}
+		const double seconds = watch.getSeconds();
+
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(2) << "radius " << radius << ": " << unsigned(4.0f * radius * radius) << " tiles, " << allNodes
+			<< " nodes, " << nodes.size() << " after frustum culling, selection " << seconds / rounds * 1e6 << " us";
+		Engine::Tests::TestSuite::report(os.str());
+	}
+}
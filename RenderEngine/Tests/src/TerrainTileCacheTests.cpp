@@ -0,0 +1,270 @@
+#include "TestSuite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "TerrainTileCache.h"
+#include "Threadpool.h"
+
+namespace
+{
+	// Same steps as the cache and terrain.frag computeNormal()
+	const float NORMAL_STEP = 0.01f;
+	const float NORMAL_HEIGHT_SCALE = 0.01f;
+
+	Engine::TerrainTileCache::Parameters createParameters(unsigned int resolution, unsigned int slots)
+	{
+		Engine::TerrainTileCache::Parameters params;
+		params.resolution = resolution;
+		params.memoryBudget = Engine::TerrainTileCache::getTileBytes(resolution) * slots;
+		params.prefetchTime = 1.5f;
+		params.maxPrefetchDistance = 6.0f;
+		params.maxPendingTiles = 64;
+		return params;
+	}
+
+	// Acquires the tiles drawn around the camera (same range as TerrainTileCache::update), returns the misses
+	unsigned int drawTiles(Engine::TerrainTileCache & cache, const glm::vec2 & cameraTile, unsigned int radius)
+	{
+		const int x = (int)floorf(cameraTile.x);
+		const int y = (int)floorf(cameraTile.y);
+		const int r = int(radius);
+		unsigned int misses = 0;
+		for (int i = x - r; i < x + r; i++)
+		{
+			for (int j = y - r; j < y + r; j++)
+			{
+				misses += cache.acquire(i, j) < 0 ? 1 : 0;
+			}
+		}
+		return misses;
+	}
+
+	// Visible tiles which were not ready when drawn, with the tiles taking one frame to be generated
+	unsigned int countMovingMisses(float speed, bool prefetch)
+	{
+		const unsigned int radius = 4;
+		Engine::TerrainTileCache cache(createParameters(9, 256), Engine::TerrainHeightField::getSettingsParameters());
+		const glm::vec2 velocity(speed, speed * 0.5f);
+		const float frameTime = 1.0f / 60.0f;
+
+		unsigned int misses = 0;
+		for (unsigned long long frame = 0; frame < 600; frame++)
+		{
+			const glm::vec2 cameraTile = velocity * (float(frame) * frameTime);
+			cache.update(frame, cameraTile, prefetch ? velocity : glm::vec2(0.0f), radius);
+			const unsigned int frameMisses = drawTiles(cache, cameraTile, radius);
+			// The first frame is a cold fill
+			misses += frame > 0 ? frameMisses : 0;
+			cache.flush();
+		}
+		return misses;
+	}
+}
+
+// Generated heights match the height field bit for bit, normals the terrain.frag formula, and neighbour tiles share their borders
+TEST_CASE(tileCacheMatchesHeightField)
+{
+	const unsigned int res = 17;
+	const Engine::TerrainHeightField::Parameters heightParams = Engine::TerrainHeightField::getSettingsParameters();
+	const Engine::TerrainHeightField field(heightParams);
+	Engine::TerrainTileCache cache(createParameters(res, 16), heightParams);
+
+	cache.update(0, glm::vec2(0.0f), glm::vec2(0.0f), 1);
+	cache.flush();
+
+	size_t heightMismatches = 0, borderMismatches = 0;
+	float maxNormalError = 0.0f;
+	for (int i = -1; i < 1; i++)
+	{
+		for (int j = -1; j < 1; j++)
+		{
+			const int slot = cache.acquire(i, j);
+			CHECK(slot >= 0);
+			if (slot < 0)
+			{
+				continue;
+			}
+
+			const float * heights = cache.getSlotHeights(unsigned(slot));
+			const signed char * normals = cache.getSlotNormals(unsigned(slot));
+			for (unsigned int b = 0; b < res; b++)
+			{
+				for (unsigned int a = 0; a < res; a++)
+				{
+					const float u = fabsf(float(i) + float(a) / float(res - 1));
+					const float v = fabsf(float(j) + float(b) / float(res - 1));
+					heightMismatches += heights[b * res + a] == field.getNoiseHeight(u, v) ? 0 : 1;
+
+					const glm::vec3 expected = glm::normalize(glm::vec3(
+						field.getNoiseHeight(u - NORMAL_STEP, v) * NORMAL_HEIGHT_SCALE - field.getNoiseHeight(u + NORMAL_STEP, v) * NORMAL_HEIGHT_SCALE,
+						NORMAL_STEP * NORMAL_STEP,
+						field.getNoiseHeight(u, v - NORMAL_STEP) * NORMAL_HEIGHT_SCALE - field.getNoiseHeight(u, v + NORMAL_STEP) * NORMAL_HEIGHT_SCALE));
+					const signed char * texel = normals + (b * res + a) * 4;
+					const glm::vec3 normal(float(texel[0]) / 127.0f, float(texel[1]) / 127.0f, float(texel[2]) / 127.0f);
+					maxNormalError = std::max(maxNormalError, glm::length(normal - expected));
+				}
+			}
+
+			// Last column of (i, j) against the first column of (i + 1, j)
+			const int right = cache.acquire(i + 1, j);
+			if (i + 1 < 1 && right >= 0)
+			{
+				const float * rightHeights = cache.getSlotHeights(unsigned(right));
+				const signed char * rightNormals = cache.getSlotNormals(unsigned(right));
+				for (unsigned int b = 0; b < res; b++)
+				{
+					borderMismatches += heights[b * res + res - 1] == rightHeights[b * res] ? 0 : 1;
+					for (unsigned int c = 0; c < 4; c++)
+					{
+						borderMismatches += normals[(b * res + res - 1) * 4 + c] == rightNormals[b * res * 4 + c] ? 0 : 1;
+					}
+				}
+			}
+		}
+	}
+
+	std::ostringstream os;
+	os << std::setprecision(3) << "max normal error " << maxNormalError;
+	Engine::Tests::TestSuite::report(os.str());
+	CHECK(heightMismatches == 0);
+	CHECK(borderMismatches == 0);
+	// Quantization to signed bytes, 0.5 / 127 per component
+	CHECK(maxNormalError < 0.007f);
+}
+
+// With room for a few more tiles than the view, only the tiles not drawn on the last two frames are evicted
+TEST_CASE(tileCacheEviction)
+{
+	const unsigned int radius = 3;
+	Engine::TerrainTileCache cache(createParameters(9, 40), Engine::TerrainHeightField::getSettingsParameters());
+	CHECK(cache.getNumSlots() == 40);
+
+	std::vector<std::pair<int, int>> previous, current;
+	size_t lostVisible = 0;
+	for (unsigned long long frame = 0; frame < 300; frame++)
+	{
+		const glm::vec2 cameraTile(float(frame) * 0.1f, float(frame) * 0.03f);
+		cache.update(frame, cameraTile, glm::vec2(0.0f), radius);
+		cache.flush();
+
+		// Every tile drawn on the previous frame is still resident
+		for (const std::pair<int, int> & tile : previous)
+		{
+			lostVisible += cache.acquire(tile.first, tile.second) < 0 ? 1 : 0;
+		}
+
+		current.clear();
+		const int x = (int)floorf(cameraTile.x);
+		const int y = (int)floorf(cameraTile.y);
+		for (int i = x - int(radius); i < x + int(radius); i++)
+		{
+			for (int j = y - int(radius); j < y + int(radius); j++)
+			{
+				if (cache.acquire(i, j) >= 0)
+				{
+					current.push_back(std::make_pair(i, j));
+				}
+			}
+		}
+		previous.swap(current);
+	}
+
+	const Engine::TerrainTileCache::Statistics & stats = cache.getStatistics();
+	CHECK(lostVisible == 0);
+	CHECK(stats.evictedTiles > 0);
+	CHECK(stats.residentTiles <= 40);
+	CHECK(stats.memoryUsed <= stats.memoryBudget);
+}
+
+// A budget smaller than the view stalls the requests instead of evicting visible tiles
+TEST_CASE(tileCacheBudgetStall)
+{
+	const unsigned int radius = 3;
+	Engine::TerrainTileCache cache(createParameters(9, 30), Engine::TerrainHeightField::getSettingsParameters());
+
+	for (unsigned long long frame = 0; frame < 10; frame++)
+	{
+		cache.update(frame, glm::vec2(0.5f), glm::vec2(0.0f), radius);
+		cache.flush();
+		drawTiles(cache, glm::vec2(0.5f), radius);
+	}
+
+	const Engine::TerrainTileCache::Statistics & stats = cache.getStatistics();
+	CHECK(stats.residentTiles == 30);
+	CHECK(stats.evictedTiles == 0);
+	CHECK(stats.budgetStalls > 0);
+}
+
+// Changing the height field drops every tile, the ones being generated included
+TEST_CASE(tileCacheHeightParameters)
+{
+	Engine::TerrainHeightField::Parameters heightParams = Engine::TerrainHeightField::getSettingsParameters();
+	Engine::TerrainTileCache cache(createParameters(9, 16), heightParams);
+
+	cache.update(0, glm::vec2(0.0f), glm::vec2(0.0f), 1);
+	cache.flush();
+	CHECK(cache.acquire(0, 0) >= 0);
+
+	// Same settings, nothing changes
+	cache.setHeightParameters(heightParams);
+	CHECK(cache.acquire(0, 0) >= 0);
+
+	cache.update(1, glm::vec2(5.0f), glm::vec2(0.0f), 1);
+	heightParams.amplitude *= 2.0f;
+	cache.setHeightParameters(heightParams);
+	CHECK(cache.acquire(0, 0) < 0);
+	cache.flush();
+	CHECK(cache.getNewTiles().empty());
+	CHECK(cache.acquire(5, 5) < 0);
+	CHECK(cache.getStatistics().residentTiles == 0);
+
+	// Every slot is available again
+	cache.update(2, glm::vec2(0.0f), glm::vec2(0.0f), 2);
+	cache.flush();
+	CHECK(cache.getStatistics().residentTiles == 16);
+
+	const Engine::TerrainHeightField field(heightParams);
+	const int slot = cache.acquire(0, 0);
+	CHECK(slot >= 0 && cache.getSlotHeights(unsigned(slot))[0] == field.getNoiseHeight(0.0f, 0.0f));
+}
+
+// Prefetching ahead of a moving camera hides the generation latency
+TEST_CASE(tileCachePrefetch)
+{
+	for (float speed : { 4.0f, 8.0f })
+	{
+		const unsigned int withoutPrefetch = countMovingMisses(speed, false);
+		const unsigned int withPrefetch = countMovingMisses(speed, true);
+
+		std::ostringstream os;
+		os << speed << " tiles/s: " << withoutPrefetch << " visible misses without prefetch, " << withPrefetch << " with prefetch";
+		Engine::Tests::TestSuite::report(os.str());
+		CHECK(withoutPrefetch > 0);
+		CHECK(withPrefetch < withoutPrefetch / 4);
+	}
+}
+
+// Cold fill of the 24x24 terrain window with the LandscapeComponent settings
+BENCHMARK(tileCacheFill)
+{
+	Engine::TerrainTileCache::Parameters params = createParameters(65, 1);
+	params.memoryBudget = 32 * 1024 * 1024;
+	params.maxPendingTiles = 1024;
+	Engine::TerrainTileCache cache(params, Engine::TerrainHeightField::getSettingsParameters());
+
+	Engine::Tests::Stopwatch watch;
+	cache.update(0, glm::vec2(0.0f), glm::vec2(0.0f), 12);
+	cache.flush();
+	const double seconds = watch.getSeconds();
+
+	const Engine::TerrainTileCache::Statistics & stats = cache.getStatistics();
+	std::ostringstream os;
+	os << std::fixed << std::setprecision(1) << stats.generatedTiles << " tiles in " << seconds << " s, "
+		<< double(stats.generatedTiles) / seconds / double(Engine::Concurrent::ThreadPool::getInstance().getPoolSize()) << " tiles/s per thread, "
+		<< double(stats.memoryUsed) / (1024.0 * 1024.0) << " MB";
+	Engine::Tests::TestSuite::report(os.str());
+}
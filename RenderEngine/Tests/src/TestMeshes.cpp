@@ -0,0 +1,90 @@
+#include "TestMeshes.h"
+
+#include "datatables/MeshTable.h"
+#include "defaultobjects/TreeShapes.h"
+#include "vegetation/FractalTree.h"
+
+#include <memory>
+#include <random>
+#include <string>
+
+void Engine::Tests::registerTreeShapes()
+{
+	static bool registered = false;
+	if (registered)
+	{
+		return;
+	}
+
+	Engine::MeshTable::getInstance().addMeshToCache("trunk", new Engine::Mesh(10, 8, Engine::TrunkData::triangleIndex, Engine::TrunkData::vertexPos, 0, 0, Engine::TrunkData::texCoord, 0, 0, false));
+	Engine::MeshTable::getInstance().addMeshToCache("leaf", new Engine::Mesh(2, 3, Engine::LeafData::triangleIndex, Engine::LeafData::vertexPos, 0, 0, 0, 0, 0, false));
+	registered = true;
+}
+
+std::vector<Engine::TreeGenerationData> Engine::Tests::createTreeSpecies(unsigned int count)
+{
+	std::uniform_int_distribution<unsigned int> d(0, 50000);
+	std::default_random_engine e(0);
+
+	std::uniform_real_distribution<float> leafColor(0.0f, 1.0f);
+	std::default_random_engine eLeaf(d(e) * d(e));
+
+	std::uniform_real_distribution<float> trunkColor(0.0f, 1.0f);
+	std::default_random_engine eTrunk(d(e) * d(e));
+
+	std::vector<Engine::TreeGenerationData> species;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Engine::TreeGenerationData treeData;
+		treeData.treeName = std::string("Tree_") + std::to_string(i);
+		treeData.emissiveLeaf = leafColor(eLeaf) > 0.8f;
+		treeData.startTrunkColor = trunkColor(eTrunk) >= 0.5f ? glm::vec3(0.2f, 0.2f, 0.0f) : glm::vec3(0.65f, 0.65f, 0.65f);
+		treeData.endTrunkColor = treeData.startTrunkColor;
+		treeData.leafStartColor = glm::vec3(1.0 - leafColor(eLeaf), 1.0 - leafColor(eLeaf), 1.0 - leafColor(eLeaf)) * 0.5f;
+		treeData.leafEndColor = treeData.leafStartColor;
+		treeData.maxBranchesSplit = 4;
+		float rotFactor = leafColor(eLeaf) * 0.7f + 0.3f;
+		treeData.maxBranchRotation = glm::vec3(45.0f, 10.0f, 10.0f) * rotFactor;
+		treeData.minBranchRotation = glm::vec3(-45.0f, -10.0f, -10.0f) * rotFactor;
+		treeData.maxDepth = 7;
+		treeData.depthStartingLeaf = 6;
+		treeData.rotateMainTrunk = false;
+		treeData.scalingFactor = (glm::vec3(0.75, 1.0, 0.75) + glm::vec3(0.0f, (1.0f - rotFactor) * 0.25f, 0.0f));
+		treeData.seed = d(e);
+		treeData.startBranchingDepth = 2;
+		treeData.parallelSplitDepth = 4;
+
+		species.push_back(treeData);
+	}
+
+	return species;
+}
+
+Engine::Mesh * Engine::Tests::createForest(unsigned int numTrees)
+{
+	registerTreeShapes();
+
+	std::vector<unsigned int> faces;
+	std::vector<float> vertices;
+	std::vector<float> uvs;
+	float offset = 0.0f;
+	for (const TreeGenerationData & data : createTreeSpecies(numTrees))
+	{
+		FractalTree generator(data);
+		std::unique_ptr<Mesh> tree(generator.generateCPU());
+
+		const unsigned int firstVertex = unsigned(vertices.size() / 3);
+		for (unsigned int v = 0; v < tree->getNumVertices() * 3; v++)
+		{
+			vertices.push_back(tree->getVertices()[v] + (v % 3 == 0 ? offset : 0.0f));
+		}
+		offset += 10.0f;
+		uvs.insert(uvs.end(), tree->getUVs(), tree->getUVs() + tree->getNumVertices() * 2);
+		for (unsigned int i = 0; i < tree->getNumFaces() * 3; i++)
+		{
+			faces.push_back(tree->getFaces()[i] + firstVertex);
+		}
+	}
+
+	return new Mesh(unsigned(faces.size() / 3), unsigned(vertices.size() / 3), faces.data(), vertices.data(), 0, 0, uvs.data(), 0, 0, false);
+}
@@ -0,0 +1,75 @@
+#include "TestSuite.h"
+
+#include <iostream>
+
+#include "Threadpool.h"
+
+unsigned int Engine::Tests::TestSuite::failedChecks = 0;
+
+std::vector<Engine::Tests::TestCase> & Engine::Tests::TestSuite::getCases()
+{
+	// Built on first use, cases register themselves during static initialization
+	static std::vector<Engine::Tests::TestCase> cases;
+	return cases;
+}
+
+bool Engine::Tests::TestSuite::add(const char * name, Engine::Tests::TestFunction function, bool benchmark)
+{
+	getCases().push_back({ name, function, benchmark });
+	return true;
+}
+
+int Engine::Tests::TestSuite::run(bool benchmarks, const std::string & filter)
+{
+	int failedCases = 0;
+	unsigned int runCases = 0;
+	for (const Engine::Tests::TestCase & testCase : getCases())
+	{
+		if ((testCase.benchmark && !benchmarks) || std::string(testCase.name).find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		std::cout << "[ RUN  ] " << testCase.name << std::endl;
+		failedChecks = 0;
+		Engine::Tests::Stopwatch watch;
+		testCase.function();
+		const double ms = watch.getSeconds() * 1000.0;
+		runCases++;
+
+		if (failedChecks > 0)
+		{
+			std::cout << "[ FAIL ] " << testCase.name << " (" << failedChecks << " failed checks)" << std::endl;
+			failedCases++;
+		}
+		else
+		{
+			std::cout << "[  OK  ] " << testCase.name << " (" << ms << " ms)" << std::endl;
+		}
+	}
+
+	std::cout << runCases << " case(s) run, " << failedCases << " failed" << std::endl;
+	return failedCases;
+}
+
+void Engine::Tests::TestSuite::fail(const char * file, int line, const std::string & message)
+{
+	// Only the first failures of a case are printed, checks inside loops could flood the output
+	if (failedChecks < 10)
+	{
+		std::cout << "  " << file << ":" << line << ": check failed: " << message << std::endl;
+	}
+	failedChecks++;
+}
+
+void Engine::Tests::TestSuite::report(const std::string & message)
+{
+	std::cout << "  " << message << std::endl;
+}
+
+void Engine::Tests::restartPool(unsigned int numThreads)
+{
+	Engine::Concurrent::ThreadPool & pool = Engine::Concurrent::ThreadPool::getInstance();
+	pool.shutDown();
+	pool.init(numThreads);
+}
@@ -0,0 +1,287 @@
+#include "TestSuite.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+
+#include "Threadpool.h"
+
+namespace
+{
+	// The previous thread pool (single locked queue of heap allocated tasks), kept as the benchmark baseline
+	class Runnable
+	{
+	public:
+		virtual ~Runnable() {}
+		virtual void run() = 0;
+	};
+
+	class LockedQueuePool
+	{
+	private:
+		std::vector<std::thread> pool;
+		std::queue<std::unique_ptr<Runnable>> tasks;
+		std::mutex globalLock;
+		std::condition_variable monitor;
+		bool active;
+	public:
+		LockedQueuePool(unsigned int numThreads)
+			:active(true)
+		{
+			for (unsigned int i = 0; i < numThreads; i++)
+			{
+				pool.push_back(std::thread(&LockedQueuePool::pollTask, this));
+			}
+		}
+
+		~LockedQueuePool()
+		{
+			std::unique_lock<std::mutex> lock(globalLock);
+			active = false;
+			monitor.notify_all();
+			lock.unlock();
+			for (auto & thread : pool)
+			{
+				thread.join();
+			}
+		}
+
+		void addTask(std::unique_ptr<Runnable> task)
+		{
+			std::unique_lock<std::mutex> lock(globalLock);
+			tasks.push(std::move(task));
+			lock.unlock();
+			monitor.notify_one();
+		}
+	private:
+		void pollTask()
+		{
+			std::unique_lock<std::mutex> lock(globalLock);
+			while (true)
+			{
+				while (tasks.empty() && active)
+				{
+					monitor.wait(lock);
+				}
+				if (tasks.empty())
+				{
+					return;
+				}
+
+				std::unique_ptr<Runnable> task = std::move(tasks.front());
+				tasks.pop();
+				lock.unlock();
+				task->run();
+				lock.lock();
+			}
+		}
+	};
+
+	typedef std::chrono::high_resolution_clock Clock;
+
+	// A benchmark task: a little work, and the delay between its submission and its start
+	typedef struct TaskSample
+	{
+		Clock::time_point submitted;
+		double latency;
+	} TaskSample;
+
+	void runSample(TaskSample * sample, std::atomic<unsigned int> * done)
+	{
+		sample->latency = std::chrono::duration<double>(Clock::now() - sample->submitted).count();
+		volatile unsigned int x = 1;
+		for (unsigned int i = 0; i < 256; i++)
+		{
+			x = x * 1664525u + 1013904223u;
+		}
+		done->fetch_add(1, std::memory_order_release);
+	}
+
+	class SampleRunnable : public Runnable
+	{
+	private:
+		TaskSample * sample;
+		std::atomic<unsigned int> * done;
+	public:
+		SampleRunnable(TaskSample * s, std::atomic<unsigned int> * d) : sample(s), done(d) {}
+		void run() { runSample(sample, done); }
+	};
+
+	void waitFor(const std::atomic<unsigned int> & done, unsigned int count)
+	{
+		while (done.load(std::memory_order_acquire) < count)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// Submits numTasks tasks in bursts of burstSize, waiting for each burst. Returns the tasks per second,
+	// and the submission to start latencies (microseconds) through latencies
+	template<class Submit>
+	double runBursts(unsigned int numTasks, unsigned int burstSize, Submit submit, std::vector<double> & latencies)
+	{
+		std::vector<TaskSample> samples(numTasks);
+		std::atomic<unsigned int> done(0);
+
+		Engine::Tests::Stopwatch watch;
+		for (unsigned int first = 0; first < numTasks; first += burstSize)
+		{
+			const unsigned int last = std::min(numTasks, first + burstSize);
+			for (unsigned int i = first; i < last; i++)
+			{
+				samples[i].submitted = Clock::now();
+				submit(&samples[i], &done);
+			}
+			waitFor(done, last);
+		}
+		const double seconds = watch.getSeconds();
+
+		latencies.clear();
+		for (const TaskSample & sample : samples)
+		{
+			latencies.push_back(sample.latency * 1e6);
+		}
+		std::sort(latencies.begin(), latencies.end());
+		return numTasks / seconds;
+	}
+
+	std::string formatResult(const std::string & name, double tasksPerSecond, const std::vector<double> & latencies)
+	{
+		const size_t n = latencies.size();
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(1) << name << ": " << unsigned(tasksPerSecond) << " tasks/s, latency p50 "
+			<< latencies[n / 2] << " us, p99 " << latencies[n * 99 / 100] << " us, max " << latencies[n - 1] << " us";
+		return os.str();
+	}
+}
+
+TEST_CASE(threadPoolParallelFor)
+{
+	std::vector<unsigned char> visits(100003, 0);
+	Engine::Concurrent::parallelFor(0, visits.size(), 64, [&visits](size_t i)
+	{
+		visits[i]++;
+	});
+
+	CHECK(std::count(visits.begin(), visits.end(), 1) == std::ptrdiff_t(visits.size()));
+}
+
+TEST_CASE(threadPoolParallelReduce)
+{
+	// Exact integer sum
+	const size_t n = 1000000;
+	unsigned long long sum = Engine::Concurrent::parallelReduce(0, n, 1000, 0ull, [](size_t begin, size_t end)
+	{
+		unsigned long long s = 0;
+		for (size_t i = begin; i < end; i++)
+		{
+			s += i;
+		}
+		return s;
+	}, [](unsigned long long a, unsigned long long b) { return a + b; });
+	CHECK(sum == (unsigned long long)n * (n - 1) / 2);
+
+	// Float sums are combined in range order, so they do not depend on the number of workers
+	auto harmonic = []()
+	{
+		return Engine::Concurrent::parallelReduce(0, 200000, 777, 0.0f, [](size_t begin, size_t end)
+		{
+			float s = 0.0f;
+			for (size_t i = begin; i < end; i++)
+			{
+				s += 1.0f / float(i + 1);
+			}
+			return s;
+		}, [](float a, float b) { return a + b; });
+	};
+
+	Engine::Tests::restartPool(1);
+	const float oneWorker = harmonic();
+	Engine::Tests::restartPool(4);
+	const float fourWorkers = harmonic();
+	Engine::Tests::restartPool(0);
+	CHECK(oneWorker == fourWorkers);
+}
+
+TEST_CASE(threadPoolFutures)
+{
+	Engine::Concurrent::ThreadPool & pool = Engine::Concurrent::ThreadPool::getInstance();
+
+	Engine::Concurrent::Future<int> answer = pool.submit([]() { return 41; });
+	Engine::Concurrent::Future<int> next = answer.then([](Engine::Concurrent::Future<int> & previous) { return previous.get() + 1; });
+	CHECK(next.get() == 42);
+
+	Engine::Concurrent::Future<void> failing = pool.submit([]() { throw std::runtime_error("task failed"); });
+	bool rethrown = false;
+	try
+	{
+		failing.get();
+	}
+	catch (const std::runtime_error &)
+	{
+		rethrown = true;
+	}
+	CHECK(rethrown);
+
+	// Nested waits from inside the workers must not deadlock
+	std::vector<Engine::Concurrent::Future<size_t>> outer;
+	for (size_t i = 0; i < 64; i++)
+	{
+		outer.push_back(pool.submit([&pool, i]()
+		{
+			Engine::Concurrent::Future<size_t> inner = pool.submit([i]() { return i * 2; });
+			return inner.get() + 1;
+		}));
+	}
+	size_t total = 0;
+	for (auto & f : outer)
+	{
+		total += f.get();
+	}
+	CHECK(total == 64 * 63 + 64);
+}
+
+// Throughput and dispatch latency of small tasks, against the previous single queue pool, from 1 to
+// hardware_concurrency workers. Bursts of 1024 tasks measure the queues under load, bursts of one task
+// per worker measure the wake up latency
+BENCHMARK(threadPoolThroughput)
+{
+	const unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<unsigned int> threadCounts;
+	for (unsigned int threads = 1; threads < maxThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	std::vector<double> latencies;
+	for (unsigned int threads : threadCounts)
+	{
+		Engine::Tests::TestSuite::report(std::to_string(threads) + " worker(s)");
+		for (unsigned int burst : { 1024u, threads })
+		{
+			const unsigned int numTasks = burst > threads ? 200000 : 20000 * threads;
+			const std::string burstName = "  burst " + std::to_string(burst) + ", ";
+
+			Engine::Tests::restartPool(threads);
+			Engine::Concurrent::ThreadPool & pool = Engine::Concurrent::ThreadPool::getInstance();
+			double rate = runBursts(numTasks, burst, [&pool](TaskSample * sample, std::atomic<unsigned int> * done)
+			{
+				pool.execute([sample, done]() { runSample(sample, done); });
+			}, latencies);
+			Engine::Tests::TestSuite::report(formatResult(burstName + "work stealing", rate, latencies));
+
+			LockedQueuePool lockedPool(threads);
+			rate = runBursts(numTasks, burst, [&lockedPool](TaskSample * sample, std::atomic<unsigned int> * done)
+			{
+				lockedPool.addTask(std::unique_ptr<Runnable>(new SampleRunnable(sample, done)));
+			}, latencies);
+			Engine::Tests::TestSuite::report(formatResult(burstName + "locked queue", rate, latencies));
+		}
+	}
+
+	Engine::Tests::restartPool(0);
+}
@@ -0,0 +1,185 @@
+#include "TestSuite.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "VegetationInstanceStore.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	typedef Engine::VegetationInstanceStore Store;
+
+	// One instance per tile, at the tile position and with the placement seed as type. Tiles wait for the
+	// gate to open, so they stay pending as long as the test needs
+	struct GatedGenerator
+	{
+		std::atomic<bool> open;
+		std::atomic<unsigned int> calls;
+
+		GatedGenerator() : open(true), calls(0) {}
+
+		Store::Generator get()
+		{
+			return [this](const Engine::VegetationPlacement & placement, int i, int j, std::vector<Store::Instance> & instances)
+			{
+				while (!open.load())
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+				calls++;
+
+				Store::Instance instance;
+				instance.modelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(float(i), 0.0f, float(j)));
+				instance.placement = glm::vec4(float(i), 0.0f, float(j), 1.0f);
+				instance.type = placement.getParameters().seed;
+				instances.push_back(instance);
+			};
+		}
+	};
+
+	std::vector<long long> sortedChanges(const Store & store)
+	{
+		std::vector<long long> tiles;
+		for (const glm::ivec2 & tile : store.getChangedTiles())
+		{
+			tiles.push_back((long long)tile.x * 1000 + tile.y);
+		}
+		std::sort(tiles.begin(), tiles.end());
+		return tiles;
+	}
+
+	// Tiles of [0, 2) x [0, 2) holding the single instance of the given placement seed
+	unsigned int tilesOfSeed(const Store & store, unsigned int seed)
+	{
+		unsigned int count = 0;
+		for (int i = 0; i < 2; i++)
+		{
+			for (int j = 0; j < 2; j++)
+			{
+				const std::vector<Store::Instance> & instances = store.getTile(i, j);
+				count += (instances.size() == 1 && instances[0].type == seed) ? 1 : 0;
+			}
+		}
+		return count;
+	}
+}
+
+// The instance store lists the tiles which got their instances or were released, also by a placement change, so their
+// shadows are rendered again
+TEST_CASE(instanceStoreChangedTiles)
+{
+	GatedGenerator generator;
+	Store store(generator.get(), Engine::VegetationPlacement::getSettingsParameters(), 64);
+
+	store.update(0, 3, 0, 2);
+	store.flush();
+	CHECK(sortedChanges(store) == std::vector<long long>({ 0, 1, 1000, 1001, 2000, 2001 }));
+
+	// Nothing changes while the area stays
+	store.update(0, 3, 0, 2);
+	CHECK(store.getChangedTiles().empty());
+
+	// Moving the area releases the column left behind, and the new one is listed once generated
+	store.update(1, 4, 0, 2);
+	CHECK(sortedChanges(store) == std::vector<long long>({ 0, 1 }));
+	store.flush();
+	CHECK(sortedChanges(store) == std::vector<long long>({ 0, 1, 3000, 3001 }));
+	store.update(1, 4, 0, 2);
+	CHECK(store.getChangedTiles().empty());
+
+	// A new placement releases every tile, which is listed on the next update, and again once generated
+	Engine::VegetationPlacement::Parameters params = Engine::VegetationPlacement::getSettingsParameters();
+	params.seed++;
+	store.setPlacementParameters(params);
+	CHECK(store.getChangedTiles().empty());
+	store.update(1, 4, 0, 2);
+	CHECK(sortedChanges(store) == std::vector<long long>({ 1000, 1001, 2000, 2001, 3000, 3001 }));
+	CHECK(store.getStatistics().releasedTiles == 6);
+	store.flush();
+	CHECK(sortedChanges(store) == std::vector<long long>({ 1000, 1000, 1001, 1001, 2000, 2000, 2001, 2001, 3000, 3000, 3001, 3001 }));
+	store.update(1, 4, 0, 2);
+	CHECK(store.getChangedTiles().empty());
+	CHECK(store.getStatistics().releasedTiles == 0);
+}
+
+// Tiles still being generated when the store is cleared are dropped when they finish, and the area is
+// generated again on the next update
+TEST_CASE(instanceStoreClearWhileGenerating)
+{
+	Engine::Tests::restartPool(2);
+	GatedGenerator generator;
+	const Engine::VegetationPlacement::Parameters params = Engine::VegetationPlacement::getSettingsParameters();
+	Store store(generator.get(), params, 64);
+
+	generator.open = false;
+	store.update(0, 2, 0, 2);
+	CHECK(store.getStatistics().pendingTiles == 4);
+	store.clear();
+	generator.open = true;
+	store.flush();
+
+	// The stale results ran, but were not stored nor listed
+	CHECK(generator.calls.load() == 4);
+	CHECK(store.getStatistics().residentTiles == 0);
+	CHECK(store.getStatistics().totalGeneratedTiles == 0);
+	CHECK(store.getStatistics().memoryUsed == 0);
+	CHECK(store.getChangedTiles().empty());
+	CHECK(tilesOfSeed(store, params.seed) == 0);
+
+	store.update(0, 2, 0, 2);
+	store.flush();
+	CHECK(generator.calls.load() == 8);
+	CHECK(store.getStatistics().residentTiles == 4);
+	CHECK(store.getStatistics().totalGeneratedTiles == 4);
+	CHECK(sortedChanges(store) == std::vector<long long>({ 0, 1, 1000, 1001 }));
+	CHECK(tilesOfSeed(store, params.seed) == 4);
+
+	// Only the resident tiles are listed as released
+	store.clear();
+	store.update(0, 2, 0, 2);
+	CHECK(sortedChanges(store) == std::vector<long long>({ 0, 1, 1000, 1001 }));
+	store.flush();
+
+	Engine::Tests::restartPool(0);
+}
+
+// Changing the placement while tiles are being generated keeps only the tiles of the new placement, even
+// with the old ones finishing afterwards. Setting the same placement again keeps the tiles
+TEST_CASE(instanceStorePlacementChangeWhileGenerating)
+{
+	Engine::Tests::restartPool(2);
+	GatedGenerator generator;
+	const Engine::VegetationPlacement::Parameters oldParams = Engine::VegetationPlacement::getSettingsParameters();
+	Engine::VegetationPlacement::Parameters newParams = oldParams;
+	newParams.seed = oldParams.seed + 1;
+	Store store(generator.get(), oldParams, 64);
+
+	// Both generations are in flight at once
+	generator.open = false;
+	store.update(0, 2, 0, 2);
+	store.setPlacementParameters(newParams);
+	store.update(0, 2, 0, 2);
+	CHECK(store.getStatistics().pendingTiles == 8);
+	generator.open = true;
+	store.flush();
+
+	CHECK(generator.calls.load() == 8);
+	CHECK(store.getStatistics().residentTiles == 4);
+	CHECK(store.getStatistics().totalGeneratedTiles == 4);
+	CHECK(tilesOfSeed(store, newParams.seed) == 4);
+	CHECK(tilesOfSeed(store, oldParams.seed) == 0);
+
+	const unsigned long long version = store.getVersion();
+	store.setPlacementParameters(newParams);
+	store.update(0, 2, 0, 2);
+	CHECK(store.getVersion() == version);
+	CHECK(store.getChangedTiles().empty());
+	CHECK(tilesOfSeed(store, newParams.seed) == 4);
+
+	Engine::Tests::restartPool(0);
+}
@@ -0,0 +1,190 @@
+#include "TestSuite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "TerrainHeightField.h"
+#include "VegetationPlacement.h"
+
+#include <glm/glm.hpp>
+
+namespace
+{
+	// Finite differences of computeNormal() in terrain.frag, in double precision on the scalar height field
+	double referenceSlopeCos(const Engine::TerrainHeightField & field, float u, float v)
+	{
+		const double step = 0.01, heightScale = 0.01;
+		const glm::dvec3 normal = glm::normalize(glm::dvec3(
+			(double(field.getNoiseHeight(u - 0.01f, v)) - double(field.getNoiseHeight(u + 0.01f, v))) * heightScale,
+			step * step,
+			(double(field.getNoiseHeight(u, v - 0.01f)) - double(field.getNoiseHeight(u, v + 0.01f))) * heightScale));
+		return normal.y;
+	}
+
+	// Random world positions over a few tiles around the origin, on both signs of the axes
+	void randomPositions(std::vector<float> & x, std::vector<float> & z, size_t count, float tileWidth, unsigned int seed)
+	{
+		std::default_random_engine engine(seed);
+		std::uniform_real_distribution<float> position(-4.0f * tileWidth, 4.0f * tileWidth);
+		x.resize(count);
+		z.resize(count);
+		for (size_t k = 0; k < count; k++)
+		{
+			x[k] = position(engine);
+			z[k] = position(engine);
+		}
+	}
+
+	float quantile(std::vector<float> values, float q)
+	{
+		std::sort(values.begin(), values.end());
+		return values[size_t(q * float(values.size() - 1))];
+	}
+}
+
+// The random values only depend on the seed, the tile, the kind and the index: the same for a given world seed,
+// different for another one or for any other input, and uniform in [0, 1)
+TEST_CASE(vegetationPlacementRandom)
+{
+	Engine::VegetationPlacement::Parameters params = Engine::VegetationPlacement::getSettingsParameters();
+	params.seed = 1234;
+	const Engine::VegetationPlacement placement(params);
+	const Engine::VegetationPlacement same(params);
+	params.seed = 1235;
+	const Engine::VegetationPlacement other(params);
+
+	size_t differences = 0, sameAsOtherSeed = 0, sameAsNeighbour = 0, outOfRange = 0, samples = 0;
+	unsigned int buckets[16] = {};
+	for (int i = -8; i < 8; i++)
+	{
+		for (int j = -8; j < 8; j++)
+		{
+			for (unsigned int kind = 0; kind < 4; kind++)
+			{
+				for (unsigned int index = 0; index < 64; index++)
+				{
+					const float value = placement.random(i, j, kind, index);
+					differences += (value != same.random(i, j, kind, index) || value != placement.random(i, j, kind, index)) ? 1 : 0;
+					sameAsOtherSeed += value == other.random(i, j, kind, index) ? 1 : 0;
+					sameAsNeighbour += (value == placement.random(i + 1, j, kind, index) || value == placement.random(i, j + 1, kind, index)
+						|| value == placement.random(i, j, kind + 1, index) || value == placement.random(i, j, kind, index + 1)) ? 1 : 0;
+					outOfRange += (value < 0.0f || value >= 1.0f) ? 1 : 0;
+					buckets[std::min(unsigned(value * 16.0f), 15u)]++;
+					samples++;
+				}
+			}
+		}
+	}
+
+	CHECK(differences == 0);
+	CHECK(outOfRange == 0);
+	// Values have 24 bits, so a few collisions are expected out of 65536 samples
+	CHECK(sameAsOtherSeed < 10);
+	CHECK(sameAsNeighbour < 40);
+	for (unsigned int bucket : buckets)
+	{
+		CHECK_NEAR(double(bucket) / double(samples), 1.0 / 16.0, 0.005);
+	}
+}
+
+// Heights are those of the terrain surface, and the height and water masks accept exactly the noise heights
+// within the vegetation range. Evaluating twice, or with another seed, gives the same result
+TEST_CASE(vegetationPlacementHeightMask)
+{
+	Engine::VegetationPlacement::Parameters params = Engine::VegetationPlacement::getSettingsParameters();
+	const Engine::TerrainHeightField field(params.terrain);
+	const float tileWidth = params.terrain.tileWidth;
+
+	const size_t count = 20000;
+	std::vector<float> x, z;
+	randomPositions(x, z, count, tileWidth, 29);
+
+	// Range around the median noise height, so both masks reject part of the samples. No slope mask
+	std::vector<float> noise(count);
+	for (size_t k = 0; k < count; k++)
+	{
+		noise[k] = field.getNoiseHeight(fabsf(x[k] / tileWidth), fabsf(z[k] / tileWidth));
+	}
+	params.minHeight = quantile(noise, 0.3f);
+	params.maxHeight = quantile(noise, 0.7f);
+	params.minSlopeCos = -1.0f;
+	const Engine::VegetationPlacement placement(params);
+
+	std::vector<float> heights(count), heightsAgain(count);
+	std::vector<unsigned char> accepted(count), acceptedAgain(count);
+	placement.evaluate(x.data(), z.data(), heights.data(), accepted.data(), count);
+
+	size_t heightErrors = 0, maskErrors = 0, numAccepted = 0;
+	for (size_t k = 0; k < count; k++)
+	{
+		const float height = field.getHeight(x[k], z[k]);
+		heightErrors += memcmp(&heights[k], &height, sizeof(float)) != 0 ? 1 : 0;
+		const bool inRange = noise[k] > params.minHeight && noise[k] < params.maxHeight;
+		maskErrors += (accepted[k] != 0) != inRange ? 1 : 0;
+		numAccepted += accepted[k];
+	}
+	CHECK(heightErrors == 0);
+	CHECK(maskErrors == 0);
+	CHECK(numAccepted > count / 3 && numAccepted < count / 2);
+
+	placement.evaluate(x.data(), z.data(), heightsAgain.data(), acceptedAgain.data(), count);
+	CHECK(heights == heightsAgain);
+	CHECK(accepted == acceptedAgain);
+
+	params.seed++;
+	const Engine::VegetationPlacement otherSeed(params);
+	otherSeed.evaluate(x.data(), z.data(), heightsAgain.data(), acceptedAgain.data(), count);
+	CHECK(heights == heightsAgain);
+	CHECK(accepted == acceptedAgain);
+}
+
+// The slope mask follows the finite differences normal of the terrain shader. Samples whose slope is within
+// float rounding of the threshold are not compared
+TEST_CASE(vegetationPlacementSlopeMask)
+{
+	Engine::VegetationPlacement::Parameters params = Engine::VegetationPlacement::getSettingsParameters();
+	const Engine::TerrainHeightField field(params.terrain);
+	const float tileWidth = params.terrain.tileWidth;
+
+	const size_t count = 20000;
+	std::vector<float> x, z;
+	randomPositions(x, z, count, tileWidth, 31);
+
+	// Every height accepted, and the slope threshold on the median slope
+	std::vector<float> slopes(count);
+	for (size_t k = 0; k < count; k++)
+	{
+		slopes[k] = float(referenceSlopeCos(field, fabsf(x[k] / tileWidth), fabsf(z[k] / tileWidth)));
+	}
+	params.minHeight = -1e30f;
+	params.maxHeight = 1e30f;
+	params.minSlopeCos = quantile(slopes, 0.5f);
+	const Engine::VegetationPlacement placement(params);
+
+	std::vector<float> heights(count);
+	std::vector<unsigned char> accepted(count);
+	placement.evaluate(x.data(), z.data(), heights.data(), accepted.data(), count);
+
+	size_t maskErrors = 0, compared = 0, numAccepted = 0;
+	for (size_t k = 0; k < count; k++)
+	{
+		numAccepted += accepted[k];
+		if (fabsf(slopes[k] - params.minSlopeCos) < 1e-5f)
+		{
+			continue;
+		}
+		maskErrors += (accepted[k] != 0) != (slopes[k] > params.minSlopeCos) ? 1 : 0;
+		compared++;
+	}
+
+	std::ostringstream os;
+	os << compared << " of " << count << " samples compared, slope threshold " << params.minSlopeCos << ", " << numAccepted << " accepted";
+	Engine::Tests::TestSuite::report(os.str());
+	CHECK(maskErrors == 0);
+	CHECK(compared > count * 9 / 10);
+	CHECK(numAccepted > count * 4 / 10 && numAccepted < count * 6 / 10);
+}
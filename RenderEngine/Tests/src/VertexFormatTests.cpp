@@ -0,0 +1,291 @@
+#include "TestSuite.h"
+#include "TestMeshes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <sstream>
+
+#include "VertexFormat.h"
+#include "datatables/MeshTable.h"
+#include "vegetation/FractalTree.h"
+
+namespace
+{
+	std::unique_ptr<Engine::Mesh> generateTree()
+	{
+		Engine::Tests::registerTreeShapes();
+		Engine::FractalTree tree(Engine::Tests::createTreeSpecies(1)[0]);
+		return std::unique_ptr<Engine::Mesh>(tree.generateCPU());
+	}
+
+	// Same as the private Mesh::getAttributeData
+	void getAttributeData(const Engine::Mesh & mesh, const float * data[Engine::VERTEX_ATTRIB_COUNT])
+	{
+		data[Engine::VERTEX_ATTRIB_POSITION] = mesh.getVertices();
+		data[Engine::VERTEX_ATTRIB_NORMAL] = mesh.getNormals();
+		data[Engine::VERTEX_ATTRIB_COLOR] = mesh.getColor();
+		data[Engine::VERTEX_ATTRIB_EMISSION] = mesh.getEmissive();
+		data[Engine::VERTEX_ATTRIB_UV] = mesh.getUVs();
+		data[Engine::VERTEX_ATTRIB_TANGENT] = mesh.getTangetns();
+	}
+
+	// Bytes per vertex of the mesh attributes stored with the given format (summing every buffer when not interleaved)
+	unsigned int getBytesPerVertex(const Engine::Mesh & mesh, Engine::VertexFormat format)
+	{
+		const float * data[Engine::VERTEX_ATTRIB_COUNT];
+		getAttributeData(mesh, data);
+		format.computeLayout(data);
+		if (format.isInterleaved())
+		{
+			return format.getVertexSize();
+		}
+
+		unsigned int size = 0;
+		for (unsigned int i = 0; i < Engine::VERTEX_ATTRIB_COUNT; i++)
+		{
+			size += format.getAttribute(Engine::VertexAttribute(i)).present ? format.getAttribute(Engine::VertexAttribute(i)).stride : 0;
+		}
+		return size;
+	}
+}
+
+TEST_CASE(vertexFormatLayout)
+{
+	std::unique_ptr<Engine::Mesh> tree = generateTree();
+	const float * data[Engine::VERTEX_ATTRIB_COUNT];
+	getAttributeData(*tree, data);
+
+	// Position, normal, color and emission (3 floats each) and uv (2 floats)
+	Engine::VertexFormat interleaved(true);
+	interleaved.computeLayout(data);
+	CHECK(interleaved.getVertexSize() == 56);
+	CHECK(interleaved.getAttribute(Engine::VERTEX_ATTRIB_POSITION).offset == 0);
+	CHECK(interleaved.getAttribute(Engine::VERTEX_ATTRIB_NORMAL).offset == 12);
+	CHECK(interleaved.getAttribute(Engine::VERTEX_ATTRIB_UV).offset == 48);
+	CHECK(interleaved.getAttribute(Engine::VERTEX_ATTRIB_UV).stride == 56);
+	CHECK(!interleaved.getAttribute(Engine::VERTEX_ATTRIB_TANGENT).present);
+
+	// Position 12, octahedral normal 4, unorm8 color and emission 4 + 4, half uv 4
+	Engine::VertexFormat quantized = Engine::VertexFormat::quantized(true);
+	quantized.computeLayout(data);
+	CHECK(quantized.getVertexSize() == 28);
+
+	Engine::VertexFormat separate;
+	separate.computeLayout(data);
+	CHECK(separate.getAttribute(Engine::VERTEX_ATTRIB_NORMAL).offset == 0);
+	CHECK(separate.getAttribute(Engine::VERTEX_ATTRIB_NORMAL).stride == 12);
+	CHECK(separate.getAttribute(Engine::VERTEX_ATTRIB_UV).stride == 8);
+
+	// Float interleaved packing keeps every value as it is
+	const unsigned int numVertices = tree->getNumVertices();
+	std::vector<unsigned char> packed(size_t(numVertices) * interleaved.getVertexSize());
+	interleaved.packInterleaved(data, numVertices, packed.data());
+	for (unsigned int i = 0; i < Engine::VERTEX_ATTRIB_COUNT; i++)
+	{
+		const Engine::VertexAttributeFormat & attribute = interleaved.getAttribute(Engine::VertexAttribute(i));
+		if (!attribute.present)
+		{
+			continue;
+		}
+
+		bool same = true;
+		for (unsigned int v = 0; v < numVertices && same; v++)
+		{
+			same = memcmp(packed.data() + v * attribute.stride + attribute.offset, data[i] + v * attribute.components, attribute.components * sizeof(float)) == 0;
+		}
+		CHECK(same);
+	}
+}
+
+// Octahedral snorm16 unit vectors, on random directions and on the axes
+TEST_CASE(vertexFormatOctahedralError)
+{
+	std::default_random_engine engine(7);
+	std::normal_distribution<float> normal(0.0f, 1.0f);
+
+	double maxAngle = 0.0;
+	for (unsigned int i = 0; i < 1000000; i++)
+	{
+		float v[3] = { normal(engine), normal(engine), normal(engine) };
+		const float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (length < 1e-6f)
+		{
+			continue;
+		}
+		v[0] /= length; v[1] /= length; v[2] /= length;
+
+		short encoded[2];
+		float decoded[3];
+		Engine::encodeOctahedral(v, encoded);
+		Engine::decodeOctahedral(encoded, decoded);
+
+		CHECK_NEAR(sqrt(double(decoded[0]) * decoded[0] + double(decoded[1]) * decoded[1] + double(decoded[2]) * decoded[2]), 1.0, 1e-6);
+		// atan2 of the cross and dot products, acos is too imprecise close to 1
+		const double cx = double(v[1]) * decoded[2] - double(v[2]) * decoded[1];
+		const double cy = double(v[2]) * decoded[0] - double(v[0]) * decoded[2];
+		const double cz = double(v[0]) * decoded[1] - double(v[1]) * decoded[0];
+		const double dot = double(v[0]) * decoded[0] + double(v[1]) * decoded[1] + double(v[2]) * decoded[2];
+		maxAngle = std::max(maxAngle, atan2(sqrt(cx * cx + cy * cy + cz * cz), dot) * 180.0 / 3.14159265358979);
+	}
+	Engine::Tests::TestSuite::report("max octahedral error: " + std::to_string(maxAngle) + " degrees");
+	CHECK(maxAngle < 0.01);
+
+	for (unsigned int axis = 0; axis < 6; axis++)
+	{
+		float v[3] = { 0.0f, 0.0f, 0.0f };
+		v[axis % 3] = axis < 3 ? 1.0f : -1.0f;
+
+		short encoded[2];
+		float decoded[3];
+		Engine::encodeOctahedral(v, encoded);
+		Engine::decodeOctahedral(encoded, decoded);
+		CHECK(decoded[0] == v[0] && decoded[1] == v[1] && decoded[2] == v[2]);
+	}
+}
+
+TEST_CASE(vertexFormatHalfError)
+{
+	// Every half but NaN converts to a float and back to itself
+	for (unsigned int h = 0; h < 0x10000u; h++)
+	{
+		const float f = Engine::halfToFloat((unsigned short)h);
+		if (std::isnan(f))
+		{
+			CHECK((h & 0x7c00u) == 0x7c00u && (h & 0x3ffu) != 0);
+			CHECK(std::isnan(Engine::halfToFloat(Engine::floatToHalf(f))));
+			continue;
+		}
+		CHECK(Engine::floatToHalf(f) == h);
+	}
+
+	// Ties round to even
+	CHECK(Engine::halfToFloat(Engine::floatToHalf(1.0f + ldexpf(1.0f, -11))) == 1.0f);
+	CHECK(Engine::halfToFloat(Engine::floatToHalf(1.0f + 3.0f * ldexpf(1.0f, -11))) == 1.0f + ldexpf(1.0f, -9));
+	// Overflow and underflow
+	CHECK(std::isinf(Engine::halfToFloat(Engine::floatToHalf(65536.0f))));
+	CHECK(Engine::halfToFloat(Engine::floatToHalf(65504.0f)) == 65504.0f);
+	CHECK(Engine::halfToFloat(Engine::floatToHalf(ldexpf(1.0f, -26))) == 0.0f);
+	CHECK(Engine::halfToFloat(Engine::floatToHalf(-ldexpf(1.0f, -24))) == -ldexpf(1.0f, -24));
+
+	// Relative error of normal values, at most half an ulp
+	std::default_random_engine engine(11);
+	std::uniform_real_distribution<float> value(-60000.0f, 60000.0f);
+	double maxRelative = 0.0;
+	for (unsigned int i = 0; i < 1000000; i++)
+	{
+		const float f = value(engine);
+		if (fabsf(f) < ldexpf(1.0f, -14))
+		{
+			continue;
+		}
+		maxRelative = std::max(maxRelative, fabs(double(Engine::halfToFloat(Engine::floatToHalf(f))) - f) / fabs(f));
+	}
+	CHECK(maxRelative <= ldexp(1.0, -11));
+}
+
+TEST_CASE(vertexFormatUnorm8Error)
+{
+	double maxError = 0.0;
+	for (unsigned int i = 0; i <= 100000; i++)
+	{
+		const float f = float(i) / 100000.0f;
+		maxError = std::max(maxError, fabs(double(Engine::unorm8ToFloat(Engine::floatToUnorm8(f))) - f));
+	}
+	CHECK(maxError <= 1.0 / 510.0 + 1e-7);
+
+	for (unsigned int u = 0; u < 256; u++)
+	{
+		CHECK(Engine::floatToUnorm8(Engine::unorm8ToFloat((unsigned char)u)) == u);
+	}
+	CHECK(Engine::floatToUnorm8(-0.5f) == 0);
+	CHECK(Engine::floatToUnorm8(7.0f) == 255);
+}
+
+// Quantized packing writes the encoded value of each attribute at its offset
+TEST_CASE(vertexFormatQuantizedPacking)
+{
+	std::unique_ptr<Engine::Mesh> tree = generateTree();
+	const float * data[Engine::VERTEX_ATTRIB_COUNT];
+	getAttributeData(*tree, data);
+
+	Engine::VertexFormat format = Engine::VertexFormat::quantized(true);
+	format.computeLayout(data);
+	const unsigned int numVertices = tree->getNumVertices();
+	std::vector<unsigned char> packed(size_t(numVertices) * format.getVertexSize());
+	format.packInterleaved(data, numVertices, packed.data());
+
+	const Engine::VertexAttributeFormat & normal = format.getAttribute(Engine::VERTEX_ATTRIB_NORMAL);
+	const Engine::VertexAttributeFormat & color = format.getAttribute(Engine::VERTEX_ATTRIB_COLOR);
+	const Engine::VertexAttributeFormat & uv = format.getAttribute(Engine::VERTEX_ATTRIB_UV);
+	for (unsigned int v = 0; v < numVertices; v++)
+	{
+		const unsigned char * vertex = packed.data() + size_t(v) * format.getVertexSize();
+		CHECK(memcmp(vertex, data[Engine::VERTEX_ATTRIB_POSITION] + v * 3, 3 * sizeof(float)) == 0);
+
+		short encoded[2];
+		float decoded[3];
+		memcpy(encoded, vertex + normal.offset, sizeof(encoded));
+		Engine::decodeOctahedral(encoded, decoded);
+		const float * n = data[Engine::VERTEX_ATTRIB_NORMAL] + v * 3;
+		const float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		CHECK((decoded[0] * n[0] + decoded[1] * n[1] + decoded[2] * n[2]) / length > 0.99999f);
+
+		for (unsigned int c = 0; c < 3; c++)
+		{
+			CHECK(vertex[color.offset + c] == Engine::floatToUnorm8(data[Engine::VERTEX_ATTRIB_COLOR][v * 3 + c]));
+		}
+		for (unsigned int c = 0; c < 2; c++)
+		{
+			unsigned short half;
+			memcpy(&half, vertex + uv.offset + c * sizeof(unsigned short), sizeof(half));
+			CHECK(half == Engine::floatToHalf(data[Engine::VERTEX_ATTRIB_UV][v * 2 + c]));
+		}
+	}
+}
+
+// Bytes per vertex of the trunk, leaf and tree meshes on each layout, and packing throughput of a tree
+BENCHMARK(vertexFormatPacking)
+{
+	std::unique_ptr<Engine::Mesh> tree = generateTree();
+	Engine::MeshTable & table = Engine::MeshTable::getInstance();
+	const Engine::Mesh * meshes[] = { table.getMesh("trunk"), table.getMesh("leaf"), tree.get() };
+	const char * names[] = { "trunk", "leaf", "tree" };
+
+	for (unsigned int m = 0; m < 3; m++)
+	{
+		std::ostringstream os;
+		os << names[m] << " (" << meshes[m]->getNumVertices() << " vertices): " << getBytesPerVertex(*meshes[m], Engine::VertexFormat())
+			<< " bytes/vertex separate, " << getBytesPerVertex(*meshes[m], Engine::VertexFormat(true)) << " interleaved, "
+			<< getBytesPerVertex(*meshes[m], Engine::VertexFormat::quantized(true)) << " quantized interleaved";
+		Engine::Tests::TestSuite::report(os.str());
+	}
+
+	const float * data[Engine::VERTEX_ATTRIB_COUNT];
+	getAttributeData(*tree, data);
+	const unsigned int numVertices = tree->getNumVertices();
+	const unsigned int rounds = 2000;
+
+	Engine::VertexFormat formats[] = { Engine::VertexFormat(true), Engine::VertexFormat::quantized(true) };
+	const char * formatNames[] = { "interleaved", "quantized interleaved" };
+	for (unsigned int f = 0; f < 2; f++)
+	{
+		formats[f].computeLayout(data);
+		std::vector<unsigned char> packed(size_t(numVertices) * formats[f].getVertexSize());
+
+		Engine::Tests::Stopwatch watch;
+		for (unsigned int r = 0; r < rounds; r++)
+		{
+			formats[f].packInterleaved(data, numVertices, packed.data());
+		}
+		const double seconds = watch.getSeconds();
+
+		std::ostringstream os;
+		os << std::fixed << std::setprecision(1) << formatNames[f] << " packing: " << (double(rounds) * numVertices / seconds * 1e-6)
+			<< " Mvert/s, " << (double(rounds) * packed.size() / seconds * 1e-9) << " GB/s written";
+		Engine::Tests::TestSuite::report(os.str());
+	}
+}
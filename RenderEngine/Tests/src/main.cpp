@@ -0,0 +1,31 @@
+/**
+* @author Nadir Romn Guerrero
+* @email nadir.ro.gue@gmail.com
+*/
+
+#include <iostream>
+#include <string>
+
+#include "TestSuite.h"
+
+// Runs the engine CPU tests. Usage: Tests [--bench] [name filter]
+// --bench also runs the benchmarks. The exit code is the number of failed cases
+int main(int argc, char ** argv)
+{
+	bool benchmarks = false;
+	std::string filter;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg(argv[i]);
+		if (arg == "--bench")
+		{
+			benchmarks = true;
+		}
+		else
+		{
+			filter = arg;
+		}
+	}
+
+	return Engine::Tests::TestSuite::run(benchmarks, filter);
+}